@@ -0,0 +1,76 @@
+#ifndef HOST_IDF_H
+#define HOST_IDF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "mqtt_client.h"
+#include "driver/spi_master.h"
+#include "esp_wifi.h"
+
+/*
+ * Controles do ESP-IDF de mentira (host_idf.c) para os testes no host.
+ * Tarefas rodam em pthreads; o relógio é o monotônico do host, ou um relógio
+ * virtual que só anda em vTaskDelay (testes do driver, determinísticos).
+ */
+
+// --- Relógio ---
+void host_clock_set_virtual(bool virtual_clock);
+void host_clock_advance_us(int64_t us);
+
+/* Chamado depois de cada vTaskDelay com o relógio virtual, da própria tarefa que dormiu */
+typedef void (*host_delay_hook_t)(TaskHandle_t task, int64_t now_us);
+void host_set_delay_hook(host_delay_hook_t hook);
+
+/* Encerra a tarefa que chamou (pthread_exit); usado pelo hook para terminar um roteiro */
+void host_task_exit(void);
+
+// --- Tarefas ---
+typedef struct {
+    char name[16];
+    BaseType_t core_id;
+    UBaseType_t priority;
+    bool static_storage;
+    TaskHandle_t handle;
+} host_task_info_t;
+
+/* Procura uma tarefa criada pelo nome; false se não existe */
+bool host_task_info(const char* name, host_task_info_t* out_info);
+
+/* Faz as próximas n criações de tarefa falharem (sem memória) */
+void host_task_fail_next(int n);
+
+/* Espera a tarefa terminar (vTaskDelete(NULL) ou host_task_exit) */
+void host_task_join(TaskHandle_t task);
+
+// --- MQTT: o teste faz o papel do broker ---
+typedef int (*host_mqtt_publish_hook_t)(const char* topic, const char* data, int len, int qos);
+void host_set_mqtt_publish_hook(host_mqtt_publish_hook_t hook);
+esp_mqtt_client_handle_t host_mqtt_client(void);
+
+// --- SPI: o teste faz o papel do chip ---
+typedef esp_err_t (*host_spi_transfer_hook_t)(spi_transaction_t* transaction);
+void host_set_spi_transfer_hook(host_spi_transfer_hook_t hook);
+/* Faz as próximas n chamadas a spi_bus_add_device falharem */
+void host_spi_fail_add_next(int n);
+/* Clock do dispositivo SPI registrado (0 se nenhum) */
+int host_spi_device_clock(void);
+
+// --- Wi-Fi: último modo de power save pedido (esp_wifi_set_ps) ---
+wifi_ps_type_t host_wifi_ps(void);
+
+// --- I2C: bytes enviados, endereço incluído; o hook recebe cada escrita (sem o byte de endereço) ---
+typedef void (*host_i2c_write_hook_t)(uint8_t address, const uint8_t* data, size_t length);
+uint32_t host_i2c_bytes(void);
+void host_set_i2c_write_hook(host_i2c_write_hook_t hook);
+
+// --- cJSON: alocação pelos hooks instalados em cJSON_InitHooks (malloc/free sem hooks) ---
+void* host_cjson_malloc(size_t size);
+void host_cjson_free(void* ptr);
+
+// --- Log: acima deste nível não imprime (padrão ESP_LOG_WARN) ---
+void host_set_log_level(esp_log_level_t level);
+
+#endif
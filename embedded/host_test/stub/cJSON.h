@@ -0,0 +1,25 @@
+#pragma once
+// Só as declarações: os testes não decodificam JSON
+#include <stddef.h>
+
+typedef struct cJSON {
+    struct cJSON* next;
+    struct cJSON* child;
+    int type;
+    char* valuestring;
+    int valueint;
+    double valuedouble;
+    char* string;
+} cJSON;
+
+typedef struct {
+    void* (*malloc_fn)(size_t size);
+    void (*free_fn)(void* ptr);
+} cJSON_Hooks;
+
+void cJSON_InitHooks(cJSON_Hooks* hooks);
+cJSON* cJSON_ParseWithLength(const char* value, size_t length);
+void cJSON_Delete(cJSON* item);
+cJSON* cJSON_GetObjectItemCaseSensitive(const cJSON* object, const char* name);
+int cJSON_IsString(const cJSON* item);
+int cJSON_IsNumber(const cJSON* item);
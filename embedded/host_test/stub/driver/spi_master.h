@@ -0,0 +1,42 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef int spi_host_device_t;
+typedef struct host_spi_device* spi_device_handle_t;
+
+#define VSPI_HOST               2
+#define SPI_DEVICE_HALFDUPLEX   (1 << 4)
+#define SPI_TRANS_USE_RXDATA    (1 << 2)
+#define SPI_TRANS_USE_TXDATA    (1 << 3)
+
+typedef struct {
+    int miso_io_num;
+    int mosi_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+} spi_bus_config_t;
+
+typedef struct {
+    int clock_speed_hz;
+    int mode;
+    int spics_io_num;
+    int queue_size;
+    uint32_t flags;
+} spi_device_interface_config_t;
+
+typedef struct {
+    uint32_t flags;
+    size_t length;
+    size_t rxlength;
+    void* user;
+    union { const void* tx_buffer; uint8_t tx_data[4]; };
+    union { void* rx_buffer; uint8_t rx_data[4]; };
+} spi_transaction_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* config, int dma_chan);
+esp_err_t spi_bus_free(spi_host_device_t host);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* config,
+                             spi_device_handle_t* out_handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* transaction);
@@ -0,0 +1,34 @@
+#pragma once
+// Stand-in do ESP-IDF para os testes no host: só o que o firmware usa
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                          0
+#define ESP_FAIL                        -1
+#define ESP_ERR_NO_MEM                  0x101
+#define ESP_ERR_INVALID_ARG             0x102
+#define ESP_ERR_INVALID_STATE           0x103
+#define ESP_ERR_INVALID_SIZE            0x104
+#define ESP_ERR_NOT_FOUND               0x105
+#define ESP_ERR_NOT_SUPPORTED           0x106
+#define ESP_ERR_TIMEOUT                 0x107
+#define ESP_ERR_INVALID_CRC             0x109
+#define ESP_ERR_NVS_NO_FREE_PAGES       0x1100
+#define ESP_ERR_NVS_NOT_FOUND           0x1102
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   0x1110
+
+const char* esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK(x) do {                                                        \
+        esp_err_t err_rc_ = (x);                                                       \
+        if (err_rc_ != ESP_OK) {                                                       \
+            host_abort_on_error(err_rc_, __FILE__, __LINE__, #x);                      \
+        }                                                                              \
+    } while (0)
+
+void host_abort_on_error(esp_err_t err, const char* file, int line, const char* expr);
@@ -0,0 +1,20 @@
+#pragma once
+#include "esp_event.h"
+
+typedef struct { uint32_t addr; } esp_ip4_addr_t;
+typedef struct { esp_ip4_addr_t ip, netmask, gw; } esp_netif_ip_info_t;
+typedef struct host_netif esp_netif_t;
+
+esp_err_t esp_netif_init(void);
+esp_netif_t* esp_netif_create_default_wifi_sta(void);
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t* netif);
+esp_err_t esp_netif_set_ip_info(esp_netif_t* netif, const esp_netif_ip_info_t* info);
+uint32_t esp_ip4addr_aton(const char* addr);
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(a) (int) ((a)->addr & 0xFF), (int) (((a)->addr >> 8) & 0xFF), \
+                  (int) (((a)->addr >> 16) & 0xFF), (int) (((a)->addr >> 24) & 0xFF)
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+typedef enum { IP_EVENT_STA_GOT_IP, IP_EVENT_STA_LOST_IP } ip_event_t;
+typedef struct { esp_netif_ip_info_t ip_info; } ip_event_got_ip_t;
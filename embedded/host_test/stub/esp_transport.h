@@ -0,0 +1,8 @@
+#pragma once
+#include "esp_err.h"
+
+typedef struct host_transport* esp_transport_handle_t;
+
+esp_transport_handle_t esp_transport_tcp_init(void);
+esp_err_t esp_transport_set_default_port(esp_transport_handle_t transport, int port);
+int esp_transport_get_socket(esp_transport_handle_t transport);
@@ -0,0 +1,48 @@
+#pragma once
+// FreeRTOS do host: tarefas são pthreads, seções críticas são um mutex global (host_idf.c)
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+typedef uint32_t EventBits_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t) 0xFFFFFFFF)
+#define configTICK_RATE_HZ      100     // Como CONFIG_FREERTOS_HZ no sdkconfig
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks)    ((uint32_t) (ticks) * portTICK_PERIOD_MS)
+#define tskNO_AFFINITY          0x7FFFFFFF
+#define configMAX_PRIORITIES    25
+#define tskIDLE_PRIORITY        0
+#define portNUM_PROCESSORS      2
+#define IRAM_ATTR
+
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+
+typedef struct { uint32_t opaque[32]; } StaticTask_t;
+typedef struct { uint32_t opaque[20]; } StaticSemaphore_t;
+typedef struct { uint32_t opaque[20]; } StaticQueue_t;
+typedef struct { uint32_t opaque[12]; } StaticTimer_t;
+typedef struct { uint32_t opaque[8]; } StaticEventGroup_t;
+
+typedef struct { uint32_t owner; uint32_t count; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+#define taskENTER_CRITICAL(mux)     do { (void) (mux); host_critical_enter(); } while (0)
+#define taskEXIT_CRITICAL(mux)      do { (void) (mux); host_critical_exit(); } while (0)
@@ -0,0 +1,30 @@
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "dlog.h"
+#include "host_idf.h"
+#include "test_util.h"
+
+/* O comando "bench" chega no handler do MQTT: pedir a medição não pode prender quem pediu */
+static void test_benchmark(void) {
+    CHECK_EQ(dlog_init(), ESP_OK);
+
+    int64_t start = esp_timer_get_time();
+    CHECK_EQ(dlog_benchmark_start(), ESP_OK);
+    int64_t caller_us = esp_timer_get_time() - start;
+    printf("dlog_benchmark_start: %lld us para quem chama\n", (long long) caller_us);
+    CHECK(caller_us < 50 * 1000);
+    CHECK_EQ(dlog_benchmark_start(), ESP_ERR_INVALID_STATE);
+
+    host_task_info_t info;
+    CHECK(host_task_info("dlog_bench", &info));
+    host_task_join(info.handle);
+    CHECK_EQ(dlog_benchmark_start(), ESP_OK); // Terminou: pode medir de novo
+    CHECK(host_task_info("dlog_bench", &info));
+    host_task_join(info.handle);
+}
+
+TEST_MAIN(
+    { "benchmark", test_benchmark },
+)
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include "host_idf.h"
+#include "lcd_i2c.h"
+#include "test_util.h"
+
+/*
+ * HD44780 atrás do PCF8574, do jeito que o lcd_i2c.c fala com ele: cada byte do
+ * expansor é D7..D4 | BL | E | RW | RS, e o nibble entra na descida do E.
+ */
+static struct {
+    char ddram[2][LCD_DDRAM_LINE_LEN];
+    uint8_t line, addr;     // Contador de endereço
+    uint8_t shift;          // Deslocamento do display para a esquerda, em colunas
+    bool four_bit;
+    bool high_pending;      // Modo 4 bits: já veio o nibble alto
+    uint8_t high;
+    uint8_t last;           // Último byte do expansor, para achar a descida do E
+    uint32_t commands, chars;
+} lcd;
+
+static void lcd_model_reset(void) {
+    memset(&lcd, 0, sizeof(lcd));
+    memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+}
+
+static void lcd_model_byte(uint8_t value, bool rs) {
+    if (rs) {
+        lcd.chars++;
+        lcd.ddram[lcd.line][lcd.addr] = (char) value;
+        lcd.addr = (lcd.addr + 1) % LCD_DDRAM_LINE_LEN;
+        return;
+    }
+    lcd.commands++;
+    if (value & LCD_SET_DDRAM_ADDR) {
+        uint8_t addr = value & 0x7F;
+        lcd.line = addr >= LCD_LINE2_DDRAM_ADDR;
+        lcd.addr = (addr - (lcd.line ? LCD_LINE2_DDRAM_ADDR : 0)) % LCD_DDRAM_LINE_LEN;
+    } else if (value & LCD_FUNCTION_SET) {
+        lcd.four_bit = !(value & 0x10);
+    } else if (value & LCD_CURSOR_SHIFT) {
+        if (value & LCD_DISPLAY_MOVE) {
+            lcd.shift = (lcd.shift + ((value & 0x04) ? LCD_DDRAM_LINE_LEN - 1 : 1)) % LCD_DDRAM_LINE_LEN;
+        }
+    } else if (value & LCD_RETURN_HOME) {
+        lcd.line = lcd.addr = lcd.shift = 0;
+    } else if (value & LCD_CLEAR_DISPLAY) {
+        memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+        lcd.line = lcd.addr = lcd.shift = 0;
+    }
+}
+
+static void lcd_model_write(uint8_t address, const uint8_t* data, size_t length) {
+    CHECK_EQ(address, LCD_I2C_ADDRESS);
+    for (size_t i = 0; i < length; i++) {
+        uint8_t value = data[i];
+        if ((lcd.last & LCD_ENABLE_BIT) && !(value & LCD_ENABLE_BIT)) {
+            uint8_t nibble = value & 0xF0;
+            bool rs = value & LCD_REGISTER_SELECT_BIT;
+            if (!lcd.four_bit) {
+                lcd_model_byte(nibble, rs);  // Na inicialização cada nibble é um comando de 8 bits
+            } else if (!lcd.high_pending) {
+                lcd.high = nibble;
+                lcd.high_pending = true;
+            } else {
+                lcd_model_byte(lcd.high | nibble >> 4, rs);
+                lcd.high_pending = false;
+            }
+        }
+        lcd.last = value;
+    }
+}
+
+/* A linha como aparece na tela, com o deslocamento atual */
+static void lcd_model_visible(uint8_t line, char out[LCD_COLS + 1]) {
+    for (uint8_t col = 0; col < LCD_COLS; col++) {
+        out[col] = lcd.ddram[line][(lcd.shift + col) % LCD_DDRAM_LINE_LEN];
+    }
+    out[LCD_COLS] = '\0';
+}
+
+static void check_screen(const char* line1, size_t offset, const char* line2) {
+    char visible[LCD_COLS + 1], expected[LCD_COLS + 1];
+    lcd_model_visible(0, visible);
+    snprintf(expected, sizeof(expected), "%-16.16s", line1 + offset);
+    if (strcmp(visible, expected) != 0) {
+        fprintf(stderr, "linha 1 no passo %zu: \"%s\", esperado \"%s\"\n", offset, visible, expected);
+    }
+    CHECK(strcmp(visible, expected) == 0);
+    lcd_model_visible(1, visible);
+    snprintf(expected, sizeof(expected), "%-16s", line2);
+    CHECK(strcmp(visible, expected) == 0);
+}
+
+static const char* const NAME = "Chave de fenda Phillips 3/16 isolada";
+
+/*
+ * Uma passada completa do letreiro: a tela confere em cada passo e os bytes I2C de cada
+ * passo são medidos no barramento do host. Retorna os bytes por passo de rolagem.
+ */
+static uint32_t run_pass(const char* line2) {
+    lcd_model_reset();
+    host_set_i2c_write_hook(lcd_model_write);
+    CHECK_EQ(lcd_module_init(), ESP_OK);
+
+    size_t len = strlen(NAME), steps = len - LCD_COLS;
+    uint32_t pass = lcd_marquee_start(NAME, line2);
+    CHECK_EQ(pass, 2 * LCD_MARQUEE_PAUSE_STEPS + steps + 1);
+    CHECK(lcd_marquee_active());
+    check_screen(NAME, 0, line2);
+
+    uint32_t scroll_bytes = 0;
+    size_t offset = 0;
+    for (uint32_t step = 0; step < pass; step++) {
+        uint32_t before = host_i2c_bytes(), counted = lcd_i2c_bytes_sent();
+        lcd_marquee_step();
+        uint32_t spent = host_i2c_bytes() - before;
+        CHECK_EQ(lcd_i2c_bytes_sent() - counted, spent);  // A conta do driver bate com o barramento
+        if (step < LCD_MARQUEE_PAUSE_STEPS) {
+            CHECK_EQ(spent, 0);  // Pausa no começo
+        } else if (offset < steps && spent) {
+            offset++;
+            scroll_bytes += spent;
+        } else if (step == pass - 1) {
+            offset = 0;  // Volta ao início
+        }
+        check_screen(NAME, offset, line2);
+    }
+    CHECK_EQ(offset, 0);
+    host_set_i2c_write_hook(NULL);
+    printf("linha 2 \"%s\": %zu passos, %u bytes I2C por passo\n", line2, steps, scroll_bytes / (uint32_t) steps);
+    return scroll_bytes / (uint32_t) steps;
+}
+
+/* Linha 2 em branco: cada passo é um só comando de deslocamento (2 nibbles, 2 escritas cada, 2 bytes por escrita) */
+static void test_letreiro_deslocamento(void) {
+    CHECK_EQ(run_pass(""), 8);
+    CHECK_EQ(run_pass("    "), 8);
+}
+
+/* Linha 2 preenchida: ela não pode mexer, então cada passo reescreve a linha 1 (cursor + 16 caracteres) */
+static void test_letreiro_linha2(void) {
+    CHECK_EQ(run_pass("Emprestado"), (1 + LCD_COLS) * 8);
+    CHECK_EQ(lcd.chars - strlen("Emprestado") - LCD_COLS, (strlen(NAME) - LCD_COLS + 1) * LCD_COLS);
+}
+
+TEST_MAIN(
+    { "letreiro_deslocamento", test_letreiro_deslocamento },
+    { "letreiro_linha2", test_letreiro_linha2 },
+)
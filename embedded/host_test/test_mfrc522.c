@@ -0,0 +1,584 @@
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mfrc522.h"
+#include "tag_record.h"
+#include "host_idf.h"
+#include "virtual_rc522.h"
+#include "test_util.h"
+
+#define SCRIPT_POLLS_MAX    200     // Roteiro que não termina nisso falhou
+
+static rc522_handle_t script_scanner = NULL;
+
+/* Varreduras feitas até agora; o relógio virtual anda também antes de rc522_start terminar */
+static uint32_t script_polls(void) {
+    rc522_stats_t stats = { 0 };
+    if (script_scanner != NULL) {
+        rc522_get_stats(script_scanner, &stats);
+    }
+    return stats.polls;
+}
+
+static rc522_config_t spi_config(void) {
+    return (rc522_config_t) {
+        .transport = RC522_TRANSPORT_SPI,
+        .spi = {
+            .host = VSPI_HOST,
+            .miso_gpio = 19,
+            .mosi_gpio = 23,
+            .sck_gpio = 18,
+            .sda_gpio = 15,
+            .clock_speed_hz = 5000000,
+        },
+    };
+}
+
+/* Config zerada não pode prender a tarefa no núcleo PRO, junto com o Wi-Fi */
+static void test_afinidade_padrao(void) {
+    rc522_config_t config = spi_config();
+    rc522_handle_t scanner;
+    CHECK_EQ(rc522_create(&config, &scanner), ESP_OK);
+
+    host_task_info_t info;
+    CHECK(host_task_info("rc522_task", &info));
+    CHECK_EQ(info.core_id, RC522_TASK_NO_AFFINITY);
+}
+
+static void test_afinidade_fixa(void) {
+    rc522_config_t config = spi_config();
+    config.pin_core = true;
+    config.core_id = 0;
+    static rc522_storage_t storage;
+    rc522_handle_t scanner;
+    CHECK_EQ(rc522_create_static(&config, &storage, &scanner), ESP_OK);
+
+    host_task_info_t info;
+    CHECK(host_task_info("rc522_task", &info));
+    CHECK_EQ(info.core_id, 0);
+    CHECK(info.static_storage);
+}
+
+/* Sem memória para a tarefa, create falha em vez de devolver um handle sem tarefa */
+static void test_sem_tarefa(void) {
+    rc522_config_t config = spi_config();
+    rc522_handle_t scanner = NULL;
+    host_task_fail_next(1);
+    CHECK_EQ(rc522_create(&config, &scanner), ESP_ERR_NO_MEM);
+    CHECK(scanner == NULL);
+
+    static rc522_storage_t storage;
+    host_task_fail_next(1);
+    CHECK_EQ(rc522_create_static(&config, &storage, &scanner), ESP_ERR_NO_MEM);
+    CHECK(scanner == NULL);
+    CHECK_EQ(host_spi_device_clock(), 0); // O dispositivo SPI foi liberado
+
+    // O armazenamento volta a servir
+    CHECK_EQ(rc522_create_static(&config, &storage, &scanner), ESP_OK);
+}
+
+/* Roda a tarefa do leitor no relógio virtual até o hook encerrá-la */
+static void run_scanner(rc522_config_t* config, esp_event_handler_t handler, host_delay_hook_t script) {
+    host_clock_set_virtual(true);
+    host_set_delay_hook(script);
+    rc522_handle_t scanner;
+    CHECK_EQ(rc522_create(config, &scanner), ESP_OK);
+    CHECK_EQ(rc522_register_events(scanner, RC522_EVENT_ANY, handler, NULL), ESP_OK);
+    script_scanner = scanner;
+    CHECK_EQ(rc522_start(scanner), ESP_OK);
+
+    host_task_info_t info;
+    CHECK(host_task_info("rc522_task", &info));
+    host_task_join(info.handle);
+}
+
+static void write_record(int tag, uint32_t item_id, const char* name) {
+    tag_record_t record = { .item_id = item_id };
+    snprintf(record.name, sizeof(record.name), "%s", name);
+    tag_record_encode(&record, vrc522_tag_memory(tag) + TAG_RECORD_FIRST_PAGE * 4);
+}
+
+// --- registro: cada tag lida devolve o próprio registro, mesmo com outra no campo ---
+
+typedef struct {
+    uint64_t serial_number;
+    bool found;
+    tag_record_t record;
+} record_read_t;
+
+static record_read_t record_reads[4];
+static int record_read_count = 0;
+
+static void record_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
+    if (id != RC522_EVENT_TAG_SCANNED || record_read_count == 4) {
+        return;
+    }
+    rc522_event_data_t* data = (rc522_event_data_t*) event_data;
+    rc522_tag_t* tag = (rc522_tag_t*) data->ptr;
+    record_read_t* read = &record_reads[record_read_count++];
+    uint8_t raw[TAG_RECORD_SIZE];
+    read->serial_number = tag->serial_number;
+    read->found = rc522_read_pages(data->rc522, TAG_RECORD_FIRST_PAGE, raw, TAG_RECORD_PAGES) == ESP_OK &&
+                  tag_record_decode(raw, &read->record);
+}
+
+static void record_script(TaskHandle_t task, int64_t now_us) {
+    if (record_read_count == 2 || script_polls() > SCRIPT_POLLS_MAX) {
+        host_task_exit();
+    }
+}
+
+/*
+ * Duas tags chegam juntas: a anticolisão escolhe uma, mas as páginas lidas no handler
+ * têm de ser as da tag do evento (a tag é selecionada pelo UID reportado, não por quem
+ * ganhou a última anticolisão).
+ */
+static void test_registro(void) {
+    vrc522_install();
+    int first = vrc522_tag_add((const uint8_t[4]) { 0x11, 0x22, 0x33, 0x44 });
+    int second = vrc522_tag_add((const uint8_t[4]) { 0x11, 0x22, 0x33, 0xC4 }); // Colide no último bit do UID
+    write_record(first, 101, "Parafuso M6");
+    write_record(second, 202, "Porca M6");
+    vrc522_tag_enter(first);
+    vrc522_tag_enter(second);
+
+    rc522_config_t config = spi_config();
+    run_scanner(&config, record_handler, record_script);
+
+    CHECK_EQ(record_read_count, 2);
+    CHECK(record_reads[0].serial_number != record_reads[1].serial_number);
+    for (int i = 0; i < record_read_count; i++) {
+        record_read_t* read = &record_reads[i];
+        CHECK(read->found);
+        uint32_t expected = read->serial_number == vrc522_tag_serial(first) ? 101 : 202;
+        printf("tag %010llX -> item %lu \"%s\"\n", (unsigned long long) read->serial_number,
+               (unsigned long) read->record.item_id, read->record.name);
+        CHECK_EQ(read->record.item_id, expected);
+    }
+    // Lidas e postas em HALT: ficam quietas até saírem do campo
+    CHECK_EQ(vrc522_tag_state(first), VRC522_HALT);
+    CHECK_EQ(vrc522_tag_state(second), VRC522_HALT);
+}
+
+// --- uid_longo: UIDs de 7 bytes que só diferem no segundo nível de cascata ---
+
+#define LONG_UID_LEN    7
+
+static const uint8_t long_uids[2][LONG_UID_LEN] = {
+    { 0x04, 0xA1, 0xB2, 0x11, 0x22, 0x33, 0x44 },
+    { 0x04, 0xA1, 0xB2, 0x55, 0x66, 0x77, 0x80 },  // Mesmo CL1 (88 04 A1 B2): mesmo lote do fabricante
+};
+
+static int long_tags[2];
+static int long_phase = 0;
+static uint32_t long_mark = 0;
+static int long_removed[2];
+static rc522_tag_t long_scanned[2];
+
+static int long_index(uint64_t serial_number) {
+    for (int i = 0; i < 2; i++) {
+        if (serial_number == vrc522_tag_serial(long_tags[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void long_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
+    rc522_tag_t* tag = (rc522_tag_t*) ((rc522_event_data_t*) event_data)->ptr;
+    int i = long_index(tag->serial_number);
+    CHECK(i >= 0);
+    if (id == RC522_EVENT_TAG_REMOVED) {
+        long_removed[i]++;
+        return;
+    }
+    CHECK(id == RC522_EVENT_TAG_SCANNED && record_read_count < 4);
+    long_scanned[i] = *tag;
+    record_read_t* read = &record_reads[record_read_count++];
+    uint8_t raw[TAG_RECORD_SIZE];
+    read->serial_number = tag->serial_number;
+    read->found = rc522_read_pages(((rc522_event_data_t*) event_data)->rc522, TAG_RECORD_FIRST_PAGE, raw,
+                                   TAG_RECORD_PAGES) == ESP_OK &&
+                  tag_record_decode(raw, &read->record);
+}
+
+static void long_script(TaskHandle_t task, int64_t now_us) {
+    uint32_t polls = script_polls();
+    CHECK(polls <= SCRIPT_POLLS_MAX);
+    switch (long_phase) {
+        case 0:  // As duas chegam juntas
+            if (record_read_count == 2) {
+                long_mark = polls;
+                long_phase++;
+            }
+            break;
+        case 1:  // Paradas no campo: a verificação de presença acha cada uma pelo UID inteiro
+            if (polls - long_mark >= 10) {
+                CHECK_EQ(record_read_count, 2);
+                CHECK_EQ(long_removed[0] + long_removed[1], 0);
+                vrc522_tag_leave(long_tags[1]);
+                long_phase++;
+            }
+            break;
+        case 2:
+            if (long_removed[1] == 1) {
+                CHECK_EQ(long_removed[0], 0);
+                host_task_exit();
+            }
+            break;
+    }
+}
+
+/*
+ * Com só o primeiro nível de cascata as duas tags teriam o mesmo serial: o driver precisa
+ * resolver 0x95, reportar o UID inteiro e selecionar (leitura e presença) pelos dois níveis.
+ */
+static void test_uid_longo(void) {
+    vrc522_install();
+    for (int i = 0; i < 2; i++) {
+        long_tags[i] = vrc522_tag_add_uid(long_uids[i], LONG_UID_LEN);
+        write_record(long_tags[i], 301 + i, i == 0 ? "Chave 10 mm" : "Chave 13 mm");
+        vrc522_tag_enter(long_tags[i]);
+    }
+    rc522_config_t config = spi_config();
+    run_scanner(&config, long_handler, long_script);
+
+    CHECK_EQ(long_phase, 2);
+    CHECK_EQ(record_read_count, 2);
+    CHECK(record_reads[0].serial_number != record_reads[1].serial_number);
+    for (int i = 0; i < 2; i++) {
+        rc522_tag_t* tag = &long_scanned[i];
+        CHECK_EQ(tag->uid_len, LONG_UID_LEN);
+        CHECK(memcmp(tag->uid, long_uids[i], LONG_UID_LEN) == 0);
+    }
+    for (int i = 0; i < record_read_count; i++) {
+        record_read_t* read = &record_reads[i];
+        printf("tag %016llX -> item %lu \"%s\"\n", (unsigned long long) read->serial_number,
+               (unsigned long) read->record.item_id, read->record.name);
+        CHECK(read->found);
+        CHECK_EQ(read->record.item_id, 301 + long_index(read->serial_number));
+    }
+    CHECK(vrc522_frames(0x95) > 0);
+}
+
+// --- presenca: chegadas e saídas roteirizadas, com a histerese da remoção ---
+
+typedef struct {
+    int32_t id;
+    uint64_t serial_number;
+    uint32_t poll;
+    int64_t dwell_us;
+} presence_event_t;
+
+#define PRESENCE_EVENTS_MAX 16
+#define PRESENCE_MISSES     3
+
+static presence_event_t presence_events[PRESENCE_EVENTS_MAX];
+static int presence_event_count = 0;
+static int presence_phase = 0;
+static uint32_t presence_mark = 0;
+static int presence_a = -1, presence_b = -1;
+
+static void presence_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
+    CHECK(presence_event_count < PRESENCE_EVENTS_MAX);
+    rc522_tag_t* tag = (rc522_tag_t*) ((rc522_event_data_t*) event_data)->ptr;
+    presence_events[presence_event_count++] = (presence_event_t) {
+        .id = id, .serial_number = tag->serial_number, .poll = script_polls(), .dwell_us = tag->dwell_us,
+    };
+}
+
+/* Eventos de um tipo para uma tag, até agora */
+static int presence_count(int32_t id, int tag) {
+    int n = 0;
+    for (int i = 0; i < presence_event_count; i++) {
+        n += presence_events[i].id == id && presence_events[i].serial_number == vrc522_tag_serial(tag);
+    }
+    return n;
+}
+
+static void presence_next(void) {
+    presence_phase++;
+    presence_mark = script_polls();
+}
+
+static void presence_script(TaskHandle_t task, int64_t now_us) {
+    uint32_t polls = script_polls(), since = polls - presence_mark;
+    CHECK(polls <= SCRIPT_POLLS_MAX);
+    switch (presence_phase) {
+        case 0:  // A chega
+            if (polls >= 2) {
+                vrc522_tag_enter(presence_a);
+                presence_next();
+            }
+            break;
+        case 1:  // Parada no campo: um só SCANNED, e entre as verificações ela fica em HALT
+            if (since >= 10) {
+                CHECK_EQ(presence_count(RC522_EVENT_TAG_SCANNED, presence_a), 1);
+                CHECK_EQ(presence_event_count, 1);
+                CHECK_EQ(vrc522_tag_state(presence_a), VRC522_HALT);
+                vrc522_tag_enter(presence_b);  // B chega com A no campo
+                presence_next();
+            }
+            break;
+        case 2:  // Piscada de A mais curta que a histerese: nem remoção nem chegada nova
+            if (since >= 5) {
+                CHECK_EQ(presence_count(RC522_EVENT_TAG_SCANNED, presence_b), 1);
+                CHECK_EQ(presence_event_count, 2);
+                vrc522_tag_leave(presence_a);
+                presence_next();
+            }
+            break;
+        case 3:
+            if (since >= 1) {
+                vrc522_tag_enter(presence_a);
+                presence_next();
+            }
+            break;
+        case 4:  // A sai de vez: REMOVED depois de PRESENCE_MISSES verificações sem resposta
+            if (since >= 10) {
+                CHECK_EQ(presence_event_count, 2);
+                vrc522_tag_leave(presence_a);
+                presence_next();
+            }
+            break;
+        case 5:
+            if (presence_count(RC522_EVENT_TAG_REMOVED, presence_a) == 1) {
+                presence_event_t* removed = &presence_events[presence_event_count - 1];
+                printf("A removida %lu varreduras depois de sair, %lld ms no campo\n",
+                       (unsigned long) (removed->poll - presence_mark), (long long) (removed->dwell_us / 1000));
+                CHECK(removed->poll - presence_mark >= PRESENCE_MISSES);
+                CHECK(removed->dwell_us > 0);
+                CHECK_EQ(presence_count(RC522_EVENT_TAG_REMOVED, presence_b), 0);
+                vrc522_tag_enter(presence_a);  // Volta: é outra visita
+                presence_next();
+            }
+            break;
+        case 6:
+            if (presence_count(RC522_EVENT_TAG_SCANNED, presence_a) == 2) {
+                vrc522_tag_leave(presence_a);
+                vrc522_tag_leave(presence_b);
+                presence_next();
+            }
+            break;
+        case 7:
+            if (presence_count(RC522_EVENT_TAG_REMOVED, presence_a) == 2 &&
+                presence_count(RC522_EVENT_TAG_REMOVED, presence_b) == 1) {
+                host_task_exit();
+            }
+            break;
+    }
+}
+
+static void test_presenca(void) {
+    vrc522_install();
+    presence_a = vrc522_tag_add((const uint8_t[4]) { 0xA1, 0x02, 0x03, 0x04 });
+    presence_b = vrc522_tag_add((const uint8_t[4]) { 0xB1, 0x02, 0x03, 0x04 });
+    rc522_config_t config = spi_config();
+    config.removal_misses = PRESENCE_MISSES;
+    run_scanner(&config, presence_handler, presence_script);
+
+    CHECK_EQ(presence_phase, 7);
+    CHECK_EQ(presence_event_count, 6);  // A, B, A removida, A de novo, A e B removidas
+    printf("%lu WUPA, %lu SELECT, %lu HLTA em %lu varreduras\n", (unsigned long) vrc522_frames(0x52),
+           (unsigned long) vrc522_frames(0x93), (unsigned long) vrc522_frames(0x50), (unsigned long) script_polls());
+}
+
+// --- relogio_falha: o clock SPI cai um degrau sem deixar o handle do dispositivo pendurado ---
+
+static int clock_phase = 0;
+static int clock_trained_hz = 0;
+
+static void clock_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
+}
+
+/*
+ * Cada verificação de link (a cada RC522_LINK_CHECK_INTERVAL varreduras ociosas) encontra
+ * erros de SPI acumulados e tenta descer o clock; spi_bus_add_device falha no meio.
+ */
+static void clock_script(TaskHandle_t task, int64_t now_us) {
+    uint32_t polls = script_polls();
+    if (polls > SCRIPT_POLLS_MAX * 2) {
+        CHECK(false);
+    }
+    switch (clock_phase) {
+        case 0:
+            if (polls >= 1) {
+                clock_trained_hz = host_spi_device_clock();
+                vrc522_spi_fail_next(RC522_LINK_ERROR_THRESHOLD);
+                host_spi_fail_add_next(1); // Só o clock novo falha: volta ao antigo
+                clock_phase++;
+            }
+            break;
+        case 1:
+            if (polls >= RC522_LINK_CHECK_INTERVAL) {
+                printf("fallback sem memória: %d Hz (treinado %d Hz)\n", host_spi_device_clock(), clock_trained_hz);
+                CHECK_EQ(host_spi_device_clock(), clock_trained_hz);
+                vrc522_spi_fail_next(RC522_LINK_ERROR_THRESHOLD);
+                host_spi_fail_add_next(2); // Nem o antigo volta: fica sem dispositivo
+                clock_phase++;
+            }
+            break;
+        case 2:
+            if (polls >= 2 * RC522_LINK_CHECK_INTERVAL) {
+                CHECK_EQ(host_spi_device_clock(), 0);
+                clock_phase++;
+            }
+            break;
+        case 3:
+            // Sem dispositivo as transferências falham em vez de usar o handle removido
+            if (polls >= 3 * RC522_LINK_CHECK_INTERVAL) {
+                printf("dispositivo de volta: %d Hz\n", host_spi_device_clock());
+                CHECK(host_spi_device_clock() != 0);
+                CHECK(host_spi_device_clock() <= clock_trained_hz);
+                host_task_exit();
+            }
+            break;
+    }
+}
+
+static void test_relogio_falha(void) {
+    vrc522_install();
+    rc522_config_t config = spi_config();
+    config.spi.clock_speed_hz = 0; // Treina o link no start e verifica em execução
+    run_scanner(&config, clock_handler, clock_script);
+    CHECK_EQ(clock_phase, 3);
+}
+
+// --- ganho: erros de sinal fraco sobem o RxGain, janelas limpas o trazem de volta, timeouts não contam ---
+
+#define GAIN_POLLS_MAX  600
+#define GAIN_LOST_SELECTS 64    // Duas janelas inteiras de timeouts
+
+static int gain_tag = -1;
+static int gain_phase = 0;
+static uint32_t gain_mark = 0;
+static rc522_stats_t gain_before;
+
+static void gain_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
+}
+
+static rc522_stats_t gain_stats(void) {
+    rc522_stats_t stats = { 0 };
+    rc522_get_stats(script_scanner, &stats);
+    return stats;
+}
+
+static void gain_script(TaskHandle_t task, int64_t now_us) {
+    if (script_scanner == NULL) {
+        return;
+    }
+    rc522_stats_t stats = gain_stats();
+    CHECK(stats.polls <= GAIN_POLLS_MAX);
+    CHECK_EQ(stats.rx_gain, vrc522_rx_gain());
+    switch (gain_phase) {
+        case 0:  // A tag fica no campo, mas abaixo de 43 dB as respostas chegam com erro de paridade
+            if (stats.polls >= 1) {
+                vrc522_tag_enter(gain_tag);
+                vrc522_set_weak_below(6);
+                gain_phase++;
+            }
+            break;
+        case 1:
+            if (stats.rx_gain == 6) {
+                printf("RxGain 4 -> 6 em %lu varreduras\n", (unsigned long) stats.polls);
+                vrc522_set_weak_below(0);  // O metal saiu de perto
+                gain_mark = stats.polls;
+                gain_phase++;
+            }
+            break;
+        case 2:  // Sem erros, cada janela desce um passo até o ganho configurado
+            if (stats.rx_gain == 4) {
+                printf("RxGain 6 -> 4 em %lu varreduras limpas\n", (unsigned long) (stats.polls - gain_mark));
+                gain_before = stats;
+                gain_mark = vrc522_frames(0x93);
+                vrc522_fault(0x93, VRC522_FAULT_LOST, GAIN_LOST_SELECTS);  // Só timeouts, nenhum erro de sinal
+                gain_phase++;
+            }
+            break;
+        case 3:
+            if (vrc522_frames(0x93) - gain_mark > GAIN_LOST_SELECTS + RC522_GAIN_WINDOW) {
+                CHECK(stats.stage[RC522_STAGE_SELECT].timeout - gain_before.stage[RC522_STAGE_SELECT].timeout >=
+                      GAIN_LOST_SELECTS);
+                CHECK_EQ(stats.gain_changes, gain_before.gain_changes);
+                CHECK_EQ(stats.rx_gain, 4);
+                host_task_exit();
+            }
+            break;
+    }
+}
+
+static void test_ganho(void) {
+    vrc522_install();
+    gain_tag = vrc522_tag_add((const uint8_t[4]) { 0x61, 0x02, 0x03, 0x04 });
+    rc522_config_t config = spi_config();
+    config.rx_gain = 4;
+    config.removal_misses = 255;  // A tag não sai do campo nas falhas: só o ganho está em jogo
+    run_scanner(&config, gain_handler, gain_script);
+    CHECK_EQ(gain_phase, 3);
+}
+
+// --- leitura_refaz: um READ sem resposta é repetido depois de selecionar a tag de novo ---
+
+static int reread_tag = -1;
+static bool reread_done = false;
+
+static void reread_page(rc522_handle_t rc522, vrc522_fault_t fault, int count, esp_err_t expected) {
+    rc522_stats_t before = { 0 }, after = { 0 };
+    uint8_t pages[16];
+    rc522_get_stats(rc522, &before);
+    vrc522_fault(0x30, fault, count);
+    CHECK_EQ(rc522_read_pages(rc522, 4, pages, 4), expected);
+    rc522_get_stats(rc522, &after);
+    if (expected == ESP_OK) {
+        CHECK(memcmp(pages, vrc522_tag_memory(reread_tag) + 16, sizeof(pages)) == 0);
+        CHECK_EQ(after.retry_saves - before.retry_saves, 1);
+    }
+    CHECK_EQ(vrc522_tag_state(reread_tag), VRC522_HALT);
+    vrc522_fault(0, VRC522_FAULT_LOST, 0);
+}
+
+static void reread_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
+    if (id != RC522_EVENT_TAG_SCANNED || reread_done) {
+        return;
+    }
+    rc522_handle_t rc522 = ((rc522_event_data_t*) event_data)->rc522;
+    uint8_t* memory = vrc522_tag_memory(reread_tag);
+    for (int i = 0; i < 16; i++) {
+        memory[16 + i] = (uint8_t) (0xA0 + i);
+    }
+    reread_page(rc522, VRC522_FAULT_GARBLED, 1, ESP_OK);  // A tag toma o quadro como inválido e vai para HALT
+    reread_page(rc522, VRC522_FAULT_LOST, 1, ESP_OK);     // O quadro se perdeu: a tag continua ACTIVE
+    reread_page(rc522, VRC522_FAULT_CRC, 1, ESP_OK);      // Resposta corrompida: a tag continua selecionada
+    reread_page(rc522, VRC522_FAULT_LOST, RC522_FAST_RETRIES + 1, ESP_ERR_TIMEOUT);
+    reread_done = true;
+}
+
+static void reread_script(TaskHandle_t task, int64_t now_us) {
+    uint32_t polls = script_polls();
+    if (polls == 1) {
+        vrc522_tag_enter(reread_tag);
+    }
+    if (reread_done || polls > SCRIPT_POLLS_MAX) {
+        host_task_exit();
+    }
+}
+
+static void test_leitura_refaz(void) {
+    vrc522_install();
+    reread_tag = vrc522_tag_add((const uint8_t[4]) { 0x71, 0x02, 0x03, 0x04 });
+    rc522_config_t config = spi_config();
+    run_scanner(&config, reread_handler, reread_script);
+    CHECK(reread_done);
+}
+
+TEST_MAIN(
+    { "afinidade_padrao", test_afinidade_padrao },
+    { "afinidade_fixa", test_afinidade_fixa },
+    { "sem_tarefa", test_sem_tarefa },
+    { "registro", test_registro },
+    { "uid_longo", test_uid_longo },
+    { "relogio_falha", test_relogio_falha },
+    { "presenca", test_presenca },
+    { "ganho", test_ganho },
+    { "leitura_refaz", test_leitura_refaz },
+)
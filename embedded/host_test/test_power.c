@@ -0,0 +1,33 @@
+#include "host_idf.h"
+#include "net_profile.h"
+#include "power.h"
+#include "test_util.h"
+
+/* "latencia" (rádio sempre ligado) e light sleep se excluem; os perfis sem light sleep mantêm a rede escolhida */
+static void test_latencia_light_sleep(void) {
+    CHECK_EQ(power_init(), ESP_OK);
+    CHECK_EQ(power_apply(POWER_PROFILE_DESEMPENHO), ESP_OK);
+    CHECK_EQ(power_set_net_profile(NET_PROFILE_LATENCIA), ESP_OK);
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_NONE);
+
+    // Light sleep tira o rádio de WIFI_PS_NONE
+    CHECK_EQ(power_apply(POWER_PROFILE_BATERIA), ESP_OK);
+    CHECK_EQ(net_profile_get(), NET_PROFILE_ECONOMIA);
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_MIN_MODEM);
+
+    // E, com ele ligado, "latencia" é recusada
+    CHECK_EQ(power_set_net_profile(NET_PROFILE_LATENCIA), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_MIN_MODEM);
+    CHECK_EQ(power_set_net_profile(NET_PROFILE_ECONOMIA), ESP_OK);
+
+    // Sem light sleep a rede fica como estava, e "latencia" volta a valer
+    CHECK_EQ(power_apply(POWER_PROFILE_DESEMPENHO), ESP_OK);
+    CHECK_EQ(net_profile_get(), NET_PROFILE_ECONOMIA);
+    CHECK_EQ(power_set_net_profile(NET_PROFILE_LATENCIA), ESP_OK);
+    CHECK_EQ(power_apply(POWER_PROFILE_DESEMPENHO), ESP_OK);
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_NONE);
+}
+
+TEST_MAIN(
+    { "latencia_light_sleep", test_latencia_light_sleep },
+)
@@ -0,0 +1,342 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "scan_outbox.h"
+#include "enroll.h"
+#include "host_idf.h"
+#include "test_util.h"
+
+#define TOPIC           "rfid/scanner/uid"
+#define TOPIC_BULK      "rfid/carga/uid"
+#define READER          "LEITOR_TESTE"
+
+// --- Broker de mentira: conta as leituras entregues e pode segurar ou atrasar cada publish ---
+
+static pthread_mutex_t broker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t broker_cond = PTHREAD_COND_INITIALIZER;
+static bool broker_hold = false;        // Segura o próximo publish até broker_release()
+static bool broker_inside = false;      // Um publish está preso em broker_hold
+static uint32_t broker_delay_ms = 0;    // Atraso de cada publish (broker lento)
+static uint32_t broker_readings = 0;
+#define BROKER_UIDS_MAX 64
+static uint64_t broker_uids[BROKER_UIDS_MAX];   // UIDs entregues, na ordem
+static int64_t broker_last_us = 0;      // Quando o último publish foi entregue
+
+static int broker_publish(const char* topic, const char* data, int len, int qos) {
+    (void) topic;
+    (void) qos;
+    uint32_t readings = 0;
+    uint64_t uids[SCAN_OUTBOX_BATCH_MAX];
+    for (const char* p = data; p < data + len && (p = strstr(p, "\"uid\"")) != NULL; p++) {
+        unsigned long long uid = 0;
+        sscanf(p, "\"uid\":\"%llX\"", &uid);
+        if (readings < SCAN_OUTBOX_BATCH_MAX) {
+            uids[readings] = uid;
+        }
+        readings++;
+    }
+
+    pthread_mutex_lock(&broker_lock);
+    if (broker_hold) {
+        broker_inside = true;
+        pthread_cond_broadcast(&broker_cond);
+        while (broker_hold) {
+            pthread_cond_wait(&broker_cond, &broker_lock);
+        }
+        broker_inside = false;
+    }
+    uint32_t delay_ms = broker_delay_ms;
+    pthread_mutex_unlock(&broker_lock);
+
+    if (delay_ms) {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    }
+    pthread_mutex_lock(&broker_lock);
+    for (uint32_t i = 0; i < readings && i < SCAN_OUTBOX_BATCH_MAX; i++) {
+        if (broker_readings + i < BROKER_UIDS_MAX) {
+            broker_uids[broker_readings + i] = uids[i];
+        }
+    }
+    broker_readings += readings;
+    broker_last_us = esp_timer_get_time();
+    pthread_mutex_unlock(&broker_lock);
+    return 0;
+}
+
+static void broker_wait_inside(void) {
+    pthread_mutex_lock(&broker_lock);
+    while (!broker_inside) {
+        pthread_cond_wait(&broker_cond, &broker_lock);
+    }
+    pthread_mutex_unlock(&broker_lock);
+}
+
+static void broker_release(void) {
+    pthread_mutex_lock(&broker_lock);
+    broker_hold = false;
+    pthread_cond_broadcast(&broker_cond);
+    pthread_mutex_unlock(&broker_lock);
+}
+
+/* Espera a outbox esvaziar: toda leitura enfileirada foi enviada ou descartada */
+static scan_outbox_stats_t wait_drained(void) {
+    scan_outbox_stats_t stats;
+    for (int i = 0; i < 1000; i++) {
+        scan_outbox_get_stats(&stats);
+        if (stats.published + stats.dropped >= stats.enqueued) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return stats;
+}
+
+/*
+ * DROP_OLDEST com a fila cheia descarta justo a leitura que está no publish. Ela já
+ * conta como descartada, então não pode contar como enviada também.
+ */
+static void test_contagem(void) {
+    host_set_mqtt_publish_hook(broker_publish);
+    CHECK_EQ(scan_outbox_init(SCAN_OUTBOX_DROP_OLDEST, TOPIC, TOPIC_BULK, READER), ESP_OK);
+    scan_outbox_set_client(host_mqtt_client());
+
+    broker_hold = true;
+    CHECK(scan_outbox_push(0x1001, esp_timer_get_time(), SCAN_KIND_TOGGLE));
+    broker_wait_inside();
+    for (uint64_t uid = 0x1002; uid < 0x1002 + SCAN_OUTBOX_CAPACITY; uid++) {
+        CHECK(scan_outbox_push(uid, esp_timer_get_time(), SCAN_KIND_TOGGLE));
+    }
+    broker_release();
+
+    scan_outbox_stats_t stats = wait_drained();
+    printf("enfileiradas=%lu enviadas=%lu descartadas=%lu lotes=%lu | leituras no broker=%u\n",
+           (unsigned long) stats.enqueued, (unsigned long) stats.published, (unsigned long) stats.dropped,
+           (unsigned long) stats.batches, broker_readings);
+    CHECK_EQ(stats.enqueued, SCAN_OUTBOX_CAPACITY + 1);
+    CHECK_EQ(stats.dropped, 1);
+    CHECK_EQ(stats.published, SCAN_OUTBOX_CAPACITY);
+    CHECK_EQ(stats.published + stats.dropped, stats.enqueued);
+}
+
+// Como o main.c: a leitura de sessão descartada pela fila cheia é esquecida pela sessão
+static void session_drop(const scan_record_t* record) {
+    if (record->kind != SCAN_KIND_TOGGLE) {
+        enroll_forget(record->uid);
+    }
+}
+
+/* Caminho de sessão do rc522_handler: cada UID sai uma vez, a não ser que a outbox a descarte */
+static void session_scan(uint64_t uid) {
+    if (enroll_add(uid)) {
+        scan_outbox_push(uid, esp_timer_get_time(), SCAN_KIND_ENROLL);
+    }
+}
+
+#define SESSION_BASE_UID    0x04A1B2C300ull
+#define SESSION_TAGS        (SCAN_OUTBOX_CAPACITY * 2)
+
+static uint32_t broker_distinct(uint32_t* duplicates) {
+    uint32_t distinct = 0;
+    *duplicates = 0;
+    for (uint64_t uid = SESSION_BASE_UID; uid < SESSION_BASE_UID + SESSION_TAGS; uid++) {
+        uint32_t seen = 0;
+        for (uint32_t i = 0; i < broker_readings && i < BROKER_UIDS_MAX; i++) {
+            seen += broker_uids[i] == uid;
+        }
+        distinct += seen > 0;
+        *duplicates += seen > 1 ? seen - 1 : 0;
+    }
+    return distinct;
+}
+
+/*
+ * Cadastro com a fila cheia: o dobro da capacidade passa pelo leitor com o broker parado.
+ * As UIDs descartadas são esquecidas pela sessão, e quando as tags passam de novo só elas
+ * saem outra vez: no fim toda tag chegou ao broker.
+ */
+static void test_sessao_cheia(void) {
+    host_set_mqtt_publish_hook(broker_publish);
+    CHECK_EQ(scan_outbox_init(SCAN_OUTBOX_COALESCE_UID, TOPIC, TOPIC_BULK, READER), ESP_OK);
+    scan_outbox_set_drop_hook(session_drop);
+    scan_outbox_set_client(host_mqtt_client());
+    enroll_set_mode(ENROLL_MODE_CADASTRO);
+
+    broker_hold = true;
+    session_scan(SESSION_BASE_UID);
+    broker_wait_inside();
+    for (uint64_t uid = SESSION_BASE_UID + 1; uid < SESSION_BASE_UID + SESSION_TAGS; uid++) {
+        session_scan(uid);
+    }
+    broker_release();
+    scan_outbox_stats_t stats = wait_drained();
+    uint32_t duplicates;
+    uint32_t first_pass = broker_distinct(&duplicates);
+    printf("primeira passada: %u de %u tags no broker, %lu descartadas na fila\n", first_pass, SESSION_TAGS,
+           (unsigned long) stats.dropped);
+    CHECK(stats.dropped > 0);
+    CHECK_EQ(enroll_count(), SESSION_TAGS - stats.dropped);
+
+    for (uint64_t uid = SESSION_BASE_UID; uid < SESSION_BASE_UID + SESSION_TAGS; uid++) {
+        session_scan(uid);
+    }
+    stats = wait_drained();
+    uint32_t distinct = broker_distinct(&duplicates);
+    printf("segunda passada: %u de %u tags no broker, %u repetidas (a que estava no publish ao ser descartada)\n",
+           distinct, SESSION_TAGS, duplicates);
+    CHECK_EQ(distinct, SESSION_TAGS);
+    CHECK(duplicates <= 1);
+    CHECK_EQ(enroll_count(), SESSION_TAGS);
+}
+
+/*
+ * UIDs de 7 bytes do mesmo lote de fábrica só diferem acima do primeiro nível de cascata. Com o
+ * serial inteiro cada uma sai uma vez; a mesma tag lida de novo na sessão conta como repetida.
+ */
+static void test_sessao_repetida(void) {
+    static const uint64_t batch[] = { 0x0744332211B2A104ull, 0x0780776655B2A104ull, 0x0700000001B2A104ull };
+    const int n = sizeof(batch) / sizeof(batch[0]);
+    host_set_mqtt_publish_hook(broker_publish);
+    CHECK_EQ(scan_outbox_init(SCAN_OUTBOX_COALESCE_UID, TOPIC, TOPIC_BULK, READER), ESP_OK);
+    scan_outbox_set_client(host_mqtt_client());
+    enroll_set_mode(ENROLL_MODE_CADASTRO);
+
+    for (int i = 0; i < n; i++) {
+        CHECK(enroll_add(batch[i]));
+        CHECK(scan_outbox_push(batch[i], esp_timer_get_time(), SCAN_KIND_ENROLL));
+    }
+    CHECK(!enroll_add(batch[1]));
+    CHECK_EQ(enroll_repeats(), 1);
+    CHECK_EQ(enroll_count(), n);
+
+    wait_drained();
+    for (int i = 0; i < n; i++) {
+        uint32_t seen = 0;
+        for (uint32_t r = 0; r < broker_readings && r < BROKER_UIDS_MAX; r++) {
+            seen += broker_uids[r] == batch[i];
+        }
+        CHECK_EQ(seen, 1);
+    }
+
+    enroll_set_mode(ENROLL_MODE_AUDITORIA);  // Sessão nova: nada visto, nada repetido
+    CHECK(enroll_add(batch[1]));
+    CHECK_EQ(enroll_repeats(), 0);
+}
+
+static int compare_i64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*) a;
+    int64_t y = *(const int64_t*) b;
+    return (x > y) - (x < y);
+}
+
+#define JITTER_INTERVAL_MS  20 // Múltiplo do tick de 10 ms
+#define JITTER_POLLS        120
+#define BROKER_SLOW_MS      200
+
+/*
+ * Laço no formato da tarefa do RC522: trabalho do handler e depois vTaskDelay do intervalo.
+ * O jitter é quanto cada volta passou do intervalo. direct = publish QoS1 no handler (antes da outbox).
+ */
+static void scan_loop(bool direct, int polls, int64_t* jitter_us) {
+    int64_t last_us = 0;
+    for (int i = 0; i < polls; i++) {
+        int64_t start_us = esp_timer_get_time();
+        if (i > 0) {
+            jitter_us[i - 1] = start_us - last_us - JITTER_INTERVAL_MS * 1000;
+        }
+        last_us = start_us;
+
+        uint64_t uid = 0x2000 + i; // Uma tag nova por volta: pior caso para a outbox
+        if (direct) {
+            esp_mqtt_client_publish(host_mqtt_client(), TOPIC, "{\"uid\":\"2000\"}", 0, 1, 0);
+        } else {
+            scan_outbox_push(uid, start_us, SCAN_KIND_TOGGLE);
+        }
+        vTaskDelay(pdMS_TO_TICKS(JITTER_INTERVAL_MS));
+    }
+}
+
+static void report(const char* what, int64_t* jitter_us, int n, int64_t* p50, int64_t* p99, int64_t* max) {
+    qsort(jitter_us, n, sizeof(jitter_us[0]), compare_i64);
+    *p50 = jitter_us[n * 50 / 100];
+    *p99 = jitter_us[n * 99 / 100];
+    *max = jitter_us[n - 1];
+    printf("%-22s %3d voltas: jitter p50=%lld us p99=%lld us max=%lld us\n", what, n,
+           (long long) *p50, (long long) *p99, (long long) *max);
+}
+
+/*
+ * Jitter do laço de varredura com o broker lento (cada publish leva BROKER_SLOW_MS):
+ * com o publish no handler cada volta paga o broker; com a outbox só a tarefa de envio espera.
+ */
+static void test_jitter(void) {
+    static int64_t jitter_us[JITTER_POLLS];
+    int64_t p50, p99, max;
+
+    host_set_mqtt_publish_hook(broker_publish);
+    broker_delay_ms = BROKER_SLOW_MS;
+
+    const int direct_polls = 10;
+    scan_loop(true, direct_polls, jitter_us);
+    report("publish no handler", jitter_us, direct_polls - 1, &p50, &p99, &max);
+    CHECK(p50 >= (BROKER_SLOW_MS - 10) * 1000);
+
+    CHECK_EQ(scan_outbox_init(SCAN_OUTBOX_COALESCE_UID, TOPIC, TOPIC_BULK, READER), ESP_OK);
+    scan_outbox_set_client(host_mqtt_client());
+    scan_loop(false, JITTER_POLLS, jitter_us);
+    report("outbox", jitter_us, JITTER_POLLS - 1, &p50, &p99, &max);
+    // Sobra só o ruído do escalonador do host
+    CHECK(p99 < 20 * 1000);
+
+    scan_outbox_stats_t stats;
+    scan_outbox_get_stats(&stats);
+    printf("outbox: enfileiradas=%lu enviadas=%lu descartadas=%lu pico=%u\n", (unsigned long) stats.enqueued,
+           (unsigned long) stats.published, (unsigned long) stats.dropped, stats.high_watermark);
+}
+
+/* Uma leitura sozinha: do push à entrega no broker */
+static int64_t single_latency_us(uint64_t uid, scan_kind_t kind) {
+    int64_t start_us = esp_timer_get_time();
+    CHECK(scan_outbox_push(uid, start_us, kind));
+    wait_drained();
+    return broker_last_us - start_us;
+}
+
+/*
+ * Toggle é interativo: sai sem esperar o GAP do lote, e o que chega durante um publish vai
+ * junto no seguinte. Leituras de sessão continuam esperando o GAP para juntar a bandeja.
+ */
+static void test_espera_por_tipo(void) {
+    host_set_mqtt_publish_hook(broker_publish);
+    CHECK_EQ(scan_outbox_init(SCAN_OUTBOX_COALESCE_UID, TOPIC, TOPIC_BULK, READER), ESP_OK);
+    scan_outbox_set_client(host_mqtt_client());
+
+    int64_t toggle_us = single_latency_us(0x3001, SCAN_KIND_TOGGLE);
+    int64_t audit_us = single_latency_us(0x3002, SCAN_KIND_AUDIT);
+    printf("toggle sozinho: %lld ms até o broker; auditoria: %lld ms (GAP %d ms)\n", (long long) (toggle_us / 1000),
+           (long long) (audit_us / 1000), SCAN_OUTBOX_BATCH_GAP_MS);
+    CHECK(toggle_us < SCAN_OUTBOX_BATCH_GAP_MS * 1000LL / 2);
+    CHECK(audit_us >= SCAN_OUTBOX_BATCH_GAP_MS * 1000LL);
+
+    broker_hold = true;
+    CHECK(scan_outbox_push(0x3010, esp_timer_get_time(), SCAN_KIND_TOGGLE));
+    broker_wait_inside();
+    for (uint64_t uid = 0x3011; uid < 0x3014; uid++) {
+        CHECK(scan_outbox_push(uid, esp_timer_get_time(), SCAN_KIND_TOGGLE));
+    }
+    broker_release();
+    scan_outbox_stats_t stats = wait_drained();
+    CHECK_EQ(stats.batches, 1);
+    CHECK_EQ(stats.batched, 3);
+    CHECK_EQ(broker_readings, 6);
+}
+
+TEST_MAIN(
+    { "contagem", test_contagem },
+    { "jitter", test_jitter },
+    { "sessao_cheia", test_sessao_cheia },
+    { "sessao_repetida", test_sessao_repetida },
+    { "espera_por_tipo", test_espera_por_tipo },
+)
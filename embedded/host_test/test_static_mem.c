@@ -0,0 +1,236 @@
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mfrc522.h"
+#include "scan_outbox.h"
+#include "static_mem.h"
+#include "tag_record.h"
+#include "host_idf.h"
+#include "virtual_rc522.h"
+#include "test_util.h"
+
+// Compilado com STATIC_MEM_ENABLED=1 (CMakeLists.txt)
+_Static_assert(STATIC_MEM_ENABLED, "teste do modo estático");
+
+#define OTHER_BLOCK     48
+#define OTHER_PATTERN   0x5A
+
+static void fill(uint8_t* block, uint8_t value) {
+    memset(block, value, OTHER_BLOCK);
+}
+
+static bool intact(const uint8_t* block, uint8_t value) {
+    for (int i = 0; i < OTHER_BLOCK; i++) {
+        if (block[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- arena_escopo: o cJSON de outra tarefa não cai na arena da tarefa do MQTT ---
+
+static uint8_t* volatile other_block = NULL;
+static volatile bool other_done = false;
+
+static void other_task(void* arg) {
+    other_block = host_cjson_malloc(OTHER_BLOCK);
+    fill(other_block, OTHER_PATTERN);
+    while (!other_done) {
+        ulTaskNotifyTake(pdTRUE, 1);
+    }
+    CHECK(intact(other_block, OTHER_PATTERN));
+    host_cjson_free(other_block);
+    vTaskDelete(NULL);
+}
+
+static void test_arena_escopo(void) {
+    static_mem_arena_install();
+    uint32_t heap_before = esp_get_free_heap_size();
+
+    // Na arena: o heap não mexe, e free de um ponteiro da arena não vai ao heap
+    static_mem_arena_begin();
+    void* tree = host_cjson_malloc(256);
+    CHECK(tree != NULL);
+    CHECK_EQ(esp_get_free_heap_size(), heap_before);
+
+    // Outra tarefa usando o cJSON no meio da mensagem vai para o heap
+    CHECK_EQ(xTaskCreate(other_task, "outra", 2048, NULL, 1, NULL), pdTRUE);
+    while (other_block == NULL) {
+        ulTaskNotifyTake(pdTRUE, 1);
+    }
+    CHECK(esp_get_free_heap_size() < heap_before);
+    host_cjson_free(tree);
+    static_mem_arena_end();
+
+    // A próxima mensagem reinicia a arena e a reescreve inteira: o bloco da outra tarefa fica intacto
+    static_mem_arena_begin();
+    for (int i = 0; i < STATIC_MEM_ARENA_SIZE / 64; i++) {
+        void* node = host_cjson_malloc(64);
+        CHECK(node != NULL);
+        memset(node, 0xAA, 64);
+    }
+    CHECK(host_cjson_malloc(64) == NULL); // Esgotada: falha de parse, não heap
+    CHECK(intact(other_block, OTHER_PATTERN));
+    static_mem_arena_end();
+
+    // Fora do escopo a própria tarefa do MQTT também usa o heap
+    void* outside = host_cjson_malloc(32);
+    CHECK(esp_get_free_heap_size() < heap_before);
+    host_cjson_free(outside);
+
+    host_task_info_t info;
+    CHECK(host_task_info("outra", &info));
+    other_done = true;
+    host_task_join(info.handle);
+    CHECK_EQ(esp_get_free_heap_size(), heap_before);
+}
+
+// --- soak: o regime permanente do modo estático não consome heap ---
+
+#define SOAK_TAGS           4
+#define SOAK_SLOT_US        (2 * 1000 * 1000)           // Uma tag por vez, trocada a cada 2 s
+#define SOAK_CHECK_US       (10 * 1000 * 1000)
+#define SOAK_DURATION_US    (30LL * 60 * 1000 * 1000)   // 30 min de relógio virtual
+#define SOAK_MESSAGE_NODES  12
+
+static int soak_tags[SOAK_TAGS];
+static int64_t soak_slot = -1;
+static int64_t soak_next_check_us = 0;
+static uint32_t soak_checks = 0;
+static uint32_t soak_scans = 0;
+static uint32_t soak_messages = 0;
+static uint8_t* soak_block = NULL;      // cJSON da tarefa do RC522, fora da arena
+static volatile bool soak_done = false;
+static volatile bool soak_started = false;   // rc522_start voltou: antes disso a tarefa só espera
+static int64_t soak_start_us = -1;
+static TaskHandle_t soak_mqtt = NULL;
+
+/* O mesmo caminho do handler do main.c: outbox e registro da tag (com cache) */
+static void soak_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
+    if (id != RC522_EVENT_TAG_SCANNED) {
+        return;
+    }
+    rc522_event_data_t* data = (rc522_event_data_t*) event_data;
+    rc522_tag_t* tag = (rc522_tag_t*) data->ptr;
+    scan_outbox_push(tag->serial_number, esp_timer_get_time(), SCAN_KIND_TOGGLE); // Repetida coalesce enquanto não sai
+
+    tag_record_t record;
+    if (tag_record_cache_get(tag->serial_number, &record) == TAG_RECORD_UNKNOWN) {
+        uint8_t raw[TAG_RECORD_SIZE];
+        if (rc522_read_pages(data->rc522, TAG_RECORD_FIRST_PAGE, raw, TAG_RECORD_PAGES) == ESP_OK) {
+            tag_record_cache_put(tag->serial_number, tag_record_decode(raw, &record) ? &record : NULL);
+        }
+    }
+    soak_scans++;
+}
+
+static void soak_script(TaskHandle_t task, int64_t now_us) {
+    // A tarefa ociosa (antes de rc522_start) também passa o relógio virtual: o roteiro conta a partir da varredura
+    if (!soak_started) {
+        return;
+    }
+    if (soak_start_us < 0) {
+        soak_start_us = now_us;
+    }
+    now_us -= soak_start_us;
+    int64_t slot = now_us / SOAK_SLOT_US;
+    if (slot != soak_slot) {
+        if (soak_slot >= 0) {
+            vrc522_tag_leave(soak_tags[soak_slot % SOAK_TAGS]);
+        }
+        vrc522_tag_enter(soak_tags[slot % SOAK_TAGS]);
+        soak_slot = slot;
+
+        // Outro usuário do cJSON segura um bloco enquanto as mensagens reiniciam a arena
+        if (soak_block) {
+            CHECK(intact(soak_block, OTHER_PATTERN));
+            host_cjson_free(soak_block);
+        }
+        soak_block = host_cjson_malloc(OTHER_BLOCK);
+        fill(soak_block, OTHER_PATTERN);
+        xTaskNotifyGive(soak_mqtt); // Chega uma resposta do receptor
+    }
+
+    if (now_us >= soak_next_check_us) {
+        CHECK(static_mem_heap_check());
+        soak_checks++;
+        soak_next_check_us = now_us + SOAK_CHECK_US;
+    }
+    if (now_us >= SOAK_DURATION_US) {
+        host_task_exit();
+    }
+}
+
+/* Mensagens MQTT chegando: cada uma decodifica uma árvore na arena, como handle_mqtt_data */
+static void soak_mqtt_task(void* arg) {
+    while (!soak_done) {
+        static_mem_arena_begin();
+        void* nodes[SOAK_MESSAGE_NODES];
+        for (int i = 0; i < SOAK_MESSAGE_NODES; i++) {
+            nodes[i] = host_cjson_malloc(40);
+            CHECK(nodes[i] != NULL);
+        }
+        for (int i = 0; i < SOAK_MESSAGE_NODES; i++) {
+            host_cjson_free(nodes[i]);
+        }
+        static_mem_arena_end();
+        soak_messages++;
+        ulTaskNotifyTake(pdTRUE, 1);
+    }
+    vTaskDelete(NULL);
+}
+
+static void test_soak(void) {
+    vrc522_install();
+    for (int i = 0; i < SOAK_TAGS; i++) {
+        tag_record_t record = { .item_id = 100 + i };
+        snprintf(record.name, sizeof(record.name), "Item %d", i);
+        soak_tags[i] = vrc522_tag_add((const uint8_t[4]) { 0x10 + i, 0x20, 0x30, 0x40 });
+        tag_record_encode(&record, vrc522_tag_memory(soak_tags[i]) + TAG_RECORD_FIRST_PAGE * 4);
+    }
+
+    host_clock_set_virtual(true);
+    static_mem_arena_install();
+    CHECK_EQ(scan_outbox_init(SCAN_OUTBOX_COALESCE_UID, "rfid/scanner/uid", "rfid/carga/uid", "LEITOR_TESTE"), ESP_OK);
+    scan_outbox_set_client(host_mqtt_client());
+    CHECK_EQ(xTaskCreate(soak_mqtt_task, "mqtt_task", 4096, NULL, 5, &soak_mqtt), pdTRUE);
+
+    rc522_config_t config = {
+        .transport = RC522_TRANSPORT_SPI,
+        .spi = { .host = VSPI_HOST, .miso_gpio = 19, .mosi_gpio = 23, .sck_gpio = 18, .sda_gpio = 15,
+                 .clock_speed_hz = 5000000 },
+    };
+    static rc522_storage_t storage;
+    rc522_handle_t scanner;
+    host_set_delay_hook(soak_script);
+    CHECK_EQ(rc522_create_static(&config, &storage, &scanner), ESP_OK);
+    CHECK_EQ(rc522_register_events(scanner, RC522_EVENT_ANY, soak_handler, NULL), ESP_OK);
+    uint32_t heap_boot = esp_get_free_heap_size();
+    CHECK_EQ(rc522_start(scanner), ESP_OK);
+    soak_started = true;
+
+    host_task_info_t info;
+    CHECK(host_task_info("rc522_task", &info));
+    host_task_join(info.handle);
+    soak_done = true;
+    CHECK(host_task_info("mqtt_task", &info));
+    host_task_join(info.handle);
+
+    printf("soak: %lu leituras, %lu mensagens, %lu checagens | heap livre boot=%lu fim=%lu mínimo=%lu\n",
+           (unsigned long) soak_scans, (unsigned long) soak_messages, (unsigned long) soak_checks,
+           (unsigned long) heap_boot, (unsigned long) esp_get_free_heap_size(),
+           (unsigned long) esp_get_minimum_free_heap_size());
+    CHECK(soak_scans >= SOAK_DURATION_US / SOAK_SLOT_US - 1);
+    CHECK(soak_messages > 0);
+    CHECK(soak_checks > (SOAK_DURATION_US - STATIC_MEM_WARMUP_S * 1000000LL) / SOAK_CHECK_US);
+    CHECK(static_mem_heap_check());
+}
+
+TEST_MAIN(
+    { "arena_escopo", test_arena_escopo },
+    { "soak", test_soak },
+)
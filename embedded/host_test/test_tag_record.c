@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <string.h>
+#include "tag_record.h"
+#include "test_util.h"
+
+static tag_record_t make_record(uint32_t item_id, const char* name) {
+    tag_record_t record = { .item_id = item_id };
+    snprintf(record.name, sizeof(record.name), "%s", name);
+    return record;
+}
+
+/* O handler só lê as páginas de um UID desconhecido; o cache guarda também "sem registro" */
+static void test_cache(void) {
+    tag_record_t record;
+    tag_record_t parafuso = make_record(101, "Parafuso M6");
+
+    CHECK_EQ(tag_record_cache_get(0x1001, &record), TAG_RECORD_UNKNOWN);
+    tag_record_cache_put(0x1001, &parafuso);
+    tag_record_cache_put(0x1002, NULL);
+    CHECK_EQ(tag_record_cache_get(0x1001, &record), TAG_RECORD_CACHED);
+    CHECK_EQ(record.item_id, 101);
+    CHECK(strcmp(record.name, "Parafuso M6") == 0);
+    CHECK_EQ(tag_record_cache_get(0x1002, &record), TAG_RECORD_ABSENT);
+
+    // Gravar por cima de uma entrada não ocupa outra
+    tag_record_t porca = make_record(202, "Porca M6");
+    tag_record_cache_put(0x1002, &porca);
+    CHECK_EQ(tag_record_cache_get(0x1002, &record), TAG_RECORD_CACHED);
+    CHECK_EQ(record.item_id, 202);
+
+    tag_record_cache_forget(0x1002);
+    CHECK_EQ(tag_record_cache_get(0x1002, &record), TAG_RECORD_UNKNOWN);
+
+    // Cheio, o mais antigo sai primeiro
+    for (uint64_t uid = 0x2000; uid < 0x2000 + TAG_RECORD_CACHE_SIZE; uid++) {
+        tag_record_cache_put(uid, NULL);
+    }
+    CHECK_EQ(tag_record_cache_get(0x1001, &record), TAG_RECORD_UNKNOWN);
+    CHECK_EQ(tag_record_cache_get(0x2000 + TAG_RECORD_CACHE_SIZE - 1, &record), TAG_RECORD_ABSENT);
+}
+
+TEST_MAIN(
+    { "cache", test_cache },
+)
@@ -0,0 +1,53 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Falha encerra o executável: cada cenário é um teste separado no ctest
+#define CHECK(cond) do {                                                                \
+        if (!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: falhou: %s\n", __FILE__, __LINE__, #cond);          \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_EQ(a, b) do {                                                             \
+        long long a_ = (long long) (a), b_ = (long long) (b);                           \
+        if (a_ != b_) {                                                                 \
+            fprintf(stderr, "%s:%d: falhou: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, \
+                    #a, #b, a_, b_);                                                    \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} test_case_t;
+
+/* Roda o cenário pedido em argv[1] (o ctest registra um por cenário) */
+static inline int test_main(int argc, char** argv, const test_case_t* cases, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (argc > 1 && strcmp(argv[1], cases[i].name) == 0) {
+            cases[i].run();
+            printf("ok: %s\n", cases[i].name);
+            return 0;
+        }
+    }
+    fprintf(stderr, "uso: %s <cenário>; cenários:", argv[0]);
+    for (size_t i = 0; i < n; i++) {
+        fprintf(stderr, " %s", cases[i].name);
+    }
+    fputc('\n', stderr);
+    return 2;
+}
+
+#define TEST_MAIN(...)                                                                  \
+    int main(int argc, char** argv) {                                                   \
+        static const test_case_t cases[] = { __VA_ARGS__ };                             \
+        return test_main(argc, argv, cases, sizeof(cases) / sizeof(cases[0]));         \
+    }
+
+#endif
@@ -0,0 +1,450 @@
+#include <string.h>
+#include "host_idf.h"
+#include "virtual_rc522.h"
+
+typedef struct {
+    bool used;
+    bool in_field;
+    bool woken;                 // Acordada por WUPA: um comando inválido a devolve a HALT
+    vrc522_state_t state;
+    uint8_t levels;             // Níveis de cascata: 1, 2 ou 3 para UIDs de 4, 7 ou 10 bytes
+    uint8_t level;              // Nível em que a tag READY está: avança a cada SELECT seu incompleto
+    uint8_t uid_len;
+    uint8_t uid[10];
+    uint8_t cascade[3][5];      // Por nível: CT 0x88 (menos no último) e bytes do UID, mais o BCC
+    uint8_t memory[VRC522_PAGES * 4];
+} vtag_t;
+
+static vtag_t tags[VRC522_TAGS_MAX];
+static uint8_t regs[64];
+static uint8_t fifo[64];
+static uint8_t fifo_n;
+static uint8_t fifo_rd;
+static uint32_t frames[256];
+
+static uint8_t fault_cmd;
+static vrc522_fault_t fault_kind;
+static int fault_count;
+static uint8_t weak_below;
+static int spi_fail;
+
+// Resposta de uma tag, em bits na ordem do ar (LSB primeiro)
+#define ANSWER_BITS_MAX (18 * 8)
+
+typedef struct {
+    uint8_t bits[ANSWER_BITS_MAX];
+    int n;
+} answer_t;
+
+static void crc_a(const uint8_t* data, int n, uint8_t* crc) {
+    uint16_t c = 0x6363;
+    for (int i = 0; i < n; i++) {
+        uint8_t b = data[i] ^ (uint8_t) c;
+        b ^= b << 4;
+        c = (c >> 8) ^ ((uint16_t) b << 8) ^ ((uint16_t) b << 3) ^ (b >> 4);
+    }
+    crc[0] = c & 0xFF;
+    crc[1] = c >> 8;
+}
+
+static bool crc_ok(const uint8_t* frame, int n) {
+    uint8_t crc[2];
+    if (n < 3) {
+        return false;
+    }
+    crc_a(frame, n - 2, crc);
+    return crc[0] == frame[n - 2] && crc[1] == frame[n - 1];
+}
+
+static inline int bit_of(const uint8_t* bytes, int i) {
+    return (bytes[i / 8] >> (i % 8)) & 1;
+}
+
+static void answer_bytes(answer_t* answer, const uint8_t* bytes, int n_bits) {
+    for (int i = 0; i < n_bits; i++) {
+        answer->bits[i] = bit_of(bytes, i);
+    }
+    answer->n = n_bits;
+}
+
+static void answer_with_crc(answer_t* answer, const uint8_t* data, int n) {
+    uint8_t buf[18];
+    memcpy(buf, data, n);
+    crc_a(buf, n, buf + n);
+    answer_bytes(answer, buf, (n + 2) * 8);
+}
+
+static void invalid_command(vtag_t* tag) {
+    tag->state = tag->woken ? VRC522_HALT : VRC522_IDLE;
+}
+
+/* Um quadro chegando a uma tag no campo. Retorna true se ela responde */
+static bool tag_receive(vtag_t* tag, const uint8_t* frame, int n, int bits, bool garbled, answer_t* answer) {
+    if (garbled) {
+        if (tag->state == VRC522_READY || tag->state == VRC522_ACTIVE) {
+            invalid_command(tag);
+        }
+        return false;
+    }
+
+    static const uint8_t atqa[2] = { 0x44, 0x00 };
+    static const uint8_t cascade_cmd[3] = { 0x93, 0x95, 0x97 };
+    if (bits == 7) {
+        bool wake = frame[0] == 0x52;
+        if (frame[0] != 0x26 && !wake) {
+            return false;
+        }
+        if (tag->state == VRC522_IDLE || (wake && tag->state == VRC522_HALT)) {
+            tag->woken = tag->state == VRC522_HALT;
+            tag->state = VRC522_READY;
+            tag->level = 0;
+            answer_bytes(answer, atqa, 16);
+            return true;
+        }
+        if (tag->state == VRC522_READY || tag->state == VRC522_ACTIVE) {
+            invalid_command(tag);
+        }
+        return false;
+    }
+
+    if (tag->state == VRC522_IDLE || tag->state == VRC522_HALT) {
+        return false; // Dormindo: só REQA/WUPA
+    }
+
+    if (tag->state == VRC522_READY && frame[0] == cascade_cmd[tag->level] && n >= 2) {
+        const uint8_t* sn = tag->cascade[tag->level];
+        uint8_t nvb = frame[1];
+        if (nvb == 0x70) {
+            if (n != 9 || !crc_ok(frame, n)) {
+                invalid_command(tag);
+                return false;
+            }
+            if (memcmp(frame + 2, sn, 5) != 0) {
+                invalid_command(tag); // SELECT de outra tag
+                return false;
+            }
+            // UID incompleto (SAK 0x04): continua READY, esperando o próximo nível
+            uint8_t sak[1] = { 0x04 };
+            if (++tag->level == tag->levels) {
+                tag->state = VRC522_ACTIVE;
+                sak[0] = 0x00;
+            }
+            answer_with_crc(answer, sak, 1);
+            return true;
+        }
+        int known = ((nvb >> 4) - 2) * 8 + (nvb & 0x0F);
+        if (known < 0 || known > 40) {
+            invalid_command(tag);
+            return false;
+        }
+        for (int i = 0; i < known; i++) {
+            if (bit_of(frame + 2, i) != bit_of(sn, i)) {
+                return false; // Não casa com o que já se sabe: fica quieta, continua READY
+            }
+        }
+        answer->n = 0;
+        for (int i = known; i < 40; i++) {
+            answer->bits[answer->n++] = bit_of(sn, i);
+        }
+        return true;
+    }
+
+    if (tag->state == VRC522_ACTIVE) {
+        if (frame[0] == 0x50 && n == 4 && frame[1] == 0x00 && crc_ok(frame, n)) {
+            tag->state = VRC522_HALT; // HLTA não tem resposta
+            return false;
+        }
+        if (frame[0] == 0x30 && n == 4 && crc_ok(frame, n)) {
+            uint8_t data[16];
+            for (int i = 0; i < 16; i++) {
+                data[i] = tag->memory[(frame[1] * 4 + i) % sizeof(tag->memory)];
+            }
+            answer_with_crc(answer, data, 16);
+            return true;
+        }
+        if (frame[0] == 0xA2 && n == 8 && crc_ok(frame, n) && frame[1] < VRC522_PAGES) {
+            memcpy(tag->memory + frame[1] * 4, frame + 2, 4);
+            static const uint8_t ack[1] = { 0x0A };
+            answer_bytes(answer, ack, 4);
+            return true;
+        }
+    }
+
+    invalid_command(tag);
+    return false;
+}
+
+static bool take_fault(uint8_t cmd, vrc522_fault_t* out_fault) {
+    if (fault_count > 0 && (fault_cmd == 0 || fault_cmd == cmd)) {
+        fault_count--;
+        *out_fault = fault_kind;
+        return true;
+    }
+    return false;
+}
+
+/* Transceive: envia a FIFO às tags e põe na FIFO o que voltou */
+static void transceive(void) {
+    uint8_t frame[64];
+    int n = fifo_n - fifo_rd;
+    memcpy(frame, fifo + fifo_rd, n);
+    fifo_n = fifo_rd = 0;
+
+    uint8_t tx_last = regs[0x0D] & 0x07;
+    uint8_t rx_align = (regs[0x0D] >> 4) & 0x07;
+    int bits = n ? (n - 1) * 8 + (tx_last ? tx_last : 8) : 0;
+
+    regs[0x04] |= 0x40; // TxIRq
+    regs[0x06] = 0x00;
+    regs[0x0C] &= ~0x07;
+    regs[0x0E] = (regs[0x0E] & 0x80) | 0x20;
+    if (n == 0) {
+        regs[0x04] |= 0x01;
+        return;
+    }
+    frames[frame[0]]++;
+
+    vrc522_fault_t fault;
+    bool faulty = take_fault(frame[0], &fault);
+    if (faulty && fault == VRC522_FAULT_LOST) {
+        regs[0x04] |= 0x01; // TimerIRq: ninguém respondeu
+        return;
+    }
+
+    answer_t answers[VRC522_TAGS_MAX];
+    int answered = 0;
+    for (int i = 0; i < VRC522_TAGS_MAX; i++) {
+        if (tags[i].used && tags[i].in_field &&
+            tag_receive(&tags[i], frame, n, bits, faulty && fault == VRC522_FAULT_GARBLED, &answers[answered])) {
+            answered++;
+        }
+    }
+    if (answered == 0) {
+        regs[0x04] |= 0x01;
+        return;
+    }
+
+    // Respostas somadas no ar: onde as tags discordam há colisão
+    int len = answers[0].n;
+    int collision = -1;
+    uint8_t bits_rx[ANSWER_BITS_MAX] = { 0 };
+    for (int b = 0; b < len; b++) {
+        bits_rx[b] = answers[0].bits[b];
+        for (int a = 1; a < answered; a++) {
+            if (b >= answers[a].n || answers[a].bits[b] != bits_rx[b]) {
+                collision = b;
+                break;
+            }
+        }
+        if (collision >= 0) {
+            break;
+        }
+    }
+    if (collision >= 0) {
+        memset(bits_rx + collision, 0, len - collision); // ValuesAfterColl = 0
+        regs[0x06] |= 0x08;
+        uint8_t position = collision + 1;
+        regs[0x0E] = (regs[0x0E] & 0x80) | (position > 32 ? 0x20 : (position & 0x1F));
+    }
+
+    int total = rx_align + len;
+    int bytes = (total + 7) / 8;
+    uint8_t rx[64] = { 0 };
+    for (int b = 0; b < len; b++) {
+        rx[(rx_align + b) / 8] |= bits_rx[b] << ((rx_align + b) % 8);
+    }
+    if (faulty && fault == VRC522_FAULT_CRC) {
+        rx[bytes - 1] ^= 0xFF;
+    }
+    if ((faulty && fault == VRC522_FAULT_PARITY) || (weak_below && (regs[0x26] >> 4 & 0x07) < weak_below)) {
+        regs[0x06] |= 0x02;
+    }
+    if (faulty && fault == VRC522_FAULT_PROTOCOL) {
+        regs[0x06] |= 0x01;
+    }
+    memcpy(fifo, rx, bytes);
+    fifo_n = bytes;
+    regs[0x0C] |= total % 8;
+    regs[0x04] |= 0x20; // RxIRq
+}
+
+static void write_reg(uint8_t addr, uint8_t value) {
+    switch (addr) {
+        case 0x01:
+            regs[0x01] = value;
+            if ((value & 0x0F) == 0x0F) {
+                uint8_t gain = regs[0x26];
+                memset(regs, 0, sizeof(regs));
+                regs[0x26] = gain;
+                fifo_n = fifo_rd = 0;
+            } else if ((value & 0x0F) == 0x03) {
+                uint8_t crc[2];
+                crc_a(fifo + fifo_rd, fifo_n - fifo_rd, crc);
+                regs[0x22] = crc[0];
+                regs[0x21] = crc[1];
+                regs[0x05] |= 0x04;
+            }
+            break;
+        case 0x04:
+        case 0x05:
+            // Set1/Set2: bit 7 diz se os bits marcados são ligados ou limpos
+            regs[addr] = (value & 0x80) ? regs[addr] | (value & 0x7F) : regs[addr] & ~(value & 0x7F);
+            break;
+        case 0x09:
+            if (fifo_n < sizeof(fifo)) {
+                fifo[fifo_n++] = value;
+            }
+            break;
+        case 0x0A:
+            if (value & 0x80) {
+                fifo_n = fifo_rd = 0;
+            }
+            break;
+        case 0x0D:
+            regs[0x0D] = value;
+            if ((value & 0x80) && (regs[0x01] & 0x0F) == 0x0C) {
+                transceive();
+            }
+            break;
+        default:
+            regs[addr] = value;
+    }
+}
+
+static uint8_t read_reg(uint8_t addr) {
+    switch (addr) {
+        case 0x09:
+            return fifo_rd < fifo_n ? fifo[fifo_rd++] : 0x00;
+        case 0x0A:
+            return fifo_n - fifo_rd;
+        case 0x37:
+            return 0x92;
+        default:
+            return regs[addr];
+    }
+}
+
+static uint8_t pending_read = 0xFF; // Endereço enviado na primeira metade de uma leitura full-duplex
+
+static esp_err_t spi_transfer(spi_transaction_t* t) {
+    if (spi_fail > 0) {
+        spi_fail--;
+        return ESP_FAIL;
+    }
+    if (t->flags & SPI_TRANS_USE_TXDATA) {
+        pending_read = (t->tx_data[0] >> 1) & 0x3F;
+        if (!(t->rx_buffer && t->rxlength)) {
+            return ESP_OK; // Full-duplex: os dados vêm na próxima transação
+        }
+    }
+    if (t->rx_buffer && t->rxlength) {
+        uint8_t* out = t->rx_buffer;
+        for (size_t i = 0; i < t->rxlength / 8; i++) {
+            out[i] = read_reg(pending_read);
+        }
+        return ESP_OK;
+    }
+    const uint8_t* tx = t->tx_buffer;
+    uint8_t addr = (tx[0] >> 1) & 0x3F;
+    for (size_t i = 1; i < t->length / 8; i++) {
+        write_reg(addr, tx[i]);
+    }
+    return ESP_OK;
+}
+
+void vrc522_install(void) {
+    memset(tags, 0, sizeof(tags));
+    memset(regs, 0, sizeof(regs));
+    memset(frames, 0, sizeof(frames));
+    fifo_n = fifo_rd = 0;
+    fault_count = 0;
+    weak_below = 0;
+    spi_fail = 0;
+    host_set_spi_transfer_hook(spi_transfer);
+}
+
+int vrc522_tag_add_uid(const uint8_t* uid, int uid_len) {
+    if (uid_len != 4 && uid_len != 7 && uid_len != 10) {
+        return -1;
+    }
+    for (int i = 0; i < VRC522_TAGS_MAX; i++) {
+        if (!tags[i].used) {
+            vtag_t* tag = &tags[i];
+            *tag = (vtag_t) { .used = true, .state = VRC522_IDLE, .levels = (uid_len - 1) / 3, .uid_len = uid_len };
+            memcpy(tag->uid, uid, uid_len);
+            for (int level = 0, next = 0; level < tag->levels; level++) {
+                uint8_t* sn = tag->cascade[level];
+                bool last = level + 1 == tag->levels;
+                if (!last) {
+                    sn[0] = 0x88; // Cascade tag: o UID continua no próximo nível
+                }
+                memcpy(sn + (last ? 0 : 1), uid + next, last ? 4 : 3);
+                next += last ? 4 : 3;
+                sn[4] = sn[0] ^ sn[1] ^ sn[2] ^ sn[3];
+            }
+            return i;
+        }
+    }
+    return -1;
+}
+
+int vrc522_tag_add(const uint8_t uid[4]) {
+    return vrc522_tag_add_uid(uid, 4);
+}
+
+void vrc522_tag_enter(int tag) {
+    tags[tag].in_field = true;
+    tags[tag].state = VRC522_IDLE;
+    tags[tag].woken = false;
+}
+
+void vrc522_tag_leave(int tag) {
+    tags[tag].in_field = false;
+    tags[tag].state = VRC522_IDLE;
+}
+
+vrc522_state_t vrc522_tag_state(int tag) {
+    return tags[tag].state;
+}
+
+uint8_t* vrc522_tag_memory(int tag) {
+    return tags[tag].memory;
+}
+
+uint64_t vrc522_tag_serial(int tag) {
+    const vtag_t* t = &tags[tag];
+    uint64_t serial = 0;
+    if (t->levels == 1) {
+        for (int i = 4; i >= 0; i--) {
+            serial |= (uint64_t) t->cascade[0][i] << (i * 8);
+        }
+        return serial;
+    }
+    serial = (uint64_t) t->uid_len << 56;
+    for (int i = 0; i < t->uid_len; i++) {
+        serial ^= (uint64_t) t->uid[i] << ((i % 7) * 8);
+    }
+    return serial;
+}
+
+void vrc522_fault(uint8_t cmd, vrc522_fault_t fault, int count) {
+    fault_cmd = cmd;
+    fault_kind = fault;
+    fault_count = count;
+}
+
+void vrc522_spi_fail_next(int n) {
+    spi_fail = n;
+}
+
+void vrc522_set_weak_below(uint8_t min_gain) {
+    weak_below = min_gain;
+}
+
+uint32_t vrc522_frames(uint8_t cmd) {
+    return frames[cmd];
+}
+
+uint8_t vrc522_rx_gain(void) {
+    return (regs[0x26] >> 4) & 0x07;
+}
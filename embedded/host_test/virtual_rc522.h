@@ -0,0 +1,66 @@
+#ifndef VIRTUAL_RC522_H
+#define VIRTUAL_RC522_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * MFRC522 de mentira atrás do SPI do host_idf: registradores, FIFO, CalcCRC e Transceive,
+ * com tags ISO 14443A (UID de 4, 7 ou 10 bytes, memória em páginas de 4 bytes como NTAG/Ultralight)
+ * entrando e saindo do campo. Cada tag segue a máquina de estados da norma: IDLE, READY,
+ * ACTIVE e HALT; um comando inválido em READY/ACTIVE devolve a tag a IDLE (ou HALT, se ela
+ * foi acordada por WUPA) sem resposta. Só a tarefa do leitor fala com o chip.
+ */
+
+#define VRC522_TAGS_MAX     8
+#define VRC522_PAGES        45      // NTAG213
+
+typedef enum {
+    VRC522_IDLE,
+    VRC522_READY,
+    VRC522_ACTIVE,
+    VRC522_HALT,
+} vrc522_state_t;
+
+typedef enum {
+    VRC522_FAULT_LOST,      // O quadro não chega às tags: nenhuma muda de estado, o leitor vê timeout
+    VRC522_FAULT_GARBLED,   // O quadro chega corrompido: comando inválido para as tags, timeout
+    VRC522_FAULT_PARITY,    // A resposta chega com erro de paridade (ErrorReg 0x02)
+    VRC522_FAULT_PROTOCOL,  // A resposta chega com erro de protocolo (ErrorReg 0x01)
+    VRC522_FAULT_CRC,       // A resposta chega com o último byte trocado: CRC_A não confere
+} vrc522_fault_t;
+
+/* Liga o chip ao SPI do host e zera tags, falhas e contadores */
+void vrc522_install(void);
+
+/* Cria uma tag fora do campo, com a memória zerada. Retorna o índice */
+int vrc522_tag_add(const uint8_t uid[4]);
+/* O mesmo para UIDs de 7 ou 10 bytes, que a anticolisão resolve em 2 ou 3 níveis (0x93, 0x95, 0x97) */
+int vrc522_tag_add_uid(const uint8_t* uid, int uid_len);
+void vrc522_tag_enter(int tag);
+void vrc522_tag_leave(int tag);         // Sem campo a tag desliga e volta em IDLE
+vrc522_state_t vrc522_tag_state(int tag);
+uint8_t* vrc522_tag_memory(int tag);    // VRC522_PAGES * 4 bytes
+/*
+ * serial_number que o driver reporta para a tag. UID de 4 bytes: UID e BCC, UID[0] no byte menos
+ * significativo; 7 ou 10 bytes: tamanho no byte mais alto e o UID abaixo (o de 10 dobrado com XOR)
+ */
+uint64_t vrc522_tag_serial(int tag);
+
+/* As próximas count trocas cujo quadro começa com cmd (0 = qualquer) sofrem a falha */
+void vrc522_fault(uint8_t cmd, vrc522_fault_t fault, int count);
+
+/* As próximas n transações SPI falham (fio ruim): o driver as conta como erros de link */
+void vrc522_spi_fail_next(int n);
+
+/*
+ * Sinal fraco: com RxGain abaixo de min_gain as respostas chegam com erro de paridade
+ * (0 desliga). As tags ainda recebem e executam os comandos.
+ */
+void vrc522_set_weak_below(uint8_t min_gain);
+
+/* Quadros enviados às tags que começam com cmd (0x26 REQA, 0x52 WUPA, 0x93/0x95/0x97, 0x50, 0x30, 0xA2) */
+uint32_t vrc522_frames(uint8_t cmd);
+uint8_t vrc522_rx_gain(void);
+
+#endif
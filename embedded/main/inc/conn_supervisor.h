@@ -0,0 +1,54 @@
+#ifndef CONN_SUPERVISOR_H
+#define CONN_SUPERVISOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+// --- Backoff exponencial com jitter descorrelacionado ---
+// atraso = min(CAP, aleatorio(BASE, atraso_anterior * 3)); nunca desiste
+#define CONN_BACKOFF_BASE_MS        500
+#define CONN_BACKOFF_CAP_MS         60000
+
+typedef enum {
+    CONN_HEALTH_WIFI_DOWN,      // Sem associação/IP
+    CONN_HEALTH_MQTT_DOWN,      // Wi-Fi ok, broker inacessível
+    CONN_HEALTH_OK,
+} conn_health_t;
+
+typedef void (*conn_health_cb_t)(conn_health_t health);
+
+typedef struct {
+    uint32_t base_ms;
+    uint32_t cap_ms;
+    uint32_t sleep_ms;          // Último atraso sorteado
+} conn_backoff_t;
+
+void conn_backoff_reset(conn_backoff_t* backoff);
+uint32_t conn_backoff_next(conn_backoff_t* backoff);
+
+/**
+ * Cria o temporizador de reconexão do Wi-Fi. on_health é chamado (do contexto
+ * do evento que causou a mudança) sempre que o estado agregado muda.
+ */
+esp_err_t conn_supervisor_init(conn_health_cb_t on_health);
+
+/**
+ * Passa a controlar o intervalo de reconexão do cliente MQTT. A configuração
+ * precisa continuar válida: ela é reaplicada com esp_mqtt_set_config() a cada
+ * novo atraso sorteado.
+ */
+void conn_supervisor_attach_mqtt(esp_mqtt_client_handle_t client, esp_mqtt_client_config_t* config);
+
+// Chamados pelos handlers de evento do Wi-Fi (GOT_IP / DISCONNECTED)
+void conn_supervisor_wifi_up(void);
+void conn_supervisor_wifi_down(void);
+
+// Chamados pelo handler do MQTT (CONNECTED / DISCONNECTED); ERROR sempre vem seguido de DISCONNECTED
+void conn_supervisor_mqtt_up(void);
+void conn_supervisor_mqtt_down(void);
+
+conn_health_t conn_supervisor_get_health(void);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+/*
+ * Log diferido: o caminho quente só copia um registro binário de tamanho fixo
+ * (ponteiro do formato + argumentos) para um anel; uma tarefa de baixa prioridade
+ * formata e imprime depois. O formato deve ser um literal (o ponteiro é guardado).
+ *
+ * Argumentos são uint32_t (use %lu/%lX/%ld); valores de 64 bits vão em duas metades.
+ * DLOGS guarda até DLOG_TEXT_MAX bytes de texto, que entram como o PRIMEIRO argumento (%s).
+ */
+#define DLOG_RING_SIZE          64
+#define DLOG_TEXT_MAX           32
+#define DLOG_TASK_STACK_SIZE    (3 * 1024)
+#define DLOG_TASK_PRIORITY      1
+#define DLOG_TASK_CORE          0
+#define DLOG_DEFAULT_LEVEL      ESP_LOG_INFO
+#define DLOG_BENCH_CALLS        1000
+#define DLOG_BENCH_STACK_SIZE   (3 * 1024)
+
+extern volatile esp_log_level_t dlog_level;
+
+#define DLOG(level, tag, fmt, a0, a1, a2, a3) do {                                      \
+        if ((level) <= dlog_level) {                                                   \
+            dlog_write((level), (tag), (fmt), (a0), (a1), (a2), (a3), NULL, 0);         \
+        }                                                                              \
+    } while (0)
+
+#define DLOGS(level, tag, fmt, text, text_len, a0, a1, a2) do {                         \
+        if ((level) <= dlog_level) {                                                   \
+            dlog_write((level), (tag), (fmt), (a0), (a1), (a2), 0, (text), (text_len)); \
+        }                                                                              \
+    } while (0)
+
+esp_err_t dlog_init(void);
+
+/* Não bloqueia: com o anel cheio o registro é descartado e contado */
+void dlog_write(esp_log_level_t level, const char* tag, const char* fmt,
+                uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                const char* text, int text_len);
+
+/* DLOG com o formato em variável, no formato de rc522_log_hook_t (o formato ainda deve ser literal) */
+void dlog_write_args(esp_log_level_t level, const char* tag, const char* fmt,
+                     uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+void dlog_set_level(esp_log_level_t level);
+
+uint32_t dlog_dropped(void);
+
+/**
+ * Compara o custo por chamada de ESP_LOGI e de DLOG no próprio chip e imprime o resultado.
+ * Roda numa tarefa própria, de baixa prioridade, que termina ao fim da medição: quem chama
+ * (o handler do MQTT) não fica preso nos ~1000 ESP_LOGI. Ferramenta de diagnóstico, usa o
+ * heap mesmo no modo estático. ESP_ERR_INVALID_STATE se uma medição já está rodando.
+ */
+esp_err_t dlog_benchmark_start(void);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef ENROLL_H
+#define ENROLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- Sessões de coleta: o leitor só envia cada UID uma vez, sem alternar status ---
+// Cadastro: o receptor grava as tags novas em lote. Auditoria: o receptor confere as
+// tags vistas contra o inventário esperado.
+// Tabela de UIDs já vistas na sessão (endereçamento aberto). Com 3/4 de ocupação a
+// busca continua curta; acima disso as repetidas passam e o receptor descarta.
+#define ENROLL_TABLE_BITS       12
+#define ENROLL_TABLE_SIZE       (1 << ENROLL_TABLE_BITS)
+#define ENROLL_SEEN_MAX         (ENROLL_TABLE_SIZE * 3 / 4)
+
+typedef enum {
+    ENROLL_MODE_OFF,            // Leitura normal: cada toque alterna o status
+    ENROLL_MODE_CADASTRO,
+    ENROLL_MODE_AUDITORIA,
+} enroll_mode_t;
+
+/**
+ * Troca o modo da sessão. Ao entrar num modo de coleta (ou trocar de um para o outro),
+ * a sessão começa vazia: a tabela é limpa pela própria tarefa do RC522 na próxima
+ * leitura, sem disputa com ela.
+ */
+void enroll_set_mode(enroll_mode_t mode);
+
+enroll_mode_t enroll_get_mode(void);
+
+static inline bool enroll_is_active(void) {
+    return enroll_get_mode() != ENROLL_MODE_OFF;
+}
+
+/**
+ * Chamado pela tarefa do RC522 (único escritor). Retorna true se a UID ainda não
+ * foi vista nesta sessão e deve ser enviada; uma UID já vista conta em enroll_repeats.
+ */
+bool enroll_add(uint64_t uid);
+
+/**
+ * Esquece uma UID que enroll_add aceitou mas que não chegou a sair (a outbox a descartou):
+ * a próxima leitura dela na sessão é enviada de novo. Só a tarefa do RC522 chama.
+ */
+void enroll_forget(uint64_t uid);
+
+/* UIDs distintas desta sessão, para o contador do LCD (aproximado acima de ENROLL_SEEN_MAX) */
+uint32_t enroll_count(void);
+
+/* Leituras de UIDs que a sessão já tinha visto: não saem de novo, mas o operador é avisado */
+uint32_t enroll_repeats(void);
+
+#endif
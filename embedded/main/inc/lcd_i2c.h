@@ -2,6 +2,7 @@
 #define LCD_I2C_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "driver/i2c.h" 
 #include "esp_err.h"    
 
@@ -15,6 +16,13 @@
 
 // --- Configurações Específicas do LCD ---
 #define LCD_I2C_ADDRESS 0x27 
+#define LCD_COLS                    16
+#define LCD_DDRAM_LINE_LEN          40  // Cada linha da DDRAM guarda 40 caracteres; só 16 aparecem
+#define LCD_LINE2_DDRAM_ADDR        0x40
+
+// Letreiro: texto longo da linha 1 rolado pelo deslocamento do display (linha 2 vazia) ou reescrito
+#define LCD_MARQUEE_STEP_MS         400
+#define LCD_MARQUEE_PAUSE_STEPS     3   // Passos parado no começo e no fim de cada passada
 
 // Comandos do LCD
 #define LCD_CLEAR_DISPLAY           0x01
@@ -30,6 +38,10 @@
 #define LCD_ENTRY_LEFT              0x02
 #define LCD_ENTRY_SHIFT_DECREMENT   0x00
 
+// Flags para cursor/display shift
+#define LCD_DISPLAY_MOVE            0x08
+#define LCD_MOVE_LEFT               0x00
+
 // Flags para display on/off control
 #define LCD_DISPLAY_ON              0x04
 #define LCD_CURSOR_OFF              0x00
@@ -52,4 +64,28 @@ void lcd_set_cursor(uint8_t row, uint8_t col);
 void lcd_print_char(char c);
 void lcd_print_str(const char *str);
 
+/**
+ * Escreve as duas linhas; a linha 1 pode ter até LCD_DDRAM_LINE_LEN caracteres.
+ * Se passar de LCD_COLS, liga o letreiro e retorna quantos passos tem uma passada
+ * completa (pausas e volta ao início incluídas); senão retorna 0.
+ * O deslocamento do display move as duas linhas juntas, então só é usado com a
+ * linha 2 em branco: a linha 1 vai inteira para a DDRAM e cada passo é um comando.
+ * Com a linha 2 preenchida, cada passo reescreve as 16 colunas da linha 1.
+ */
+uint32_t lcd_marquee_start(const char *line1, const char *line2);
+
+/* Um passo do letreiro: um comando de deslocamento (ou volta ao início), ou a linha 1 reescrita */
+void lcd_marquee_step(void);
+
+bool lcd_marquee_active(void);
+
+/* Bytes enviados no barramento I2C desde o boot, endereço incluído */
+uint32_t lcd_i2c_bytes_sent(void);
+
+/**
+ * Compara, numa passada sobre `line1`, o letreiro com `line2` (reescreve a linha 1) e
+ * com a linha 2 vazia (deslocamento). Usa o LCD de verdade e deixa a tela limpa.
+ */
+void lcd_marquee_bench(const char *line1, const char *line2);
+
 #endif 
\ No newline at end of file
@@ -5,7 +5,9 @@
 extern "C" {
 #endif
 
+#include <freertos/FreeRTOS.h>
 #include <esp_event.h>
+#include <esp_log.h>
 #include <driver/spi_master.h>
 #include <driver/i2c.h>
 
@@ -14,14 +16,37 @@ extern "C" {
 #define RC522_DEFAULT_SCAN_INTERVAL_MS (125)
 #define RC522_DEFAULT_TASK_STACK_SIZE (4 * 1024)
 #define RC522_DEFAULT_TASK_STACK_PRIORITY (4)
+#define RC522_TASK_NO_AFFINITY (tskNO_AFFINITY)
 #define RC522_DEFAULT_SPI_CLOCK_SPEED_HZ (5000000)
+#define RC522_LINK_TRAINING_ROUNDS (16)   /*<! FIFO pattern rounds a clock must pass during link training */
+#define RC522_LINK_CHECK_INTERVAL (80)    /*<! Idle polls between runtime link checks (~10 s at the default interval) */
+#define RC522_LINK_ERROR_THRESHOLD (3)    /*<! Link errors that make the driver fall back to a slower clock */
 #define RC522_DEFAULT_I2C_RW_TIMEOUT_MS (1000)
 #define RC522_DEFAULT_I2C_CLOCK_SPEED_HZ (100000)
+#define RC522_STATIC_EVENT_HANDLERS (2)   /*<! Handlers that can be registered on a handle created with rc522_create_static */
+#define RC522_STATIC_HANDLE_WORDS (240)   /*<! Room for the opaque handle inside rc522_storage_t */
+#define RC522_PRESENCE_MAX (12)           /*<! Tags tracked at once for RC522_EVENT_TAG_REMOVED; more are reported but not tracked */
+#define RC522_POLL_TAGS_MAX (RC522_PRESENCE_MAX) /*<! New tags read in one poll (a tray); the rest wait for the next poll */
+#define RC522_DEFAULT_REMOVAL_MISSES (3)  /*<! Failed presence checks in a row before a tag counts as removed */
+#define RC522_PRESENCE_TIMEOUT_TICKS (4)  /*<! Reply timeout for presence checks, in 0.5 ms timer ticks (polls use 30) */
+#define RC522_FAST_RETRIES (2)            /*<! Immediate retries when a tag answered but the exchange failed halfway */
+#define RC522_DEFAULT_RX_GAIN (6)         /*<! RxGain (RFCfgReg bits 6:4): 4 = 33 dB, 5 = 38 dB, 6 = 43 dB, 7 = 48 dB */
+#define RC522_GAIN_MIN (4)                /*<! Lower values repeat 18/23 dB, too deaf for a counter reader */
+#define RC522_GAIN_WINDOW (32)            /*<! Answered tag exchanges (timeouts excluded) per gain decision */
+#define RC522_GAIN_ERROR_PCT (20)         /*<! Share of failed exchanges in a window that makes the gain move */
 
 ESP_EVENT_DECLARE_BASE(RC522_EVENTS);
 
 typedef struct rc522* rc522_handle_t;
 
+/**
+ * @brief Sink for the logs the driver writes from the scan loop (transport errors, gain
+ *        changes). fmt is a string literal and the arguments are uint32_t (%lu/%lX), so the
+ *        app can store the record and format it later, off the hot path.
+ */
+typedef void (*rc522_log_hook_t)(esp_log_level_t level, const char* tag, const char* fmt,
+                                 uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
 typedef enum {
     RC522_TRANSPORT_SPI,
     RC522_TRANSPORT_I2C,
@@ -31,6 +56,12 @@ typedef struct {
     uint16_t scan_interval_ms;         /*<! How fast will ESP32 scan for nearby tags, in miliseconds */
     size_t task_stack_size;            /*<! Stack size of rc522 task */
     uint8_t task_priority;             /*<! Priority of rc522 task */
+    bool pin_core;                     /*<! Pin rc522 task to core_id. Left false (zero-initialized config), the task runs on any core */
+    int core_id;                       /*<! Core rc522 task is pinned to when pin_core is set (0 = PRO, 1 = APP) */
+    uint8_t removal_misses;            /*<! Removal hysteresis: failed presence checks in a row before RC522_EVENT_TAG_REMOVED. 0 = RC522_DEFAULT_REMOVAL_MISSES */
+    uint8_t rx_gain;                   /*<! Initial RxGain, and the one clean windows settle back to. RC522_GAIN_MIN..7. 0 = RC522_DEFAULT_RX_GAIN */
+    bool fixed_gain;                   /*<! Keep rx_gain instead of adapting it to the error mix */
+    rc522_log_hook_t log_hook;         /*<! Where scan-loop logs go. NULL = esp_log_write, formatted right away */
     rc522_transport_t transport;       /*<! Transport that will be used. Defaults to SPI */
     union {
         struct {
@@ -39,7 +70,7 @@ typedef struct {
             int mosi_gpio;
             int sck_gpio;
             int sda_gpio;
-            int clock_speed_hz;
+            int clock_speed_hz;        /*<! Leave 0 to let rc522_start train the link and pick the fastest stable clock */
             uint32_t device_flags;     /*<! Bitwise OR of SPI_DEVICE_* flags */
             /**
              * @brief Set to true if the bus is already initialized. 
@@ -62,7 +93,8 @@ typedef struct {
 typedef enum {
     RC522_EVENT_ANY = ESP_EVENT_ANY_ID,
     RC522_EVENT_NONE,
-    RC522_EVENT_TAG_SCANNED,             /*<! Tag scanned */
+    RC522_EVENT_TAG_SCANNED,             /*<! Tag entered the field. Fired once per arrival, while the tag stays it is only checked for presence. Several tags in the field are reported one after the other, in the same poll */
+    RC522_EVENT_TAG_REMOVED,             /*<! Tracked tag missed removal_misses presence checks in a row; dwell_us is set */
 } rc522_event_t;
 
 typedef struct {
@@ -71,9 +103,54 @@ typedef struct {
 } rc522_event_data_t;
 
 typedef struct {
-    uint64_t serial_number;
+    uint64_t serial_number;            /*<! Key of the tag. 4 byte UID: UID + BCC, UID[0] in the low byte. 7/10 byte UID: length in the top byte, UID below (a 10 byte UID folded) */
+    uint8_t uid[10];                   /*<! Full UID, every cascade level */
+    uint8_t uid_len;                   /*<! 4, 7 or 10 */
+    int64_t poll_start_us;             /*<! esp_timer time at which the poll that found the tag started */
+    uint32_t wake_late_us;             /*<! How late that poll started versus its schedule (light sleep wake-up, DFS) */
+    int64_t dwell_us;                  /*<! RC522_EVENT_TAG_REMOVED: from arrival to the last successful presence check */
 } rc522_tag_t;
 
+typedef enum {
+    RC522_STAGE_REQUEST,               /*<! REQA; a timeout here is the normal "no tag" outcome */
+    RC522_STAGE_ANTICOLL,              /*<! Anticollision, 4 UID bytes + BCC per cascade level */
+    RC522_STAGE_SELECT,                /*<! WUPA + SELECT, before page access and in presence checks */
+    RC522_STAGE_READ,                  /*<! READ of 4 pages */
+    RC522_STAGE_WRITE,                 /*<! WRITE of one page */
+    RC522_STAGE_COUNT,
+} rc522_stage_t;
+
+typedef struct {
+    uint32_t ok;
+    uint32_t timeout;                  /*<! No answer before the timer ran out */
+    uint32_t collision;                /*<! CollErr: more than one tag answered, or a garbled answer */
+    uint32_t parity;                   /*<! ParityErr */
+    uint32_t crc;                      /*<! CRC_A or BCC mismatch, checked in software (RxCRCEn is off) */
+    uint32_t protocol;                 /*<! ProtocolErr, BufferOvfl, or an answer of the wrong length */
+} rc522_stage_stats_t;
+
+typedef struct {
+    rc522_stage_stats_t stage[RC522_STAGE_COUNT];
+    uint32_t retries;                  /*<! Fast retries issued after a partial exchange */
+    uint32_t retry_saves;              /*<! Exchanges that a fast retry turned into a success */
+    uint32_t gain_changes;
+    uint8_t rx_gain;                   /*<! Current RxGain */
+    uint32_t polls;                    /*<! Polls run while scanning */
+    uint32_t poll_late_max_us;         /*<! Worst delay of a poll start versus its schedule (scan-loop jitter) */
+    uint64_t poll_late_sum_us;         /*<! Sum of those delays, for the mean */
+} rc522_stats_t;
+
+/**
+ * @brief Caller provided storage for rc522_create_static. Must outlive the handle,
+ *        so declare it static. The task stack is always RC522_DEFAULT_TASK_STACK_SIZE.
+ */
+typedef struct {
+    uint32_t handle[RC522_STATIC_HANDLE_WORDS];
+    rc522_config_t config;
+    StaticTask_t task_buffer;
+    StackType_t task_stack[RC522_DEFAULT_TASK_STACK_SIZE];
+} rc522_storage_t;
+
 /**
  * @brief Create RC522 scanner handle.
  *        To start scanning tags call the rc522_start function.
@@ -83,6 +160,17 @@ typedef struct {
  */
 esp_err_t rc522_create(rc522_config_t* config, rc522_handle_t* out_rc522);
 
+/**
+ * @brief Same as rc522_create, but the handle, configuration and task live in storage and
+ *        nothing is taken from the heap, neither here nor while scanning. There is no event
+ *        loop: handlers (up to RC522_STATIC_EVENT_HANDLERS) are called directly from the rc522 task.
+ * @param config Configuration (task_stack_size is ignored)
+ * @param storage Storage for the handle
+ * @param out_rc522 Pointer to resulting new handle
+ * @return ESP_OK on success
+ */
+esp_err_t rc522_create_static(rc522_config_t* config, rc522_storage_t* storage, rc522_handle_t* out_rc522);
+
 esp_err_t rc522_register_events(rc522_handle_t rc522, rc522_event_t event, esp_event_handler_t event_handler, void* event_handler_arg);
 
 esp_err_t rc522_unregister_events(rc522_handle_t rc522, rc522_event_t event, esp_event_handler_t event_handler);
@@ -102,6 +190,24 @@ esp_err_t rc522_start(rc522_handle_t rc522);
  */
 #define rc522_resume(rc522) rc522_start(rc522)
 
+/**
+ * @brief Change how often tags are polled. Takes effect after the current delay.
+ *        Between polls the task only sleeps, so a longer interval lets the chip light-sleep longer.
+ * @param rc522 Handle
+ * @param scan_interval_ms Interval in miliseconds, at least 50
+ * @return ESP_OK on success
+ */
+esp_err_t rc522_set_scan_interval(rc522_handle_t rc522, uint16_t scan_interval_ms);
+
+/**
+ * @brief Copy the RF outcome counters. Counters are updated by the rc522 task without a lock,
+ *        so a copy taken while scanning may be off by the exchange in progress.
+ * @param rc522 Handle
+ * @param out_stats Destination
+ * @return ESP_OK on success
+ */
+esp_err_t rc522_get_stats(rc522_handle_t rc522, rc522_stats_t* out_stats);
+
 /**
  * @brief Pause scan tags. If already paused, ESP_OK will just be returned.
  * @param rc522 Handle
@@ -109,6 +215,29 @@ esp_err_t rc522_start(rc522_handle_t rc522);
  */
 esp_err_t rc522_pause(rc522_handle_t rc522);
 
+/**
+ * @brief Read NTAG/MIFARE Ultralight pages (4 bytes each) from the tag that was just scanned.
+ *        Can only be called from the event handler, while the tag is still in the field.
+ * @param rc522 Handle
+ * @param page First page to read (user memory starts at page 4)
+ * @param buffer Destination, at least n_pages * 4 bytes
+ * @param n_pages Number of pages to read
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the tag left the field,
+ *         ESP_ERR_TIMEOUT or ESP_ERR_INVALID_CRC on a failed read
+ */
+esp_err_t rc522_read_pages(rc522_handle_t rc522, uint8_t page, uint8_t* buffer, uint8_t n_pages);
+
+/**
+ * @brief Write NTAG/MIFARE Ultralight pages (4 bytes each) to the tag that was just scanned.
+ *        Can only be called from the event handler, while the tag is still in the field.
+ * @param rc522 Handle
+ * @param page First page to write (user memory starts at page 4)
+ * @param data Source, n_pages * 4 bytes
+ * @param n_pages Number of pages to write
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the tag left the field, ESP_FAIL if a page was not acknowledged
+ */
+esp_err_t rc522_write_pages(rc522_handle_t rc522, uint8_t page, const uint8_t* data, uint8_t n_pages);
+
 /**
  * @brief Destroy RC522 and free all resources. Cannot be called from event handler.
  * @param rc522 Handle
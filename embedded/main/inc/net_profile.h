@@ -0,0 +1,57 @@
+#ifndef NET_PROFILE_H
+#define NET_PROFILE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include "esp_transport.h"
+#include "esp_wifi.h"
+
+typedef enum {
+    NET_PROFILE_ECONOMIA,       // Padrão do ESP-IDF: modem-sleep (WIFI_PS_MIN_MODEM), acorda a cada DTIM
+    NET_PROFILE_LATENCIA,       // Rádio sempre ligado (WIFI_PS_NONE) e TCP_NODELAY no socket do MQTT
+} net_profile_t;
+
+// --- Perfil escolhido na compilação; pode ser trocado em tempo de execução via MQTT ---
+#define NET_PROFILE_DEFAULT         NET_PROFILE_ECONOMIA
+#define NET_LATENCIA_STATIC_RX_BUF  16      // Buffers fixos de RX do Wi-Fi quando o boot sai em "latencia" (sdkconfig: 10)
+#define NET_MQTT_TASK_PRIORITY      6       // Acima da tarefa do RC522 (4) e da outbox (3)
+
+// --- Modo benchmark: pings de requisição/resposta contra o receptor ---
+#define NET_BENCH_PINGS             1000
+#define NET_BENCH_TIMEOUT_MS        2000
+#define NET_BENCH_ON_BOOT           0       // 1 = roda o benchmark logo após a primeira conexão MQTT
+#define NET_BENCH_TASK_STACK_SIZE   (3 * 1024)
+#define NET_BENCH_TASK_PRIORITY     2
+#define NET_BENCH_TASK_CORE         0       // Núcleo PRO, junto com a pilha de rede
+
+/**
+ * Aplica o perfil ao rádio e, se o cliente já estiver conectado, ao socket do MQTT.
+ * Pode ser chamado a qualquer momento depois de esp_wifi_start().
+ */
+esp_err_t net_profile_apply(net_profile_t profile);
+
+/**
+ * Ajusta a configuração de esp_wifi_init() ao perfil de boot (NET_PROFILE_DEFAULT): só o
+ * perfil de latência ganha mais buffers de RX. Eles são alocados uma vez no init, então
+ * trocar de perfil em execução muda o power save e o Nagle, mas não os buffers.
+ */
+void net_profile_wifi_init_config(wifi_init_config_t* cfg);
+
+net_profile_t net_profile_get(void);
+
+/**
+ * Informa o transporte TCP usado pelo cliente MQTT, para que o TCP_NODELAY seja
+ * reaplicado a cada nova conexão (chamar em MQTT_EVENT_CONNECTED).
+ */
+void net_profile_on_mqtt_connected(esp_transport_handle_t transport);
+
+/**
+ * Dispara em segundo plano NET_BENCH_PINGS pings em ping_topic e imprime a
+ * distribuição de RTT. As respostas devem ser entregues a net_profile_bench_on_pong().
+ */
+esp_err_t net_profile_bench_start(esp_mqtt_client_handle_t client, const char* ping_topic);
+
+void net_profile_bench_on_pong(const char* data, int data_len);
+
+#endif
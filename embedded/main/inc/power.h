@@ -0,0 +1,77 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "net_profile.h"
+
+/*
+ * Gerência de energia (esp_pm): DFS entre max/min_freq_mhz e light sleep automático
+ * quando nenhuma trava está presa. Travas só em volta do trabalho de verdade: a
+ * rajada de SPI de cada varredura (dentro do driver do RC522), o desenho no LCD e o
+ * tratamento/envio do MQTT. O Wi-Fi continua associado em modem-sleep, acordando
+ * a cada DTIM. Requer CONFIG_PM_ENABLE e CONFIG_FREERTOS_USE_TICKLESS_IDLE.
+ */
+typedef enum {
+    POWER_PROFILE_DESEMPENHO,   // 160 MHz fixo, sem light sleep, rádio sempre ligado: como antes
+    POWER_PROFILE_EQUILIBRIO,   // DFS 80-160 MHz e light sleep; varredura a cada 125 ms
+    POWER_PROFILE_BATERIA,      // DFS 40-160 MHz e light sleep; varredura a cada 250 ms
+} power_profile_t;
+
+typedef struct {
+    const char* name;
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep;
+    uint16_t scan_interval_ms;  // Maior parcela do toque->evento: em média metade disto
+} power_profile_config_t;
+
+// --- Perfil escolhido na compilação; pode ser trocado em execução via MQTT (tópico de perfil) ---
+#define POWER_PROFILE_DEFAULT       POWER_PROFILE_DESEMPENHO   // Leitores de carrinho: POWER_PROFILE_BATERIA
+
+// --- Instrumentação: relatório periódico de travas e da latência toque->evento ---
+// O tempo em cada modo (light sleep, APB_MIN, CPU_MAX) vem de CONFIG_PM_PROFILING, ligado no sdkconfig.
+#define POWER_INSTRUMENT            0       // 1 = imprime o relatório junto com as estatísticas da outbox
+
+typedef enum {
+    POWER_LOCK_LCD,             // APB no máximo: o I2C do LCD não muda de clock no meio da tela
+    POWER_LOCK_MQTT,            // CPU no máximo enquanto trata mensagens e drena a outbox
+    POWER_LOCK_COUNT,
+} power_lock_t;
+
+/* Cria as travas. Chamar antes de qualquer power_lock(); até power_apply() o clock fica fixo. */
+esp_err_t power_init(void);
+
+/**
+ * Aplica DFS/light sleep do perfil, então só depois de esp_wifi_start(). Light sleep
+ * exige modem-sleep: se a rede estiver em latencia, ela volta para economia; os perfis
+ * sem light sleep mantêm o perfil de rede escolhido. O intervalo de varredura fica por
+ * conta de quem tem o handle do RC522 (power_get_config()->scan_interval_ms).
+ */
+esp_err_t power_apply(power_profile_t profile);
+
+/**
+ * Troca o perfil de rede (comandos "latencia"/"economia"). Latência com um perfil de
+ * light sleep é recusada com ESP_ERR_INVALID_STATE: o rádio sempre ligado o anularia.
+ */
+esp_err_t power_set_net_profile(net_profile_t profile);
+
+power_profile_t power_get(void);
+
+const power_profile_config_t* power_get_config(void);
+
+/* Travas com contagem: podem ser aninhadas e presas por mais de uma tarefa */
+void power_lock(power_lock_t lock);
+
+void power_unlock(power_lock_t lock);
+
+/**
+ * Registra uma leitura: quanto a varredura que achou a tag atrasou em relação ao
+ * horário (acordar do light sleep e DFS) e quanto levou da varredura até o handler.
+ */
+void power_record_tap(uint32_t wake_late_us, uint32_t poll_to_event_us);
+
+void power_report(void);
+
+#endif
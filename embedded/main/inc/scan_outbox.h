@@ -0,0 +1,100 @@
+#ifndef SCAN_OUTBOX_H
+#define SCAN_OUTBOX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+// --- Configuração da fila de saída de leituras ---
+#define SCAN_OUTBOX_CAPACITY          16      // Número fixo de leituras pendentes (pool pré-alocado)
+#define SCAN_OUTBOX_TASK_STACK_SIZE   (4 * 1024)  // Monta o lote com snprintf
+#define SCAN_OUTBOX_TASK_PRIORITY     3       // Abaixo da tarefa do RC522 (4)
+#define SCAN_OUTBOX_TASK_CORE         0       // Núcleo PRO, junto com Wi-Fi/lwIP/MQTT
+#define SCAN_OUTBOX_RETRY_DELAY_MS    500     // Espera antes de tentar de novo quando o publish falha
+#define SCAN_OUTBOX_PAYLOAD_MAX       128
+#define SCAN_OUTBOX_TOPIC_MAX         48
+// Leituras vão para <tópico>/p/<partição>, escolhida pelo hash da UID: no receptor em
+// cluster cada partição pertence a uma instância, então os toggles de um item ficam em ordem.
+// Potência de 2 (o hash usa os bits altos). Deve ser igual a PARTICOES no receptor.py.
+#define SCAN_OUTBOX_PARTITION_BITS    4
+#define SCAN_OUTBOX_PARTITIONS        (1 << SCAN_OUTBOX_PARTITION_BITS)
+
+// --- Lote: leituras próximas no tempo (uma bandeja, toques seguidos) saem num publish só ---
+// O lote fecha quando passa SCAN_OUTBOX_BATCH_GAP_MS sem leitura nova, quando a primeira
+// já esperou SCAN_OUTBOX_BATCH_AGE_MS ou quando junta SCAN_OUTBOX_BATCH_MAX leituras do mesmo
+// tipo. Vai para <tópico>/lote, fora das partições: o receptor processa o lote numa transação
+// só. Um lote de uma leitura sai como antes, na partição da UID. GAP 0 desliga o lote.
+// Toggle é interativo e não espera GAP: sai na hora, e as leituras que chegam durante o
+// publish vão juntas no seguinte. Só as leituras de sessão (cadastro, auditoria) esperam.
+#define SCAN_OUTBOX_BATCH_GAP_MS      250     // Uma bandeja sai numa varredura; toques seguidos ficam a ~1 s
+#define SCAN_OUTBOX_TOGGLE_GAP_MS     0       // Espera dos toggles por leitura nova antes de fechar o lote
+#define SCAN_OUTBOX_BATCH_AGE_MS      1500
+#define SCAN_OUTBOX_BATCH_MAX         10
+#define SCAN_OUTBOX_BATCH_PAYLOAD_MAX (112 + SCAN_OUTBOX_BATCH_MAX * 56)
+#define SCAN_OUTBOX_BATCH_SUFFIX      "/lote"   // Deve casar com MQTT_TOPIC_LOTE no receptor.py
+
+// Política aplicada quando a fila está cheia (ou a UID já está na fila)
+typedef enum {
+    SCAN_OUTBOX_DROP_OLDEST,    // Descarta a leitura mais antiga para abrir espaço
+    SCAN_OUTBOX_DROP_NEWEST,    // Descarta a leitura que acabou de chegar
+    SCAN_OUTBOX_COALESCE_UID,   // Uma UID já pendente não é enfileirada de novo; se cheia, descarta a mais antiga
+} scan_outbox_policy_t;
+
+// O que o receptor faz com a leitura. O tipo também escolhe a classe de tráfego: toggles
+// saem no tópico interativo, sessões de cadastro e auditoria no de carga, que o receptor
+// atende noutra fila e noutra conexão, sem atrasar os toques do balcão.
+typedef enum {
+    SCAN_KIND_TOGGLE,           // Alterna o status do item (interativo)
+    SCAN_KIND_ENROLL,           // Modo cadastro: grava a tag nova (carga)
+    SCAN_KIND_AUDIT,            // Auditoria: só marca a tag como vista (carga)
+} scan_kind_t;
+
+typedef struct {
+    uint64_t uid;
+    int64_t timestamp_us;       // esp_timer_get_time() no momento da leitura
+    uint32_t seq;               // Número da leitura neste boot; reenvios repetem o mesmo (dedupe no receptor)
+    scan_kind_t kind;
+} scan_record_t;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t published;
+    uint32_t dropped;
+    uint32_t coalesced;
+    uint32_t publish_failures;
+    uint16_t high_watermark;    // Maior ocupação observada da fila
+    uint32_t batches;           // Publishes com mais de uma leitura
+    uint32_t batched;           // Leituras que foram nesses publishes
+    uint32_t batch_wait_max_ms; // Maior espera da primeira leitura de um lote até o publish
+} scan_outbox_stats_t;
+
+/**
+ * Prepara a fila e cria a tarefa de envio. Cada boot sorteia um identificador
+ * que, junto com leitorId e seq, identifica a leitura de forma única. O cliente MQTT pode ser informado
+ * depois com scan_outbox_set_client(); até lá as leituras ficam na fila.
+ * topic é a base dos toggles e bulk_topic a das leituras de sessão (ver scan_kind_t).
+ */
+esp_err_t scan_outbox_init(scan_outbox_policy_t policy, const char* topic, const char* bulk_topic,
+                           const char* reader_id);
+
+void scan_outbox_set_client(esp_mqtt_client_handle_t client);
+
+/**
+ * Enfileira uma leitura sem bloquear. Seguro para chamar a partir do handler
+ * do RC522: não toca no socket nem no lock do cliente MQTT.
+ * Retorna false se a leitura foi descartada ou agrupada pela política.
+ */
+bool scan_outbox_push(uint64_t uid, int64_t timestamp_us, scan_kind_t kind);
+
+/*
+ * Chamado com cada leitura que a fila cheia descartou (a mais antiga ou, em DROP_NEWEST,
+ * a que acabou de chegar), fora da seção crítica, na tarefa que fez o push. Uma leitura
+ * agrupada com a que já estava na fila não é descartada: essa ainda vai sair.
+ */
+typedef void (*scan_outbox_drop_hook_t)(const scan_record_t* record);
+void scan_outbox_set_drop_hook(scan_outbox_drop_hook_t hook);
+
+void scan_outbox_get_stats(scan_outbox_stats_t* out_stats);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef STATIC_MEM_H
+#define STATIC_MEM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Modo de alocação estática (opt-in): tarefas, filas, mutex e timer da aplicação
+ * usam memória reservada na compilação, o handle do RC522 fica em armazenamento
+ * fornecido pelo app e o cJSON decodifica cada mensagem MQTT numa arena que é
+ * reiniciada a cada mensagem. Depois do boot, o caminho da leitura não toca no heap.
+ * Requer CONFIG_FREERTOS_SUPPORT_STATIC_ALLOCATION (já ligado no sdkconfig).
+ */
+#ifndef STATIC_MEM_ENABLED
+#define STATIC_MEM_ENABLED          0       // 1 = liga o modo estático (ou -DSTATIC_MEM_ENABLED=1)
+#endif
+#define STATIC_MEM_ARENA_SIZE       2048    // Arena do cJSON: uma mensagem MQTT por vez
+#define STATIC_MEM_REPORT_MAX       16      // Entradas no relatório de boot
+#define STATIC_MEM_WARMUP_S         120     // Depois do aquecimento o heap livre não deve cair
+#define STATIC_MEM_HEAP_TOLERANCE   512     // Oscilação aceita (buffers do Wi-Fi/lwIP vêm e vão)
+
+#if STATIC_MEM_ENABLED
+#define STATIC_TASK_STORAGE(name, stack_size) \
+    static StackType_t name##_stack[stack_size]; static StaticTask_t name##_tcb
+#define STATIC_TASK_BUFFERS(name)   name##_stack, &name##_tcb
+#else
+// Nada é reservado e a tarefa vai para o heap, como antes; sobra só a checagem do tamanho
+#define STATIC_TASK_STORAGE(name, stack_size) \
+    _Static_assert((stack_size) > 0, "pilha de " #name)
+#define STATIC_TASK_BUFFERS(name)   NULL, NULL
+#endif
+
+/**
+ * Cria a tarefa fixada em core. Com stack/tcb (STATIC_TASK_BUFFERS) usa a memória
+ * reservada e a contabiliza no relatório; com NULL usa o heap.
+ */
+esp_err_t static_mem_task_create(TaskFunction_t fn, const char* name, uint32_t stack_size, void* arg,
+                                 UBaseType_t priority, TaskHandle_t* out_handle, BaseType_t core,
+                                 StackType_t* stack, StaticTask_t* tcb);
+
+/* Registra um bloco estático (pool, fila, arena...) para o relatório de boot */
+void static_mem_account(const char* what, size_t bytes);
+
+/* Imprime os blocos registrados, o total e o heap livre */
+void static_mem_report(void);
+
+/**
+ * Instala os hooks de alocação do cJSON (só no modo estático; senão não faz nada).
+ * Os hooks são globais, mas a arena não: fora de um escopo begin/end, e em qualquer
+ * outra tarefa, o cJSON continua alocando e liberando no heap.
+ */
+void static_mem_arena_install(void);
+
+/**
+ * Abre o escopo da arena para a tarefa que chamou, vazia: o que ela decodificar até
+ * static_mem_arena_end sai da arena. Um escopo por vez; a árvore não sobrevive ao end.
+ */
+void static_mem_arena_begin(void);
+void static_mem_arena_end(void);
+
+/**
+ * Teste de regime permanente, chamado periodicamente: após STATIC_MEM_WARMUP_S
+ * guarda o heap livre como referência e acusa erro se ele cair além da tolerância.
+ * Retorna false nesse caso.
+ */
+bool static_mem_heap_check(void);
+
+#endif
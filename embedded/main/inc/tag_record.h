@@ -0,0 +1,53 @@
+#ifndef TAG_RECORD_H
+#define TAG_RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- Registro do item gravado na memória de usuário da tag (NTAG / Ultralight) ---
+// Layout (28 bytes, páginas 4..10):
+//   [0..1]   'E' 'S'  (assinatura)
+//   [2]      versão
+//   [3]      reservado
+//   [4..7]   id do item (uint32, little-endian)
+//   [8..23]  nome para o LCD, completado com '\0'
+//   [24..25] CRC-16/CCITT dos bytes 0..23 (little-endian)
+//   [26..27] reservado
+#define TAG_RECORD_FIRST_PAGE   4
+#define TAG_RECORD_PAGES        7
+#define TAG_RECORD_SIZE         (TAG_RECORD_PAGES * 4)
+#define TAG_RECORD_NAME_LEN     16
+#define TAG_RECORD_VERSION      1
+
+typedef struct {
+    uint32_t item_id;
+    char name[TAG_RECORD_NAME_LEN + 1];
+} tag_record_t;
+
+void tag_record_encode(const tag_record_t* record, uint8_t raw[TAG_RECORD_SIZE]);
+
+/**
+ * Retorna false se a tag não tem registro (tag virgem, outro formato ou
+ * checksum inválido); nesse caso o display espera a resposta do servidor.
+ */
+bool tag_record_decode(const uint8_t raw[TAG_RECORD_SIZE], tag_record_t* out_record);
+
+// --- Cache dos registros já lidos, por UID: a tag só é lida de novo quando o UID sai do cache ---
+// Usado só pela tarefa do leitor (handler do RC522), sem trava.
+#define TAG_RECORD_CACHE_SIZE   16
+
+typedef enum {
+    TAG_RECORD_UNKNOWN,     // Nunca lido (ou expulso do cache): precisa ler as páginas
+    TAG_RECORD_ABSENT,      // Lido, a tag não tem registro
+    TAG_RECORD_CACHED,      // Lido, registro em out_record
+} tag_record_cache_state_t;
+
+tag_record_cache_state_t tag_record_cache_get(uint64_t uid, tag_record_t* out_record);
+
+/* record NULL guarda que a tag não tem registro. Substitui a entrada mais antiga quando cheio */
+void tag_record_cache_put(uint64_t uid, const tag_record_t* record);
+
+/* Esquece o UID: a próxima leitura vai à tag (ex.: gravação que falhou no meio) */
+void tag_record_cache_forget(uint64_t uid);
+
+#endif
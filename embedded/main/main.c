@@ -1,221 +1,797 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/timers.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "mfrc522.h"
 #include "mqtt_client.h"
 #include "cJSON.h"
 #include "lcd_i2c.h"
+#include "power.h"
 #include "esp_timer.h"
+#include "scan_outbox.h"
+#include "conn_supervisor.h"
+#include "net_profile.h"
+#include "tag_record.h"
+#include "dlog.h"
+#include "static_mem.h"
+#include "enroll.h"
 
 #define WIFI_SSID           "MOB-ALTOS"
 #define WIFI_PASSWORD       "mob3876150"
 #define MQTT_BROKER_URL     "mqtt://192.168.18.73"
 #define MQTT_USERNAME       "calebe"
 #define MQTT_PASSWORD       "8811"
-#define MQTT_TOPIC          "rfid/scanner/uid"
+// Classes de tráfego, cada uma com seu espaço de tópicos; o receptor atende cada uma numa fila
+#define MQTT_TOPIC          "rfid/scanner/uid"     // Interativo: toggles saem em rfid/scanner/uid/p/<partição>
+#define MQTT_TOPIC_BULK     "rfid/carga/uid"       // Carga: leituras de cadastro e auditoria, mesma forma
+#define MQTT_TOPIC_TELEMETRY "rfid/telemetria/leitor/" READER_ID // Telemetria: estatísticas a cada STATS_LOG_INTERVAL_S, QoS 0
 #define MQTT_TOPIC_RESPONSE "rfid/scanner/response"
+#define MQTT_TOPIC_PROFILE  "rfid/scanner/perfil"   // "latencia" | "economia" | "benchmark" | "desempenho" | "equilibrio" | "bateria" | "energia"
+#define MQTT_TOPIC_PING     "rfid/telemetria/ping"
+#define MQTT_TOPIC_PONG     "rfid/telemetria/pong"
+#define MQTT_TOPIC_ENCODE   "rfid/scanner/gravar"   // {"uid","itemId","nome"}: grava o registro na próxima leitura da tag
+#define MQTT_TOPIC_LOG      "rfid/scanner/log"      // "0".."5" (nível, como esp_log_level_t) | "bench" | "lcd"
+#define MQTT_TOPIC_ENROLL   "rfid/scanner/cadastro/" READER_ID  // "1" liga o modo cadastro, "0" desliga (retido)
+#define MQTT_TOPIC_AUDIT    "rfid/scanner/auditoria/" READER_ID // "1" liga o modo auditoria, "0" desliga (retido)
+#define MQTT_BROKER_PORT    1883
+// A sessão persistente guarda as inscrições no broker: ao mudar mqtt_subscriptions, troque a revisão
+#define MQTT_CLIENT_ID      READER_ID "-r7"
 #define LCD_MESSAGE_TIMEOUT_MS 5000
-#define RFID_DEBOUNCE_MS    3000
+#define LCD_BENCH_NAME      "Furadeira de impacto Bosch GSB 13 RE"  // Nome longo de exemplo para o bench "lcd"
+#define RFID_REMOVAL_MISSES 3      // Verificações de presença falhas seguidas até a tag contar como retirada
+#define READER_ID           "ESP32_LEITOR_01"
+#define SCAN_OUTBOX_POLICY  SCAN_OUTBOX_COALESCE_UID
+#define STATS_LOG_INTERVAL_S 60
+#define TELEMETRY_PAYLOAD_MAX 192
+
+// IP fixo opcional: evita a espera pelo DHCP no boot. Comente WIFI_STATIC_IP para usar DHCP.
+// #define WIFI_STATIC_IP      "192.168.18.50"
+#define WIFI_STATIC_GATEWAY "192.168.18.1"
+#define WIFI_STATIC_NETMASK "255.255.255.0"
+#define WIFI_CACHE_NAMESPACE "wifi_cache"
+
+// Divisão de núcleos: rádio/rede no PRO (0), leitura e display no APP (1).
+// Wi-Fi, lwIP e a tarefa do MQTT são fixados no PRO pelo sdkconfig.
+#define CORE_SCANNER        1
+#define CORE_DISPLAY        1
+#define DISPLAY_TASK_STACK_SIZE (3 * 1024)
+#define DISPLAY_TASK_PRIORITY   2
+#define TASK_STATS_MAX      24
 
 static const char* TAG = "RFID_MQTT_PROJECT";
 static esp_mqtt_client_handle_t client = NULL;
 static SemaphoreHandle_t lcd_mutex;
-static esp_timer_handle_t lcd_timeout_timer;
+static TimerHandle_t lcd_timeout_timer;
+static QueueHandle_t display_queue;
+static int64_t s_boot_display_us = 0; // Fim da inicialização do LCD (esp_timer_get_time, em us)
+
+typedef struct {
+    bool temporary;     // false = volta para a tela de espera
+    bool bench;         // Mede o letreiro com line1/line2 e volta para a tela de espera
+    char line1[LCD_DDRAM_LINE_LEN + 1]; // Mais de 16 caracteres vira letreiro
+    char line2[17];
+} display_msg_t;
 
-static void lcd_timeout_callback(void* arg) {
+#if STATIC_MEM_ENABLED
+static StaticSemaphore_t lcd_mutex_buffer;
+static StaticTimer_t lcd_timeout_timer_buffer;
+static StaticQueue_t display_queue_buffer;
+static uint8_t display_queue_storage[sizeof(display_msg_t)];
+#endif
+STATIC_TASK_STORAGE(display_task, DISPLAY_TASK_STACK_SIZE);
+
+// Quem desenha no LCD segura também a trava de energia: o I2C não muda de clock no meio da tela
+static void lcd_lock(void) {
     xSemaphoreTake(lcd_mutex, portMAX_DELAY);
-    lcd_clear();
-    lcd_set_cursor(0, 0);
-    lcd_print_str(" Storege Track  ");
+    power_lock(POWER_LOCK_LCD);
+}
+
+static void lcd_unlock(void) {
+    power_unlock(POWER_LOCK_LCD);
     xSemaphoreGive(lcd_mutex);
 }
 
 void show_await_message() {
-    xSemaphoreTake(lcd_mutex, portMAX_DELAY);
+    lcd_lock();
     lcd_clear();
     lcd_set_cursor(0, 0);
+    if (enroll_is_active()) {
+        // Tela própria da sessão de coleta: o contador sobe a cada tag nova
+        char line2[17];
+        snprintf(line2, sizeof(line2), "Tags: %lu", (unsigned long) enroll_count());
+        lcd_print_str(enroll_get_mode() == ENROLL_MODE_CADASTRO ? " Modo cadastro  " : "   Auditoria    ");
+        lcd_set_cursor(1, 0);
+        lcd_print_str(line2);
+        lcd_unlock();
+        return;
+    }
     lcd_print_str(" Storege Track  ");
-    xSemaphoreGive(lcd_mutex);
+    // Segunda linha da tela de espera mostra a saúde da conexão
+    switch (conn_supervisor_get_health()) {
+        case CONN_HEALTH_WIFI_DOWN:
+            lcd_set_cursor(1, 0);
+            lcd_print_str("Sem WiFi");
+            break;
+        case CONN_HEALTH_MQTT_DOWN:
+            lcd_set_cursor(1, 0);
+            lcd_print_str("Sem servidor");
+            break;
+        default:
+            break;
+    }
+    lcd_unlock();
 }
 
 void show_temp_message(const char* line1, const char* line2) {
-    xSemaphoreTake(lcd_mutex, portMAX_DELAY);
-    lcd_clear();
-    lcd_set_cursor(0, 0);
-    lcd_print_str(line1);
-    lcd_set_cursor(1, 0);
-    lcd_print_str(line2);
-    xSemaphoreGive(lcd_mutex);
-    esp_timer_start_once(lcd_timeout_timer, LCD_MESSAGE_TIMEOUT_MS * 1000);
+    xTimerStop(lcd_timeout_timer, portMAX_DELAY);
+    lcd_lock();
+    uint32_t marquee_steps = lcd_marquee_start(line1, line2);
+    lcd_unlock();
+    // Um nome longo fica na tela pelo menos uma passada inteira do letreiro
+    uint32_t timeout_ms = marquee_steps * LCD_MARQUEE_STEP_MS;
+    if (timeout_ms < LCD_MESSAGE_TIMEOUT_MS) {
+        timeout_ms = LCD_MESSAGE_TIMEOUT_MS;
+    }
+    xTimerChangePeriod(lcd_timeout_timer, pdMS_TO_TICKS(timeout_ms), portMAX_DELAY);
+}
+
+/*
+ * O LCD é lento (cada caractere custa alguns ms no I2C), então quem quer mudar a
+ * tela só posta o pedido; a tarefa de display no núcleo APP faz o desenho.
+ * Fila de uma posição: só a tela mais recente importa, mas a tela de espera nunca
+ * substitui uma mensagem ainda não desenhada (ela volta sozinha no timeout da mensagem).
+ */
+static void display_post_temp(const char* line1, const char* line2) {
+    display_msg_t msg = { .temporary = true };
+    snprintf(msg.line1, sizeof(msg.line1), "%s", line1);
+    snprintf(msg.line2, sizeof(msg.line2), "%s", line2);
+    xQueueOverwrite(display_queue, &msg);
+}
+
+static void display_post_idle(void) {
+    display_msg_t msg = { .temporary = false };
+    xQueueSend(display_queue, &msg, 0);
+}
+
+static void display_post_bench(void) {
+    display_msg_t msg = { .bench = true };
+    snprintf(msg.line1, sizeof(msg.line1), "%s", LCD_BENCH_NAME);
+    snprintf(msg.line2, sizeof(msg.line2), "Sts: Emprestado");
+    xQueueOverwrite(display_queue, &msg);
+}
+
+static void display_task(void* arg) {
+    // O LCD inicializa aqui, em paralelo com o leitor que o app_main sobe no outro núcleo.
+    // Mensagens postadas antes disso esperam na fila.
+    lcd_lock();
+    esp_err_t err = lcd_module_init();
+    lcd_unlock();
+    ESP_ERROR_CHECK(err);
+    s_boot_display_us = esp_timer_get_time();
+    show_await_message();
+
+    display_msg_t msg;
+    while (1) {
+        // Com letreiro na tela, o tempo de espera da fila é o relógio dos passos
+        TickType_t wait = lcd_marquee_active() ? pdMS_TO_TICKS(LCD_MARQUEE_STEP_MS) : portMAX_DELAY;
+        if (xQueueReceive(display_queue, &msg, wait) != pdTRUE) {
+            lcd_lock();
+            lcd_marquee_step();
+            lcd_unlock();
+        } else if (msg.bench) {
+            xTimerStop(lcd_timeout_timer, portMAX_DELAY);
+            lcd_lock();
+            lcd_marquee_bench(msg.line1, msg.line2);
+            lcd_unlock();
+            show_await_message();
+        } else if (msg.temporary) {
+            show_temp_message(msg.line1, msg.line2);
+        } else {
+            show_await_message();
+        }
+    }
+}
+
+static void lcd_timeout_callback(TimerHandle_t timer) {
+    display_post_idle();
 }
 
 
 static EventGroupHandle_t s_wifi_event_group;
+#if STATIC_MEM_ENABLED
+static StaticEventGroup_t s_wifi_event_group_buffer;
+#endif
 #define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
-static int s_retry_num = 0;
+
+// Marcos de tempo do boot (esp_timer_get_time, em us)
+static int64_t s_boot_scanner_ready_us = 0;
+static int64_t s_boot_wifi_us = 0;
+static int64_t s_boot_mqtt_us = 0;
+
+// Último AP usado (canal + BSSID), guardado na NVS para pular a varredura no próximo boot
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_ap_cache_t;
+
+static wifi_config_t s_wifi_config = { .sta = { .ssid = WIFI_SSID, .password = WIFI_PASSWORD, }, };
+static wifi_ap_cache_t s_ap_cache;
+static bool s_ap_cache_valid = false;
+
+static bool wifi_cache_load(wifi_ap_cache_t* cache) {
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*cache);
+    esp_err_t err = nvs_get_blob(nvs, "ap", cache, &len);
+    nvs_close(nvs);
+    return err == ESP_OK && len == sizeof(*cache) && cache->channel != 0;
+}
+
+static void wifi_cache_store(const wifi_ap_cache_t* cache) {
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs, "ap", cache, sizeof(*cache)) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+        if (!s_ap_cache_valid || s_ap_cache.channel != event->channel ||
+            memcmp(s_ap_cache.bssid, event->bssid, sizeof(s_ap_cache.bssid)) != 0) {
+            memcpy(s_ap_cache.bssid, event->bssid, sizeof(s_ap_cache.bssid));
+            s_ap_cache.channel = event->channel;
+            s_ap_cache_valid = true;
+            wifi_cache_store(&s_ap_cache);
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < 5) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Tentando reconectar ao Wi-Fi...");
-        } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        if (s_wifi_config.sta.bssid_set) {
+            // O AP guardado pode ter mudado de canal ou sido trocado: volta para a varredura completa
+            ESP_LOGI(TAG, "AP em cache indisponivel, varrendo todos os canais...");
+            s_wifi_config.sta.bssid_set = false;
+            s_wifi_config.sta.channel = 0;
+            s_ap_cache_valid = false;
+            esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
         }
+        // A nova tentativa (já com a configuração de varredura completa) sai do backoff do supervisor
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        conn_supervisor_wifi_down();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Conectado! IP: " IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
+        conn_supervisor_wifi_up();
+        if (s_boot_wifi_us == 0) {
+            s_boot_wifi_us = esp_timer_get_time();
+        }
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
+
+/* Dispara a conexão e retorna sem esperar; o resultado chega por s_wifi_event_group. */
 void wifi_init_sta(void) {
+#if STATIC_MEM_ENABLED
+    s_wifi_event_group = xEventGroupCreateStatic(&s_wifi_event_group_buffer);
+#else
     s_wifi_event_group = xEventGroupCreate();
+#endif
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    esp_netif_t* netif = esp_netif_create_default_wifi_sta();
+
+#ifdef WIFI_STATIC_IP
+    esp_netif_ip_info_t ip_info = {
+        .ip.addr = esp_ip4addr_aton(WIFI_STATIC_IP),
+        .gw.addr = esp_ip4addr_aton(WIFI_STATIC_GATEWAY),
+        .netmask.addr = esp_ip4addr_aton(WIFI_STATIC_NETMASK),
+    };
+    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(netif));
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(netif, &ip_info));
+#else
+    (void) netif;
+#endif
+
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    net_profile_wifi_init_config(&cfg);
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL));
-    wifi_config_t wifi_config = { .sta = { .ssid = WIFI_SSID, .password = WIFI_PASSWORD, }, };
+
+    s_ap_cache_valid = wifi_cache_load(&s_ap_cache);
+    if (s_ap_cache_valid) {
+        s_wifi_config.sta.bssid_set = true;
+        memcpy(s_wifi_config.sta.bssid, s_ap_cache.bssid, sizeof(s_ap_cache.bssid));
+        s_wifi_config.sta.channel = s_ap_cache.channel;
+        ESP_LOGI(TAG, "Usando AP em cache (canal %d)", s_ap_cache.channel);
+    }
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(net_profile_apply(NET_PROFILE_DEFAULT));
+}
+
+static void log_boot_times(void) {
+    ESP_LOGI(TAG, "Boot: leitor pronto em %lld ms | display em %lld ms | Wi-Fi em %lld ms | MQTT em %lld ms",
+             s_boot_scanner_ready_us / 1000, s_boot_display_us / 1000, s_boot_wifi_us / 1000,
+             s_boot_mqtt_us / 1000);
+}
+
+static const char* const mqtt_subscriptions[] = {
+    MQTT_TOPIC_RESPONSE,
+    MQTT_TOPIC_PROFILE,
+    MQTT_TOPIC_PONG,
+    MQTT_TOPIC_ENCODE,
+    MQTT_TOPIC_LOG,
+    MQTT_TOPIC_ENROLL,
+    MQTT_TOPIC_AUDIT,
+};
+static esp_transport_handle_t s_mqtt_transport = NULL;
+
+static inline bool topic_is(esp_mqtt_event_handle_t event, const char* topic) {
+    return event->topic_len == (int) strlen(topic) && strncmp(event->topic, topic, event->topic_len) == 0;
+}
+
+static rc522_handle_t s_scanner = NULL;
+
+static void apply_power_profile(power_profile_t profile) {
+    if (power_apply(profile) == ESP_OK && s_scanner) {
+        rc522_set_scan_interval(s_scanner, power_get_config()->scan_interval_ms);
+    }
+}
+
+static void handle_profile_command(const char* data, int data_len) {
+    if (data_len == 8 && strncmp(data, "latencia", 8) == 0) {
+        power_set_net_profile(NET_PROFILE_LATENCIA);
+    } else if (data_len == 8 && strncmp(data, "economia", 8) == 0) {
+        power_set_net_profile(NET_PROFILE_ECONOMIA);
+    } else if (data_len == 9 && strncmp(data, "benchmark", 9) == 0) {
+        net_profile_bench_start(client, MQTT_TOPIC_PING);
+    } else if (data_len == 10 && strncmp(data, "desempenho", 10) == 0) {
+        apply_power_profile(POWER_PROFILE_DESEMPENHO);
+    } else if (data_len == 10 && strncmp(data, "equilibrio", 10) == 0) {
+        apply_power_profile(POWER_PROFILE_EQUILIBRIO);
+    } else if (data_len == 7 && strncmp(data, "bateria", 7) == 0) {
+        apply_power_profile(POWER_PROFILE_BATERIA);
+    } else if (data_len == 7 && strncmp(data, "energia", 7) == 0) {
+        power_report();
+    } else {
+        ESP_LOGW(TAG, "Perfil desconhecido: %.*s", data_len, data);
+    }
+}
+
+// Gravação pendente pedida pelo receptor; aplicada pela tarefa do RC522 quando a tag voltar ao campo
+static portMUX_TYPE s_encode_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_encode_pending = false;
+static uint64_t s_encode_uid = 0;
+static tag_record_t s_encode_record;
+
+static void handle_encode_command(const char* data, int data_len) {
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (!json) {
+        return;
+    }
+    cJSON *uid = cJSON_GetObjectItemCaseSensitive(json, "uid");
+    cJSON *item_id = cJSON_GetObjectItemCaseSensitive(json, "itemId");
+    cJSON *nome = cJSON_GetObjectItemCaseSensitive(json, "nome");
+
+    if (cJSON_IsString(uid) && cJSON_IsNumber(item_id) && cJSON_IsString(nome)) {
+        tag_record_t record = { .item_id = (uint32_t) item_id->valuedouble };
+        snprintf(record.name, sizeof(record.name), "%s", nome->valuestring);
+
+        taskENTER_CRITICAL(&s_encode_lock);
+        s_encode_uid = strtoull(uid->valuestring, NULL, 16);
+        s_encode_record = record;
+        s_encode_pending = true;
+        taskEXIT_CRITICAL(&s_encode_lock);
+
+        display_post_temp(record.name, "Aproxime p/ grav");
+    }
+    cJSON_Delete(json);
+}
+
+static void handle_log_command(const char* data, int data_len) {
+    if (data_len == 5 && strncmp(data, "bench", 5) == 0) {
+        if (dlog_benchmark_start() != ESP_OK) {
+            ESP_LOGW(TAG, "Benchmark do log já rodando ou sem memória");
+        }
+    } else if (data_len == 3 && strncmp(data, "lcd", 3) == 0) {
+        display_post_bench();
+    } else if (data_len == 1 && data[0] >= '0' && data[0] <= '5') {
+        dlog_set_level((esp_log_level_t) (data[0] - '0'));
+    }
+}
+
+static void handle_session_command(enroll_mode_t mode, const char* data, int data_len) {
+    if (data_len != 1 || (data[0] != '0' && data[0] != '1')) {
+        return;
+    }
+    if (data[0] == '1') {
+        enroll_set_mode(mode);
+    } else if (enroll_get_mode() == mode) {
+        enroll_set_mode(ENROLL_MODE_OFF); // O "0" retido de uma sessão não encerra a outra
+    }
+    ESP_LOGI(TAG, "Modo %s %s", mode == ENROLL_MODE_CADASTRO ? "cadastro" : "auditoria",
+             enroll_get_mode() == mode ? "ligado" : "desligado");
+    display_post_idle();
+}
+
+/* Uma mensagem recebida; roda no escopo da arena do cJSON (modo estático) */
+static void handle_mqtt_data(esp_mqtt_event_handle_t event) {
+    // O pong chega em rajada durante o benchmark: tratado antes de qualquer log
+    if (topic_is(event, MQTT_TOPIC_PONG)) {
+        net_profile_bench_on_pong(event->data, event->data_len);
+        return;
+    }
+    if (topic_is(event, MQTT_TOPIC_PROFILE)) {
+        handle_profile_command(event->data, event->data_len);
+        return;
+    }
+    if (topic_is(event, MQTT_TOPIC_ENCODE)) {
+        handle_encode_command(event->data, event->data_len);
+        return;
+    }
+    if (topic_is(event, MQTT_TOPIC_LOG)) {
+        handle_log_command(event->data, event->data_len);
+        return;
+    }
+    if (topic_is(event, MQTT_TOPIC_ENROLL)) {
+        handle_session_command(ENROLL_MODE_CADASTRO, event->data, event->data_len);
+        return;
+    }
+    if (topic_is(event, MQTT_TOPIC_AUDIT)) {
+        handle_session_command(ENROLL_MODE_AUDITORIA, event->data, event->data_len);
+        return;
+    }
+    DLOGS(ESP_LOG_INFO, TAG, "MQTT_EVENT_DATA: %s (%lu bytes)", event->topic, event->topic_len, event->data_len, 0, 0);
+    DLOGS(ESP_LOG_DEBUG, TAG, "DADOS: %s", event->data, event->data_len, 0, 0, 0);
+    if (topic_is(event, MQTT_TOPIC_RESPONSE)) {
+        char line1[LCD_DDRAM_LINE_LEN + 1] = "";
+        char line2[17] = "";
+
+        cJSON *json = cJSON_ParseWithLength(event->data, event->data_len);
+
+        if (json) {
+            cJSON *nome = cJSON_GetObjectItemCaseSensitive(json, "nome");
+            cJSON *status = cJSON_GetObjectItemCaseSensitive(json, "status");
+            cJSON *erro = cJSON_GetObjectItemCaseSensitive(json, "erro");
+            cJSON *lote = cJSON_GetObjectItemCaseSensitive(json, "lote");
+
+            if (cJSON_IsNumber(lote)) {
+                // Resposta de um lote: só o resumo, que vira letreiro na primeira linha
+                cJSON *devolvidos = cJSON_GetObjectItemCaseSensitive(json, "devolvidos");
+                cJSON *emprestados = cJSON_GetObjectItemCaseSensitive(json, "emprestados");
+                cJSON *erros = cJSON_GetObjectItemCaseSensitive(json, "erros");
+                cJSON *falhas = cJSON_GetObjectItemCaseSensitive(json, "falhas");
+                snprintf(line1, sizeof(line1), "%d itens: %d devolvidos, %d emprestados", lote->valueint,
+                         cJSON_IsNumber(devolvidos) ? devolvidos->valueint : 0,
+                         cJSON_IsNumber(emprestados) ? emprestados->valueint : 0);
+                if (cJSON_IsNumber(falhas) && falhas->valueint > 0) {
+                    // Leituras que o banco recusou: não foram gravadas, o operador passa de novo
+                    snprintf(line2, sizeof(line2), "%d nao gravados", falhas->valueint);
+                } else if (cJSON_IsNumber(erros) && erros->valueint > 0) {
+                    snprintf(line2, sizeof(line2), "%d sem cadastro", erros->valueint);
+                }
+            } else if (nome && status) {
+                snprintf(line1, sizeof(line1), "%s", nome->valuestring); // Longo vira letreiro
+                snprintf(line2, sizeof(line2), "Sts: %.11s", status->valuestring);
+            } else if (erro) {
+                snprintf(line1, sizeof(line1), "ERRO");
+                snprintf(line2, sizeof(line2), "%.16s", erro->valuestring);
+            }
+            cJSON_Delete(json);
+        } else {
+            snprintf(line1, sizeof(line1), "Erro JSON");
+            snprintf(line2, sizeof(line2), "Formato invalido");
+        }
+        display_post_temp(line1, line2);
+    }
 }
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_mqtt_event_handle_t event = event_data;
     client = event->client;
+    power_lock(POWER_LOCK_MQTT);
     switch (event->event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED: Conectado ao broker!");
-            esp_mqtt_client_subscribe(client, MQTT_TOPIC_RESPONSE, 1);
-            break;
-        case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA: MENSAGEM RECEBIDA!");
-            ESP_LOGI(TAG, "TOPICO: %.*s", event->topic_len, event->topic);
-            ESP_LOGI(TAG, "DADOS: %.*s", event->data_len, event->data);
-            if (strncmp(event->topic, MQTT_TOPIC_RESPONSE, event->topic_len) == 0) {
-                char line1[17] = "";
-                char line2[17] = "";
-
-                char* data_copy = malloc(event->data_len + 1);
-                if (data_copy == NULL) {
-                    ESP_LOGE(TAG, "Falha ao alocar memoria para dados MQTT");
-                    break;
-                }
-                memcpy(data_copy, event->data, event->data_len);
-                data_copy[event->data_len] = '\0';
-
-                cJSON *json = cJSON_Parse(data_copy);
-                free(data_copy);
-
-                if (json) {
-                    cJSON *nome = cJSON_GetObjectItemCaseSensitive(json, "nome");
-                    cJSON *status = cJSON_GetObjectItemCaseSensitive(json, "status");
-                    cJSON *erro = cJSON_GetObjectItemCaseSensitive(json, "erro");
-
-                    if (nome && status) {
-                        snprintf(line1, sizeof(line1), "%.16s", nome->valuestring);
-                        snprintf(line2, sizeof(line2), "Sts: %.11s", status->valuestring);
-                    } else if (erro) {
-                        snprintf(line1, sizeof(line1), "ERRO");
-                        snprintf(line2, sizeof(line2), "%.16s", erro->valuestring);
-                    }
-                    cJSON_Delete(json);
-                } else {
-                    snprintf(line1, sizeof(line1), "Erro JSON");
-                    snprintf(line2, sizeof(line2), "Formato invalido");
+            // Sessão persistente: o broker já guarda a inscrição quando session_present
+            if (!event->session_present) {
+                for (size_t i = 0; i < sizeof(mqtt_subscriptions) / sizeof(mqtt_subscriptions[0]); i++) {
+                    esp_mqtt_client_subscribe(client, mqtt_subscriptions[i], 1);
                 }
-                show_temp_message(line1, line2);
             }
+            net_profile_on_mqtt_connected(s_mqtt_transport);
+            if (s_boot_mqtt_us == 0) {
+                s_boot_mqtt_us = esp_timer_get_time();
+                log_boot_times();
+#if NET_BENCH_ON_BOOT
+                net_profile_bench_start(client, MQTT_TOPIC_PING);
+#endif
+            }
+            conn_supervisor_mqtt_up();
+            break;
+        case MQTT_EVENT_ERROR:
+            // Toda falha de conexão termina em DISCONNECTED: o backoff avança só lá, uma vez por falha
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            conn_supervisor_mqtt_down();
+            break;
+        case MQTT_EVENT_DATA:
+            static_mem_arena_begin(); // Cada mensagem decodifica numa arena vazia, só desta tarefa
+            handle_mqtt_data(event);
+            static_mem_arena_end();
             break;
         default:
             break;
     }
+    power_unlock(POWER_LOCK_MQTT);
 }
+// Estática: o supervisor reaplica esta configuração ao sortear cada intervalo de reconexão
+static esp_mqtt_client_config_t mqtt_cfg = {
+    .broker.address.uri = MQTT_BROKER_URL,
+    .credentials = {
+        .username = MQTT_USERNAME,
+        .client_id = MQTT_CLIENT_ID,
+        .authentication.password = MQTT_PASSWORD,
+    },
+    .session.disable_clean_session = true,
+    .task.priority = NET_MQTT_TASK_PRIORITY,
+};
+
 static void mqtt_app_start(void) {
-    esp_mqtt_client_config_t mqtt_cfg = {
-        .broker.address.uri = MQTT_BROKER_URL,
-        .credentials = { .username = MQTT_USERNAME, .authentication.password = MQTT_PASSWORD, },
-    };
+    // Transporte próprio para ter acesso ao socket (TCP_NODELAY no perfil de latência)
+    s_mqtt_transport = esp_transport_tcp_init();
+    esp_transport_set_default_port(s_mqtt_transport, MQTT_BROKER_PORT);
+    mqtt_cfg.network.transport = s_mqtt_transport;
+
     client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    conn_supervisor_attach_mqtt(client, &mqtt_cfg);
     esp_mqtt_client_start(client);
+    scan_outbox_set_client(client);
 }
 
-static uint64_t last_scanned_uid = 0;
-static int64_t last_scan_time = 0;
+// Leitura de sessão que a outbox cheia descartou: esquece a UID, e a próxima leitura dela sai de novo.
+// Roda no push, dentro do rc522_handler, como enroll_add
+static void on_outbox_drop(const scan_record_t* record) {
+    if (record->kind != SCAN_KIND_TOGGLE) {
+        enroll_forget(record->uid);
+        DLOG(ESP_LOG_WARN, TAG, "Fila cheia: tag %08lX%08lX descartada; aproxime de novo",
+             (uint32_t) (record->uid >> 32), (uint32_t) record->uid, 0, 0);
+    }
+}
+
+static int64_t handler_max_us = 0;   // Pior tempo gasto no handler (jitter imposto ao loop do RC522)
 static void rc522_handler(void* arg, esp_event_base_t base, int32_t id, void* event_data) {
     if (id == RC522_EVENT_TAG_SCANNED) {
         rc522_event_data_t* data = (rc522_event_data_t*) event_data;
         rc522_tag_t* tag = (rc522_tag_t*) data->ptr;
         int64_t now = esp_timer_get_time();
+        power_record_tap(tag->wake_late_us, (uint32_t) (now - tag->poll_start_us));
 
-        if (tag->serial_number == last_scanned_uid &&
-            (now - last_scan_time) < (RFID_DEBOUNCE_MS * 1000)) {
-            return;
+        // Gravação pedida pelo receptor: não publica a leitura
+        tag_record_t record;
+        bool encode = false;
+        taskENTER_CRITICAL(&s_encode_lock);
+        if (s_encode_pending && s_encode_uid == tag->serial_number) {
+            record = s_encode_record;
+            s_encode_pending = false;
+            encode = true;
         }
+        taskEXIT_CRITICAL(&s_encode_lock);
 
-        last_scanned_uid = tag->serial_number;
-        last_scan_time = now;
+        if (encode) {
+            uint8_t raw[TAG_RECORD_SIZE];
+            tag_record_encode(&record, raw);
+            esp_err_t err = rc522_write_pages(data->rc522, TAG_RECORD_FIRST_PAGE, raw, TAG_RECORD_PAGES);
+            if (err == ESP_OK) {
+                tag_record_cache_put(tag->serial_number, &record);
+            } else {
+                tag_record_cache_forget(tag->serial_number); // Pode ter gravado só parte das páginas
+            }
+            display_post_temp(record.name, err == ESP_OK ? "Tag gravada" : "Falha ao gravar");
+            return;
+        }
 
-        esp_timer_stop(lcd_timeout_timer);
-        show_temp_message("Lendo...", "");
+        // Cadastro/auditoria: cada UID sai uma vez por sessão, sem ler o registro da tag
+        enroll_mode_t mode = enroll_get_mode();
+        if (mode != ENROLL_MODE_OFF) {
+            // Repetida na sessão: não sai de novo, mas aparece no LCD em vez de sumir calada.
+            // push false é a UID já na fila (vai sair) ou descartada: aí on_outbox_drop a esquece
+            if (!enroll_add(tag->serial_number)) {
+                display_post_temp("Tag ja lida", "nesta sessao");
+            } else if (scan_outbox_push(tag->serial_number, now,
+                                        mode == ENROLL_MODE_CADASTRO ? SCAN_KIND_ENROLL : SCAN_KIND_AUDIT)) {
+                display_post_idle();
+            }
+            return;
+        }
 
-        if (client) {
-            char uid_hex_string[21];
-            snprintf(uid_hex_string, sizeof(uid_hex_string), "%llX", tag->serial_number);
+        // Sem debounce: o driver só avisa de novo depois que a tag sai do campo (RFID_REMOVAL_MISSES).
+        // Entrega para a tarefa de envio; o publish QoS1 não bloqueia mais a varredura
+        scan_outbox_push(tag->serial_number, now, SCAN_KIND_TOGGLE);
 
-            char json_payload[100];
-            snprintf(json_payload, sizeof(json_payload),
-                     "{\"uid\":\"%s\",\"leitorId\":\"ESP32_LEITOR_01\"}",
-                     uid_hex_string);
+        // Com o registro na tag o nome aparece na hora; o servidor só confirma o novo status.
+        // As páginas só são lidas da primeira vez que o UID aparece; falha de RF não vai para o cache
+        tag_record_cache_state_t cached = tag_record_cache_get(tag->serial_number, &record);
+        if (cached == TAG_RECORD_UNKNOWN) {
+            uint8_t raw[TAG_RECORD_SIZE];
+            if (rc522_read_pages(data->rc522, TAG_RECORD_FIRST_PAGE, raw, TAG_RECORD_PAGES) == ESP_OK) {
+                bool found = tag_record_decode(raw, &record);
+                tag_record_cache_put(tag->serial_number, found ? &record : NULL);
+                cached = found ? TAG_RECORD_CACHED : TAG_RECORD_ABSENT;
+            }
+        }
+        if (cached == TAG_RECORD_CACHED) {
+            display_post_temp(record.name, "Confirmando...");
+        } else {
+            display_post_temp("Lendo...", "");
+        }
 
-            esp_mqtt_client_publish(client, MQTT_TOPIC, json_payload, 0, 1, 0);
+        int64_t elapsed = esp_timer_get_time() - now;
+        if (elapsed > handler_max_us) {
+            handler_max_us = elapsed;
         }
+    } else if (id == RC522_EVENT_TAG_REMOVED) {
+        rc522_tag_t* tag = (rc522_tag_t*) ((rc522_event_data_t*) event_data)->ptr;
+        DLOG(ESP_LOG_INFO, TAG, "Tag %08lX%08lX retirada após %lu ms no leitor",
+             (uint32_t) (tag->serial_number >> 32), (uint32_t) tag->serial_number,
+             (uint32_t) (tag->dwell_us / 1000), 0);
     }
 }
 
-void app_main(void) {
-    ESP_ERROR_CHECK(nvs_flash_init());
+static void on_connection_health(conn_health_t health) {
+    // Não sobrescreve uma mensagem temporária; ela volta para a tela de espera ao expirar
+    if (!xTimerIsTimerActive(lcd_timeout_timer)) {
+        display_post_idle();
+    }
+}
 
-    ESP_ERROR_CHECK(lcd_module_init());
-    lcd_mutex = xSemaphoreCreateMutex();
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+/* Modo trace: uso de CPU por tarefa desde o boot, para conferir a divisão de núcleos.
+   Requer CONFIG_FREERTOS_USE_TRACE_FACILITY e CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS no menuconfig. */
+static void log_task_cpu_stats(void) {
+    static TaskStatus_t tasks[TASK_STATS_MAX];
+    uint32_t total_runtime;
+    UBaseType_t count = uxTaskGetSystemState(tasks, TASK_STATS_MAX, &total_runtime);
+    if (count == 0 || total_runtime == 0) {
+        return;
+    }
+    // O contador total é o tempo decorrido; cada núcleo soma até 100%
+    for (UBaseType_t i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "CPU %-16s %3lu%%"
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+                 " core=%d"
+#endif
+                 , tasks[i].pcTaskName, tasks[i].ulRunTimeCounter / (total_runtime / 100 + 1)
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+                 , tasks[i].xCoreID == tskNO_AFFINITY ? -1 : (int) tasks[i].xCoreID
+#endif
+                 );
+    }
+}
+#endif
+
+static void log_scan_stats(void) {
+    scan_outbox_stats_t stats;
+    scan_outbox_get_stats(&stats);
+    ESP_LOGI(TAG, "Outbox: enfileiradas=%lu enviadas=%lu descartadas=%lu agrupadas=%lu falhas=%lu pico=%u | handler max=%lld us | log descartados=%lu",
+             stats.enqueued, stats.published, stats.dropped, stats.coalesced,
+             stats.publish_failures, stats.high_watermark, handler_max_us, dlog_dropped());
+    if (stats.batches > 0) {
+        ESP_LOGI(TAG, "Lotes: %lu publishes com %lu leituras (%lu publishes a menos) | espera max=%lu ms",
+                 stats.batches, stats.batched, stats.batched - stats.batches, stats.batch_wait_max_ms);
+    }
 
-    const esp_timer_create_args_t lcd_timer_args = {
-            .callback = &lcd_timeout_callback,
-            .name = "lcd_timeout"
+    // Taxa de sucesso do RF por etapa; REQA em timeout é só o leitor vazio
+    static const char* const stage_names[RC522_STAGE_COUNT] = {
+        [RC522_STAGE_REQUEST] = "reqa", [RC522_STAGE_ANTICOLL] = "anticoll", [RC522_STAGE_SELECT] = "select",
+        [RC522_STAGE_READ] = "read", [RC522_STAGE_WRITE] = "write",
     };
-    ESP_ERROR_CHECK(esp_timer_create(&lcd_timer_args, &lcd_timeout_timer));
+    rc522_stats_t rf;
+    if (!s_scanner || rc522_get_stats(s_scanner, &rf) != ESP_OK) {
+        return;
+    }
+    for (int i = 0; i < RC522_STAGE_COUNT; i++) {
+        const rc522_stage_stats_t* st = &rf.stage[i];
+        if (st->ok + st->timeout + st->collision + st->parity + st->crc + st->protocol == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "RF %-8s ok=%lu timeout=%lu colisao=%lu paridade=%lu crc=%lu protocolo=%lu", stage_names[i],
+                 st->ok, st->timeout, st->collision, st->parity, st->crc, st->protocol);
+    }
+    ESP_LOGI(TAG, "RF: retentativas=%lu recuperadas=%lu | ganho RxGain=%u (%lu trocas)",
+             rf.retries, rf.retry_saves, rf.rx_gain, rf.gain_changes);
+    // Jitter da varredura: quanto cada poll começou depois do previsto
+    ESP_LOGI(TAG, "Varredura: %lu polls, atraso max=%lu us media=%llu us", rf.polls, rf.poll_late_max_us,
+             rf.polls ? rf.poll_late_sum_us / rf.polls : 0);
+}
 
-    show_await_message();
-    vTaskDelay(pdMS_TO_TICKS(500));
+/* Resumo das estatísticas para o receptor. QoS 0 e fora da outbox: telemetria perdida não faz falta. */
+static void publish_telemetry(void) {
+    esp_mqtt_client_handle_t mqtt = client;
+    if (mqtt == NULL) {
+        return;
+    }
+    scan_outbox_stats_t stats;
+    scan_outbox_get_stats(&stats);
+    rc522_stats_t rf = { 0 };
+    if (s_scanner) {
+        rc522_get_stats(s_scanner, &rf);
+    }
+    uint32_t rf_ok = 0, rf_fail = 0;
+    for (int i = RC522_STAGE_ANTICOLL; i < RC522_STAGE_COUNT; i++) {
+        const rc522_stage_stats_t* st = &rf.stage[i];
+        rf_ok += st->ok;
+        rf_fail += st->timeout + st->collision + st->parity + st->crc + st->protocol;
+    }
 
-    wifi_init_sta();
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                         WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                         pdFALSE, pdFALSE, portMAX_DELAY);
+    char payload[TELEMETRY_PAYLOAD_MAX];
+    snprintf(payload, sizeof(payload),
+             "{\"enfileiradas\":%lu,\"enviadas\":%lu,\"descartadas\":%lu,\"falhas\":%lu,\"lotes\":%lu,"
+             "\"rfOk\":%lu,\"rfFalhas\":%lu,\"rxGain\":%u,\"uptime\":%lld}",
+             stats.enqueued, stats.published, stats.dropped, stats.publish_failures, stats.batches,
+             rf_ok, rf_fail, rf.rx_gain, esp_timer_get_time() / 1000000);
+    power_lock(POWER_LOCK_MQTT);
+    esp_mqtt_client_publish(mqtt, MQTT_TOPIC_TELEMETRY, payload, 0, 0, 0);
+    power_unlock(POWER_LOCK_MQTT);
+}
 
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Wi-Fi conectado. Iniciando MQTT...");
-        mqtt_app_start();
-    } else {
-        ESP_LOGE(TAG, "Falha ao conectar ao Wi-Fi.");
-        show_temp_message("Erro no WiFi", "Reinicie");
-        return; 
+void app_main(void) {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
     }
+    ESP_ERROR_CHECK(err);
+    ESP_ERROR_CHECK(dlog_init());
+    ESP_ERROR_CHECK(power_init());
+    static_mem_arena_install();
+
+#if STATIC_MEM_ENABLED
+    lcd_mutex = xSemaphoreCreateMutexStatic(&lcd_mutex_buffer);
+#else
+    lcd_mutex = xSemaphoreCreateMutex();
+#endif
+
+#if STATIC_MEM_ENABLED
+    lcd_timeout_timer = xTimerCreateStatic("lcd_timeout", pdMS_TO_TICKS(LCD_MESSAGE_TIMEOUT_MS), pdFALSE,
+                                           NULL, lcd_timeout_callback, &lcd_timeout_timer_buffer);
+    display_queue = xQueueCreateStatic(1, sizeof(display_msg_t), display_queue_storage, &display_queue_buffer);
+    static_mem_account("lcd/display", sizeof(lcd_mutex_buffer) + sizeof(lcd_timeout_timer_buffer) +
+                       sizeof(display_queue_buffer) + sizeof(display_queue_storage));
+#else
+    lcd_timeout_timer = xTimerCreate("lcd_timeout", pdMS_TO_TICKS(LCD_MESSAGE_TIMEOUT_MS), pdFALSE,
+                                     NULL, lcd_timeout_callback);
+    display_queue = xQueueCreate(1, sizeof(display_msg_t));
+#endif
+    ESP_ERROR_CHECK(static_mem_task_create(display_task, "display", DISPLAY_TASK_STACK_SIZE, NULL,
+                                           DISPLAY_TASK_PRIORITY, NULL, CORE_DISPLAY,
+                                           STATIC_TASK_BUFFERS(display_task)));
+    ESP_ERROR_CHECK(scan_outbox_init(SCAN_OUTBOX_POLICY, MQTT_TOPIC, MQTT_TOPIC_BULK, READER_ID));
+    scan_outbox_set_drop_hook(on_outbox_drop);
+    ESP_ERROR_CHECK(conn_supervisor_init(on_connection_health));
+
+    // Wi-Fi associa em segundo plano enquanto o leitor e o display sobem
+    wifi_init_sta();
 
     rc522_config_t config = {
         .transport = RC522_TRANSPORT_SPI,
@@ -226,16 +802,51 @@ void app_main(void) {
             .sck_gpio = 18,
             .sda_gpio = 15
         },
+        .pin_core = true,
+        .core_id = CORE_SCANNER,
+        .removal_misses = RFID_REMOVAL_MISSES,
+        .log_hook = dlog_write_args,
     };
 
-    rc522_handle_t scanner;
-    ESP_ERROR_CHECK(rc522_create(&config, &scanner));
-    ESP_ERROR_CHECK(rc522_register_events(scanner, RC522_EVENT_TAG_SCANNED, rc522_handler, NULL));
-    ESP_ERROR_CHECK(rc522_start(scanner));
+#if STATIC_MEM_ENABLED
+    static rc522_storage_t scanner_storage;
+    static_mem_account("rc522", sizeof(scanner_storage));
+    ESP_ERROR_CHECK(rc522_create_static(&config, &scanner_storage, &s_scanner));
+#else
+    ESP_ERROR_CHECK(rc522_create(&config, &s_scanner));
+#endif
+    ESP_ERROR_CHECK(rc522_register_events(s_scanner, RC522_EVENT_ANY, rc522_handler, NULL));
+    ESP_ERROR_CHECK(rc522_start(s_scanner));
+    // Depois do Wi-Fi (light sleep exige modem-sleep) e do leitor (intervalo de varredura)
+    apply_power_profile(POWER_PROFILE_DEFAULT);
+    s_boot_scanner_ready_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Leitor pronto em %lld ms. Aguardando Wi-Fi...", s_boot_scanner_ready_us / 1000);
+    static_mem_report();
+
+    // Leituras feitas antes do MQTT ficam na outbox e são enviadas ao conectar.
+    // O supervisor tenta o Wi-Fi indefinidamente, então esta espera não precisa de timeout.
+    xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    ESP_LOGI(TAG, "Wi-Fi conectado. Iniciando MQTT...");
+    mqtt_app_start();
 
     ESP_LOGI(TAG, "Sistema iniciado e pronto.");
 
+    int seconds = 0;
     while(1) {
         vTaskDelay(pdMS_TO_TICKS(1000));
+        if (++seconds % STATS_LOG_INTERVAL_S == 0) {
+            log_scan_stats();
+            publish_telemetry();
+#if STATIC_MEM_ENABLED
+            static_mem_heap_check();
+#endif
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+            log_task_cpu_stats();
+#endif
+#if POWER_INSTRUMENT
+            power_report();
+#endif
+        }
     }
-}
\ No newline at end of file
+}
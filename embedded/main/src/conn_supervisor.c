@@ -0,0 +1,115 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "conn_supervisor.h"
+
+static const char *TAG_SUP = "conn_supervisor";
+
+static conn_health_cb_t health_cb = NULL;
+static conn_health_t health = CONN_HEALTH_WIFI_DOWN;
+static bool wifi_up = false;
+static bool mqtt_up = false;
+
+static conn_backoff_t wifi_backoff = { .base_ms = CONN_BACKOFF_BASE_MS, .cap_ms = CONN_BACKOFF_CAP_MS };
+static conn_backoff_t mqtt_backoff = { .base_ms = CONN_BACKOFF_BASE_MS, .cap_ms = CONN_BACKOFF_CAP_MS };
+static esp_timer_handle_t wifi_retry_timer;
+
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static esp_mqtt_client_config_t* mqtt_config = NULL;
+
+void conn_backoff_reset(conn_backoff_t* backoff) {
+    backoff->sleep_ms = backoff->base_ms;
+}
+
+uint32_t conn_backoff_next(conn_backoff_t* backoff) {
+    uint32_t upper = backoff->sleep_ms * 3;
+    if (upper <= backoff->base_ms || upper > backoff->cap_ms) {
+        upper = backoff->cap_ms;
+    }
+    uint32_t sleep = backoff->base_ms + esp_random() % (upper - backoff->base_ms + 1);
+    backoff->sleep_ms = sleep;
+    return sleep;
+}
+
+static void update_health(void) {
+    conn_health_t current = !wifi_up ? CONN_HEALTH_WIFI_DOWN
+                          : !mqtt_up ? CONN_HEALTH_MQTT_DOWN
+                          : CONN_HEALTH_OK;
+    if (current != health) {
+        health = current;
+        if (health_cb) {
+            health_cb(health);
+        }
+    }
+}
+
+static void wifi_retry_callback(void* arg) {
+    esp_wifi_connect();
+}
+
+// esp-mqtt só aceita um intervalo fixo de reconexão; sorteia o próximo e reaplica a configuração
+static void mqtt_schedule_reconnect(void) {
+    if (!mqtt_client || !mqtt_config) {
+        return;
+    }
+    mqtt_config->network.reconnect_timeout_ms = conn_backoff_next(&mqtt_backoff);
+    esp_mqtt_set_config(mqtt_client, mqtt_config);
+}
+
+esp_err_t conn_supervisor_init(conn_health_cb_t on_health) {
+    health_cb = on_health;
+    conn_backoff_reset(&wifi_backoff);
+    conn_backoff_reset(&mqtt_backoff);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = &wifi_retry_callback,
+        .name = "wifi_retry",
+    };
+    return esp_timer_create(&timer_args, &wifi_retry_timer);
+}
+
+void conn_supervisor_attach_mqtt(esp_mqtt_client_handle_t client, esp_mqtt_client_config_t* config) {
+    mqtt_client = client;
+    mqtt_config = config;
+    // Mesmo a primeira reconexão já sai com atraso sorteado
+    mqtt_schedule_reconnect();
+}
+
+void conn_supervisor_wifi_up(void) {
+    esp_timer_stop(wifi_retry_timer);
+    conn_backoff_reset(&wifi_backoff);
+    wifi_up = true;
+    update_health();
+}
+
+void conn_supervisor_wifi_down(void) {
+    uint32_t delay_ms = conn_backoff_next(&wifi_backoff);
+    ESP_LOGI(TAG_SUP, "Wi-Fi caiu, nova tentativa em %lu ms", delay_ms);
+    esp_timer_stop(wifi_retry_timer);
+    esp_timer_start_once(wifi_retry_timer, (uint64_t) delay_ms * 1000);
+    wifi_up = false;
+    mqtt_up = false;
+    update_health();
+}
+
+void conn_supervisor_mqtt_up(void) {
+    conn_backoff_reset(&mqtt_backoff);
+    mqtt_schedule_reconnect();
+    mqtt_up = true;
+    update_health();
+}
+
+void conn_supervisor_mqtt_down(void) {
+    if (mqtt_up) {
+        ESP_LOGI(TAG_SUP, "Broker MQTT desconectado");
+    }
+    mqtt_schedule_reconnect();
+    mqtt_up = false;
+    update_health();
+}
+
+conn_health_t conn_supervisor_get_health(void) {
+    return health;
+}
@@ -0,0 +1,160 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "dlog.h"
+#include "static_mem.h"
+
+static const char *TAG_DLOG = "dlog";
+
+typedef struct {
+    const char* tag;
+    const char* fmt;
+    uint32_t timestamp_ms;
+    uint32_t args[4];
+    uint8_t level;
+    uint8_t has_text;
+    char text[DLOG_TEXT_MAX];
+} dlog_record_t;
+
+volatile esp_log_level_t dlog_level = DLOG_DEFAULT_LEVEL;
+
+static dlog_record_t ring[DLOG_RING_SIZE];
+static uint16_t ring_head = 0;
+static uint16_t ring_count = 0;
+static uint32_t dropped = 0;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t dlog_task_handle = NULL;
+STATIC_TASK_STORAGE(dlog_task, DLOG_TASK_STACK_SIZE);
+
+static const char level_letter[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+
+void dlog_write(esp_log_level_t level, const char* tag, const char* fmt,
+                uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                const char* text, int text_len) {
+    uint32_t now_ms = (uint32_t) (esp_timer_get_time() / 1000);
+    bool stored = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (ring_count < DLOG_RING_SIZE) {
+        dlog_record_t* rec = &ring[(ring_head + ring_count) % DLOG_RING_SIZE];
+        rec->tag = tag;
+        rec->fmt = fmt;
+        rec->timestamp_ms = now_ms;
+        rec->args[0] = a0;
+        rec->args[1] = a1;
+        rec->args[2] = a2;
+        rec->args[3] = a3;
+        rec->level = level;
+        rec->has_text = text != NULL;
+        if (text) {
+            int len = text_len < DLOG_TEXT_MAX - 1 ? text_len : DLOG_TEXT_MAX - 1;
+            memcpy(rec->text, text, len);
+            rec->text[len] = '\0';
+        }
+        ring_count++;
+        stored = true;
+    } else {
+        dropped++;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (stored && dlog_task_handle) {
+        xTaskNotifyGive(dlog_task_handle);
+    }
+}
+
+static void dlog_task(void* arg) {
+    dlog_record_t rec;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (1) {
+            taskENTER_CRITICAL(&ring_lock);
+            bool has_record = ring_count > 0;
+            if (has_record) {
+                rec = ring[ring_head];
+                ring_head = (ring_head + 1) % DLOG_RING_SIZE;
+                ring_count--;
+            }
+            taskEXIT_CRITICAL(&ring_lock);
+
+            if (!has_record) {
+                break;
+            }
+
+            esp_log_level_t level = (esp_log_level_t) rec.level;
+            esp_log_write(level, rec.tag, "%c (%lu) %s: ", level_letter[rec.level], rec.timestamp_ms, rec.tag);
+            if (rec.has_text) {
+                esp_log_write(level, rec.tag, rec.fmt, rec.text, rec.args[0], rec.args[1], rec.args[2]);
+            } else {
+                esp_log_write(level, rec.tag, rec.fmt, rec.args[0], rec.args[1], rec.args[2], rec.args[3]);
+            }
+            esp_log_write(level, rec.tag, "\n");
+        }
+    }
+}
+
+esp_err_t dlog_init(void) {
+    if (dlog_task_handle) {
+        return ESP_OK;
+    }
+    static_mem_account("dlog", sizeof(ring));
+    return static_mem_task_create(dlog_task, "dlog", DLOG_TASK_STACK_SIZE, NULL,
+                                  DLOG_TASK_PRIORITY, &dlog_task_handle, DLOG_TASK_CORE,
+                                  STATIC_TASK_BUFFERS(dlog_task));
+}
+
+void dlog_write_args(esp_log_level_t level, const char* tag, const char* fmt,
+                     uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    DLOG(level, tag, fmt, a0, a1, a2, a3);
+}
+
+void dlog_set_level(esp_log_level_t level) {
+    dlog_level = level;
+    esp_log_level_set("*", level);
+}
+
+uint32_t dlog_dropped(void) {
+    return dropped;
+}
+
+static volatile bool bench_running = false;
+
+static void dlog_bench_task(void* arg) {
+    // Mede só o custo para quem chama; o anel é esvaziado entre rodadas para não descartar
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < DLOG_BENCH_CALLS; i++) {
+        ESP_LOGI(TAG_DLOG, "bench uid=%08lX len=%lu", i, i & 0xFF);
+    }
+    int64_t direct_us = esp_timer_get_time() - start;
+
+    int64_t deferred_us = 0;
+    for (uint32_t i = 0; i < DLOG_BENCH_CALLS; i++) {
+        if (i % (DLOG_RING_SIZE / 2) == 0) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
+        int64_t t0 = esp_timer_get_time();
+        DLOG(ESP_LOG_INFO, TAG_DLOG, "bench uid=%08lX len=%lu", i, i & 0xFF, 0, 0);
+        deferred_us += esp_timer_get_time() - t0;
+    }
+
+    ESP_LOGI(TAG_DLOG, "Custo por chamada: ESP_LOGI=%lld ns, DLOG=%lld ns (%d chamadas)",
+             direct_us * 1000 / DLOG_BENCH_CALLS, deferred_us * 1000 / DLOG_BENCH_CALLS, DLOG_BENCH_CALLS);
+    bench_running = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t dlog_benchmark_start(void) {
+    if (bench_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    bench_running = true;
+    if (xTaskCreatePinnedToCore(dlog_bench_task, "dlog_bench", DLOG_BENCH_STACK_SIZE, NULL,
+                                DLOG_TASK_PRIORITY, NULL, DLOG_TASK_CORE) != pdTRUE) {
+        bench_running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
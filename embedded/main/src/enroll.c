@@ -0,0 +1,115 @@
+#include <string.h>
+#include "esp_log.h"
+#include "enroll.h"
+#include "static_mem.h"
+
+static const char *TAG_ENROLL = "enroll";
+
+// 0 marca posição livre: nenhuma tag ISO14443A tem UID zero
+static uint64_t seen[ENROLL_TABLE_SIZE];
+static volatile enroll_mode_t current_mode = ENROLL_MODE_OFF;
+static volatile bool clear_pending = false;
+static volatile uint32_t seen_count = 0;
+static uint32_t overflow = 0;
+static volatile uint32_t repeats = 0;
+static bool accounted = false;
+
+void enroll_set_mode(enroll_mode_t mode) {
+    if (mode == current_mode) {
+        return;
+    }
+    if (current_mode != ENROLL_MODE_OFF) {
+        ESP_LOGI(TAG_ENROLL, "Sessão de %s encerrada: %lu tags distintas (%lu acima da tabela), %lu leituras repetidas",
+                 current_mode == ENROLL_MODE_CADASTRO ? "cadastro" : "auditoria",
+                 (unsigned long) seen_count, (unsigned long) overflow, (unsigned long) repeats);
+    }
+    if (mode != ENROLL_MODE_OFF) {
+        if (!accounted) {
+            static_mem_account("enroll", sizeof(seen));
+            accounted = true;
+        }
+        clear_pending = true;
+        seen_count = 0;
+        repeats = 0;
+    }
+    current_mode = mode;
+}
+
+enroll_mode_t enroll_get_mode(void) {
+    return current_mode;
+}
+
+// Hash de Fibonacci sobre 64 bits (a outbox faz o mesmo em 32): os bits altos do produto
+static inline uint32_t enroll_slot(uint64_t uid) {
+    return (uint32_t) ((uid * 0x9E3779B97F4A7C15ull) >> (64 - ENROLL_TABLE_BITS));
+}
+
+static inline uint32_t enroll_next(uint32_t slot) {
+    return (slot + 1) & (ENROLL_TABLE_SIZE - 1);
+}
+
+bool enroll_add(uint64_t uid) {
+    if (clear_pending) {
+        memset(seen, 0, sizeof(seen));
+        seen_count = 0;
+        overflow = 0;
+        repeats = 0;
+        clear_pending = false;
+    }
+    if (uid == 0) {
+        return false;
+    }
+
+    uint32_t slot = enroll_slot(uid);
+    while (seen[slot] != 0) {
+        if (seen[slot] == uid) {
+            repeats++;
+            return false;
+        }
+        slot = enroll_next(slot);
+    }
+
+    if (seen_count >= ENROLL_SEEN_MAX) {
+        overflow++;
+        return true; // Sem espaço para lembrar: envia e deixa o receptor deduplicar
+    }
+    seen[slot] = uid;
+    seen_count++;
+    return true;
+}
+
+void enroll_forget(uint64_t uid) {
+    if (clear_pending || uid == 0) {
+        return; // A tabela vai ser limpa de qualquer jeito
+    }
+    uint32_t hole = enroll_slot(uid);
+    while (seen[hole] != uid) {
+        if (seen[hole] == 0) {
+            if (overflow > 0) {
+                overflow--; // Foi enviada sem ser lembrada (tabela cheia)
+            }
+            return;
+        }
+        hole = enroll_next(hole);
+    }
+
+    // Remoção sem lápide: quem vem depois na mesma sequência e pode ocupar o buraco sobe para ele,
+    // senão a busca pararia no buraco antes de chegar à UID
+    for (uint32_t slot = enroll_next(hole); seen[slot] != 0; slot = enroll_next(slot)) {
+        uint32_t home = enroll_slot(seen[slot]);
+        if (((slot - home) & (ENROLL_TABLE_SIZE - 1)) >= ((slot - hole) & (ENROLL_TABLE_SIZE - 1))) {
+            seen[hole] = seen[slot];
+            hole = slot;
+        }
+    }
+    seen[hole] = 0;
+    seen_count--;
+}
+
+uint32_t enroll_count(void) {
+    return seen_count + overflow;
+}
+
+uint32_t enroll_repeats(void) {
+    return repeats;
+}
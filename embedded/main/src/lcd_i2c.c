@@ -1,11 +1,22 @@
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "lcd_i2c.h" 
 
 #define ACK_CHECK_EN 0x1  
 static const char *TAG_LCD = "lcd_module"; 
 static bool i2c_initialized_flag = false; 
+static uint32_t i2c_bytes_sent = 0;
+
+// Estado do letreiro; só a tarefa de display mexe no LCD (com o mutex do main.c)
+static uint8_t marquee_len = 0;             // Tamanho da linha 1; 0 = sem letreiro
+static uint8_t marquee_offset = 0;          // Deslocamento atual do display, em colunas
+static uint8_t marquee_pause = 0;
+static uint32_t marquee_pass_start_bytes = 0;
+static bool marquee_shift = false;          // true: deslocamento do display; false: reescreve a linha 1
+static char marquee_line1[LCD_DDRAM_LINE_LEN];
 
 static esp_err_t i2c_bus_init(void) {
     if (i2c_initialized_flag) {
@@ -51,6 +62,7 @@ static esp_err_t lcd_i2c_send_buffer(uint8_t *data_wr, size_t size) {
     i2c_master_stop(cmd);
     esp_err_t ret = i2c_master_cmd_begin(LCD_I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000)); 
     i2c_cmd_link_delete(cmd);
+    i2c_bytes_sent += size + 1;
 
     if (ret != ESP_OK) {
         ESP_LOGE(TAG_LCD, "Falha ao enviar dados I2C para o LCD (end: 0x%X): %s", LCD_I2C_ADDRESS, esp_err_to_name(ret));
@@ -119,6 +131,9 @@ esp_err_t lcd_module_init(void) {
 void lcd_clear(void) {
     lcd_send_command(LCD_CLEAR_DISPLAY);
     vTaskDelay(pdMS_TO_TICKS(2)); 
+    // O clear também desfaz o deslocamento: encerra o letreiro
+    marquee_len = 0;
+    marquee_offset = 0;
 }
 
 void lcd_set_cursor(uint8_t row, uint8_t col) {
@@ -138,4 +153,122 @@ void lcd_print_str(const char *str) {
     while (*str) {
         lcd_print_char(*str++);
     }
-}
\ No newline at end of file
+}
+
+uint32_t lcd_i2c_bytes_sent(void) {
+    return i2c_bytes_sent;
+}
+
+bool lcd_marquee_active(void) {
+    return marquee_len > 0;
+}
+
+/* Modo software: reescreve a janela de 16 colunas da linha 1 a partir do deslocamento atual */
+static void lcd_marquee_draw(void) {
+    lcd_set_cursor(0, 0);
+    for (uint8_t col = 0; col < LCD_COLS; col++) {
+        lcd_print_char(marquee_line1[marquee_offset + col]);
+    }
+}
+
+uint32_t lcd_marquee_start(const char *line1, const char *line2) {
+    size_t len1 = strnlen(line1, LCD_DDRAM_LINE_LEN);
+    size_t len2 = strnlen(line2, LCD_COLS);
+
+    // O deslocamento move as duas linhas: só serve com a linha 2 em branco
+    bool line2_blank = true;
+    for (size_t i = 0; i < len2; i++) {
+        line2_blank = line2_blank && line2[i] == ' ';
+    }
+
+    // Sem deslocamento, o que passa de 16 colunas só é escrito quando rolar
+    size_t written1 = (line2_blank || len1 <= LCD_COLS) ? len1 : LCD_COLS;
+    lcd_clear();
+    lcd_set_cursor(0, 0);
+    for (size_t i = 0; i < written1; i++) {
+        lcd_print_char(line1[i]);
+    }
+    lcd_set_cursor(1, 0);
+    for (size_t i = 0; i < len2; i++) {
+        lcd_print_char(line2[i]);
+    }
+
+    if (len1 <= LCD_COLS) {
+        return 0;
+    }
+    memcpy(marquee_line1, line1, len1);
+    marquee_len = (uint8_t) len1;
+    marquee_shift = line2_blank;
+    marquee_pause = LCD_MARQUEE_PAUSE_STEPS;
+    marquee_pass_start_bytes = i2c_bytes_sent;
+    return 2 * LCD_MARQUEE_PAUSE_STEPS + (len1 - LCD_COLS) + 1;
+}
+
+void lcd_marquee_step(void) {
+    if (marquee_len == 0) {
+        return;
+    }
+    if (marquee_pause > 0) {
+        marquee_pause--;
+        return;
+    }
+
+    if (marquee_offset < marquee_len - LCD_COLS) {
+        marquee_offset++;
+        if (marquee_shift) {
+            // Um comando move a tela inteira uma coluna: nada da linha 1 é reenviado
+            lcd_send_command(LCD_CURSOR_SHIFT | LCD_DISPLAY_MOVE | LCD_MOVE_LEFT);
+        } else {
+            lcd_marquee_draw();
+        }
+        if (marquee_offset == marquee_len - LCD_COLS) {
+            marquee_pause = LCD_MARQUEE_PAUSE_STEPS;
+        }
+    } else {
+        marquee_offset = 0;
+        if (marquee_shift) {
+            // Fim da passada: o return home desfaz o deslocamento sem tocar na DDRAM
+            lcd_send_command(LCD_RETURN_HOME);
+            vTaskDelay(pdMS_TO_TICKS(2));
+        } else {
+            lcd_marquee_draw();
+        }
+        marquee_pause = LCD_MARQUEE_PAUSE_STEPS;
+        ESP_LOGD(TAG_LCD, "Letreiro: passada de %u colunas em %lu bytes I2C", marquee_len,
+                 (unsigned long) (i2c_bytes_sent - marquee_pass_start_bytes));
+        marquee_pass_start_bytes = i2c_bytes_sent;
+    }
+}
+
+// Rola a passada inteira sem pausas e retorna os bytes I2C gastos; tempo em *elapsed_us
+static uint32_t lcd_marquee_bench_pass(const char *line1, const char *line2, int64_t *elapsed_us) {
+    lcd_marquee_start(line1, line2);
+    marquee_pause = 0;
+    uint32_t bytes = i2c_bytes_sent;
+    int64_t start = esp_timer_get_time();
+    while (marquee_offset < marquee_len - LCD_COLS) {
+        lcd_marquee_step();
+    }
+    *elapsed_us = esp_timer_get_time() - start;
+    return i2c_bytes_sent - bytes;
+}
+
+void lcd_marquee_bench(const char *line1, const char *line2) {
+    size_t len1 = strnlen(line1, LCD_DDRAM_LINE_LEN);
+    if (len1 <= LCD_COLS) {
+        ESP_LOGW(TAG_LCD, "Bench do letreiro precisa de mais de %d caracteres", LCD_COLS);
+        return;
+    }
+    uint32_t steps = len1 - LCD_COLS;
+    int64_t soft_us, shift_us;
+
+    // Com a linha 2 preenchida o letreiro reescreve a linha 1; em branco, desloca o display
+    uint32_t soft_bytes = lcd_marquee_bench_pass(line1, line2, &soft_us);
+    uint32_t shift_bytes = lcd_marquee_bench_pass(line1, "", &shift_us);
+    lcd_clear();
+
+    ESP_LOGI(TAG_LCD, "Letreiro, %lu passos (bytes I2C por passo, tempo total):", (unsigned long) steps);
+    ESP_LOGI(TAG_LCD, "  software (linha 2 \"%s\") %4lu  %6lld us", line2,
+             (unsigned long) (soft_bytes / steps), soft_us);
+    ESP_LOGI(TAG_LCD, "  deslocamento (2 vazia)  %4lu  %6lld us", (unsigned long) (shift_bytes / steps), shift_us);
+}
@@ -2,12 +2,20 @@
 #include <freertos/task.h>
 #include <esp_system.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_pm.h>
 #include <string.h>
 
 #include "mfrc522.h"
 
 static const char* TAG = "rc522";
 
+/* UID as anticollision resolves it: 4, 7 or 10 bytes over 1 to 3 cascade levels */
+typedef struct {
+    uint8_t levels;
+    uint8_t sn[3][5];                      /*<! Per level 4 bytes + BCC; all but the last level start with the cascade tag 0x88 */
+} rc522_uid_t;
+
 struct rc522 {
     bool running;                          /*<! Indicates whether rc522 task is running or not */
     rc522_config_t* config;                /*<! Configuration */
@@ -16,10 +24,54 @@ struct rc522 {
     spi_device_handle_t spi_handle;
     bool initialized;                      /*<! Set on the first start() when configuration is sent to rc522 */
     bool scanning;                         /*<! Whether the rc522 is in scanning or idle mode */
-    bool tag_was_present_last_time;
     bool bus_initialized_by_user;          /*<! Whether the bus has been initialized manually by the user, before calling rc522_create function */
+    bool spi_clock_auto;                   /*<! SPI clock is chosen by link training instead of the user */
+    uint8_t spi_clock_index;               /*<! Index of the current clock in rc522_spi_clocks */
+    uint16_t link_errors;                  /*<! Transport errors and failed link checks since the last clock change */
+    uint32_t link_check_counter;           /*<! Polls since the last runtime link check */
+    uint32_t spi_bytes;                    /*<! Bytes moved over SPI, used to report bus time per poll */
+    uint32_t spi_transactions;             /*<! SPI transfers issued, to compare a presence check with a full poll */
+    uint32_t scan_transactions;            /*<! Transfers of the last poll that found a new tag */
+    bool presence_cost_reported;           /*<! The cost of a presence check was logged once for this handle */
+    struct {
+        uint64_t serial_number;            /*<! 0 = free slot */
+        rc522_uid_t uid;                   /*<! Cascade levels from anticollision, sent as is in SELECT */
+        uint8_t misses;                    /*<! Failed presence checks in a row */
+        int64_t arrived_us;
+        int64_t last_seen_us;
+    } present[RC522_PRESENCE_MAX];         /*<! Tags in the field, kept in HALT between presence checks */
+    uint8_t present_count;
+    rc522_uid_t scanned;                   /*<! Tag of the RC522_EVENT_TAG_SCANNED being dispatched, selected again for page access */
+    bool static_storage;                   /*<! Handle, config and task live in a caller provided rc522_storage_t */
+    esp_pm_lock_handle_t pm_lock;          /*<! Held during each poll burst, so the chip may light-sleep between polls */
+    int64_t next_poll_us;                  /*<! When the next poll should start, to measure how late it wakes up */
+    rc522_stats_t stats;                   /*<! RF outcome counters, see rc522_get_stats */
+    uint8_t last_error;                    /*<! Outcome of the last exchange: 0, ErrorReg bits or RC522_ERR_TIMEOUT */
+    uint8_t gain_window;                   /*<! Answered tag exchanges counted towards the next gain decision */
+    uint8_t gain_weak;                     /*<! ...of which failed like a weak signal: parity, CRC */
+    uint8_t gain_strong;                   /*<! ...of which failed like an overdriven receiver: protocol, overflow */
+    struct {
+        rc522_event_t event;
+        esp_event_handler_t handler;
+        void* arg;
+    } static_handlers[RC522_STATIC_EVENT_HANDLERS]; /*<! Called directly, as a static handle has no event loop */
 };
 
+_Static_assert(sizeof(struct rc522) <= sizeof(((rc522_storage_t*) 0)->handle), "RC522_STATIC_HANDLE_WORDS is too small");
+
+#define RC522_FIFO_SIZE (64)
+
+/* Exchange outcomes, as ErrorReg bits where the chip has one */
+#define RC522_ERR_PROTOCOL (0x01)
+#define RC522_ERR_PARITY (0x02)
+#define RC522_ERR_CRC (0x04)      /*<! Only set by the driver: RxCRCEn is off, so the chip never checks */
+#define RC522_ERR_COLLISION (0x08)
+#define RC522_ERR_TIMEOUT (0xFF)
+
+/* Clock steps tried by link training, fastest first (MFRC522 supports up to 10 MHz) */
+static const int rc522_spi_clocks[] = { 10000000, 8000000, 6666666, 5000000, 4000000, 2000000, 1000000 };
+#define RC522_SPI_CLOCKS_N (sizeof(rc522_spi_clocks) / sizeof(rc522_spi_clocks[0]))
+
 ESP_EVENT_DEFINE_BASE(RC522_EVENTS);
 
 static esp_err_t rc522_spi_send(rc522_handle_t rc522, uint8_t* buffer, uint8_t length);
@@ -29,9 +81,40 @@ static esp_err_t rc522_i2c_receive(rc522_handle_t rc522, uint8_t* buffer, uint8_
 
 static void rc522_task(void* arg);
 
-static esp_err_t rc522_write_n(rc522_handle_t rc522, uint8_t addr, uint8_t n, uint8_t *data)
+static void rc522_create_pm_lock(rc522_handle_t rc522)
+{
+#ifdef CONFIG_PM_ENABLE
+    if(ESP_OK != esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "rc522", &rc522->pm_lock)) {
+        ESP_LOGW(TAG, "Cannot create PM lock, polls will run at whatever clock DFS picks");
+        rc522->pm_lock = NULL;
+    }
+#endif
+}
+
+static void rc522_log(rc522_handle_t rc522, esp_log_level_t level, const char* fmt,
+                      uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    if(rc522->config->log_hook) {
+        rc522->config->log_hook(level, TAG, fmt, a0, a1, a2, a3);
+        return;
+    }
+    if(level > esp_log_level_get(TAG)) {
+        return;
+    }
+
+    static const char level_letter[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+    esp_log_write(level, TAG, "%c (%lu) %s: ", level_letter[level], esp_log_timestamp(), TAG);
+    esp_log_write(level, TAG, fmt, a0, a1, a2, a3);
+    esp_log_write(level, TAG, "\n");
+}
+
+static esp_err_t rc522_write_n(rc522_handle_t rc522, uint8_t addr, uint8_t n, const uint8_t *data)
 {
-    uint8_t* buffer = (uint8_t*) malloc(n + 1); // FIXME: memcheck
+    if(n > RC522_FIFO_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t buffer[RC522_FIFO_SIZE + 1];
     buffer[0] = addr;
     memcpy(buffer + 1, data, n);
     esp_err_t ret;
@@ -46,9 +129,9 @@ static esp_err_t rc522_write_n(rc522_handle_t rc522, uint8_t addr, uint8_t n, ui
             ESP_LOGE(TAG, "write: Unknown transport");
             ret = ESP_ERR_INVALID_STATE; // unknown transport
     }
-    free(buffer);
     if(ESP_OK != ret) {
-        ESP_LOGE(TAG, "Failed to write data (err: %s)", esp_err_to_name(ret));
+        rc522->link_errors++;
+        rc522_log(rc522, ESP_LOG_ERROR, "Failed to write data (err: 0x%lx)", ret, 0, 0, 0);
     }
     return ret;
 }
@@ -58,9 +141,8 @@ static inline esp_err_t rc522_write(rc522_handle_t rc522, uint8_t addr, uint8_t
     return rc522_write_n(rc522, addr, 1, &val);
 }
 
-static uint8_t* rc522_read_n(rc522_handle_t rc522, uint8_t addr, uint8_t n)
+static esp_err_t rc522_read_n(rc522_handle_t rc522, uint8_t addr, uint8_t n, uint8_t* buffer)
 {
-    uint8_t* buffer = (uint8_t*) malloc(n); // FIXME: memcheck
     esp_err_t ret;
     switch(rc522->config->transport) {
         case RC522_TRANSPORT_SPI:
@@ -74,18 +156,18 @@ static uint8_t* rc522_read_n(rc522_handle_t rc522, uint8_t addr, uint8_t n)
             ret = ESP_ERR_INVALID_STATE; // unknown transport
     }
     if(ESP_OK != ret) {
-        free(buffer);
-        buffer = NULL;
-        ESP_LOGE(TAG, "Failed to read data (err: %s)", esp_err_to_name(ret));
+        rc522->link_errors++;
+        rc522_log(rc522, ESP_LOG_ERROR, "Failed to read data (err: 0x%lx)", ret, 0, 0, 0);
     }
-    return buffer;
+    return ret;
 }
 
 static inline uint8_t rc522_read(rc522_handle_t rc522, uint8_t addr)
 {
-    uint8_t* buffer = rc522_read_n(rc522, addr, 1);
-    uint8_t res = buffer[0];
-    free(buffer);
+    uint8_t res;
+    if(ESP_OK != rc522_read_n(rc522, addr, 1, &res)) {
+        return 0x00;
+    }
 
     return res;
 }
@@ -115,39 +197,88 @@ static esp_err_t rc522_antenna_on(rc522_handle_t rc522)
         }
     }
 
-    return rc522_write(rc522, 0x26, 0x60); // 43dB gain
+    return rc522_write(rc522, 0x26, rc522->stats.rx_gain << 4);
 }
 
-rc522_config_t* rc522_clone_config(rc522_config_t* config)
+static void rc522_copy_config(rc522_config_t* new_config, const rc522_config_t* config)
 {
-    rc522_config_t* new_config = calloc(1, sizeof(rc522_config_t)); // FIXME: memcheck
     memcpy(new_config, config, sizeof(rc522_config_t));
 
     // defaults
     new_config->scan_interval_ms = config->scan_interval_ms < 50 ? RC522_DEFAULT_SCAN_INTERVAL_MS : config->scan_interval_ms;
+    new_config->removal_misses = config->removal_misses == 0 ? RC522_DEFAULT_REMOVAL_MISSES : config->removal_misses;
+    new_config->rx_gain = config->rx_gain < RC522_GAIN_MIN || config->rx_gain > 7 ? RC522_DEFAULT_RX_GAIN : config->rx_gain;
     new_config->task_stack_size = config->task_stack_size == 0 ? RC522_DEFAULT_TASK_STACK_SIZE : config->task_stack_size;
     new_config->task_priority = config->task_priority == 0 ? RC522_DEFAULT_TASK_STACK_PRIORITY : config->task_priority;
+    new_config->core_id = config->pin_core ? config->core_id : RC522_TASK_NO_AFFINITY;
     new_config->spi.clock_speed_hz = config->spi.clock_speed_hz == 0 ? RC522_DEFAULT_SPI_CLOCK_SPEED_HZ : config->spi.clock_speed_hz;
     new_config->i2c.rw_timeout_ms = config->i2c.rw_timeout_ms == 0 ? RC522_DEFAULT_I2C_RW_TIMEOUT_MS : config->i2c.rw_timeout_ms;
     new_config->i2c.clock_speed_hz = config->i2c.clock_speed_hz == 0 ? RC522_DEFAULT_I2C_CLOCK_SPEED_HZ : config->i2c.clock_speed_hz;
+}
+
+rc522_config_t* rc522_clone_config(rc522_config_t* config)
+{
+    rc522_config_t* new_config = calloc(1, sizeof(rc522_config_t)); // FIXME: memcheck
+    rc522_copy_config(new_config, config);
 
     return new_config;
 }
 
+static esp_err_t rc522_spi_add_device(rc522_handle_t rc522)
+{
+    spi_device_interface_config_t devcfg = {
+        .clock_speed_hz = rc522->config->spi.clock_speed_hz,
+        .mode = 0,
+        .spics_io_num = rc522->config->spi.sda_gpio,
+        .queue_size = 7,
+        .flags = rc522->config->spi.device_flags,
+    };
+
+    return spi_bus_add_device(rc522->config->spi.host, &devcfg, &rc522->spi_handle);
+}
+
+/**
+ * Re-adds the SPI device with a new clock; the bus itself stays initialized.
+ * If the new device cannot be added the old clock is restored. If even that fails
+ * spi_handle is NULL, transfers fail with ESP_ERR_INVALID_STATE and rc522_check_link
+ * keeps trying to add the device back.
+ */
+static esp_err_t rc522_spi_set_clock(rc522_handle_t rc522, uint8_t clock_index)
+{
+    esp_err_t ret;
+
+    if(rc522->spi_handle) {
+        if(ESP_OK != (ret = spi_bus_remove_device(rc522->spi_handle))) {
+            return ret;
+        }
+        rc522->spi_handle = NULL;
+    }
+
+    int old_clock_hz = rc522->config->spi.clock_speed_hz;
+    rc522->config->spi.clock_speed_hz = rc522_spi_clocks[clock_index];
+
+    if(ESP_OK != (ret = rc522_spi_add_device(rc522))) {
+        rc522->spi_handle = NULL;
+        rc522->config->spi.clock_speed_hz = old_clock_hz;
+        if(ESP_OK != rc522_spi_add_device(rc522)) {
+            rc522->spi_handle = NULL;
+            ESP_LOGE(TAG, "Cannot add the SPI device back (err: 0x%x)", ret);
+        }
+        return ret;
+    }
+
+    rc522->spi_clock_index = clock_index;
+    rc522->link_errors = 0;
+
+    return ESP_OK;
+}
+
 static esp_err_t rc522_create_transport(rc522_handle_t rc522)
 {
     esp_err_t ret;
 
     switch(rc522->config->transport) {
         case RC522_TRANSPORT_SPI: {
-                spi_device_interface_config_t devcfg = {
-                    .clock_speed_hz = rc522->config->spi.clock_speed_hz,
-                    .mode = 0,
-                    .spics_io_num = rc522->config->spi.sda_gpio,
-                    .queue_size = 7,
-                    .flags = rc522->config->spi.device_flags,
-                };
-
                 rc522->bus_initialized_by_user = rc522->config->spi.bus_is_initialized;
 
                 if(! rc522->bus_initialized_by_user) {
@@ -164,7 +295,7 @@ static esp_err_t rc522_create_transport(rc522_handle_t rc522)
                     }
                 }
 
-                ret = spi_bus_add_device(rc522->config->spi.host, &devcfg, &rc522->spi_handle);
+                ret = rc522_spi_add_device(rc522);
             }
             break;
         case RC522_TRANSPORT_I2C: {
@@ -203,6 +334,8 @@ esp_err_t rc522_create(rc522_config_t* config, rc522_handle_t* out_rc522)
 
     rc522_handle_t rc522 = calloc(1, sizeof(struct rc522)); // FIXME: memcheck
     rc522->config = rc522_clone_config(config);
+    rc522->stats.rx_gain = rc522->config->rx_gain;
+    rc522->spi_clock_auto = config->transport == RC522_TRANSPORT_SPI && config->spi.clock_speed_hz == 0;
 
     if(ESP_OK != (ret = rc522_create_transport(rc522))) {
         ESP_LOGE(TAG, "Cannot create transport");
@@ -221,13 +354,53 @@ esp_err_t rc522_create(rc522_config_t* config, rc522_handle_t* out_rc522)
         return ret;
     }
 
+    rc522_create_pm_lock(rc522);
     rc522->running = true;
-    if (xTaskCreate(rc522_task, "rc522_task", rc522->config->task_stack_size, rc522, rc522->config->task_priority, &rc522->task_handle) != pdTRUE) {
+    if (xTaskCreatePinnedToCore(rc522_task, "rc522_task", rc522->config->task_stack_size, rc522, rc522->config->task_priority, &rc522->task_handle, rc522->config->core_id) != pdTRUE) {
         ESP_LOGE(TAG, "Cannot create task");
         rc522_destroy(rc522);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_rc522 = rc522;
+    return ESP_OK;
+}
+
+esp_err_t rc522_create_static(rc522_config_t* config, rc522_storage_t* storage, rc522_handle_t* out_rc522)
+{
+    if(! config || ! storage || ! out_rc522) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret;
+
+    memset(storage->handle, 0, sizeof(storage->handle));
+    rc522_handle_t rc522 = (rc522_handle_t) storage->handle;
+    rc522->static_storage = true;
+    rc522->config = &storage->config;
+    rc522_copy_config(rc522->config, config);
+    rc522->config->task_stack_size = sizeof(storage->task_stack);
+    rc522->stats.rx_gain = rc522->config->rx_gain;
+    rc522->spi_clock_auto = config->transport == RC522_TRANSPORT_SPI && config->spi.clock_speed_hz == 0;
+
+    if(ESP_OK != (ret = rc522_create_transport(rc522))) {
+        ESP_LOGE(TAG, "Cannot create transport");
+        rc522_destroy(rc522);
         return ret;
     }
 
+    // No event loop: posting to one copies the event data to the heap on every scan
+    rc522_create_pm_lock(rc522);
+    rc522->running = true;
+    rc522->task_handle = xTaskCreateStaticPinnedToCore(rc522_task, "rc522_task", sizeof(storage->task_stack), rc522,
+                                                       rc522->config->task_priority, storage->task_stack,
+                                                       &storage->task_buffer, rc522->config->core_id);
+    if(! rc522->task_handle) {
+        ESP_LOGE(TAG, "Cannot create task");
+        rc522_destroy(rc522);
+        return ESP_ERR_NO_MEM;
+    }
+
     *out_rc522 = rc522;
     return ESP_OK;
 }
@@ -238,6 +411,18 @@ esp_err_t rc522_register_events(rc522_handle_t rc522, rc522_event_t event, esp_e
         return ESP_ERR_INVALID_ARG;
     }
 
+    if(rc522->static_storage) {
+        for(int i = 0; i < RC522_STATIC_EVENT_HANDLERS; i++) {
+            if(! rc522->static_handlers[i].handler) {
+                rc522->static_handlers[i].event = event;
+                rc522->static_handlers[i].arg = event_handler_arg;
+                rc522->static_handlers[i].handler = event_handler;
+                return ESP_OK;
+            }
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
     return esp_event_handler_register_with(rc522->event_handle, RC522_EVENTS, event, event_handler, event_handler_arg);
 }
 
@@ -247,10 +432,19 @@ esp_err_t rc522_unregister_events(rc522_handle_t rc522, rc522_event_t event, esp
         return ESP_ERR_INVALID_ARG;
     }
 
+    if(rc522->static_storage) {
+        for(int i = 0; i < RC522_STATIC_EVENT_HANDLERS; i++) {
+            if(rc522->static_handlers[i].handler == event_handler && rc522->static_handlers[i].event == event) {
+                rc522->static_handlers[i].handler = NULL;
+            }
+        }
+        return ESP_OK;
+    }
+
     return esp_event_handler_unregister_with(rc522->event_handle, RC522_EVENTS, event, event_handler);
 }
 
-static uint64_t rc522_sn_to_u64(uint8_t* sn)
+static uint64_t rc522_sn_to_u64(const uint8_t* sn)
 {
     if(! sn) {
         return 0;
@@ -264,8 +458,44 @@ static uint64_t rc522_sn_to_u64(uint8_t* sn)
     return result;
 }
 
-/* Returns pointer to dynamically allocated array of two element */
-static uint8_t* rc522_calculate_crc(rc522_handle_t rc522, uint8_t *data, uint8_t n)
+/* Writes the UID bytes of every cascade level to out (10 bytes), without cascade tags and BCCs. Returns the length */
+static uint8_t rc522_uid_bytes(const rc522_uid_t* uid, uint8_t* out)
+{
+    uint8_t len = 0;
+
+    for(uint8_t level = 0; level < uid->levels; level++) {
+        bool last = level + 1 == uid->levels;
+        memcpy(out + len, uid->sn[level] + (last ? 0 : 1), last ? 4 : 3);
+        len += last ? 4 : 3;
+    }
+
+    return len;
+}
+
+/**
+ * serial_number of a UID. A 4 byte UID keeps the value the driver always reported (UID + BCC),
+ * which is what the receptor has stored. Longer UIDs get their length in the top byte, so they
+ * never meet a 4 byte one, and the UID below it: exact for 7 bytes, the last 3 bytes of a 10
+ * byte UID XORed over the first ones.
+ */
+static uint64_t rc522_uid_to_u64(const rc522_uid_t* uid)
+{
+    if(uid->levels == 1) {
+        return rc522_sn_to_u64(uid->sn[0]);
+    }
+
+    uint8_t bytes[10];
+    uint8_t len = rc522_uid_bytes(uid, bytes);
+    uint64_t result = (uint64_t) len << 56;
+    for(uint8_t i = 0; i < len; i++) {
+        result ^= (uint64_t) bytes[i] << ((i % 7) * 8);
+    }
+
+    return result;
+}
+
+/* Writes CRC_A of data to crc[0] (low) and crc[1] (high) */
+static void rc522_calculate_crc(rc522_handle_t rc522, const uint8_t *data, uint8_t n, uint8_t* crc)
 {
     rc522_clear_bitmask(rc522, 0x05, 0x04);
     rc522_set_bitmask(rc522, 0x0A, 0x80);
@@ -284,16 +514,17 @@ static uint8_t* rc522_calculate_crc(rc522_handle_t rc522, uint8_t *data, uint8_t
         }
     }
 
-    uint8_t* res = (uint8_t*) malloc(2); // FIXME: memcheck
-    res[0] = rc522_read(rc522, 0x22);
-    res[1] = rc522_read(rc522, 0x21);
-
-    return res;
+    crc[0] = rc522_read(rc522, 0x22);
+    crc[1] = rc522_read(rc522, 0x21);
 }
 
-static uint8_t* rc522_card_write(rc522_handle_t rc522, uint8_t cmd, uint8_t *data, uint8_t n, uint8_t* res_n)
+/**
+ * Returns true if the tag answered without error; at most res_size bytes of the answer are
+ * copied to res. The outcome is left in last_error for the caller to count.
+ */
+static bool rc522_card_write(rc522_handle_t rc522, uint8_t cmd, const uint8_t *data, uint8_t n, uint8_t* res, uint8_t res_size, uint8_t* res_n)
 {
-    uint8_t *result = NULL;
+    bool answered = false;
     uint8_t irq = 0x00;
     uint8_t irq_wait = 0x00;
     uint8_t last_bits = 0;
@@ -332,8 +563,11 @@ static uint8_t* rc522_card_write(rc522_handle_t rc522, uint8_t cmd, uint8_t *dat
 
     rc522_clear_bitmask(rc522, 0x0D, 0x80);
 
-    if(i != 0) {
-        if((rc522_read(rc522, 0x06) & 0x1B) == 0x00) {
+    rc522->last_error = RC522_ERR_TIMEOUT;
+    if(i != 0 && (nn & irq_wait)) {
+        rc522->last_error = rc522_read(rc522, 0x06) & 0x1B;
+        // After a collision the bits before it are still in the FIFO, for the anticollision loop
+        if(rc522->last_error == 0x00 || rc522->last_error == RC522_ERR_COLLISION) {
             if(cmd == 0x0C) {
                 nn = rc522_read(rc522, 0x0A);
                 last_bits = rc522_read(rc522, 0x0C) & 0x07;
@@ -344,77 +578,540 @@ static uint8_t* rc522_card_write(rc522_handle_t rc522, uint8_t cmd, uint8_t *dat
                     *res_n = nn;
                 }
 
-                result = (uint8_t*) malloc(*res_n); // FIXME: memcheck
-
-                for(i = 0; i < *res_n; i++) {
-                    result[i] = rc522_read(rc522, 0x09);
+                for(i = 0; i < *res_n && i < res_size; i++) {
+                    res[i] = rc522_read(rc522, 0x09);
                 }
+                answered = rc522->last_error == 0x00;
             }
         }
     }
 
-    return result;
+    return answered;
 }
 
-static uint8_t* rc522_request(rc522_handle_t rc522, uint8_t* res_n)
+/**
+ * Steps RxGain once a window of answered tag exchanges is full. If too many of them failed,
+ * parity and CRC errors point to a weak signal (metal detuning the antenna, a tag at the edge
+ * of the field): more gain. Protocol errors and buffer overflows point to a saturated receiver:
+ * less gain. Collisions are left out, as two items stacked on the reader collide at any gain,
+ * and so are timeouts: a tag that leaves mid-exchange says nothing about the receiver. A clean
+ * window steps the gain back towards the configured one, so an old burst of errors does not
+ * keep it up for good.
+ */
+static void rc522_adapt_gain(rc522_handle_t rc522, uint8_t error)
 {
-    uint8_t* result = NULL;
+    if(rc522->config->fixed_gain || error == RC522_ERR_TIMEOUT) {
+        return;
+    }
+
+    rc522->gain_window++;
+    if(error & (RC522_ERR_PARITY | RC522_ERR_CRC)) {
+        rc522->gain_weak++;
+    } else if(error && ! (error & RC522_ERR_COLLISION)) {
+        rc522->gain_strong++;
+    }
+    if(rc522->gain_window < RC522_GAIN_WINDOW) {
+        return;
+    }
+
+    const uint8_t threshold = RC522_GAIN_WINDOW * RC522_GAIN_ERROR_PCT / 100;
+    uint8_t gain = rc522->stats.rx_gain;
+    if(rc522->gain_weak + rc522->gain_strong >= threshold) {
+        if(rc522->gain_weak >= rc522->gain_strong && gain < 7) {
+            gain++;
+        } else if(rc522->gain_strong > rc522->gain_weak && gain > RC522_GAIN_MIN) {
+            gain--;
+        }
+    } else if(gain != rc522->config->rx_gain) {
+        gain += gain < rc522->config->rx_gain ? 1 : -1;
+    }
+
+    if(gain != rc522->stats.rx_gain) {
+        rc522_log(rc522, ESP_LOG_INFO, "RxGain %lu -> %lu (%lu weak, %lu strong failures)",
+                  rc522->stats.rx_gain, gain, rc522->gain_weak, rc522->gain_strong);
+        rc522->stats.rx_gain = gain;
+        rc522->stats.gain_changes++;
+        rc522_write(rc522, 0x26, gain << 4);
+    }
+    rc522->gain_window = 0;
+    rc522->gain_weak = 0;
+    rc522->gain_strong = 0;
+}
+
+/**
+ * Counts the outcome of an exchange. A failed exchange without error bits (the answer had the
+ * wrong length) counts as a protocol error. Returns ok, and leaves the outcome in last_error.
+ */
+static bool rc522_count(rc522_handle_t rc522, rc522_stage_t stage, bool ok)
+{
+    uint8_t error = ok ? 0x00 : (rc522->last_error ? rc522->last_error : RC522_ERR_PROTOCOL);
+    rc522_stage_stats_t* stats = &rc522->stats.stage[stage];
+
+    rc522->last_error = error;
+    if(error == 0x00) {
+        stats->ok++;
+    } else if(error == RC522_ERR_TIMEOUT) {
+        stats->timeout++;
+    } else if(error & RC522_ERR_COLLISION) {
+        stats->collision++;
+    } else if(error & RC522_ERR_PARITY) {
+        stats->parity++;
+    } else if(error & RC522_ERR_CRC) {
+        stats->crc++;
+    } else {
+        stats->protocol++;
+    }
+
+    // Nobody answering (REQA on an empty field included) is left out by rc522_adapt_gain
+    rc522_adapt_gain(rc522, error);
+    return ok;
+}
+
+static bool rc522_request(rc522_handle_t rc522, uint8_t* res_n)
+{
+    uint8_t atqa[2];
     rc522_write(rc522, 0x0D, 0x07);
 
     uint8_t req_mode = 0x26;
-    result = rc522_card_write(rc522, 0x0C, &req_mode, 1, res_n);
+    *res_n = 0;
+
+    return rc522_count(rc522, RC522_STAGE_REQUEST,
+                       rc522_card_write(rc522, 0x0C, &req_mode, 1, atqa, sizeof(atqa), res_n) && *res_n * 8 == 0x10);
+}
+
+/**
+ * Bit frame anticollision for one cascade level: 4 uid bytes + BCC into sn. When several tags
+ * answer (a tray), the first colliding bit is taken as 1 and the next round sends the bits known
+ * so far, which only the tags that match keep answering. The winner is selected and halted by
+ * the caller; the others drop back to IDLE and answer the next REQA.
+ */
+static bool rc522_anticoll_level(rc522_handle_t rc522, uint8_t level_cmd, uint8_t* sn)
+{
+    uint8_t known_bits = 0;
+
+    memset(sn, 0, 5);
+    rc522_clear_bitmask(rc522, 0x0E, 0x80); // ValuesAfterColl = 0: keep the bits received before a collision
+
+    for(uint8_t round = 0; round < 32; round++) {
+        uint8_t full_bytes = known_bits / 8;
+        uint8_t last_bits = known_bits % 8;
+        uint8_t frame[7] = { level_cmd, ((2 + full_bytes) << 4) | last_bits }; // NVB: bytes and bits sent
+        uint8_t res[5] = { 0 };
+        uint8_t res_n = 0;
+
+        memcpy(frame + 2, sn, 5);
+        rc522_write(rc522, 0x0D, (last_bits << 4) | last_bits); // RxAlign = TxLastBits: the answer completes the byte
+        bool answered = rc522_card_write(rc522, 0x0C, frame, 2 + full_bytes + (last_bits ? 1 : 0), res, 5 - full_bytes, &res_n);
+        if(! answered && rc522->last_error != RC522_ERR_COLLISION) {
+            break;
+        }
+
+        uint8_t sent_mask = (1 << last_bits) - 1;
+        sn[full_bytes] = (sn[full_bytes] & sent_mask) | (res[0] & (uint8_t) ~sent_mask);
+        memcpy(sn + full_bytes + 1, res + 1, 4 - full_bytes);
+
+        if(answered) {
+            rc522_write(rc522, 0x0D, 0x00);
+            if(res_n != 5 - full_bytes) {
+                return rc522_count(rc522, RC522_STAGE_ANTICOLL, false);
+            }
+            if((sn[0] ^ sn[1] ^ sn[2] ^ sn[3]) != sn[4]) {
+                rc522->last_error = RC522_ERR_CRC; // A bit flipped on the way: the UID would be wrong
+                return rc522_count(rc522, RC522_STAGE_ANTICOLL, false);
+            }
+            return rc522_count(rc522, RC522_STAGE_ANTICOLL, true);
+        }
 
-    if(*res_n * 8 != 0x10) {
-        free(result);
-        return NULL;
+        // CollPos counts from the first bit received in this round, 1 based (0 = 32)
+        uint8_t coll = rc522_read(rc522, 0x0E);
+        uint8_t position = known_bits + ((coll & 0x1F) ? (coll & 0x1F) : 32);
+        if((coll & 0x20) || position > 32) {
+            break; // CollPosNotValid, or a collision in the BCC: nothing left to resolve
+        }
+        sn[(position - 1) / 8] |= 1 << ((position - 1) % 8);
+        known_bits = position;
     }
 
-    return result;
+    rc522_write(rc522, 0x0D, 0x00);
+    return rc522_count(rc522, RC522_STAGE_ANTICOLL, false);
 }
 
-static uint8_t* rc522_anticoll(rc522_handle_t rc522)
+static void rc522_halt(rc522_handle_t rc522)
 {
-    uint8_t res_n;
+    uint8_t res_data[1];
+    uint8_t res_data_n;
+    uint8_t buf[] = { 0x50, 0x00, 0x00, 0x00 };
+    rc522_calculate_crc(rc522, buf, 2, buf + 2);
+    rc522_card_write(rc522, 0x0C, buf, 4, res_data, sizeof(res_data), &res_data_n);
+    rc522_clear_bitmask(rc522, 0x08, 0x08);
+}
 
+/* Sends data followed by its CRC_A. Returns true if the tag answered */
+static bool rc522_transceive_crc(rc522_handle_t rc522, const uint8_t* data, uint8_t n, uint8_t* res, uint8_t res_size, uint8_t* res_n)
+{
+    uint8_t buf[n + 2];
+    memcpy(buf, data, n);
+    rc522_calculate_crc(rc522, buf, n, buf + n);
+
+    *res_n = 0;
     rc522_write(rc522, 0x0D, 0x00);
-    uint8_t* result = rc522_card_write(rc522, 0x0C, (uint8_t[]) { 0x93, 0x20 }, 2, &res_n);
+    return rc522_card_write(rc522, 0x0C, buf, n + 2, res, res_size, res_n);
+}
 
-    if(result && res_n != 5) { // all cards/tags serial numbers is 5 bytes long (?)
-        free(result);
-        return NULL;
+/**
+ * SELECT cascade of uid. The levels uid does not have yet are resolved by anticollision first
+ * (a new tag starts with none), the known ones are sent as they are. Only a selected (ACTIVE)
+ * tag goes to HALT on HLTA; other tags that answered drop to IDLE.
+ */
+static bool rc522_select_uid(rc522_handle_t rc522, rc522_uid_t* uid)
+{
+    static const uint8_t cascade[] = { 0x93, 0x95, 0x97 };
+    uint8_t res_n = 0;
+
+    for(uint8_t level = 0; level < 3; level++) {
+        if(level == uid->levels) {
+            if(! rc522_anticoll_level(rc522, cascade[level], uid->sn[level])) {
+                return false;
+            }
+            uid->levels++;
+        }
+
+        uint8_t select[7] = { cascade[level], 0x70 };
+        uint8_t sak[3];
+        memcpy(select + 2, uid->sn[level], 5); // 4 uid bytes + BCC go straight into the SELECT frame
+        if(! rc522_count(rc522, RC522_STAGE_SELECT,
+                         rc522_transceive_crc(rc522, select, sizeof(select), sak, sizeof(sak), &res_n) && res_n == 3)) {
+            return false;
+        }
+
+        if(! (sak[0] & 0x04)) { // uid complete
+            return level + 1 == uid->levels;
+        }
     }
 
-    return result;
+    return false;
+}
+
+/* Wakes up the halted tags (WUPA) and selects the one being dispatched */
+static esp_err_t rc522_select_tag(rc522_handle_t rc522)
+{
+    uint8_t res_n = 0;
+    uint8_t wupa = 0x52;
+    uint8_t atqa[2];
+
+    rc522_write(rc522, 0x0D, 0x07);
+    if(! rc522_card_write(rc522, 0x0C, &wupa, 1, atqa, sizeof(atqa), &res_n) || res_n != 2) {
+        // Not counted, as in the presence check: the tag may just be gone. Several woken tags
+        // collide on ATQA only if they are of different types, and the SELECT below still works
+        if(rc522->last_error != RC522_ERR_COLLISION) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    return rc522_select_uid(rc522, &rc522->scanned) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/* CRC_A (ISO 14443-3) computed here instead of by the chip: saves the CalcCRC round trips over SPI */
+static void rc522_crc_a(const uint8_t* data, uint8_t n, uint8_t* crc)
+{
+    uint16_t c = 0x6363;
+
+    for(uint8_t i = 0; i < n; i++) {
+        uint8_t b = data[i] ^ (uint8_t) c;
+        b ^= b << 4;
+        c = (c >> 8) ^ ((uint16_t) b << 8) ^ ((uint16_t) b << 3) ^ (b >> 4);
+    }
+
+    crc[0] = c & 0xFF;
+    crc[1] = c >> 8;
+}
+
+#define RC522_FAST_TIMEOUT (0xFF)
+
+/**
+ * Lean transceive for presence checks: plain register writes instead of read-modify-write,
+ * the short timer set by the caller and no FIFO read back. Waits for any of wait_irq or the
+ * timer. Returns the ErrorReg bits that card_write also rejects, or RC522_FAST_TIMEOUT.
+ */
+static uint8_t rc522_transceive_fast(rc522_handle_t rc522, const uint8_t* data, uint8_t n, uint8_t tx_last_bits, uint8_t wait_irq, uint8_t* fifo_level)
+{
+    uint8_t irq = 0x00;
+
+    rc522_write(rc522, 0x01, 0x00);                 // Idle, stops a pending receive
+    rc522_write(rc522, 0x04, 0x7F);                 // Clear all IRQ flags
+    rc522_write(rc522, 0x0A, 0x80);                 // Flush FIFO
+    rc522_write_n(rc522, 0x09, n, data);
+    rc522_write(rc522, 0x01, 0x0C);                 // Transceive
+    rc522_write(rc522, 0x0D, 0x80 | tx_last_bits);  // StartSend
+
+    for(uint16_t i = 1000; i != 0 && ! (irq & (wait_irq | 0x01)); i--) {
+        irq = rc522_read(rc522, 0x04);
+    }
+
+    rc522_write(rc522, 0x0D, 0x00);
+
+    if(! (irq & wait_irq)) {
+        return RC522_FAST_TIMEOUT;
+    }
+    if(fifo_level) {
+        *fifo_level = rc522_read(rc522, 0x0A) & 0x7F;
+    }
+    return wait_irq == 0x40 ? 0x00 : rc522_read(rc522, 0x06) & 0x1B;
+}
+
+/**
+ * Presence check of a known UID: WUPA wakes the halted tags, the SELECT cascade with the full UID
+ * is answered (SAK + CRC_A) at its last level only by that tag, and HLTA puts it back to sleep.
+ * The other woken tags fall back to HALT on the first SELECT that is not theirs (for 7 byte UIDs
+ * of the same batch, often the second level), so REQA keeps ignoring them.
+ */
+static bool rc522_check_presence(rc522_handle_t rc522, const rc522_uid_t* uid)
+{
+    static const uint8_t hlta[] = { 0x50, 0x00, 0x57, 0xCD };
+    static const uint8_t cascade[] = { 0x93, 0x95, 0x97 };
+    uint8_t wupa = 0x52;
+    uint8_t fifo_level = 0;
+
+    uint8_t select[3][9];
+    for(uint8_t level = 0; level < uid->levels; level++) {
+        select[level][0] = cascade[level];
+        select[level][1] = 0x70;
+        memcpy(select[level] + 2, uid->sn[level], 5);
+        rc522_crc_a(select[level], 7, select[level] + 7);
+    }
+
+    for(uint8_t attempt = 0; attempt <= RC522_FAST_RETRIES; attempt++) {
+        // Any answer is enough, even a collision between several tags. No answer: the tag is gone
+        if(rc522_transceive_fast(rc522, &wupa, 1, 0x07, 0x30, NULL) == RC522_FAST_TIMEOUT) {
+            return false;
+        }
+        if(attempt > 0) {
+            rc522->stats.retries++;
+        }
+
+        // Someone is there but a SELECT failed: retry now instead of counting a miss
+        bool selected = true;
+        for(uint8_t level = 0; selected && level < uid->levels; level++) {
+            rc522->last_error = rc522_transceive_fast(rc522, select[level], sizeof(select[level]), 0x00, 0x30, &fifo_level);
+            selected = rc522_count(rc522, RC522_STAGE_SELECT, rc522->last_error == 0x00 && fifo_level == 3);
+        }
+        if(selected) {
+            if(attempt > 0) {
+                rc522->stats.retry_saves++;
+            }
+            rc522_transceive_fast(rc522, hlta, sizeof(hlta), 0x00, 0x40, NULL); // No answer: wait for TxIRq only
+            return true;
+        }
+    }
+
+    return false;
 }
 
-static uint8_t* rc522_get_tag(rc522_handle_t rc522)
+static bool rc522_get_tag(rc522_handle_t rc522, rc522_uid_t* uid)
 {
-    uint8_t* result = NULL;
-    uint8_t* res_data = NULL;
     uint8_t res_data_n;
 
-    res_data = rc522_request(rc522, &res_data_n);
+    for(uint8_t attempt = 0; attempt <= RC522_FAST_RETRIES; attempt++) {
+        bool requested = rc522_request(rc522, &res_data_n);
+
+        if(! requested && rc522->last_error == RC522_ERR_TIMEOUT) {
+            return false; // Nobody new in the field
+        }
+        if(attempt > 0) {
+            rc522->stats.retries++;
+        }
+
+        // A garbled ATQA or UID still means a tag is there, and a failed exchange sends it back
+        // to IDLE, so REQA can start over right away instead of waiting for the next poll
+        uid->levels = 0;
+        if(requested && rc522_select_uid(rc522, uid)) {
+            if(attempt > 0) {
+                rc522->stats.retry_saves++;
+            }
+            rc522_halt(rc522);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+esp_err_t rc522_read_pages(rc522_handle_t rc522, uint8_t page, uint8_t* buffer, uint8_t n_pages)
+{
+    if(! rc522 || ! buffer || n_pages == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(xTaskGetCurrentTaskHandle() != rc522->task_handle) {
+        ESP_LOGE(TAG, "Pages can only be accessed from event handler");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = rc522_select_tag(rc522);
+
+    // READ returns 4 pages (16 bytes) + CRC_A per command
+    for(uint8_t done = 0; err == ESP_OK && done < n_pages; done += 4) {
+        uint8_t res_n;
+        uint8_t res[18];
+
+        // A corrupted answer leaves the tag selected, so the same READ can simply be sent again.
+        // No answer means the READ or its reply was lost, and the tag may have dropped to HALT on
+        // a garbled frame: halt it for sure, then wake and select it again before retrying
+        for(uint8_t attempt = 0; attempt <= RC522_FAST_RETRIES; attempt++) {
+            if(attempt > 0) {
+                rc522->stats.retries++;
+                if(rc522->last_error == RC522_ERR_TIMEOUT) {
+                    rc522_halt(rc522);
+                    if(rc522_select_tag(rc522) != ESP_OK) {
+                        break; // Gone: err stays ESP_ERR_TIMEOUT
+                    }
+                }
+            }
+            bool answered = rc522_transceive_crc(rc522, (uint8_t[]) { 0x30, page + done }, 2, res, sizeof(res), &res_n) && res_n == 18;
+            if(answered) {
+                uint8_t crc[2];
+                rc522_crc_a(res, 16, crc);
+                if(crc[0] != res[16] || crc[1] != res[17]) {
+                    rc522->last_error = RC522_ERR_CRC;
+                    answered = false;
+                }
+            }
+            if(! rc522_count(rc522, RC522_STAGE_READ, answered)) {
+                err = rc522->last_error == RC522_ERR_CRC ? ESP_ERR_INVALID_CRC : ESP_ERR_TIMEOUT;
+                continue;
+            }
+
+            if(attempt > 0) {
+                rc522->stats.retry_saves++;
+            }
+            uint8_t pages = (n_pages - done) < 4 ? (n_pages - done) : 4;
+            memcpy(buffer + done * 4, res, pages * 4);
+            err = ESP_OK;
+            break;
+        }
+    }
+
+    rc522_halt(rc522);
+    return err;
+}
+
+esp_err_t rc522_write_pages(rc522_handle_t rc522, uint8_t page, const uint8_t* data, uint8_t n_pages)
+{
+    if(! rc522 || ! data || n_pages == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(xTaskGetCurrentTaskHandle() != rc522->task_handle) {
+        ESP_LOGE(TAG, "Pages can only be accessed from event handler");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = rc522_select_tag(rc522);
+
+    // WRITE (0xA2) programs one page and is answered by a 4 bit ACK (0xA)
+    for(uint8_t i = 0; err == ESP_OK && i < n_pages; i++) {
+        uint8_t cmd[6] = { 0xA2, page + i };
+        memcpy(cmd + 2, data + i * 4, 4);
+
+        uint8_t res_n;
+        uint8_t ack[1];
+        if(! rc522_count(rc522, RC522_STAGE_WRITE,
+                         rc522_transceive_crc(rc522, cmd, sizeof(cmd), ack, sizeof(ack), &res_n) && (ack[0] & 0x0F) == 0x0A)) {
+            err = ESP_FAIL; // Not retried: a NAK may come after the page was already programmed
+        }
+    }
 
-    if(res_data != NULL) {
-        free(res_data);
+    rc522_halt(rc522);
+    return err;
+}
 
-        result = rc522_anticoll(rc522);
+/* Writes a pattern into the 64 byte FIFO and reads it back, byte by byte */
+static bool rc522_link_test(rc522_handle_t rc522, uint8_t rounds)
+{
+    uint8_t pattern[] = { 0x00, 0xFF, 0x55, 0xAA, 0x0F, 0xF0, 0x01, 0x80, 0x3C, 0xC3, 0x96, 0x69 };
+    const uint8_t n = sizeof(pattern);
+    bool ok = true;
 
-        if(result != NULL) {
-            uint8_t buf[] = { 0x50, 0x00, 0x00, 0x00 };
-            uint8_t* crc = rc522_calculate_crc(rc522, buf, 2);
-            buf[2] = crc[0];
-            buf[3] = crc[1];
-            free(crc);
-            res_data = rc522_card_write(rc522, 0x0C, buf, 4, &res_data_n);
-            free(res_data);
-            rc522_clear_bitmask(rc522, 0x08, 0x08);
+    for(uint8_t r = 0; ok && r < rounds; r++) {
+        rc522_write(rc522, 0x0A, 0x80); // FlushBuffer
+        rc522_write_n(rc522, 0x09, n, pattern);
 
-            return result;
+        if((rc522_read(rc522, 0x0A) & 0x7F) != n) {
+            ok = false;
+            break;
+        }
+        for(uint8_t i = 0; i < n; i++) {
+            if(rc522_read(rc522, 0x09) != pattern[i]) {
+                ok = false;
+                break;
+            }
+        }
+        // Next round uses the inverted pattern so every bit toggles on the wire
+        for(uint8_t i = 0; i < n; i++) {
+            pattern[i] = ~pattern[i];
         }
     }
 
-    return NULL;
+    rc522_write(rc522, 0x0A, 0x80);
+    return ok;
+}
+
+/* Finds the fastest clock that passes the FIFO pattern test, backing off one step as margin */
+static esp_err_t rc522_train_link(rc522_handle_t rc522)
+{
+    esp_err_t err;
+
+    for(uint8_t i = 0; i < RC522_SPI_CLOCKS_N; i++) {
+        if(ESP_OK != (err = rc522_spi_set_clock(rc522, i))) {
+            return err;
+        }
+        if(! rc522_link_test(rc522, RC522_LINK_TRAINING_ROUNDS)) {
+            continue;
+        }
+
+        // The chip maximum needs no margin; a clock that passed right after a failure does
+        if(i > 0 && i + 1 < RC522_SPI_CLOCKS_N) {
+            if(ESP_OK != (err = rc522_spi_set_clock(rc522, i + 1))) {
+                return err;
+            }
+        }
+
+        return ESP_OK;
+    }
+
+    return ESP_FAIL;
+}
+
+/* Runtime fallback: periodic link check, dropping one clock step when errors accumulate */
+static void rc522_check_link(rc522_handle_t rc522)
+{
+    if(! rc522->spi_clock_auto || ++rc522->link_check_counter < RC522_LINK_CHECK_INTERVAL) {
+        return;
+    }
+    rc522->link_check_counter = 0;
+    esp_err_t err;
+
+    if(! rc522->spi_handle) {
+        // A failed clock change left no device: add it back at the current clock
+        if(ESP_OK != (err = rc522_spi_add_device(rc522))) {
+            rc522->spi_handle = NULL;
+            ESP_LOGE(TAG, "SPI device still missing (err: 0x%x)", err);
+            return;
+        }
+        ESP_LOGW(TAG, "SPI device added back at %d Hz", rc522->config->spi.clock_speed_hz);
+    }
+
+    if(! rc522_link_test(rc522, 1)) {
+        rc522->link_errors++;
+    }
+
+    if(rc522->link_errors >= RC522_LINK_ERROR_THRESHOLD && rc522->spi_clock_index + 1 < RC522_SPI_CLOCKS_N) {
+        ESP_LOGW(TAG, "SPI link errors (%d), falling back to %d Hz",
+                 rc522->link_errors, rc522_spi_clocks[rc522->spi_clock_index + 1]);
+        if(ESP_OK != (err = rc522_spi_set_clock(rc522, rc522->spi_clock_index + 1))) {
+            ESP_LOGE(TAG, "SPI clock fallback failed (err: 0x%x), %s", err,
+                     rc522->spi_handle ? "staying at the old clock" : "device lost");
+        }
+    }
 }
 
 esp_err_t rc522_start(rc522_handle_t rc522)
@@ -442,6 +1139,15 @@ esp_err_t rc522_start(rc522_handle_t rc522)
         }
         // ------- End of RW test --------
 
+        if(rc522->spi_clock_auto) {
+            if((err = rc522_train_link(rc522)) != ESP_OK) {
+                ESP_LOGE(TAG, "SPI link training failed");
+                rc522_destroy(rc522);
+                return err;
+            }
+            ESP_LOGI(TAG, "SPI clock: %d Hz", rc522->config->spi.clock_speed_hz);
+        }
+
         rc522_write(rc522, 0x01, 0x0F);
         rc522_write(rc522, 0x2A, 0x8D);
         rc522_write(rc522, 0x2B, 0x3E);
@@ -461,6 +1167,17 @@ esp_err_t rc522_start(rc522_handle_t rc522)
     return ESP_OK;
 }
 
+esp_err_t rc522_get_stats(rc522_handle_t rc522, rc522_stats_t* out_stats)
+{
+    if(! rc522 || ! out_stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(out_stats, &rc522->stats, sizeof(rc522_stats_t));
+
+    return ESP_OK;
+}
+
 esp_err_t rc522_pause(rc522_handle_t rc522)
 {
     if(! rc522) {
@@ -474,11 +1191,24 @@ esp_err_t rc522_pause(rc522_handle_t rc522)
     return ESP_OK;
 }
 
+esp_err_t rc522_set_scan_interval(rc522_handle_t rc522, uint16_t scan_interval_ms)
+{
+    if(! rc522 || scan_interval_ms < 50) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rc522->config->scan_interval_ms = scan_interval_ms; // Picked up after the current delay
+
+    return ESP_OK;
+}
+
 static void rc522_destroy_transport(rc522_handle_t rc522)
 {
     switch(rc522->config->transport) {
         case RC522_TRANSPORT_SPI:
-            spi_bus_remove_device(rc522->spi_handle);
+            if(rc522->spi_handle) {
+                spi_bus_remove_device(rc522->spi_handle);
+            }
             if(rc522->bus_initialized_by_user) {
                 spi_bus_free(rc522->config->spi.host);
             }
@@ -510,6 +1240,13 @@ void rc522_destroy(rc522_handle_t rc522)
         esp_event_loop_delete(rc522->event_handle);
         rc522->event_handle = NULL;
     }
+    if(rc522->pm_lock) {
+        esp_pm_lock_delete(rc522->pm_lock);
+        rc522->pm_lock = NULL;
+    }
+    if(rc522->static_storage) {
+        return; // storage belongs to the caller
+    }
     free(rc522->config);
     rc522->config = NULL;
     free(rc522);
@@ -526,6 +1263,17 @@ static esp_err_t rc522_dispatch_event(rc522_handle_t rc522, rc522_event_t event,
         .rc522 = rc522,
         .ptr = data,
     };
+
+    if(rc522->static_storage) {
+        for(int i = 0; i < RC522_STATIC_EVENT_HANDLERS; i++) {
+            if(rc522->static_handlers[i].handler &&
+               (rc522->static_handlers[i].event == event || rc522->static_handlers[i].event == RC522_EVENT_ANY)) {
+                rc522->static_handlers[i].handler(rc522->static_handlers[i].arg, RC522_EVENTS, event, &e_data);
+            }
+        }
+        return ESP_OK;
+    }
+
     esp_err_t err;
     if(ESP_OK != (err = esp_event_post_to(rc522->event_handle, RC522_EVENTS, event, &e_data, sizeof(rc522_event_data_t), portMAX_DELAY))) {
         return err;
@@ -536,7 +1284,13 @@ static esp_err_t rc522_dispatch_event(rc522_handle_t rc522, rc522_event_t event,
 
 static esp_err_t rc522_spi_send(rc522_handle_t rc522, uint8_t* buffer, uint8_t length)
 {
+    if(! rc522->spi_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
     buffer[0] = (buffer[0] << 1) & 0x7E;
+    rc522->spi_bytes += length;
+    rc522->spi_transactions++;
 
     return spi_device_transmit(rc522->spi_handle, &(spi_transaction_t){
         .length = 8 * length,
@@ -546,7 +1300,13 @@ static esp_err_t rc522_spi_send(rc522_handle_t rc522, uint8_t* buffer, uint8_t l
 
 static esp_err_t rc522_spi_receive(rc522_handle_t rc522, uint8_t* buffer, uint8_t length, uint8_t addr)
 {
+    if(! rc522->spi_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
     addr = ((addr << 1) & 0x7E) | 0x80;
+    rc522->spi_bytes += length + 1;
+    rc522->spi_transactions += (SPI_DEVICE_HALFDUPLEX & rc522->config->spi.device_flags) ? 1 : 2;
 
     esp_err_t ret;
 
@@ -588,9 +1348,99 @@ static esp_err_t rc522_i2c_receive(rc522_handle_t rc522, uint8_t* buffer, uint8_
     return i2c_master_write_read_device(rc522->config->i2c.port, RC522_I2C_ADDRESS, &addr, 1, buffer, length, rc522->config->i2c.rw_timeout_ms / portTICK_PERIOD_MS);
 }
 
+/* Logs how much bus time the trained clock saves on a poll, compared to the default clock */
+static void rc522_report_poll_cost(rc522_handle_t rc522, uint32_t poll_bytes)
+{
+    int clock = rc522->config->spi.clock_speed_hz;
+    uint32_t bits = poll_bytes * 8;
+    uint32_t us_default = (uint64_t) bits * 1000000 / RC522_DEFAULT_SPI_CLOCK_SPEED_HZ;
+    uint32_t us_trained = (uint64_t) bits * 1000000 / clock;
+
+    ESP_LOGI(TAG, "Poll: %lu SPI bytes, %lu us on the wire at %d Hz (%ld us vs. %d Hz default)",
+             poll_bytes, us_trained, clock, (long) us_default - (long) us_trained, RC522_DEFAULT_SPI_CLOCK_SPEED_HZ);
+}
+
+/* Checks every tracked tag, firing RC522_EVENT_TAG_REMOVED after removal_misses misses in a row */
+static void rc522_update_presence(rc522_handle_t rc522, int64_t now_us)
+{
+    if(rc522->present_count == 0) {
+        return;
+    }
+
+    rc522_write(rc522, 0x2D, RC522_PRESENCE_TIMEOUT_TICKS); // A tag in the field answers in well under 1 ms
+
+    for(int i = 0; i < RC522_PRESENCE_MAX; i++) {
+        if(rc522->present[i].serial_number == 0) {
+            continue;
+        }
+
+        uint32_t transactions = rc522->spi_transactions;
+        if(rc522_check_presence(rc522, &rc522->present[i].uid)) {
+            if(! rc522->presence_cost_reported) {
+                ESP_LOGI(TAG, "Presence check: %lu SPI transactions (full poll that found the tag: %lu)",
+                         rc522->spi_transactions - transactions, rc522->scan_transactions);
+                rc522->presence_cost_reported = true;
+            }
+            rc522->present[i].misses = 0;
+            rc522->present[i].last_seen_us = now_us;
+            continue;
+        }
+
+        if(++rc522->present[i].misses < rc522->config->removal_misses) {
+            continue;
+        }
+
+        rc522_tag_t tag = {
+            .serial_number = rc522->present[i].serial_number,
+            .poll_start_us = now_us,
+            .dwell_us = rc522->present[i].last_seen_us - rc522->present[i].arrived_us,
+        };
+        tag.uid_len = rc522_uid_bytes(&rc522->present[i].uid, tag.uid);
+        rc522->present[i].serial_number = 0;
+        rc522->present_count--;
+        rc522_dispatch_event(rc522, RC522_EVENT_TAG_REMOVED, &tag);
+    }
+
+    rc522_write(rc522, 0x2D, 0x1E);
+}
+
+/* Starts tracking a tag found by rc522_get_tag. Returns false if it was already tracked */
+static bool rc522_track_tag(rc522_handle_t rc522, const rc522_uid_t* uid, int64_t now_us)
+{
+    uint64_t serial_number = rc522_uid_to_u64(uid);
+    int free_slot = -1;
+
+    for(int i = 0; i < RC522_PRESENCE_MAX; i++) {
+        if(rc522->present[i].serial_number == serial_number) {
+            // Fell out of HALT (a field glitch) and answered REQA again: still the same visit
+            rc522->present[i].misses = 0;
+            rc522->present[i].last_seen_us = now_us;
+            return false;
+        }
+        if(rc522->present[i].serial_number == 0 && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    if(free_slot < 0) {
+        rc522_log(rc522, ESP_LOG_WARN, "Presence table full, tag %08lX%08lX is not tracked",
+                  (uint32_t) (serial_number >> 32), (uint32_t) serial_number, 0, 0);
+        return true;
+    }
+
+    rc522->present[free_slot].serial_number = serial_number;
+    rc522->present[free_slot].uid = *uid;
+    rc522->present[free_slot].misses = 0;
+    rc522->present[free_slot].arrived_us = now_us;
+    rc522->present[free_slot].last_seen_us = now_us;
+    rc522->present_count++;
+    return true;
+}
+
 static void rc522_task(void* arg)
 {
     rc522_handle_t rc522 = (rc522_handle_t) arg;
+    bool poll_cost_reported = false;
 
     while(rc522->running) {
         if(! rc522->scanning) {
@@ -599,26 +1449,68 @@ static void rc522_task(void* arg)
             continue;
         }
 
-        uint8_t* serial_no_array = rc522_get_tag(rc522);
-        
-        if(! serial_no_array) {
-            rc522->tag_was_present_last_time = false;
-        } else if(! rc522->tag_was_present_last_time) {
-            rc522_tag_t tag = {
-                .serial_number = rc522_sn_to_u64(serial_no_array),
-            };
-            free(serial_no_array);
-            rc522_dispatch_event(rc522, RC522_EVENT_TAG_SCANNED, &tag);
-            rc522->tag_was_present_last_time = true;
+        int64_t poll_start_us = esp_timer_get_time();
+        int64_t wake_late_us = rc522->next_poll_us ? poll_start_us - rc522->next_poll_us : 0;
+        if(wake_late_us > 0) {
+            // A slow handler or a starved task shows up here as a late poll
+            rc522->stats.poll_late_sum_us += wake_late_us;
+            if(wake_late_us > rc522->stats.poll_late_max_us) {
+                rc522->stats.poll_late_max_us = (uint32_t) wake_late_us;
+            }
+        }
+        rc522->stats.polls++;
+        if(rc522->pm_lock) {
+            esp_pm_lock_acquire(rc522->pm_lock);
+        }
+
+        rc522_update_presence(rc522, poll_start_us);
+
+        // Tracked tags sit in HALT, so REQA only finds the ones that just arrived. Each tag found
+        // is halted too: a tray comes out one tag per REQA, all within this poll
+        uint32_t bytes_before = rc522->spi_bytes;
+        uint32_t transactions_before = rc522->spi_transactions;
+        rc522_uid_t uid;
+        uint8_t found = 0;
+
+        while(found < RC522_POLL_TAGS_MAX && rc522_get_tag(rc522, &uid)) {
+            found++;
+            if(rc522_track_tag(rc522, &uid, poll_start_us)) {
+                rc522->scan_transactions = rc522->spi_transactions - transactions_before;
+                rc522->scanned = uid;
+                rc522_tag_t tag = {
+                    .serial_number = rc522_uid_to_u64(&uid),
+                    .poll_start_us = poll_start_us,
+                    .wake_late_us = wake_late_us > 0 ? (uint32_t) wake_late_us : 0, // Tick rounding can wake it early
+                };
+                tag.uid_len = rc522_uid_bytes(&uid, tag.uid);
+                rc522_dispatch_event(rc522, RC522_EVENT_TAG_SCANNED, &tag);
+            }
+            transactions_before = rc522->spi_transactions;
+        }
+        bool tag_present = found > 0;
+
+        if(! tag_present && ! poll_cost_reported && rc522->config->transport == RC522_TRANSPORT_SPI) {
+            rc522_report_poll_cost(rc522, rc522->spi_bytes - bytes_before);
+            poll_cost_reported = true;
+        }
+
+        if(! tag_present) {
+            rc522_check_link(rc522);
+        }
+
+        if(rc522->pm_lock) {
+            esp_pm_lock_release(rc522->pm_lock);
         }
 
         int delay_interval_ms = rc522->config->scan_interval_ms;
 
-        if(rc522->tag_was_present_last_time) {
-            delay_interval_ms *= 2; // extra scan-bursting prevention
+        if(rc522->present_count > 0) {
+            delay_interval_ms *= 2; // extra scan-bursting prevention; also spaces out the presence checks
         }
 
-        vTaskDelay(delay_interval_ms / portTICK_PERIOD_MS);
+        TickType_t delay_ticks = delay_interval_ms / portTICK_PERIOD_MS;
+        rc522->next_poll_us = esp_timer_get_time() + (int64_t) delay_ticks * portTICK_PERIOD_MS * 1000;
+        vTaskDelay(delay_ticks);
     }
 
     vTaskDelete(NULL);
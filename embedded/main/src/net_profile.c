@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "lwip/sockets.h"
+#include "net_profile.h"
+
+static const char *TAG_NET = "net_profile";
+
+static net_profile_t current_profile = NET_PROFILE_DEFAULT;
+static esp_transport_handle_t mqtt_transport = NULL;
+
+// Estado do benchmark (um por vez)
+static uint32_t bench_rtt_us[NET_BENCH_PINGS];
+static TaskHandle_t bench_task_handle = NULL;
+static esp_mqtt_client_handle_t bench_client = NULL;
+static const char* bench_topic = NULL;
+static volatile int32_t bench_waiting_seq = -1;
+
+static void apply_nodelay(void) {
+    if (!mqtt_transport) {
+        return;
+    }
+    int sock = esp_transport_get_socket(mqtt_transport);
+    if (sock < 0) {
+        return;
+    }
+    int nodelay = (current_profile == NET_PROFILE_LATENCIA) ? 1 : 0;
+    if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) != 0) {
+        ESP_LOGW(TAG_NET, "Falha ao ajustar TCP_NODELAY no socket %d", sock);
+    }
+}
+
+esp_err_t net_profile_apply(net_profile_t profile) {
+    wifi_ps_type_t ps = (profile == NET_PROFILE_LATENCIA) ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM;
+    esp_err_t err = esp_wifi_set_ps(ps);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_NET, "Falha ao ajustar power save: %s", esp_err_to_name(err));
+        return err;
+    }
+    current_profile = profile;
+    apply_nodelay();
+    ESP_LOGI(TAG_NET, "Perfil de rede: %s", profile == NET_PROFILE_LATENCIA ? "latencia" : "economia");
+    return ESP_OK;
+}
+
+void net_profile_wifi_init_config(wifi_init_config_t* cfg) {
+    if (NET_PROFILE_DEFAULT == NET_PROFILE_LATENCIA && cfg->static_rx_buf_num < NET_LATENCIA_STATIC_RX_BUF) {
+        cfg->static_rx_buf_num = NET_LATENCIA_STATIC_RX_BUF;
+    }
+}
+
+net_profile_t net_profile_get(void) {
+    return current_profile;
+}
+
+void net_profile_on_mqtt_connected(esp_transport_handle_t transport) {
+    mqtt_transport = transport;
+    apply_nodelay();
+}
+
+void net_profile_bench_on_pong(const char* data, int data_len) {
+    TaskHandle_t task = bench_task_handle;
+    if (!task) {
+        return;
+    }
+    // Resposta é o próprio payload do ping ecoado: {"seq":N}
+    char buf[24];
+    int len = data_len < (int) sizeof(buf) - 1 ? data_len : (int) sizeof(buf) - 1;
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+    const char* seq_str = strstr(buf, "\"seq\":");
+    if (seq_str && atol(seq_str + 6) == bench_waiting_seq) {
+        xTaskNotifyGive(task);
+    }
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+static void bench_task(void* arg) {
+    char payload[24];
+    int received = 0;
+
+    ESP_LOGI(TAG_NET, "Benchmark: %d pings em '%s'", NET_BENCH_PINGS, bench_topic);
+    for (int32_t seq = 0; seq < NET_BENCH_PINGS; seq++) {
+        snprintf(payload, sizeof(payload), "{\"seq\":%ld}", seq);
+        ulTaskNotifyTake(pdTRUE, 0); // Descarta respostas atrasadas do ping anterior
+        bench_waiting_seq = seq;
+
+        int64_t start = esp_timer_get_time();
+        esp_mqtt_client_publish(bench_client, bench_topic, payload, 0, 0, 0);
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NET_BENCH_TIMEOUT_MS)) > 0) {
+            bench_rtt_us[received++] = (uint32_t) (esp_timer_get_time() - start);
+        }
+    }
+    bench_waiting_seq = -1;
+
+    if (received > 0) {
+        qsort(bench_rtt_us, received, sizeof(bench_rtt_us[0]), compare_u32);
+        uint64_t sum = 0;
+        for (int i = 0; i < received; i++) {
+            sum += bench_rtt_us[i];
+        }
+        ESP_LOGI(TAG_NET, "RTT (%s, %d/%d respostas) min=%lu p50=%lu p90=%lu p99=%lu max=%lu media=%llu us",
+                 current_profile == NET_PROFILE_LATENCIA ? "latencia" : "economia",
+                 received, NET_BENCH_PINGS,
+                 bench_rtt_us[0],
+                 bench_rtt_us[received * 50 / 100],
+                 bench_rtt_us[received * 90 / 100],
+                 bench_rtt_us[received * 99 / 100],
+                 bench_rtt_us[received - 1],
+                 sum / received);
+    } else {
+        ESP_LOGW(TAG_NET, "Benchmark sem respostas; o receptor está ouvindo '%s'?", bench_topic);
+    }
+
+    bench_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t net_profile_bench_start(esp_mqtt_client_handle_t client, const char* ping_topic) {
+    if (!client || !ping_topic) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (bench_task_handle) {
+        return ESP_ERR_INVALID_STATE; // Já em andamento
+    }
+    bench_client = client;
+    bench_topic = ping_topic;
+    if (xTaskCreatePinnedToCore(bench_task, "net_bench", NET_BENCH_TASK_STACK_SIZE, NULL,
+                                NET_BENCH_TASK_PRIORITY, &bench_task_handle, NET_BENCH_TASK_CORE) != pdTRUE) {
+        bench_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
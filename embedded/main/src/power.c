@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "net_profile.h"
+#include "power.h"
+
+static const char *TAG_POWER = "power";
+
+static const power_profile_config_t profiles[] = {
+    [POWER_PROFILE_DESEMPENHO] = { "desempenho", 160, 160, false, 125 },
+    [POWER_PROFILE_EQUILIBRIO] = { "equilibrio", 160, 80, true, 125 },
+    [POWER_PROFILE_BATERIA]    = { "bateria", 160, 40, true, 250 },
+};
+
+static const struct {
+    const char* name;
+    esp_pm_lock_type_t type;
+} lock_types[POWER_LOCK_COUNT] = {
+    [POWER_LOCK_LCD] = { "lcd", ESP_PM_APB_FREQ_MAX },
+    [POWER_LOCK_MQTT] = { "mqtt", ESP_PM_CPU_FREQ_MAX },
+};
+
+typedef struct {
+    esp_pm_lock_handle_t handle;
+    uint32_t depth;
+    uint32_t acquired;          // Vezes que a trava passou de solta para presa
+    int64_t held_since_us;
+    int64_t held_total_us;
+} power_lock_state_t;
+
+static power_profile_t current_profile = POWER_PROFILE_DEFAULT;
+static power_lock_state_t locks[POWER_LOCK_COUNT];
+static portMUX_TYPE power_lock_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t stats_since_us = 0;
+
+// Latência toque->evento, só a parte que a gerência de energia afeta
+static uint32_t tap_count = 0;
+static uint64_t tap_wake_late_sum_us = 0;
+static uint32_t tap_wake_late_max_us = 0;
+static uint64_t tap_poll_to_event_sum_us = 0;
+static uint32_t tap_poll_to_event_max_us = 0;
+
+esp_err_t power_init(void) {
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        esp_err_t err = esp_pm_lock_create(lock_types[i].type, 0, lock_types[i].name, &locks[i].handle);
+        if (err != ESP_OK) {
+            // Sem CONFIG_PM_ENABLE: as travas viram contadores e o clock fica fixo
+            ESP_LOGW(TAG_POWER, "Trava '%s' indisponível: %s", lock_types[i].name, esp_err_to_name(err));
+            locks[i].handle = NULL;
+        }
+    }
+    stats_since_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+esp_err_t power_apply(power_profile_t profile) {
+    const power_profile_config_t* cfg = &profiles[profile];
+    // Com o rádio sempre ligado (WIFI_PS_NONE) o Wi-Fi segura uma trava e o chip nunca dorme:
+    // light sleep leva o rádio para modem-sleep antes; sem light sleep, o perfil de rede escolhido fica
+    if (cfg->light_sleep && net_profile_get() == NET_PROFILE_LATENCIA) {
+        ESP_LOGW(TAG_POWER, "Perfil %s usa light sleep: rede sai de latencia para economia", cfg->name);
+        net_profile_apply(NET_PROFILE_ECONOMIA);
+    }
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = cfg->max_freq_mhz,
+        .min_freq_mhz = cfg->min_freq_mhz,
+        .light_sleep_enable = cfg->light_sleep,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_POWER, "Falha ao configurar esp_pm: %s", esp_err_to_name(err));
+        return err;
+    }
+    current_profile = profile;
+    ESP_LOGI(TAG_POWER, "Perfil de energia: %s (%d-%d MHz, light sleep %s, varredura %u ms)", cfg->name,
+             cfg->min_freq_mhz, cfg->max_freq_mhz, cfg->light_sleep ? "ligado" : "desligado",
+             cfg->scan_interval_ms);
+    return ESP_OK;
+}
+
+esp_err_t power_set_net_profile(net_profile_t profile) {
+    const power_profile_config_t* cfg = &profiles[current_profile];
+    if (profile == NET_PROFILE_LATENCIA && cfg->light_sleep) {
+        ESP_LOGW(TAG_POWER, "Rede em latencia recusada: o perfil %s usa light sleep, que o rádio sempre "
+                 "ligado anularia (troque antes para desempenho)", cfg->name);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return net_profile_apply(profile);
+}
+
+power_profile_t power_get(void) {
+    return current_profile;
+}
+
+const power_profile_config_t* power_get_config(void) {
+    return &profiles[current_profile];
+}
+
+void power_lock(power_lock_t lock) {
+    power_lock_state_t* state = &locks[lock];
+    if (state->handle) {
+        esp_pm_lock_acquire(state->handle);
+    }
+    taskENTER_CRITICAL(&power_lock_mux);
+    if (state->depth++ == 0) {
+        state->held_since_us = esp_timer_get_time();
+        state->acquired++;
+    }
+    taskEXIT_CRITICAL(&power_lock_mux);
+}
+
+void power_unlock(power_lock_t lock) {
+    power_lock_state_t* state = &locks[lock];
+    taskENTER_CRITICAL(&power_lock_mux);
+    if (state->depth > 0 && --state->depth == 0) {
+        state->held_total_us += esp_timer_get_time() - state->held_since_us;
+    }
+    taskEXIT_CRITICAL(&power_lock_mux);
+    if (state->handle) {
+        esp_pm_lock_release(state->handle);
+    }
+}
+
+void power_record_tap(uint32_t wake_late_us, uint32_t poll_to_event_us) {
+    // Só a tarefa do RC522 chama
+    tap_count++;
+    tap_wake_late_sum_us += wake_late_us;
+    tap_poll_to_event_sum_us += poll_to_event_us;
+    if (wake_late_us > tap_wake_late_max_us) {
+        tap_wake_late_max_us = wake_late_us;
+    }
+    if (poll_to_event_us > tap_poll_to_event_max_us) {
+        tap_poll_to_event_max_us = poll_to_event_us;
+    }
+}
+
+void power_report(void) {
+    const power_profile_config_t* cfg = power_get_config();
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - stats_since_us;
+
+    ESP_LOGI(TAG_POWER, "Energia: perfil %s, %lld s de medição", cfg->name, elapsed / 1000000);
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        taskENTER_CRITICAL(&power_lock_mux);
+        int64_t held = locks[i].held_total_us + (locks[i].depth ? now - locks[i].held_since_us : 0);
+        uint32_t acquired = locks[i].acquired;
+        taskEXIT_CRITICAL(&power_lock_mux);
+        uint32_t basis_points = elapsed > 0 ? (uint32_t) (held * 10000 / elapsed) : 0;
+        ESP_LOGI(TAG_POWER, "  trava %-5s presa %3lu.%02lu%% do tempo (%lu vezes)", lock_types[i].name,
+                 (unsigned long) (basis_points / 100), (unsigned long) (basis_points % 100),
+                 (unsigned long) acquired);
+    }
+
+    if (tap_count > 0) {
+        uint32_t wake_avg = tap_wake_late_sum_us / tap_count;
+        uint32_t event_avg = tap_poll_to_event_sum_us / tap_count;
+        // O toque cai em qualquer ponto do intervalo: espera média de meio intervalo até a varredura
+        ESP_LOGI(TAG_POWER, "  toque->evento (%lu leituras): atraso ao acordar %lu us (max %lu), "
+                 "varredura->handler %lu us (max %lu)", (unsigned long) tap_count,
+                 (unsigned long) wake_avg, (unsigned long) tap_wake_late_max_us,
+                 (unsigned long) event_avg, (unsigned long) tap_poll_to_event_max_us);
+        ESP_LOGI(TAG_POWER, "  estimado: média %lu ms, pior %lu ms",
+                 (unsigned long) ((cfg->scan_interval_ms * 1000 / 2 + wake_avg + event_avg) / 1000),
+                 (unsigned long) ((cfg->scan_interval_ms * 1000 + tap_wake_late_max_us +
+                                   tap_poll_to_event_max_us) / 1000));
+    }
+#if CONFIG_PM_PROFILING
+    // Tempo em cada modo (SLEEP, APB_MIN, APB_MAX, CPU_MAX) e por trava, incluindo as do IDF
+    esp_pm_dump_locks(stdout);
+#else
+    ESP_LOGI(TAG_POWER, "  tempo em light sleep: indisponível sem CONFIG_PM_PROFILING");
+#endif
+}
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "dlog.h"
+#include "power.h"
+#include "scan_outbox.h"
+#include "static_mem.h"
+
+static const char *TAG_OUTBOX = "scan_outbox";
+
+// Pool fixo: nenhuma alocação por mensagem no caminho da leitura
+static scan_record_t ring[SCAN_OUTBOX_CAPACITY];
+static uint16_t ring_head = 0;   // Próxima leitura a ser enviada
+static uint16_t ring_count = 0;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static scan_outbox_policy_t outbox_policy;
+static const char* outbox_topics[SCAN_KIND_AUDIT + 1]; // Base do tópico por tipo de leitura
+static const char* outbox_reader_id;
+static scan_outbox_stats_t outbox_stats;
+static esp_mqtt_client_handle_t outbox_client = NULL;
+static uint32_t outbox_boot_id;
+static uint32_t next_seq = 0;
+static TaskHandle_t sender_task_handle = NULL;
+static scan_outbox_drop_hook_t drop_hook = NULL;
+static char batch_payload[SCAN_OUTBOX_BATCH_PAYLOAD_MAX]; // Só a tarefa de envio usa; grande demais para a pilha
+STATIC_TASK_STORAGE(sender_task, SCAN_OUTBOX_TASK_STACK_SIZE);
+
+static inline uint16_t ring_index(uint16_t offset) {
+    return (ring_head + offset) % SCAN_OUTBOX_CAPACITY;
+}
+
+bool scan_outbox_push(uint64_t uid, int64_t timestamp_us, scan_kind_t kind) {
+    bool accepted = true;
+    bool evicted = false;
+    scan_record_t dropped;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (outbox_policy == SCAN_OUTBOX_COALESCE_UID) {
+        for (uint16_t i = 0; i < ring_count; i++) {
+            if (ring[ring_index(i)].uid == uid) {
+                outbox_stats.coalesced++;
+                accepted = false;
+                break;
+            }
+        }
+    }
+
+    if (accepted && ring_count == SCAN_OUTBOX_CAPACITY) {
+        outbox_stats.dropped++;
+        evicted = true;
+        if (outbox_policy == SCAN_OUTBOX_DROP_NEWEST) {
+            accepted = false;
+            dropped = (scan_record_t) { .uid = uid, .timestamp_us = timestamp_us, .kind = kind };
+        } else {
+            dropped = ring[ring_head];
+            ring_head = ring_index(1);
+            ring_count--;
+        }
+    }
+
+    if (accepted) {
+        ring[ring_index(ring_count)] = (scan_record_t) {
+            .uid = uid, .timestamp_us = timestamp_us, .seq = ++next_seq, .kind = kind,
+        };
+        ring_count++;
+        outbox_stats.enqueued++;
+        if (ring_count > outbox_stats.high_watermark) {
+            outbox_stats.high_watermark = ring_count;
+        }
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (evicted && drop_hook) {
+        drop_hook(&dropped);
+    }
+    if (accepted && sender_task_handle) {
+        xTaskNotifyGive(sender_task_handle);
+    }
+    return accepted;
+}
+
+void scan_outbox_set_drop_hook(scan_outbox_drop_hook_t hook) {
+    drop_hook = hook;
+}
+
+/* Copia da cabeça até max leituras seguidas do mesmo tipo. Retorna quantas. */
+static uint16_t ring_peek(scan_record_t* out, uint16_t max) {
+    uint16_t n = 0;
+    taskENTER_CRITICAL(&ring_lock);
+    while (n < ring_count && n < max && (n == 0 || ring[ring_index(n)].kind == out[0].kind)) {
+        out[n] = ring[ring_index(n)];
+        n++;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    return n;
+}
+
+/*
+ * Tira da cabeça as leituras enviadas que ainda estão lá. Uma leitura descartada (DROP_OLDEST)
+ * enquanto o publish estava em andamento já entrou em dropped e não conta de novo:
+ * enqueued = published + dropped + pendentes.
+ */
+static void ring_pop_if(const scan_record_t* sent, uint16_t n) {
+    uint16_t popped = 0;
+    taskENTER_CRITICAL(&ring_lock);
+    for (uint16_t i = 0; i < n; i++) {
+        if (ring_count > 0 && ring[ring_head].uid == sent[i].uid &&
+            ring[ring_head].seq == sent[i].seq) {
+            ring_head = ring_index(1);
+            ring_count--;
+            popped++;
+        }
+    }
+    outbox_stats.published += popped;
+    if (n > 1) {
+        outbox_stats.batches++;
+        outbox_stats.batched += popped;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+}
+
+// Espera por leitura nova antes de fechar o lote, pelo tipo da mais antiga na fila
+static const uint32_t batch_gap_ms[] = {
+    [SCAN_KIND_TOGGLE] = SCAN_OUTBOX_TOGGLE_GAP_MS,
+    [SCAN_KIND_ENROLL] = SCAN_OUTBOX_BATCH_GAP_MS,
+    [SCAN_KIND_AUDIT] = SCAN_OUTBOX_BATCH_GAP_MS,
+};
+
+/*
+ * Espera o lote fechar: o GAP do tipo sem leitura nova, a mais antiga esperando há
+ * SCAN_OUTBOX_BATCH_AGE_MS ou o lote cheio. Cada push acorda a espera para recontar.
+ */
+static void wait_batch(void) {
+    while (SCAN_OUTBOX_BATCH_GAP_MS > 0) {
+        int64_t now = esp_timer_get_time();
+        taskENTER_CRITICAL(&ring_lock);
+        uint16_t count = ring_count;
+        int64_t oldest_us = count ? ring[ring_head].timestamp_us : now;
+        int64_t newest_us = count ? ring[ring_index(count - 1)].timestamp_us : now;
+        uint32_t gap_ms = count ? batch_gap_ms[ring[ring_head].kind] : 0;
+        taskEXIT_CRITICAL(&ring_lock);
+
+        if (gap_ms == 0) {
+            return;
+        }
+        int64_t left_us = newest_us + gap_ms * 1000LL - now;
+        if (oldest_us + SCAN_OUTBOX_BATCH_AGE_MS * 1000LL - now < left_us) {
+            left_us = oldest_us + SCAN_OUTBOX_BATCH_AGE_MS * 1000LL - now;
+        }
+        if (count == 0 || count >= SCAN_OUTBOX_BATCH_MAX || left_us <= 0) {
+            return;
+        }
+        TickType_t ticks = pdMS_TO_TICKS(left_us / 1000);
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    }
+}
+
+// Hash de Fibonacci da UID (dobrada em 32 bits): os bits altos do produto, que misturam todos
+// os bits da UID. receptor.py não precisa repetir a conta, só assinar os tópicos
+static uint32_t uid_partition(uint64_t uid) {
+    return ((uint32_t) (uid ^ (uid >> 32)) * 2654435761u) >> (32 - SCAN_OUTBOX_PARTITION_BITS);
+}
+
+// Campo extra do payload; leituras normais não levam nenhum (compatível com receptores antigos)
+static const char* const kind_suffix[] = {
+    [SCAN_KIND_TOGGLE] = "",
+    [SCAN_KIND_ENROLL] = ",\"cadastro\":1",
+    [SCAN_KIND_AUDIT] = ",\"auditoria\":1",
+};
+
+/* {"leitorId","boot",<tipo>,"lote":[{"uid","seq","t"}...]}; t em ms desde o boot do leitor */
+static bool format_batch(const scan_record_t* records, uint16_t n) {
+    int len = snprintf(batch_payload, sizeof(batch_payload), "{\"leitorId\":\"%s\",\"boot\":\"%08lX\"%s,\"lote\":[",
+                       outbox_reader_id, outbox_boot_id, kind_suffix[records[0].kind]);
+    for (uint16_t i = 0; i < n && len < (int) sizeof(batch_payload); i++) {
+        len += snprintf(batch_payload + len, sizeof(batch_payload) - len, "%s{\"uid\":\"%llX\",\"seq\":%lu,\"t\":%lld}",
+                        i ? "," : "", records[i].uid, records[i].seq, records[i].timestamp_us / 1000);
+    }
+    if (len < (int) sizeof(batch_payload)) {
+        len += snprintf(batch_payload + len, sizeof(batch_payload) - len, "]}");
+    }
+    return len < (int) sizeof(batch_payload);
+}
+
+static void scan_outbox_task(void* arg) {
+    char payload[SCAN_OUTBOX_PAYLOAD_MAX];
+    char topic[SCAN_OUTBOX_TOPIC_MAX];
+    scan_record_t records[SCAN_OUTBOX_BATCH_MAX];
+    uint16_t n;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Enquanto o lote junta leituras o chip pode dormir
+        wait_batch();
+        power_lock(POWER_LOCK_MQTT);
+        while ((n = ring_peek(records, SCAN_OUTBOX_BATCH_GAP_MS > 0 ? SCAN_OUTBOX_BATCH_MAX : 1)) > 0) {
+            esp_mqtt_client_handle_t client = outbox_client;
+            if (client == NULL) {
+                break; // Aguarda scan_outbox_set_client()
+            }
+
+            const char* data = payload;
+            if (n > 1 && format_batch(records, n)) {
+                data = batch_payload;
+                snprintf(topic, sizeof(topic), "%s" SCAN_OUTBOX_BATCH_SUFFIX, outbox_topics[records[0].kind]);
+            } else {
+                n = 1;
+                snprintf(payload, sizeof(payload),
+                         "{\"uid\":\"%llX\",\"leitorId\":\"%s\",\"boot\":\"%08lX\",\"seq\":%lu%s}",
+                         records[0].uid, outbox_reader_id, outbox_boot_id, records[0].seq,
+                         kind_suffix[records[0].kind]);
+                snprintf(topic, sizeof(topic), "%s/p/%lu", outbox_topics[records[0].kind],
+                         uid_partition(records[0].uid));
+            }
+
+            // Bloqueia apenas esta tarefa; o leitor continua varrendo
+            if (esp_mqtt_client_publish(client, topic, data, 0, 1, 0) < 0) {
+                taskENTER_CRITICAL(&ring_lock);
+                outbox_stats.publish_failures++;
+                taskEXIT_CRITICAL(&ring_lock);
+                power_unlock(POWER_LOCK_MQTT); // Esperando o broker o chip pode dormir
+                vTaskDelay(pdMS_TO_TICKS(SCAN_OUTBOX_RETRY_DELAY_MS));
+                power_lock(POWER_LOCK_MQTT);
+                continue;
+            }
+            if (n > 1) {
+                uint32_t wait_ms = (uint32_t) ((esp_timer_get_time() - records[0].timestamp_us) / 1000);
+                DLOG(ESP_LOG_DEBUG, TAG_OUTBOX, "Lote de %lu leituras, primeira esperou %lu ms", n, wait_ms, 0, 0);
+                taskENTER_CRITICAL(&ring_lock);
+                if (wait_ms > outbox_stats.batch_wait_max_ms) {
+                    outbox_stats.batch_wait_max_ms = wait_ms;
+                }
+                taskEXIT_CRITICAL(&ring_lock);
+            }
+            ring_pop_if(records, n);
+        }
+        power_unlock(POWER_LOCK_MQTT);
+    }
+}
+
+esp_err_t scan_outbox_init(scan_outbox_policy_t policy, const char* topic, const char* bulk_topic,
+                           const char* reader_id) {
+    if (!topic || !bulk_topic || !reader_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sender_task_handle) {
+        return ESP_OK;
+    }
+
+    outbox_policy = policy;
+    outbox_topics[SCAN_KIND_TOGGLE] = topic;
+    outbox_topics[SCAN_KIND_ENROLL] = bulk_topic;
+    outbox_topics[SCAN_KIND_AUDIT] = bulk_topic;
+    outbox_reader_id = reader_id;
+    outbox_boot_id = esp_random();
+
+    static_mem_account("scan_outbox", sizeof(ring) + sizeof(batch_payload));
+    if (static_mem_task_create(scan_outbox_task, "scan_outbox", SCAN_OUTBOX_TASK_STACK_SIZE,
+                               NULL, SCAN_OUTBOX_TASK_PRIORITY, &sender_task_handle,
+                               SCAN_OUTBOX_TASK_CORE, STATIC_TASK_BUFFERS(sender_task)) != ESP_OK) {
+        ESP_LOGE(TAG_OUTBOX, "Falha ao criar tarefa de envio");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void scan_outbox_set_client(esp_mqtt_client_handle_t client) {
+    outbox_client = client;
+    if (sender_task_handle) {
+        xTaskNotifyGive(sender_task_handle); // Drena o que acumulou antes do cliente existir
+    }
+}
+
+void scan_outbox_get_stats(scan_outbox_stats_t* out_stats) {
+    taskENTER_CRITICAL(&ring_lock);
+    *out_stats = outbox_stats;
+    taskEXIT_CRITICAL(&ring_lock);
+}
@@ -0,0 +1,136 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "static_mem.h"
+
+static const char *TAG_MEM = "static_mem";
+
+typedef struct {
+    const char* what;
+    size_t bytes;
+} static_mem_entry_t;
+
+static static_mem_entry_t entries[STATIC_MEM_REPORT_MAX];
+static uint8_t entry_count = 0;
+static size_t total_bytes = 0;
+static uint32_t heap_baseline = 0;
+
+#if STATIC_MEM_ENABLED
+// Alinhada a 8: os nós do cJSON têm double
+static uint8_t arena[STATIC_MEM_ARENA_SIZE] __attribute__((aligned(8)));
+static size_t arena_used = 0;
+static size_t arena_peak = 0;
+static uint32_t arena_exhausted = 0;
+static volatile TaskHandle_t arena_owner = NULL; // Tarefa dentro de begin/end; NULL = arena fechada
+
+static void* arena_malloc(size_t size) {
+    if (arena_owner == NULL || xTaskGetCurrentTaskHandle() != arena_owner) {
+        return malloc(size); // Outra tarefa, ou fora do escopo: heap, como sem os hooks
+    }
+    size_t aligned = (size + 7) & ~(size_t) 7;
+    if (arena_used + aligned > sizeof(arena)) {
+        arena_exhausted++;
+        return NULL; // cJSON trata como falha de parse
+    }
+    void* ptr = &arena[arena_used];
+    arena_used += aligned;
+    if (arena_used > arena_peak) {
+        arena_peak = arena_used;
+    }
+    return ptr;
+}
+
+static void arena_free(void* ptr) {
+    // Da arena não há o que liberar: ela inteira é descartada no próximo begin
+    if ((uint8_t*) ptr < arena || (uint8_t*) ptr >= arena + sizeof(arena)) {
+        free(ptr);
+    }
+}
+#endif
+
+esp_err_t static_mem_task_create(TaskFunction_t fn, const char* name, uint32_t stack_size, void* arg,
+                                 UBaseType_t priority, TaskHandle_t* out_handle, BaseType_t core,
+                                 StackType_t* stack, StaticTask_t* tcb) {
+    TaskHandle_t handle = NULL;
+
+    if (stack && tcb) {
+        handle = xTaskCreateStaticPinnedToCore(fn, name, stack_size, arg, priority, stack, tcb, core);
+        static_mem_account(name, stack_size + sizeof(StaticTask_t));
+    } else if (xTaskCreatePinnedToCore(fn, name, stack_size, arg, priority, &handle, core) != pdTRUE) {
+        handle = NULL;
+    }
+
+    if (out_handle) {
+        *out_handle = handle;
+    }
+    return handle ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void static_mem_account(const char* what, size_t bytes) {
+    if (entry_count < STATIC_MEM_REPORT_MAX) {
+        entries[entry_count++] = (static_mem_entry_t) { .what = what, .bytes = bytes };
+    }
+    total_bytes += bytes;
+}
+
+void static_mem_report(void) {
+    ESP_LOGI(TAG_MEM, "Memória estática (%s):", STATIC_MEM_ENABLED ? "modo estático" : "modo heap");
+    for (uint8_t i = 0; i < entry_count; i++) {
+        ESP_LOGI(TAG_MEM, "  %-16s %6u bytes", entries[i].what, (unsigned) entries[i].bytes);
+    }
+    ESP_LOGI(TAG_MEM, "  total            %6u bytes | heap livre=%lu mínimo=%lu",
+             (unsigned) total_bytes, (unsigned long) esp_get_free_heap_size(),
+             (unsigned long) esp_get_minimum_free_heap_size());
+}
+
+void static_mem_arena_install(void) {
+#if STATIC_MEM_ENABLED
+    cJSON_Hooks hooks = {
+        .malloc_fn = arena_malloc,
+        .free_fn = arena_free,
+    };
+    cJSON_InitHooks(&hooks);
+    static_mem_account("cjson_arena", sizeof(arena));
+#endif
+}
+
+void static_mem_arena_begin(void) {
+#if STATIC_MEM_ENABLED
+    arena_used = 0;
+    arena_owner = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+void static_mem_arena_end(void) {
+#if STATIC_MEM_ENABLED
+    arena_owner = NULL;
+#endif
+}
+
+bool static_mem_heap_check(void) {
+    if (esp_timer_get_time() < (int64_t) STATIC_MEM_WARMUP_S * 1000000) {
+        return true;
+    }
+
+    uint32_t free_now = esp_get_free_heap_size();
+    if (heap_baseline == 0) {
+        heap_baseline = free_now;
+        ESP_LOGI(TAG_MEM, "Aquecimento concluído: heap livre de referência=%lu", (unsigned long) heap_baseline);
+        return true;
+    }
+
+    bool flat = free_now + STATIC_MEM_HEAP_TOLERANCE >= heap_baseline;
+    if (!flat) {
+        ESP_LOGE(TAG_MEM, "Heap caiu %lu bytes desde o aquecimento (livre=%lu mínimo=%lu)",
+                 (unsigned long) (heap_baseline - free_now), (unsigned long) free_now,
+                 (unsigned long) esp_get_minimum_free_heap_size());
+    }
+#if STATIC_MEM_ENABLED
+    ESP_LOGI(TAG_MEM, "Arena cJSON: pico=%u/%u bytes, esgotada %lu vezes",
+             (unsigned) arena_peak, (unsigned) sizeof(arena), (unsigned long) arena_exhausted);
+#endif
+    return flat;
+}
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "tag_record.h"
+
+typedef struct {
+    uint64_t uid;
+    bool used;
+    bool has_record;
+    tag_record_t record;
+} cache_entry_t;
+
+static cache_entry_t cache[TAG_RECORD_CACHE_SIZE];
+static int cache_next = 0;
+
+static uint16_t crc16_ccitt(const uint8_t* data, int len) {
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+void tag_record_encode(const tag_record_t* record, uint8_t raw[TAG_RECORD_SIZE]) {
+    memset(raw, 0, TAG_RECORD_SIZE);
+    raw[0] = 'E';
+    raw[1] = 'S';
+    raw[2] = TAG_RECORD_VERSION;
+    raw[4] = record->item_id & 0xFF;
+    raw[5] = (record->item_id >> 8) & 0xFF;
+    raw[6] = (record->item_id >> 16) & 0xFF;
+    raw[7] = (record->item_id >> 24) & 0xFF;
+    strncpy((char*) raw + 8, record->name, TAG_RECORD_NAME_LEN);
+
+    uint16_t crc = crc16_ccitt(raw, 24);
+    raw[24] = crc & 0xFF;
+    raw[25] = crc >> 8;
+}
+
+bool tag_record_decode(const uint8_t raw[TAG_RECORD_SIZE], tag_record_t* out_record) {
+    if (raw[0] != 'E' || raw[1] != 'S' || raw[2] != TAG_RECORD_VERSION) {
+        return false;
+    }
+    uint16_t crc = raw[24] | (raw[25] << 8);
+    if (crc != crc16_ccitt(raw, 24)) {
+        return false;
+    }
+
+    out_record->item_id = raw[4] | (raw[5] << 8) | (raw[6] << 16) | ((uint32_t) raw[7] << 24);
+    memcpy(out_record->name, raw + 8, TAG_RECORD_NAME_LEN);
+    out_record->name[TAG_RECORD_NAME_LEN] = '\0';
+    return true;
+}
+
+static cache_entry_t* cache_find(uint64_t uid) {
+    for (int i = 0; i < TAG_RECORD_CACHE_SIZE; i++) {
+        if (cache[i].used && cache[i].uid == uid) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+tag_record_cache_state_t tag_record_cache_get(uint64_t uid, tag_record_t* out_record) {
+    cache_entry_t* entry = cache_find(uid);
+    if (entry == NULL) {
+        return TAG_RECORD_UNKNOWN;
+    }
+    if (!entry->has_record) {
+        return TAG_RECORD_ABSENT;
+    }
+    *out_record = entry->record;
+    return TAG_RECORD_CACHED;
+}
+
+void tag_record_cache_put(uint64_t uid, const tag_record_t* record) {
+    cache_entry_t* entry = cache_find(uid);
+    if (entry == NULL) {
+        entry = &cache[cache_next];
+        cache_next = (cache_next + 1) % TAG_RECORD_CACHE_SIZE;
+    }
+    entry->uid = uid;
+    entry->used = true;
+    entry->has_record = record != NULL;
+    if (record != NULL) {
+        entry->record = *record;
+    }
+}
+
+void tag_record_cache_forget(uint64_t uid) {
+    cache_entry_t* entry = cache_find(uid);
+    if (entry != NULL) {
+        entry->used = false;
+    }
+}
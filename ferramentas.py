@@ -0,0 +1,1228 @@
+import paho.mqtt.client as mqtt
+import argparse
+import collections
+import datetime
+import json
+import os
+import random
+import struct
+import subprocess
+import sys
+import threading
+import time
+import urllib.request
+
+from painel import CONTADORES_HTTP_HOST, CONTADORES_HTTP_PORTA, servir_contadores, parar_servidor
+from receptor import (AUDITORIA_LISTAR_MAX, AUDITORIA_STATUS_ESPERADO, BANCO_APLICACAO, BANCO_CONECTAR_TENTATIVAS,
+                      CADASTRO_LOTE, CADASTRO_STATUS_INICIAL, MQTT_BROKER_URL, MQTT_PASSWORD, MQTT_PREFIXO_CARGA,
+                      MQTT_PREFIXO_TELEMETRIA, MQTT_TOPIC, MQTT_TOPIC_CARGA, MQTT_TOPIC_CARGA_RESPONSE,
+                      MQTT_TOPIC_LOG, MQTT_TOPIC_LOTE, MQTT_TOPIC_NOT_FOUND, MQTT_TOPIC_PARTICAO, MQTT_TOPIC_RESPONSE,
+                      MQTT_USERNAME, PARTICOES_BITS, Auditoria, CadastroEmLote, ContadoresEstoque,
+                      LedgerMovimentacoes, abrir_supervisor, atualizar_status_item, conectar_banco,
+                      criar_esquema_ledger, fonte_status, garantir_particoes, ler_replicas, log, meses_a_partir, sair)
+
+# --- Carga sintética e benchmarks contra o receptor em execução ---
+CARGA_ITENS = 200
+CARGA_TIMEOUT_S = 60
+BANDEJA_RODADAS = 20  # Por modo em --bench-bandeja; par, para os itens voltarem ao status inicial
+FAIXAS_TOQUES_POR_S = 5  # Ritmo dos toques medidos em --bench-faixas
+FAIXAS_CARGA_EM_VOO = 50  # Lotes de carga publicados e ainda sem resposta
+FAIXAS_CARGA_LOTE = 10  # Leituras por lote da carga
+REPLICA_BENCH_CONSULTAS = 200  # Consultas de --bench-banco nas réplicas
+LOG_BENCH_CHAMADAS = 10000
+CONTADORES_BENCH_LEITURAS = 200  # Consultas por lado na comparação de latência
+
+# --- Captura e reprodução do tráfego dos leitores ---
+MQTT_TOPICOS_CAPTURA = ["rfid/scanner/#", MQTT_PREFIXO_CARGA + "#", MQTT_PREFIXO_TELEMETRIA + "#"]
+TRACE_MAGICO = b"RFTR"
+TRACE_VERSAO = 1
+TRACE_CABECALHO = struct.Struct("<4sBq")  # mágico, versão, início (epoch, us)
+TRACE_REGISTRO = struct.Struct("<IHBH")  # us desde o anterior, índice do tópico, qos|retain<<2, tamanho do payload
+TRACE_TOPICO_NOVO = 0xFFFF  # Índice reservado: vem em seguida o tópico (u8 tamanho + texto) e ele ganha o próximo índice
+REPRODUCAO_OCIOSO_S = 5.0  # Sem resposta nova por este tempo, a reprodução termina
+
+# --- Tempestade de reconexões: frota de leitores virtuais contra um broker reiniciado ---
+TEMPESTADE_BACKOFF_BASE_S = 0.5  # CONN_BACKOFF_BASE_MS no firmware
+TEMPESTADE_BACKOFF_TETO_S = 60.0  # CONN_BACKOFF_CAP_MS
+TEMPESTADE_FIXO_S = 10.0  # Intervalo fixo padrão do esp-mqtt, o comportamento antes do supervisor
+TEMPESTADE_TIMEOUT_S = 300  # Espera máxima pela frota inteira, antes e depois do reinício
+
+
+def benchmark_log():
+    """Compara o custo por chamada de print com f-string e do log diferido."""
+    uid, nome = "A1B2C3D4", "Furadeira Bosch"
+
+    inicio = time.perf_counter()
+    for i in range(LOG_BENCH_CHAMADAS):
+        print(f"✓ ATUALIZADO NO BANCO: Item '{nome}' alterado para 'Emprestado' ({uid}, {i}).")
+    custo_print = (time.perf_counter() - inicio) / LOG_BENCH_CHAMADAS
+
+    inicio = time.perf_counter()
+    for i in range(LOG_BENCH_CHAMADAS):
+        log.info("✓ ATUALIZADO NO BANCO: Item '%s' alterado para 'Emprestado' (%s, %d).", nome, uid, i)
+    custo_log = (time.perf_counter() - inicio) / LOG_BENCH_CHAMADAS
+
+    sys.stderr.write(f"Custo por chamada ({LOG_BENCH_CHAMADAS} chamadas): "
+                     f"print={custo_print * 1e6:.2f} us, log diferido={custo_log * 1e6:.2f} us\n")
+
+
+def particao_uid(uid):
+    """Mesma conta de uid_partition() no scan_outbox.c."""
+    valor = int(uid, 16)
+    return (((valor ^ (valor >> 32)) & 0xFFFFFFFF) * 2654435761 & 0xFFFFFFFF) >> (32 - PARTICOES_BITS)
+
+
+def gerar_carga(conn, total, pct_duplicadas, ledger_ativo=True):
+    """
+    Carga sintética para o modo cluster: publica `total` leituras de itens reais, no formato
+    do firmware, mais `pct_duplicadas`% de reenvios com a mesma seq. Espera uma resposta por
+    mensagem, imprime a vazão e confere se cada item terminou no status esperado (um toggle
+    por leitura distinta, nenhum por reenvio). ATENÇÃO: alterna itens de verdade; use um banco de teste.
+    """
+    fonte = fonte_status(ledger_ativo)
+    cursor = conn.cursor()
+    cursor.execute(f"SELECT rfid, status_vigente FROM {fonte} "
+                   "WHERE rfid IS NOT NULL AND status_vigente IN ('Disponivel', 'Emprestado') LIMIT %s", (CARGA_ITENS,))
+    itens = {rfid.strip().upper(): status for rfid, status in cursor.fetchall()}
+    cursor.close()
+    conn.commit()
+    if not itens:
+        log.error("Nenhum item com RFID no banco para gerar carga.")
+        return False
+
+    uids = list(itens)
+    boot = "%08X" % random.getrandbits(32)
+    mensagens = []
+    toggles = dict.fromkeys(uids, 0)
+    for seq in range(1, total + 1):
+        uid = uids[seq % len(uids)]
+        toggles[uid] += 1
+        payload = json.dumps({"uid": uid, "leitorId": "CARGA", "boot": boot, "seq": seq})
+        mensagens.append((MQTT_TOPIC_PARTICAO + str(particao_uid(uid)), payload))
+        if random.random() * 100 < pct_duplicadas:
+            mensagens.append(mensagens[-1])
+
+    respostas = {"n": 0}
+    todas = threading.Event()
+
+    def on_resposta(client, userdata, msg):
+        respostas["n"] += 1
+        if respostas["n"] >= len(mensagens):
+            todas.set()
+
+    cliente = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, protocol=mqtt.MQTTv5)
+    cliente.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+    cliente.on_message = on_resposta
+    cliente.connect(MQTT_BROKER_URL, 1883, 60)
+    cliente.subscribe(MQTT_TOPIC_RESPONSE)
+    cliente.loop_start()
+    time.sleep(1)  # Garante a assinatura antes da primeira resposta
+
+    inicio = time.perf_counter()
+    for topico, payload in mensagens:
+        cliente.publish(topico, payload, qos=1)
+    concluiu = todas.wait(CARGA_TIMEOUT_S)
+    duracao = time.perf_counter() - inicio
+    cliente.loop_stop()
+    cliente.disconnect()
+
+    log.info("Carga: %d mensagens (%d reenvios), %d respostas em %.2f s = %.0f leituras/s%s",
+             len(mensagens), len(mensagens) - total, respostas["n"], duracao, respostas["n"] / duracao,
+             "" if concluiu else " (tempo esgotado)")
+
+    cursor = conn.cursor()
+    cursor.execute(f"SELECT UPPER(TRIM(rfid)), status_vigente FROM {fonte} WHERE UPPER(TRIM(rfid)) = ANY(%s)", (uids,))
+    finais = dict(cursor.fetchall())
+    cursor.close()
+    conn.commit()
+    errados = [uid for uid in uids
+               if (finais.get(uid) == itens[uid]) != (toggles[uid] % 2 == 0)]
+    if errados:
+        log.error("✗ %d itens com status inesperado (toggle duplo ou perdido): %s", len(errados), ", ".join(errados[:10]))
+    else:
+        log.info("✓ Nenhum toggle duplo ou perdido em %d itens.", len(uids))
+    return concluiu and not errados
+
+
+def benchmark_bandeja(conn, tamanho, ledger_ativo=True):
+    """
+    Bandeja de `tamanho` tags contra o receptor em execução, BANDEJA_RODADAS vezes em cada
+    modo: uma publicação por leitura (firmware sem lote) e um lote só. Mede o tempo de
+    ponta a ponta de cada bandeja (publicar até a última resposta) e as mensagens por
+    segundo. Rodadas em número par: os itens terminam no status em que começaram.
+    ATENÇÃO: alterna itens de verdade; use um banco de teste.
+    """
+    fonte = fonte_status(ledger_ativo)
+    cursor = conn.cursor()
+    cursor.execute(f"SELECT rfid FROM {fonte} WHERE rfid IS NOT NULL "
+                   "AND status_vigente IN ('Disponivel', 'Emprestado') LIMIT %s", (tamanho,))
+    uids = [linha[0].strip().upper() for linha in cursor.fetchall()]
+    cursor.close()
+    conn.commit()
+    if len(uids) < tamanho:
+        log.error("Só %d itens com RFID no banco para uma bandeja de %d.", len(uids), tamanho)
+        return False
+
+    respostas = {"n": 0, "esperadas": 0}
+    chegaram = threading.Event()
+    trava = threading.Lock()
+
+    def on_resposta(client, userdata, msg):
+        with trava:
+            respostas["n"] += 1
+            if respostas["n"] >= respostas["esperadas"]:
+                chegaram.set()
+
+    cliente = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    cliente.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+    cliente.on_message = on_resposta
+    cliente.connect(MQTT_BROKER_URL, 1883, 60)
+    cliente.subscribe(MQTT_TOPIC_RESPONSE)
+    cliente.loop_start()
+    time.sleep(1)  # Garante a assinatura antes da primeira resposta
+
+    boot = "%08X" % random.getrandbits(32)
+    seq = 0
+    resultados = {}
+    for modo in ("avulsas", "lote"):
+        tempos, mensagens, completas = [], 0, 0
+        for _ in range(BANDEJA_RODADAS):
+            registros = []
+            for uid in uids:
+                seq += 1
+                registros.append({"uid": uid, "seq": seq, "t": int(time.monotonic() * 1000)})
+            if modo == "lote":
+                publicacoes = [(MQTT_TOPIC_LOTE, {"leitorId": "BANDEJA", "boot": boot, "lote": registros})]
+            else:
+                publicacoes = [(MQTT_TOPIC_PARTICAO + str(particao_uid(r["uid"])),
+                                {"uid": r["uid"], "leitorId": "BANDEJA", "boot": boot, "seq": r["seq"]})
+                               for r in registros]
+            with trava:
+                respostas["n"], respostas["esperadas"] = 0, len(publicacoes)
+                chegaram.clear()
+            inicio = time.perf_counter()
+            for topico, dados in publicacoes:
+                cliente.publish(topico, json.dumps(dados), qos=1)
+            if chegaram.wait(CARGA_TIMEOUT_S):
+                completas += 1
+            tempos.append(time.perf_counter() - inicio)
+            mensagens += len(publicacoes)
+        tempos.sort()
+        resultados[modo] = tempos[len(tempos) // 2]
+        log.info("Bandeja de %d (%s): %d mensagens em %d bandejas; ponta a ponta p50=%.1f ms max=%.1f ms; "
+                 "%.0f mensagens/s, %.0f leituras/s%s", tamanho, modo, mensagens, BANDEJA_RODADAS,
+                 tempos[len(tempos) // 2] * 1e3, tempos[-1] * 1e3, mensagens / sum(tempos),
+                 tamanho * BANDEJA_RODADAS / sum(tempos),
+                 "" if completas == BANDEJA_RODADAS else f" ({BANDEJA_RODADAS - completas} sem todas as respostas)")
+    cliente.loop_stop()
+    cliente.disconnect()
+    log.info("  lote: bandeja %.1fx mais rápida (p50)", resultados["avulsas"] / max(resultados["lote"], 1e-9))
+    return True
+
+
+def benchmark_faixas(conn, toques, ledger_ativo=True):
+    """
+    Carga mista contra o receptor em execução: `toques` toques no balcão, um por vez, a
+    FAIXAS_TOQUES_POR_S por segundo, cada um medido do publish até a resposta do LCD.
+    Primeiro sozinhos, depois com lotes de FAIXAS_CARGA_LOTE leituras em MQTT_TOPIC_CARGA,
+    mantidos em FAIXAS_CARGA_EM_VOO sem resposta: a carga satura o receptor o tempo todo.
+    Com as faixas o p99 dos toques deve ficar onde estava; rode de novo contra um receptor
+    em --sem-faixas para ver a diferença. Toques e carga usam itens diferentes. Cada item
+    dos toques é tocado duas vezes seguidas e volta ao status inicial; os da carga, não.
+    ATENÇÃO: alterna itens de verdade; use um banco de teste.
+    """
+    fonte = fonte_status(ledger_ativo)
+    cursor = conn.cursor()
+    cursor.execute(f"SELECT rfid FROM {fonte} WHERE rfid IS NOT NULL "
+                   "AND status_vigente IN ('Disponivel', 'Emprestado') LIMIT %s", (CARGA_ITENS,))
+    uids = [linha[0].strip().upper() for linha in cursor.fetchall()]
+    cursor.close()
+    conn.commit()
+    if len(uids) < 2:
+        log.error("São precisos ao menos 2 itens com RFID no banco (há %d).", len(uids))
+        return False
+    itens_balcao, itens_carga = uids[:max(1, len(uids) // 10)], uids[max(1, len(uids) // 10):]
+    toques += toques % 2
+
+    resposta = threading.Event()
+    em_voo = threading.BoundedSemaphore(FAIXAS_CARGA_EM_VOO)
+    carga = {"lotes": 0, "respostas": 0}
+
+    def on_resposta(client, userdata, msg):
+        if msg.topic == MQTT_TOPIC_RESPONSE:
+            resposta.set()
+            return
+        carga["respostas"] += 1
+        try:
+            em_voo.release()
+        except ValueError:
+            pass  # Resposta de um lote de antes desta execução
+
+    cliente = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    cliente.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+    cliente.on_message = on_resposta
+    cliente.connect(MQTT_BROKER_URL, 1883, 60)
+    cliente.subscribe([(MQTT_TOPIC_RESPONSE, 1), (MQTT_TOPIC_CARGA_RESPONSE, 1)])
+    cliente.loop_start()
+    time.sleep(1)  # Garante a assinatura antes da primeira resposta
+
+    boot_balcao, boot_carga = ("%08X" % random.getrandbits(32) for _ in range(2))
+    seq = {"balcao": 0, "carga": 0}
+    parar_carga = threading.Event()
+
+    def gerar_carga_continua():
+        while not parar_carga.is_set():
+            if not em_voo.acquire(timeout=0.1):
+                continue
+            registros = []
+            for _ in range(FAIXAS_CARGA_LOTE):
+                seq["carga"] += 1
+                registros.append({"uid": random.choice(itens_carga), "seq": seq["carga"],
+                                  "t": int(time.monotonic() * 1000)})
+            cliente.publish(MQTT_TOPIC_CARGA + "/lote", json.dumps(
+                {"leitorId": "BENCH_CARGA", "boot": boot_carga, "lote": registros}), qos=1)
+            carga["lotes"] += 1
+
+    def medir_toques():
+        latencias, perdidos = [], 0
+        proximo = time.perf_counter()
+        for k in range(toques):
+            uid = itens_balcao[k // 2 % len(itens_balcao)]
+            seq["balcao"] += 1
+            resposta.clear()
+            inicio = time.perf_counter()
+            cliente.publish(MQTT_TOPIC_PARTICAO + str(particao_uid(uid)), json.dumps(
+                {"uid": uid, "leitorId": "BENCH_BALCAO", "boot": boot_balcao, "seq": seq["balcao"]}), qos=1)
+            if resposta.wait(CARGA_TIMEOUT_S):
+                latencias.append(time.perf_counter() - inicio)
+            else:
+                perdidos += 1
+            proximo += 1 / FAIXAS_TOQUES_POR_S
+            espera = proximo - time.perf_counter()
+            if espera > 0:
+                time.sleep(espera)
+        latencias.sort()
+        return latencias or [float("nan")], perdidos
+
+    sozinhos, perdidos_sozinhos = medir_toques()
+    gerador = threading.Thread(target=gerar_carga_continua, name="bench-carga")
+    inicio_carga = time.perf_counter()
+    gerador.start()
+    time.sleep(1)  # A carga enche a fila antes do primeiro toque medido
+    com_carga, perdidos_com_carga = medir_toques()
+    parar_carga.set()
+    gerador.join()
+    duracao_carga = time.perf_counter() - inicio_carga
+    leituras_carga = carga["respostas"] * FAIXAS_CARGA_LOTE
+    prazo = time.monotonic() + CARGA_TIMEOUT_S
+    while carga["respostas"] < carga["lotes"] and time.monotonic() < prazo:
+        time.sleep(0.1)  # Deixa o receptor vazio para a próxima execução
+    cliente.loop_stop()
+    cliente.disconnect()
+
+    def percentis(latencias):
+        return (latencias[len(latencias) // 2] * 1e3, latencias[len(latencias) * 99 // 100] * 1e3,
+                latencias[-1] * 1e3)
+
+    log.info("Faixas: %d toques a %d/s por fase", toques, FAIXAS_TOQUES_POR_S)
+    log.info("  toques sozinhos:  p50=%.1f ms p99=%.1f ms max=%.1f ms", *percentis(sozinhos))
+    log.info("  toques com carga: p50=%.1f ms p99=%.1f ms max=%.1f ms", *percentis(com_carga))
+    log.info("  carga: %d lotes publicados, %d leituras respondidas em %.1f s = %.0f leituras/s",
+             carga["lotes"], leituras_carga, duracao_carga, leituras_carga / max(duracao_carga, 1e-9))
+    log.info("  p99 com carga / sozinhos = %.2fx", percentis(com_carga)[1] / max(percentis(sozinhos)[1], 1e-9))
+    if perdidos_sozinhos or perdidos_com_carga:
+        log.error("  ✗ toques sem resposta em %d s: %d sozinhos, %d com carga", CARGA_TIMEOUT_S,
+                  perdidos_sozinhos, perdidos_com_carga)
+    return not (perdidos_sozinhos or perdidos_com_carga)
+
+
+class TraceEscritor:
+    """
+    Trace binário append-only: cabeçalho fixo e um registro de 9 bytes por mensagem, mais
+    tópico (só na primeira vez, depois vira um índice) e payload. Cada registro vai para o
+    disco na hora, então uma captura interrompida deixa um prefixo válido; reabrir o mesmo
+    arquivo continua a captura.
+    """
+
+    def __init__(self, caminho):
+        self._topicos = {}
+        self._anterior_us = None
+        existe = os.path.exists(caminho) and os.path.getsize(caminho) > 0
+        if existe:
+            leitor = TraceLeitor(caminho)
+            for momento_us, _, _, _, _ in leitor:
+                pass
+            self._topicos = {t: i for i, t in enumerate(leitor.topicos)}
+            self._inicio_us = leitor.inicio_us
+            self._anterior_us = leitor.inicio_us + (momento_us if leitor.mensagens else 0)
+            with open(caminho, "r+b") as arquivo:
+                arquivo.truncate(leitor.fim)  # Descarta o registro que a captura anterior deixou pela metade
+        self._arquivo = open(caminho, "ab")
+        if not existe:
+            self._inicio_us = time.time_ns() // 1000
+            self._arquivo.write(TRACE_CABECALHO.pack(TRACE_MAGICO, TRACE_VERSAO, self._inicio_us))
+        self.mensagens = 0
+
+    def gravar(self, topico, payload, qos=0, retain=False, momento_us=None):
+        momento_us = time.time_ns() // 1000 if momento_us is None else momento_us
+        anterior = self._anterior_us if self._anterior_us is not None else self._inicio_us
+        delta = min(max(0, momento_us - anterior), 0xFFFFFFFF)  # Pausas de mais de ~71 min são encurtadas
+        self._anterior_us = anterior + delta
+        partes = []
+        indice = self._topicos.get(topico)
+        if indice is None:
+            indice = len(self._topicos)
+            self._topicos[topico] = indice
+            nome = topico.encode("utf-8")
+            partes.append(TRACE_REGISTRO.pack(delta, TRACE_TOPICO_NOVO, qos | retain << 2, len(payload)))
+            partes.append(bytes([len(nome)]) + nome)
+        else:
+            partes.append(TRACE_REGISTRO.pack(delta, indice, qos | retain << 2, len(payload)))
+        partes.append(payload)
+        self._arquivo.write(b"".join(partes))
+        self._arquivo.flush()
+        self.mensagens += 1
+
+    def fechar(self):
+        self._arquivo.close()
+
+
+class TraceLeitor:
+    """Percorre um trace: (us desde o início, tópico, payload, qos, retain). Um registro truncado no fim é ignorado."""
+
+    def __init__(self, caminho):
+        with open(caminho, "rb") as arquivo:
+            self._dados = arquivo.read()
+        magico, versao, self.inicio_us = TRACE_CABECALHO.unpack_from(self._dados)
+        if magico != TRACE_MAGICO or versao != TRACE_VERSAO:
+            raise ValueError(f"{caminho} não é um trace v{TRACE_VERSAO}")
+        self.topicos = []
+        self.mensagens = 0
+        self.fim = TRACE_CABECALHO.size  # Fim do último registro completo lido
+
+    def __iter__(self):
+        dados, pos, momento = self._dados, TRACE_CABECALHO.size, 0
+        self.topicos, self.mensagens, self.fim = [], 0, pos
+        while pos + TRACE_REGISTRO.size <= len(dados):
+            delta, indice, flags, tamanho = TRACE_REGISTRO.unpack_from(dados, pos)
+            pos += TRACE_REGISTRO.size
+            nome_fim = pos
+            if indice == TRACE_TOPICO_NOVO:
+                if pos >= len(dados):
+                    return
+                nome_fim = pos + 1 + dados[pos]
+            # Só mexe em topicos com o registro inteiro (tópico e payload) no arquivo
+            if nome_fim + tamanho > len(dados):
+                return
+            if indice == TRACE_TOPICO_NOVO:
+                self.topicos.append(dados[pos + 1:nome_fim].decode("utf-8"))
+                indice, pos = len(self.topicos) - 1, nome_fim
+            momento += delta
+            self.mensagens += 1
+            pos += tamanho
+            self.fim = pos
+            yield momento, self.topicos[indice], dados[pos - tamanho:pos], flags & 3, bool(flags & 4)
+
+
+def capturar_trafego(caminho):
+    """Grava toda mensagem de MQTT_TOPICOS_CAPTURA no trace até Ctrl+C."""
+    trace = TraceEscritor(caminho)
+    total = {"bytes": 0}
+
+    def on_mensagem(client, userdata, msg):
+        trace.gravar(msg.topic, msg.payload, msg.qos, msg.retain)
+        total["bytes"] += len(msg.payload)
+
+    cliente = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    cliente.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+    cliente.on_connect = lambda c, u, f, rc, p=None: c.subscribe([(t, 1) for t in MQTT_TOPICOS_CAPTURA])
+    cliente.on_message = on_mensagem
+    cliente.connect(MQTT_BROKER_URL, 1883, 60)
+    log.info("Capturando %s em %s (Ctrl+C para parar)...", ", ".join(MQTT_TOPICOS_CAPTURA), caminho)
+    try:
+        cliente.loop_forever()
+    except KeyboardInterrupt:
+        pass
+    cliente.disconnect()
+    trace.fechar()
+    log.info("Captura: %d mensagens, %d bytes de payload, arquivo com %d bytes", trace.mensagens, total["bytes"],
+             os.path.getsize(caminho))
+    return True
+
+
+def eh_leitura(topico):
+    """Tópicos que os leitores publicam e o receptor consome (o resto do trace são respostas)."""
+    for base in (MQTT_TOPIC, MQTT_TOPIC_CARGA):
+        if topico in (base, base + "/lote") or topico.startswith(base + "/p/"):
+            return True
+    return False
+
+
+def normalizar_resposta(topico, payload):
+    """Resposta sem o que muda de uma execução para outra (a hora do alerta de não cadastrado)."""
+    try:
+        dados = json.loads(payload)
+    except ValueError:
+        return topico, payload.decode("utf-8", "replace")
+    if isinstance(dados, dict):
+        dados.pop("hora", None)
+    return topico, json.dumps(dados, sort_keys=True)
+
+
+def reproduzir_trafego(caminho, velocidade, golden=None, saida=None):
+    """
+    Republica as leituras de um trace no broker local: `velocidade` 1, 10... ou 0 (máxima).
+    Cada leitor tem sua thread, que publica as leituras dele na ordem e no ritmo gravados;
+    leitores diferentes correm em paralelo, como no balcão. O boot de cada leitor é trocado
+    por um novo (o mesmo em toda a reprodução), para que o dedupe do receptor trate a
+    reprodução como leituras novas, mas ainda barre os reenvios que já estavam no trace.
+    As respostas são contadas, gravadas em `saida` (que serve de golden na próxima vez) e,
+    com `golden`, comparadas como multiconjunto: entre leitores a ordem não é determinística.
+    Para repetir o golden, restaure o banco ao mesmo ponto antes de cada reprodução.
+    """
+    por_leitor = collections.defaultdict(list)
+    for momento_us, topico, payload, qos, _ in TraceLeitor(caminho):
+        if not eh_leitura(topico):
+            continue
+        try:
+            dados = json.loads(payload)
+        except ValueError:
+            continue
+        por_leitor[dados.get("leitorId", "?")].append((momento_us, topico, dados, qos))
+    total = sum(len(m) for m in por_leitor.values())
+    if not total:
+        log.error("Nenhuma leitura em %s", caminho)
+        return False
+    primeiro_us = min(m[0][0] for m in por_leitor.values())
+    boots = collections.defaultdict(lambda: "%08X" % random.getrandbits(32))
+
+    respostas = collections.Counter()
+    publicadas = collections.defaultdict(collections.deque)  # (leitorId, seq) -> instantes de publicação
+    latencias = []
+    sem_par = {"n": 0}  # Respostas sem leitura publicada com a mesma seq (firmware antigo, reenvio já respondido)
+    ultima_resposta = {"t": time.monotonic(), "perf": 0.0}
+    trace_saida = TraceEscritor(saida) if saida else None
+    trava = threading.Lock()
+
+    def on_resposta(client, userdata, msg):
+        agora = time.perf_counter()
+        with trava:
+            respostas[normalizar_resposta(msg.topic, msg.payload)] += 1
+            if msg.topic == MQTT_TOPIC_RESPONSE:
+                try:
+                    dados = json.loads(msg.payload)
+                    chave = (dados.get("leitorId"), dados.get("seq"))
+                except (ValueError, AttributeError):
+                    chave = None
+                if publicadas.get(chave):
+                    latencias.append(agora - publicadas[chave].popleft())
+                else:
+                    sem_par["n"] += 1
+            ultima_resposta["t"], ultima_resposta["perf"] = time.monotonic(), agora
+            if trace_saida:
+                trace_saida.gravar(msg.topic, msg.payload, msg.qos, msg.retain)
+
+    cliente = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    cliente.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+    cliente.on_message = on_resposta
+    cliente.connect(MQTT_BROKER_URL, 1883, 60)
+    cliente.subscribe([(MQTT_TOPIC_RESPONSE, 1), (MQTT_TOPIC_CARGA_RESPONSE, 1), (MQTT_TOPIC_NOT_FOUND, 1)])
+    cliente.loop_start()
+    time.sleep(1)  # Garante a assinatura antes da primeira resposta
+
+    inicio = time.perf_counter()
+
+    def reproduzir_leitor(mensagens):
+        for momento_us, topico, dados, qos in mensagens:
+            if velocidade:
+                espera = (momento_us - primeiro_us) / 1e6 / velocidade - (time.perf_counter() - inicio)
+                if espera > 0:
+                    time.sleep(espera)
+            if "boot" in dados:
+                dados = dict(dados, boot=boots[(dados.get("leitorId"), dados["boot"])])
+            # A resposta ecoa leitorId e seq (a maior, num lote): é por eles que a latência é pareada
+            seqs = [r["seq"] for r in dados["lote"] if "seq" in r] if isinstance(dados.get("lote"), list) \
+                else [dados["seq"]] if "seq" in dados else []
+            with trava:
+                if seqs and not (dados.get("cadastro") or dados.get("auditoria") or
+                                 topico.startswith(MQTT_PREFIXO_CARGA)):
+                    publicadas[(dados.get("leitorId"), max(seqs))].append(time.perf_counter())
+                cliente.publish(topico, json.dumps(dados), qos=qos)
+
+    threads = [threading.Thread(target=reproduzir_leitor, args=(m,)) for m in por_leitor.values()]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    publicacao_s = time.perf_counter() - inicio
+    while time.monotonic() - ultima_resposta["t"] < REPRODUCAO_OCIOSO_S:
+        time.sleep(0.1)
+    duracao = max(ultima_resposta["perf"], inicio + publicacao_s) - inicio
+    cliente.loop_stop()
+    cliente.disconnect()
+    if trace_saida:
+        trace_saida.fechar()
+
+    n_respostas = sum(respostas.values())
+    gravado_s = (max(m[-1][0] for m in por_leitor.values()) - primeiro_us) / 1e6
+    log.info("Reprodução (%s): %d leituras de %d leitores; gravadas em %.1f s, publicadas em %.1f s",
+             f"{velocidade:g}x" if velocidade else "máxima", total, len(por_leitor), gravado_s, publicacao_s)
+    log.info("  %d respostas em %.2f s = %.0f respostas/s", n_respostas, duracao, n_respostas / max(duracao, 1e-9))
+    if latencias:
+        latencias.sort()
+        log.info("  latência (pareada por leitorId/seq, %d respostas sem par): p50=%.1f ms p99=%.1f ms max=%.1f ms",
+                 sem_par["n"], latencias[len(latencias) // 2] * 1e3, latencias[len(latencias) * 99 // 100] * 1e3,
+                 latencias[-1] * 1e3)
+
+    if not golden:
+        return True
+    esperadas = collections.Counter(normalizar_resposta(topico, payload)
+                                    for _, topico, payload, _, _ in TraceLeitor(golden)
+                                    if topico in (MQTT_TOPIC_RESPONSE, MQTT_TOPIC_CARGA_RESPONSE,
+                                                  MQTT_TOPIC_NOT_FOUND))
+    faltaram, sobraram = esperadas - respostas, respostas - esperadas
+    if not faltaram and not sobraram:
+        log.info("  ✓ respostas iguais às do golden (%d)", n_respostas)
+        return True
+    log.error("  ✗ respostas diferentes do golden: %d faltaram, %d sobraram",
+              sum(faltaram.values()), sum(sobraram.values()))
+    for (topico, payload), n in list(faltaram.items())[:AUDITORIA_LISTAR_MAX]:
+        log.error("    - %dx %s %s", n, topico, payload)
+    for (topico, payload), n in list(sobraram.items())[:AUDITORIA_LISTAR_MAX]:
+        log.error("    + %dx %s %s", n, topico, payload)
+    return False
+
+
+def backoff_descorrelacionado(anterior, base=TEMPESTADE_BACKOFF_BASE_S, teto=TEMPESTADE_BACKOFF_TETO_S):
+    """Mesma conta de conn_backoff_next() no firmware: aleatório entre base e 3x o anterior, até o teto."""
+    superior = anterior * 3
+    if superior <= base or superior > teto:
+        superior = teto
+    return random.uniform(base, superior)
+
+
+def tempestade_reconexao(total, comando_reinicio, fixo=False):
+    """
+    `total` leitores virtuais conectam no broker; depois de todos conectados o broker é
+    reiniciado com `comando_reinicio` e cada leitor volta com o backoff do firmware
+    (descorrelacionado) ou, com `fixo`, com o intervalo fixo de antes. Mede quanto a frota
+    leva para voltar inteira e o pico de tentativas de conexão por segundo no broker.
+    """
+    fim = threading.Event()
+    trava = threading.Lock()
+    tentativas = []  # Instante de cada tentativa de conexão (monotonic)
+    conectados = {}  # Leitor -> instante da última conexão aceita
+    pronto = threading.Condition(trava)
+
+    def leitor_virtual(indice):
+        cliente = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=f"tempestade-{indice:04d}")
+        cliente.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+        espera = TEMPESTADE_BACKOFF_BASE_S
+        # Frota ligada de uma vez; como no firmware, a primeira tentativa já sai com atraso sorteado
+        fim.wait(backoff_descorrelacionado(espera) if not fixo else random.uniform(0, 1))
+        while not fim.is_set():
+            with trava:
+                tentativas.append(time.monotonic())
+            try:
+                cliente.connect(MQTT_BROKER_URL, 1883, 30)
+            except OSError:
+                pass
+            else:
+                while not fim.is_set() and cliente.loop(timeout=0.2) == mqtt.MQTT_ERR_SUCCESS:
+                    if cliente.is_connected() and indice not in conectados:
+                        with pronto:
+                            conectados[indice] = time.monotonic()
+                            pronto.notify_all()
+                        espera = TEMPESTADE_BACKOFF_BASE_S
+                with trava:
+                    conectados.pop(indice, None)
+            if fim.is_set():
+                break
+            espera = TEMPESTADE_FIXO_S if fixo else backoff_descorrelacionado(espera)
+            fim.wait(espera)
+        cliente.disconnect()
+
+    def esperar_frota(desde):
+        limite = time.monotonic() + TEMPESTADE_TIMEOUT_S
+        with pronto:
+            while not (len(conectados) == total and all(t >= desde for t in conectados.values())):
+                if not pronto.wait(timeout=max(0.0, limite - time.monotonic())):
+                    return False
+        return True
+
+    threads = [threading.Thread(target=leitor_virtual, args=(i,), daemon=True) for i in range(total)]
+    for t in threads:
+        t.start()
+    ok = esperar_frota(0)
+    if ok:
+        log.info("Tempestade: %d leitores conectados, reiniciando o broker (%s)...", total, comando_reinicio)
+        reinicio = time.monotonic()
+        subprocess.run(comando_reinicio, shell=True, check=False)
+        ok = esperar_frota(reinicio)
+        recuperacao_s = time.monotonic() - reinicio
+    with trava:
+        voltas = sorted(t - reinicio for t in conectados.values()) if ok else []
+        quantos = len(conectados)
+    fim.set()
+    for t in threads:
+        t.join(timeout=5)
+    if not ok:
+        log.error("  ✗ só %d de %d leitores conectados após %d s", quantos, total, TEMPESTADE_TIMEOUT_S)
+        return False
+
+    por_segundo = collections.Counter(int(t - reinicio) for t in tentativas if t >= reinicio)
+    log.info("Tempestade (%s, %d leitores): frota de volta em %.1f s | reconexão p50=%.1f s p99=%.1f s",
+             "intervalo fixo" if fixo else "backoff descorrelacionado", total, recuperacao_s,
+             voltas[len(voltas) // 2], voltas[len(voltas) * 99 // 100])
+    log.info("  %d tentativas depois do reinício | pico de %d conexões/s no broker",
+             sum(por_segundo.values()), max(por_segundo.values(), default=0))
+    return True
+
+
+def consultar_historico(conn, uid, dias):
+    """
+    Com quem o item esteve nos últimos `dias`: o último toggle antes da janela (como o
+    item entrou nela) e todos os toggles dentro dela. O índice (item_id, momento) atende
+    as duas partes, e a janela de tempo descarta as partições fora dela.
+    """
+    inicio = datetime.datetime.now() - datetime.timedelta(days=dias)
+    cursor = conn.cursor()
+    cursor.execute("SELECT id, nome FROM itens WHERE UPPER(TRIM(rfid)) = UPPER(%s)", (uid.strip(),))
+    item = cursor.fetchone()
+    if not item:
+        log.warning("✗ Item não encontrado no banco para o UID: %s", uid.strip())
+        return False
+
+    item_id, nome = item
+    cursor.execute("""
+        SELECT momento, status, leitor_id FROM (
+            (SELECT momento, status, leitor_id FROM movimentacoes
+             WHERE item_id = %s AND momento < %s ORDER BY momento DESC LIMIT 1)
+            UNION ALL
+            (SELECT momento, status, leitor_id FROM movimentacoes
+             WHERE item_id = %s AND momento >= %s)
+        ) h ORDER BY momento""", (item_id, inicio, item_id, inicio))
+    linhas = cursor.fetchall()
+    cursor.close()
+    conn.commit()
+
+    log.info("Histórico de '%s' desde %s:", nome, inicio.strftime("%d/%m %H:%M"))
+    for momento, status, leitor_id in linhas:
+        log.info("  %s  %-10s  leitor %s", momento.strftime("%d/%m %H:%M:%S"), status, leitor_id or "-")
+    if not linhas:
+        log.info("  (sem movimentações)")
+    return True
+
+
+def listar_emprestados_ha(conn, dias):
+    """Itens emprestados há mais de `dias`, lidos da projeção status_atual (uma linha por item)."""
+    cursor = conn.cursor()
+    cursor.execute("""
+        SELECT i.nome, i.rfid, s.desde, s.leitor_id FROM status_atual s JOIN itens i ON i.id = s.item_id
+        WHERE s.status = 'Emprestado' AND s.desde < now() - %s * interval '1 day'
+        ORDER BY s.desde""", (dias,))
+    linhas = cursor.fetchall()
+    cursor.close()
+    conn.commit()
+
+    log.info("%d itens emprestados há mais de %s dias:", len(linhas), dias)
+    for nome, rfid, desde, leitor_id in linhas:
+        log.info("  %-24s %-12s desde %s  leitor %s", nome, rfid, desde.strftime("%d/%m/%Y"), leitor_id or "-")
+    return True
+
+
+def tamanho_tabela(cursor, tabela):
+    """Tamanho em disco, somando as partições e os índices."""
+    # pg_partition_tree não lista uma tabela comum: para ela, o tamanho dela mesma
+    cursor.execute("SELECT COALESCE(sum(pg_total_relation_size(relid)), pg_total_relation_size(%s)) "
+                   "FROM pg_partition_tree(%s)", (tabela, tabela))
+    return cursor.fetchone()[0]
+
+
+def benchmark_ledger(conn, toggles):
+    """
+    Compara, em tabelas bench_* descartáveis, o esquema antigo (UPDATE na linha de itens a
+    cada toggle) com o ledger (upsert em status_atual e INSERT em movimentacoes, na mesma
+    transação, como no toggle real): toggles por segundo e quanto cada tabela cresceu em disco.
+    """
+    cursor = conn.cursor()
+    cursor.execute("DROP TABLE IF EXISTS bench_itens, bench_status_atual, bench_movimentacoes CASCADE")
+    cursor.execute("CREATE TABLE bench_itens AS SELECT * FROM itens WHERE rfid IS NOT NULL LIMIT %s", (CARGA_ITENS,))
+    cursor.execute("ALTER TABLE bench_itens ADD PRIMARY KEY (id)")
+    criar_esquema_ledger(cursor, "bench_")
+    garantir_particoes(cursor, meses_a_partir(datetime.date.today(), 1), "bench_")
+    cursor.execute("INSERT INTO bench_status_atual (item_id, status, desde) "
+                   "SELECT id, COALESCE(status, 'Disponivel'), now() FROM bench_itens")
+    cursor.execute("SELECT id, rfid FROM bench_itens")
+    itens = cursor.fetchall()
+    conn.commit()
+    if not itens:
+        log.error("Nenhum item com RFID no banco para o benchmark.")
+        return False
+
+    def status_do_toggle(k):
+        return "Emprestado" if (k // len(itens)) % 2 == 0 else "Disponivel"
+
+    legado_antes = tamanho_tabela(cursor, "bench_itens")
+    inicio = time.perf_counter()
+    for k in range(toggles):
+        item_id, _ = itens[k % len(itens)]
+        cursor.execute("UPDATE bench_itens SET status = %s, ultima_atualizacao = now() WHERE id = %s",
+                       (status_do_toggle(k), item_id))
+        conn.commit()
+    legado_s = time.perf_counter() - inicio
+    legado_depois = tamanho_tabela(cursor, "bench_itens")
+
+    status_antes = tamanho_tabela(cursor, "bench_status_atual")
+    conn.commit()
+    inicio = time.perf_counter()
+    for k in range(toggles):
+        item_id, rfid = itens[k % len(itens)]
+        agora = datetime.datetime.now()
+        cursor.execute("UPDATE bench_status_atual SET status = %s, desde = %s WHERE item_id = %s",
+                       (status_do_toggle(k), agora, item_id))
+        cursor.execute("INSERT INTO bench_movimentacoes (item_id, rfid, status, leitor_id, momento) "
+                       "VALUES (%s, %s, %s, %s, %s)", (item_id, rfid, status_do_toggle(k), "BENCH", agora))
+        conn.commit()
+    ledger_s = time.perf_counter() - inicio
+    status_depois = tamanho_tabela(cursor, "bench_status_atual")
+    historico = tamanho_tabela(cursor, "bench_movimentacoes")
+
+    log.info("Benchmark de esquema: %d toggles em %d itens", toggles, len(itens))
+    log.info("  legado: %.0f toggles/s | itens %d kB -> %d kB (versões mortas da linha quente)",
+             toggles / legado_s, legado_antes // 1024, legado_depois // 1024)
+    log.info("  ledger: %.0f toggles/s | status_atual %d kB -> %d kB | movimentacoes %d kB (histórico completo)",
+             toggles / ledger_s, status_antes // 1024, status_depois // 1024, historico // 1024)
+
+    cursor.execute("DROP TABLE IF EXISTS bench_itens, bench_status_atual, bench_movimentacoes CASCADE")
+    conn.commit()
+    cursor.close()
+    return True
+
+
+def benchmark_contadores(banco, conn, toggles, threads, ledger_ativo):
+    """
+    Dispara `toggles` toggles reais em `threads` conexões concorrentes, confere se os
+    contadores em memória batem com o GROUP BY no banco e compara a latência de ler a
+    contagem pelo HTTP local e pelo agregado SQL. ATENÇÃO: alterna itens; use um banco de teste.
+    """
+    class SemMqtt:
+        def publish(self, *args, **kwargs):
+            pass
+
+    fonte = fonte_status(ledger_ativo)
+    cursor = conn.cursor()
+    cursor.execute(f"SELECT rfid FROM {fonte} "
+                   "WHERE rfid IS NOT NULL AND status_vigente IN ('Disponivel', 'Emprestado') LIMIT %s", (CARGA_ITENS,))
+    uids = [linha[0] for linha in cursor.fetchall()]
+    conn.commit()
+    if not uids:
+        log.error("Nenhum item com RFID no banco para o benchmark.")
+        return False
+
+    contadores = ContadoresEstoque(banco, ledger_ativo)
+    servidor = servir_contadores(contadores)
+    ledger = LedgerMovimentacoes(banco) if ledger_ativo else None
+    por_thread = toggles // threads
+
+    def trabalhador():
+        c = banco.conectar()
+        for _ in range(por_thread):
+            atualizar_status_item(c, random.choice(uids), SemMqtt(), None, ledger, contadores)
+        c.close()
+
+    # Reconciliações seguidas no meio da carga: cada uma tem de cair entre dois toggles sem
+    # perder nem contar duas vezes nenhum deles (uma divergência aparece como WARNING)
+    reconciliacoes = []
+    carga_fim = threading.Event()
+
+    def reconciliador():
+        while not carga_fim.is_set():
+            reconciliacoes.append(contadores.reconciliar())
+
+    nivel = log.NOMES[log.nivel]
+    log.set_nivel("WARNING")  # Um log por toggle dominaria a medida
+    inicio = time.perf_counter()
+    trabalhadores = [threading.Thread(target=trabalhador) for _ in range(threads)]
+    for t in trabalhadores + [threading.Thread(target=reconciliador)]:
+        t.start()
+    for t in trabalhadores:
+        t.join()
+    duracao = time.perf_counter() - inicio
+    carga_fim.set()
+    log.set_nivel(nivel)
+    if ledger:
+        ledger.parar()
+
+    sql_agregado = f"SELECT status_vigente, count(*) FROM {fonte} WHERE status_vigente IS NOT NULL GROUP BY 1"
+    cursor.execute(sql_agregado)
+    agregado = dict(cursor.fetchall())
+    conn.commit()
+    memoria = contadores.instantaneo()["porStatus"]
+    consistente = {k: v for k, v in memoria.items() if v} == agregado
+
+    def medir(ler):
+        tempos = []
+        for _ in range(CONTADORES_BENCH_LEITURAS):
+            t0 = time.perf_counter()
+            ler()
+            tempos.append(time.perf_counter() - t0)
+        tempos.sort()
+        return tempos[len(tempos) // 2] * 1e3, tempos[len(tempos) * 99 // 100] * 1e3
+
+    def ler_sql():
+        cursor.execute(sql_agregado)
+        cursor.fetchall()
+        conn.commit()
+
+    url = f"http://{CONTADORES_HTTP_HOST}:{CONTADORES_HTTP_PORTA}/contadores"
+    sql_p50, sql_p99 = medir(ler_sql)
+    http_p50, http_p99 = medir(lambda: urllib.request.urlopen(url).read())
+    parar_servidor(servidor)
+    contadores.parar()
+    cursor.close()
+
+    log.info("Contadores: %d toggles em %d threads (%.0f/s), %d reconciliações durante a carga (%d falharam)",
+             por_thread * threads, threads, por_thread * threads / duracao, len(reconciliacoes),
+             reconciliacoes.count(False))
+    if consistente:
+        log.info("  ✓ memória igual ao banco: %s", agregado)
+    else:
+        log.error("  ✗ memória %s, banco %s", memoria, agregado)
+    log.info("  leitura da contagem: SQL p50=%.2f ms p99=%.2f ms | HTTP p50=%.2f ms p99=%.2f ms",
+             sql_p50, sql_p99, http_p50, http_p99)
+    return consistente
+
+
+def benchmark_cadastro(conn, total):
+    """
+    Ensaio local do cadastro, sem leitor: `total` UIDs sintéticas passam pelo
+    CadastroEmLote (COPY) e, para comparação, outras tantas por um INSERT com commit
+    por tag, como no cadastro manual. As linhas do ensaio são apagadas no fim.
+    """
+    uids_lote = [f"BE{random.getrandbits(48):012X}" for _ in range(total)]
+    uids_unitario = [f"BF{random.getrandbits(48):012X}" for _ in range(total)]
+    cadastro_conn = conectar_banco()
+    if not cadastro_conn:
+        return False
+
+    nivel = log.NOMES[log.nivel]
+    log.set_nivel("WARNING")  # O relatório de sessão mediria a geração das UIDs, não o banco
+    inicio = time.perf_counter()
+    cadastro = CadastroEmLote(cadastro_conn, [f"Bench {i}" for i in range(total)])
+    for uid in uids_lote:
+        cadastro.adicionar(uid)
+    cadastro.parar()
+    lote_s = time.perf_counter() - inicio
+    log.set_nivel(nivel)
+
+    cursor = conn.cursor()
+    inicio = time.perf_counter()
+    for i, uid in enumerate(uids_unitario):
+        cursor.execute("INSERT INTO itens (nome, status, rfid, ultima_atualizacao) VALUES (%s, %s, %s, now())",
+                       (f"Bench {i}", CADASTRO_STATUS_INICIAL, uid))
+        conn.commit()
+    unitario_s = time.perf_counter() - inicio
+
+    cursor.execute("DELETE FROM itens WHERE rfid = ANY(%s)", (uids_lote + uids_unitario,))
+    conn.commit()
+    cursor.close()
+
+    log.info("Cadastro de %d tags: COPY em lotes de %d %.0f tags/min | INSERT por tag %.0f tags/min",
+             total, CADASTRO_LOTE, total * 60 / lote_s, total * 60 / unitario_s)
+    if cadastro.gravadas != total:
+        log.error("  ✗ só %d de %d tags foram gravadas pelo lote", cadastro.gravadas, total)
+    return cadastro.gravadas == total
+
+
+def benchmark_auditoria(conn, total, ledger_ativo):
+    """
+    Carrega um inventário sintético de `total` itens (10% emprestados) numa auditoria,
+    registra 95% deles mais 1% de tags desconhecidas e mede o custo por leitura e o da
+    reconciliação sem a consulta. A releitura do inventário real aparece na primeira linha.
+    """
+    auditoria = Auditoria(conn, ledger_ativo)
+    auditoria.reconciliar(recarregar=False)
+
+    linhas = [(i, f"AD{i:012X}", f"Item {i}", "Emprestado" if i % 10 == 0 else AUDITORIA_STATUS_ESPERADO)
+              for i in range(1, total + 1)]
+    inicio = time.perf_counter()
+    auditoria.carregar(linhas)
+    carga_ms = (time.perf_counter() - inicio) * 1e3
+
+    vistos = [linha[1] for linha in random.sample(linhas, total * 95 // 100)]
+    vistos += [f"DE{random.getrandbits(48):012X}" for _ in range(total // 100)]
+    random.shuffle(vistos)
+    inicio = time.perf_counter()
+    for uid in vistos:
+        auditoria.registrar(uid)
+    registro_us = (time.perf_counter() - inicio) * 1e6 / len(vistos)
+
+    tempos = []
+    for _ in range(5):
+        inicio = time.perf_counter()
+        resumo = auditoria.reconciliar(recarregar=False)
+        tempos.append((time.perf_counter() - inicio) * 1e3)
+    tempos.sort()
+
+    esperados = sum(1 for linha in linhas if linha[3] == AUDITORIA_STATUS_ESPERADO)
+    vistos_set = set(vistos)
+    faltando = sum(1 for linha in linhas if linha[3] == AUDITORIA_STATUS_ESPERADO and linha[1] not in vistos_set)
+    status = sum(1 for linha in linhas if linha[3] != AUDITORIA_STATUS_ESPERADO and linha[1] in vistos_set)
+    correto = (resumo["esperados"], resumo["faltando"], resumo["statusErrado"], resumo["inesperadas"]) == \
+              (esperados, faltando, status, total // 100)
+
+    log.info("Auditoria de %d itens: carga %.0f ms | %.1f us por leitura | reconciliação (listas incluídas) "
+             "mediana %.0f ms, pior %.0f ms", total, carga_ms, registro_us, tempos[2], tempos[-1])
+    if correto:
+        log.info("  ✓ listas conferem com o cálculo por conjuntos do Python")
+    else:
+        log.error("  ✗ resumo %s; esperado faltando=%d status=%d", resumo, faltando, status)
+    return correto
+
+
+def benchmark_banco(banco, conn, total, ledger_ativo):
+    """
+    Queda do banco no meio da carga: `total` leituras sintéticas passam pelo supervisor
+    (toggles reais, com dedupe) e, na metade, todas as conexões do pool são derrubadas no
+    servidor com pg_terminate_backend. Mede quanto a leitura seguinte levou para passar e
+    confere no dedupe que nenhuma se perdeu. Com réplicas (--replicas), confere também
+    que as consultas vão para elas (pg_is_in_recovery), mede quanto a réplica leva para
+    alcançar o primário depois da carga e derruba as conexões dela no meio das consultas.
+    ATENÇÃO: alterna itens; use um banco de teste.
+    """
+    class SemMqtt:
+        def publish(self, *args, **kwargs):
+            pass
+
+    cursor = conn.cursor()
+    cursor.execute(f"SELECT rfid FROM {fonte_status(ledger_ativo)} "
+                   "WHERE rfid IS NOT NULL AND status_vigente IN ('Disponivel', 'Emprestado') LIMIT %s", (CARGA_ITENS,))
+    uids = [linha[0] for linha in cursor.fetchall()]
+    conn.commit()
+    if not uids:
+        log.error("Nenhum item com RFID no banco para o benchmark.")
+        return False
+    ledger = LedgerMovimentacoes(banco) if ledger_ativo else None
+
+    leitor, boot = "BENCH_BANCO", f"{random.getrandbits(32):08X}"
+    queda = total // 2
+    derrubadas, recuperacao_ms, tempos = 0, 0.0, []
+    nivel = log.NOMES[log.nivel]
+    log.set_nivel("WARNING")  # Um log por toggle dominaria a medida; as quedas ainda aparecem
+    for seq in range(1, total + 1):
+        if seq == queda:
+            cursor.execute("SELECT count(pg_terminate_backend(pid)) FROM pg_stat_activity WHERE application_name = %s",
+                           (BANCO_APLICACAO,))
+            derrubadas = cursor.fetchone()[0]
+            conn.commit()
+        inicio = time.perf_counter()
+        banco.processar(atualizar_status_item, random.choice(uids), SemMqtt(), (leitor, boot, seq), ledger, None)
+        tempos.append((time.perf_counter() - inicio) * 1e3)
+        if seq == queda:
+            recuperacao_ms = tempos[-1]
+
+    prazo = time.monotonic() + CARGA_TIMEOUT_S
+    while banco.pendentes() and time.monotonic() < prazo:
+        time.sleep(0.1)
+    log.set_nivel(nivel)
+    if ledger:
+        ledger.parar()
+
+    cursor.execute("SELECT count(*) FROM leituras_processadas WHERE leitor_id = %s AND boot = %s", (leitor, boot))
+    perdidas = total - cursor.fetchone()[0]
+    conn.commit()
+    cursor.close()
+
+    tempos.sort()
+    log.info("Banco: %d leituras, %d conexões derrubadas na leitura %d", total, derrubadas, queda)
+    log.info("  leitura da queda passou em %.0f ms (%d reconexões) | p50=%.1f ms p99=%.1f ms",
+             recuperacao_ms, banco.reconexoes, tempos[len(tempos) // 2], tempos[len(tempos) * 99 // 100])
+    if perdidas == 0:
+        log.info("  ✓ nenhuma leitura perdida")
+    else:
+        log.error("  ✗ %d leituras perdidas (%d ainda pendentes)", perdidas, banco.pendentes())
+    return perdidas == 0 and (not banco.replicas or benchmark_replicas(banco, conn, leitor, boot, total))
+
+
+def benchmark_replicas(banco, conn, leitor, boot, total):
+    """Parte de benchmark_banco com réplicas: atraso de replicação, destino das consultas e queda da réplica."""
+    def consultar_replica(c, lsn):
+        cursor = c.cursor()
+        cursor.execute("SELECT pg_is_in_recovery(), pg_last_wal_replay_lsn() >= %s::pg_lsn, "
+                       "(SELECT count(*) FROM leituras_processadas WHERE leitor_id = %s AND boot = %s)",
+                       (lsn, leitor, boot))
+        linha = cursor.fetchone()
+        cursor.close()
+        c.commit()
+        return linha
+
+    def derrubar():
+        c = banco.conectar_leitura()  # Fora do pool: não derruba a si mesma
+        cursor = c.cursor()
+        cursor.execute("SELECT pg_is_in_recovery(), count(pg_terminate_backend(pid)) FROM pg_stat_activity "
+                       "WHERE application_name = %s", (BANCO_APLICACAO,))
+        na_replica, derrubadas = cursor.fetchone()
+        c.close()
+        return derrubadas if na_replica else 0
+
+    cursor = conn.cursor()
+    cursor.execute("SELECT pg_current_wal_lsn()::text")
+    lsn = cursor.fetchone()[0]
+    conn.commit()
+    cursor.close()
+
+    # Atraso: da última leitura gravada no primário até a réplica ter reproduzido o WAL dela
+    inicio = time.perf_counter()
+    prazo = time.monotonic() + CARGA_TIMEOUT_S
+    em_recuperacao, alcancou, replicadas = banco.consultar(consultar_replica, lsn)
+    while not alcancou and time.monotonic() < prazo:
+        time.sleep(0.005)
+        em_recuperacao, alcancou, replicadas = banco.consultar(consultar_replica, lsn)
+    atraso_ms = (time.perf_counter() - inicio) * 1e3
+
+    # Consultas com as conexões da réplica derrubadas no meio: têm de reconectar e continuar nela
+    reconexoes, tempos, fora_da_replica, derrubadas = banco.reconexoes, [], 0, 0
+    for i in range(REPLICA_BENCH_CONSULTAS):
+        if i == REPLICA_BENCH_CONSULTAS // 2:
+            derrubadas = derrubar()
+        t0 = time.perf_counter()
+        fora_da_replica += not banco.consultar(consultar_replica, lsn)[0]
+        tempos.append((time.perf_counter() - t0) * 1e3)
+    tempos.sort()
+
+    log.info("Réplicas %s: alcançou o primário em %.1f ms depois da carga, %d/%d leituras replicadas",
+             banco.replicas, atraso_ms, replicadas, total)
+    log.info("  %d consultas (%d conexões derrubadas na %dª): p50=%.2f ms p99=%.2f ms, %d reconexões, "
+             "%d fora da réplica", REPLICA_BENCH_CONSULTAS, derrubadas, REPLICA_BENCH_CONSULTAS // 2 + 1,
+             tempos[len(tempos) // 2],
+             tempos[len(tempos) * 99 // 100], banco.reconexoes - reconexoes, fora_da_replica)
+    ok = em_recuperacao and alcancou and replicadas == total and derrubadas > 0 and fora_da_replica == 0
+    if ok:
+        log.info("  ✓ consultas na réplica, que alcançou o primário sem perder leituras")
+    else:
+        log.error("  ✗ réplica: em recuperação=%s, alcançou=%s, %d/%d leituras, %d consultas no primário",
+                  em_recuperacao, alcancou, replicadas, total, fora_da_replica)
+    return ok
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Ferramentas do sistema de estoque: benchmarks, carga sintética, "
+                                                 "captura e reprodução de tráfego, consultas. Cada uma roda e sai.")
+    parser.add_argument("--log-nivel", choices=["DEBUG", "INFO", "WARNING", "ERROR"], default="INFO",
+                        help="nível inicial do log; pode ser trocado em execução publicando em " + MQTT_TOPIC_LOG)
+    parser.add_argument("--esquema", choices=["ledger", "legado"], default="legado",
+                        help="'legado' (padrão) reescreve status na linha de itens, copiado antes de status_atual; "
+                             "'ledger' grava cada toggle em movimentacoes e o status em status_atual "
+                             "(itens.status deixa de ser atualizado: consulte a view itens_com_status)")
+    parser.add_argument("--replicas", metavar="HOST:PORTA,...",
+                        help="réplicas de leitura (substitui DB_REPLICAS); vazio = consultas no primário")
+    parser.add_argument("--bench-log", action="store_true",
+                        help="mede o custo por chamada de print e do log diferido e sai")
+    parser.add_argument("--gerar-carga", type=int, metavar="N",
+                        help="publica N leituras sintéticas para o cluster, mede a vazão, confere os toggles e sai")
+    parser.add_argument("--duplicadas", type=float, default=10,
+                        help="porcentagem de reenvios com a mesma seq em --gerar-carga")
+    parser.add_argument("--bench-bandeja", type=int, metavar="N",
+                        help="bandeja de N tags contra o receptor em execução: uma publicação por leitura "
+                             "contra um lote; compara o tempo de ponta a ponta e sai")
+    parser.add_argument("--bench-faixas", type=int, metavar="N",
+                        help="N toques interativos contra o receptor em execução, sozinhos e com uma carga "
+                             "saturando a faixa de carga; compara a latência dos toques e sai")
+    parser.add_argument("--historico", metavar="UID",
+                        help="mostra as movimentações do item nos últimos --dias e sai")
+    parser.add_argument("--dias", type=int, default=7, help="janela de --historico, em dias")
+    parser.add_argument("--emprestados-ha", type=int, metavar="DIAS",
+                        help="lista os itens emprestados há mais de DIAS dias e sai")
+    parser.add_argument("--bench-ledger", type=int, metavar="N",
+                        help="compara vazão e crescimento em disco dos dois esquemas com N toggles e sai")
+    parser.add_argument("--bench-contadores", type=int, metavar="N",
+                        help="N toggles concorrentes: confere os contadores contra o banco, compara latências e sai")
+    parser.add_argument("--threads", type=int, default=4, help="conexões concorrentes em --bench-contadores")
+    parser.add_argument("--bench-cadastro", type=int, metavar="N",
+                        help="cadastra N tags sintéticas em lote e uma a uma, compara tags/min, apaga e sai")
+    parser.add_argument("--bench-banco", type=int, metavar="N",
+                        help="N toggles pelo supervisor derrubando as conexões no meio; mede a recuperação e sai")
+    parser.add_argument("--bench-auditoria", type=int, metavar="N",
+                        help="mede leitura e reconciliação de uma auditoria sobre N itens sintéticos e sai")
+    parser.add_argument("--capturar", metavar="TRACE",
+                        help="grava todo o tráfego de " + ", ".join(MQTT_TOPICOS_CAPTURA) + " num trace binário até Ctrl+C")
+    parser.add_argument("--reproduzir", metavar="TRACE",
+                        help="republica as leituras do trace no broker, mede vazão e latência e sai")
+    parser.add_argument("--velocidade", default="1",
+                        help="ritmo de --reproduzir: 1, 10... (vezes o tempo real) ou 'max'")
+    parser.add_argument("--golden", metavar="TRACE",
+                        help="em --reproduzir, compara as respostas com as de um trace de referência")
+    parser.add_argument("--gravar-respostas", metavar="TRACE",
+                        help="em --reproduzir, grava as respostas num trace (o golden das próximas vezes)")
+    parser.add_argument("--tempestade", type=int, metavar="N",
+                        help="N leitores virtuais conectam no broker, que é reiniciado com --reiniciar-broker; "
+                             "mede o tempo até todos voltarem e o pico de conexões por segundo e sai")
+    parser.add_argument("--reiniciar-broker", metavar="COMANDO", default="systemctl restart mosquitto",
+                        help="comando de shell que reinicia o broker em --tempestade")
+    parser.add_argument("--backoff-fixo", action="store_true",
+                        help="em --tempestade, reconecta a cada %g s como o firmware antigo (referência)"
+                             % TEMPESTADE_FIXO_S)
+    args = parser.parse_args()
+    if args.threads < 1:
+        parser.error("--threads deve ser pelo menos 1")
+    try:
+        velocidade = 0 if args.velocidade == "max" else float(args.velocidade)
+    except ValueError:
+        parser.error("--velocidade deve ser um número ou 'max'")
+    try:
+        replicas = ler_replicas(args.replicas)
+    except ValueError:
+        parser.error("--replicas deve ser host:porta[,host:porta...]")
+
+    log.set_nivel(args.log_nivel)
+    if args.bench_log:
+        benchmark_log()
+        sair(0)
+    ferramenta_mqtt = None
+    if args.capturar:
+        ferramenta_mqtt = lambda: capturar_trafego(args.capturar)
+    elif args.reproduzir:
+        ferramenta_mqtt = lambda: reproduzir_trafego(args.reproduzir, velocidade, args.golden, args.gravar_respostas)
+    elif args.tempestade:
+        ferramenta_mqtt = lambda: tempestade_reconexao(args.tempestade, args.reiniciar_broker, args.backoff_fixo)
+    if ferramenta_mqtt:  # Só falam com o broker: não precisam do banco
+        ok = ferramenta_mqtt()
+        sair(0 if ok else 1)
+
+    banco = abrir_supervisor(args.esquema, replicas)
+    db_conn = None
+    ferramenta = None
+    if args.historico:
+        ferramenta = lambda: banco.consultar(consultar_historico, args.historico, args.dias)
+    elif args.emprestados_ha is not None:
+        ferramenta = lambda: banco.consultar(listar_emprestados_ha, args.emprestados_ha)
+    elif args.bench_banco:
+        ferramenta = lambda: benchmark_banco(banco, db_conn, args.bench_banco, args.esquema == "ledger")
+    elif args.bench_ledger:
+        ferramenta = lambda: benchmark_ledger(db_conn, args.bench_ledger)
+    elif args.bench_auditoria:
+        ferramenta = lambda: benchmark_auditoria(db_conn, args.bench_auditoria, args.esquema == "ledger")
+    elif args.bench_cadastro:
+        ferramenta = lambda: benchmark_cadastro(db_conn, args.bench_cadastro)
+    elif args.bench_contadores:
+        ferramenta = lambda: benchmark_contadores(banco, db_conn, args.bench_contadores, args.threads,
+                                                  args.esquema == "ledger")
+    elif args.gerar_carga:
+        ferramenta = lambda: gerar_carga(db_conn, args.gerar_carga, args.duplicadas, args.esquema == "ledger")
+    elif args.bench_bandeja:
+        ferramenta = lambda: benchmark_bandeja(db_conn, args.bench_bandeja, args.esquema == "ledger")
+    elif args.bench_faixas:
+        ferramenta = lambda: benchmark_faixas(db_conn, args.bench_faixas, args.esquema == "ledger")
+    if not ferramenta:
+        banco.parar()
+        parser.error("escolha uma ferramenta (--gerar-carga, --bench-*, --capturar, --historico...)")
+    db_conn = banco.conectar(tentativas=BANCO_CONECTAR_TENTATIVAS)
+    if not db_conn:
+        banco.parar()
+        sair(1)
+    banco.preparar_esquema()
+    ok = ferramenta()
+    banco.parar()
+    db_conn.close()
+    sair(0 if ok else 1)
@@ -0,0 +1,38 @@
+import http.server
+import json
+import threading
+
+CONTADORES_HTTP_HOST = "127.0.0.1"
+CONTADORES_HTTP_PORTA = 8081  # GET /contadores
+
+
+class _HandlerContadores(http.server.BaseHTTPRequestHandler):
+    def do_GET(self):
+        if self.path.rstrip("/") != "/contadores":
+            self.send_error(404)
+            return
+        corpo = json.dumps(self.server.contadores.instantaneo()).encode("utf-8")
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(corpo)))
+        self.end_headers()
+        self.wfile.write(corpo)
+
+    def log_message(self, fmt, *args):
+        pass  # Uma linha por requisição de painel só faria barulho
+
+
+def servir_contadores(contadores, porta=CONTADORES_HTTP_PORTA):
+    """
+    Serve contadores.instantaneo() (ContadoresEstoque do receptor.py) em GET /contadores,
+    numa thread própria. Devolve o servidor; encerre com parar_servidor().
+    """
+    servidor = http.server.ThreadingHTTPServer((CONTADORES_HTTP_HOST, porta), _HandlerContadores)
+    servidor.contadores = contadores
+    threading.Thread(target=servidor.serve_forever, name="contadores-http", daemon=True).start()
+    return servidor
+
+
+def parar_servidor(servidor):
+    servidor.shutdown()
+    servidor.server_close()
@@ -1,22 +1,162 @@
 import paho.mqtt.client as mqtt
 import psycopg2
+import psycopg2.extras
+import psycopg2.pool
+import collections
+import contextlib
+import csv
 import datetime
+import io
 import json
 import unicodedata  
 import string
+import argparse
+import queue
+import random
+import sys
+import threading
+import time
+
+from painel import servir_contadores, parar_servidor
 
 MQTT_BROKER_URL = "192.168.18.73"
 MQTT_USERNAME = "calebe"
 MQTT_PASSWORD = "8811"
-MQTT_TOPIC = "rfid/scanner/uid"
-MQTT_TOPIC_NOT_FOUND = "rfid/scanner/uid/not_found"
+MQTT_TOPIC = "rfid/scanner/uid"  # Firmware antigo; o atual publica em MQTT_TOPIC_PARTICAO + número
+MQTT_TOPIC_PARTICAO = "rfid/scanner/uid/p/"
+MQTT_TOPIC_LOTE = "rfid/scanner/uid/lote"  # Leituras juntadas pelo leitor (SCAN_OUTBOX_BATCH_* no firmware)
 MQTT_TOPIC_RESPONSE = "rfid/scanner/response"
+MQTT_PREFIXO_CARGA = "rfid/carga/"  # Classe carga: sessões de cadastro e auditoria, importações
+MQTT_TOPIC_CARGA = "rfid/carga/uid"  # Mesma forma de MQTT_TOPIC: /p/<partição> e /lote
+MQTT_TOPIC_CARGA_RESPONSE = "rfid/carga/response"
+MQTT_PREFIXO_TELEMETRIA = "rfid/telemetria/"  # Classe telemetria: alertas, estatísticas dos leitores, ping
+MQTT_TOPIC_NOT_FOUND = "rfid/telemetria/not_found"
+MQTT_TOPIC_TELEMETRIA_LEITOR = "rfid/telemetria/leitor/"  # + leitorId; estatísticas periódicas do firmware
+MQTT_TOPIC_PING = "rfid/telemetria/ping"
+MQTT_TOPIC_PONG = "rfid/telemetria/pong"
+MQTT_TOPIC_GRAVAR = "rfid/scanner/gravar"
+MQTT_TOPIC_LOG = "rfid/receptor/log"  # Payload: nome do nível (DEBUG, INFO, WARNING, ERROR)
+MQTT_TOPIC_CONTADORES = "rfid/receptor/contadores"  # Retido: contagem por status e categoria
+MQTT_TOPIC_CADASTRO = "rfid/scanner/cadastro/"  # + leitorId; retido "1" liga o modo cadastro no leitor, "0" desliga
+MQTT_TOPIC_AUDITORIA = "rfid/scanner/auditoria/"  # + leitorId; idem para o modo auditoria
+MQTT_TOPIC_AUDITORIA_RESUMO = "rfid/receptor/auditoria"  # Resumo da conferência a cada reconciliação
+
+TAG_NOME_MAX = 16  # Tamanho do nome no registro gravado na tag (ver tag_record.h)
+
+# --- Cluster: várias instâncias dividem as partições de leitura ---
+PARTICOES_BITS = 4  # Igual a SCAN_OUTBOX_PARTITION_BITS no firmware
+PARTICOES = 1 << PARTICOES_BITS
+GRUPO_COMPARTILHADO = "receptor"
+DEDUPE_RETENCAO_HORAS = 24  # Reentregas chegam em segundos; um dia de folga basta
+DEDUPE_LIMPEZA_A_CADA = 1000  # Leituras processadas entre limpezas da tabela de dedupe
+
+# --- Faixas: cada classe de tráfego tem sua fila; o callback do paho só classifica e enfileira ---
+FAIXA_INTERATIVA = "interativa"  # Toques no balcão: alguém olhando para o LCD
+FAIXA_CARGA = "carga"
+FAIXA_TELEMETRIA = "telemetria"
+FAIXA_PESOS = {FAIXA_CARGA: 4, FAIXA_TELEMETRIA: 1}  # Rodízio da thread compartilhada; a interativa tem a sua
+FAIXA_FILA_MAX = 10000  # Por faixa; o resto da carga espera no broker (janela de QoS 1 sem confirmação)
+FAIXA_AMOSTRAS = 2000  # Esperas guardadas por faixa para o relatório
 
 DB_HOST = "192.168.18.10"
 DB_PORT = "5432"
 DB_NAME = "inventario_teste"
 DB_USER = "gislenojr"
 DB_PASS = "1234"
+DB_REPLICAS = []  # [(host, porta)] das réplicas de leitura; vazio = consultas também no primário
+
+# --- Supervisor de conexões ---
+BANCO_POOL_MIN = 2  # Conexões ociosas mantidas por servidor (o psycopg2 fecha as que passam disso)
+BANCO_POOL_MAX = 8  # Conexões por servidor
+BANCO_APLICACAO = "receptor"  # application_name das conexões do pool (pg_stat_activity)
+BANCO_TENTATIVAS = 5  # Por leitura em andamento; esgotadas, ela vai para a fila de pendentes
+BANCO_BACKOFF_INICIAL_S = 0.1
+BANCO_BACKOFF_MAX_S = 2.0
+BANCO_PENDENTES_MAX = 10000  # Leituras guardadas em memória enquanto o primário não volta
+BANCO_VERIFICAR_S = 1.0  # Com pendentes, intervalo entre tentativas de drenar a fila
+BANCO_CONECTAR_TENTATIVAS = 10  # No início: cerca de um minuto de espera antes de desistir
+
+# --- Ledger de movimentações (append-only) ---
+LEDGER_MESES_A_FRENTE = 2  # Partições mensais criadas com antecedência
+LEDGER_PARTICOES_VERIFICAR_S = 6 * 3600  # De quanto em quanto tempo o receptor confere as partições à frente
+
+# --- Contadores em memória para os painéis ---
+CONTADORES_RECONCILIAR_S = 300  # Conferência com o banco
+CONTADORES_RECONCILIAR_CLUSTER_S = 30  # Em cluster os toggles das outras instâncias só chegam assim
+CONTADORES_PUBLICAR_S = 1.0  # Intervalo mínimo entre publicações do retido
+CONTADORES_COLUNA_CATEGORIA = "categoria"  # Coluna de itens; sem ela só há contagem por status
+
+# --- Modo cadastro: tags novas entram em lote ---
+CADASTRO_LOTE = 500  # Tags por COPY
+CADASTRO_INTERVALO_S = 2.0  # Espera máxima de uma tag lida antes de ir para o banco
+CADASTRO_STATUS_INICIAL = "Disponivel"
+
+# --- Auditoria: conferência do que está na prateleira ---
+AUDITORIA_STATUS_ESPERADO = "Disponivel"  # Quem deveria estar fisicamente no estoque
+AUDITORIA_RECONCILIAR_S = 10  # Releitura do inventário esperado e recálculo das listas
+AUDITORIA_LISTAR_MAX = 20  # Itens por categoria no log; a lista completa vai para --relatorio
+
+
+class LogDiferido:
+    """
+    Log diferido: quem chama só enfileira uma tupla (nível, formato, argumentos);
+    a formatação com % e a escrita no stdout acontecem numa thread separada.
+    Mesma interface de chamada do módulo logging (log.info("... %s", x)), mas sem
+    criar um LogRecord por chamada, que custa mais que o próprio print.
+    """
+    NIVEIS = {"DEBUG": 10, "INFO": 20, "WARNING": 30, "ERROR": 40}
+    NOMES = {v: k for k, v in NIVEIS.items()}
+
+    def __init__(self, nivel="INFO"):
+        self.nivel = self.NIVEIS[nivel]
+        self._fila = queue.SimpleQueue()
+        self._thread = threading.Thread(target=self._escrever, name="log", daemon=True)
+        self._thread.start()
+
+    def set_nivel(self, nome):
+        self.nivel = self.NIVEIS[nome]
+
+    def debug(self, fmt, *args):
+        if self.nivel <= 10:
+            self._fila.put((time.time(), 10, fmt, args))
+
+    def info(self, fmt, *args):
+        if self.nivel <= 20:
+            self._fila.put((time.time(), 20, fmt, args))
+
+    def warning(self, fmt, *args):
+        if self.nivel <= 30:
+            self._fila.put((time.time(), 30, fmt, args))
+
+    def error(self, fmt, *args):
+        if self.nivel <= 40:
+            self._fila.put((time.time(), 40, fmt, args))
+
+    def _escrever(self):
+        while True:
+            item = self._fila.get()
+            if item is None:
+                break
+            ts, nivel, fmt, args = item
+            linha = fmt % args if args else fmt
+            hora = time.strftime("%H:%M:%S", time.localtime(ts))
+            sys.stdout.write(f"{hora} {self.NOMES[nivel]} {linha}\n")
+            if self._fila.empty():
+                sys.stdout.flush()
+
+    def parar(self):
+        """Esvazia a fila e encerra a thread de escrita."""
+        self._fila.put(None)
+        self._thread.join()
+
+
+log = LogDiferido()
+
+
+def sair(codigo):
+    """Encerra o processo depois de esvaziar o log diferido: a mensagem que explica a saída não se perde."""
+    log.parar()
+    exit(codigo)
 
 
 def limpar_para_lcd(texto):
@@ -33,20 +173,1286 @@ def limpar_para_lcd(texto):
     return texto_final
 
 
-def conectar_banco():
-    """Conecta ao banco de dados PostgreSQL na rede."""
-    try:
-        conn = psycopg2.connect(host=DB_HOST, port=DB_PORT, dbname=DB_NAME, user=DB_USER, password=DB_PASS)
-        print(f"Conectado ao banco de dados PostgreSQL em {DB_HOST}")
+# Erros em que a conexão (não o comando) falhou: vale reconectar e repetir
+ERROS_CONEXAO = (psycopg2.OperationalError, psycopg2.InterfaceError)
+
+
+def espera_backoff(tentativa):
+    """Espera exponencial com jitter, como o conn_supervisor do firmware."""
+    return min(BANCO_BACKOFF_MAX_S, BANCO_BACKOFF_INICIAL_S * 2 ** tentativa) * random.uniform(0.5, 1.0)
+
+
+def conectar_banco(host=DB_HOST, port=DB_PORT, tentativas=1):
+    """Conecta ao banco de dados PostgreSQL na rede, com até `tentativas` tentativas."""
+    for tentativa in range(tentativas):
+        try:
+            conn = psycopg2.connect(host=host, port=port, dbname=DB_NAME, user=DB_USER, password=DB_PASS)
+            log.info("Conectado ao banco de dados PostgreSQL em %s", host)
+            return conn
+        except psycopg2.Error as e:
+            log.error("Erro ao conectar ao banco de dados PostgreSQL: %s", e)
+            if tentativa + 1 < tentativas:
+                time.sleep(espera_backoff(tentativa + 3))  # Começa em ~1 s: o servidor está fora, não ocupado
+    return None
+
+
+def conexao_viva(conn):
+    """Para as threads com conexão própria: devolve conn se aberta; se caiu, tenta abrir outra no mesmo servidor."""
+    if not conn.closed:
         return conn
+    return conectar_banco(conn.info.host, conn.info.port) or conn
+
+
+def desfazer(conn):
+    """rollback que não falha numa conexão que já caiu."""
+    if not conn.closed:
+        try:
+            conn.rollback()
+        except ERROS_CONEXAO:
+            pass
+
+
+# Comandos do caminho da leitura, preparados (PREPARE) uma vez em cada conexão do pool
+SQL_LEITURA = {
+    "item": "SELECT id, nome, status FROM itens WHERE UPPER(TRIM(rfid)) = UPPER(%s) FOR UPDATE",
+    # Em comando separado, depois da trava: num JOIN com o FOR UPDATE, quem esperou a trava
+    # relê a linha de itens mas recebe a de status_atual do snapshot antigo, e alterna de novo
+    "status_ledger": "SELECT status FROM status_atual WHERE item_id = %s",
+    "registrar_leitura": "INSERT INTO leituras_processadas (leitor_id, boot, seq) VALUES (%s, %s, %s) "
+                         "ON CONFLICT DO NOTHING",
+    "status_atual": """INSERT INTO status_atual (item_id, status, desde, leitor_id) VALUES (%s, %s, %s, %s)
+                       ON CONFLICT (item_id) DO UPDATE
+                       SET status = EXCLUDED.status, desde = EXCLUDED.desde, leitor_id = EXCLUDED.leitor_id""",
+    "itens_status": "UPDATE itens SET status = %s, ultima_atualizacao = %s WHERE UPPER(TRIM(rfid)) = UPPER(%s)",
+    "movimentacao": "INSERT INTO movimentacoes (item_id, rfid, status, leitor_id, momento) VALUES (%s, %s, %s, %s, %s)",
+}
+SQL_LEITURA_POR_ESQUEMA = {
+    "ledger": ("item", "status_ledger", "registrar_leitura", "status_atual", "movimentacao"),
+    "legado": ("item", "registrar_leitura", "itens_status"),
+}
+
+
+def executar(cursor, nome, params):
+    """Roda SQL_LEITURA[nome]: EXECUTE se a conexão já o preparou, senão o texto (conexões fora do pool)."""
+    if nome in getattr(cursor.connection, "preparadas", ()):
+        cursor.execute(f"EXECUTE {nome} ({', '.join(['%s'] * len(params))})", params)
+    else:
+        cursor.execute(SQL_LEITURA[nome], params)
+
+
+class ConexaoPreparada(psycopg2.extensions.connection):
+    """Conexão que lembra quais comandos de SQL_LEITURA já preparou."""
+
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.preparadas = set()
+
+
+class SupervisorBanco:
+    """
+    Conexões do receptor: um pool no primário para os toggles, um pool em cada réplica
+    (DB_REPLICAS) para consultas, com volta ao primário se nenhuma responder. Os comandos
+    do caminho da leitura são preparados uma vez por conexão. Uma conexão que cai sai do
+    pool e a operação é repetida com backoff até BANCO_TENTATIVAS vezes; o dedupe de
+    leituras torna a repetição segura mesmo se o commit chegou ao banco. Uma leitura que
+    esgota as tentativas entra na fila de pendentes, drenada em ordem por uma thread assim
+    que o primário volta; enquanto houver pendentes, as leituras novas entram atrás delas.
+    A faixa interativa tem uma conexão reservada no primário, fora do pool: uma carga que
+    ocupe as BANCO_POOL_MAX conexões não a deixa esperando.
+
+    Nenhuma conexão é aberta no construtor: o receptor sobe com o banco fora e as leituras
+    esperam nas pendentes. As funções de preparar (esquema, dedupe) rodam na primeira
+    conexão do primário que der certo, antes dos PREPARE, que dependem das tabelas.
+    As conexões próprias (cadastro, ferramentas) também saem daqui, de conectar().
+    """
+
+    def __init__(self, preparadas=(), replicas=DB_REPLICAS, preparar=()):
+        self._preparadas = {nome: self._para_postgres(SQL_LEITURA[nome]) for nome in preparadas}
+        self._preparar = list(preparar)
+        self._lock_esquema = threading.Lock()
+        self._esquema_pronto = not self._preparar
+        self._primario = (DB_HOST, DB_PORT)
+        self._replicas = list(replicas)
+        self._pools = {}
+        self._lock_pools = threading.Lock()
+        self._proxima_replica = 0
+        self._ordem = threading.Lock()  # Pendentes primeiro; cada faixa já processa as suas em ordem
+        self._vaga = threading.Condition(self._ordem)  # Avisada quando a drenagem abre espaço nas pendentes
+        self._pendentes = collections.deque()
+        self.reconexoes = 0
+        self.retidas = 0
+        self._fim = threading.Event()
+        self._thread = threading.Thread(target=self._drenar, name="banco", daemon=True)
+        self._thread.start()
+
+    @property
+    def replicas(self):
+        return list(self._replicas)
+
+    def _pool(self, servidor, reservada=False):
+        # Criado no primeiro uso (o pool já abre BANCO_POOL_MIN conexões): o receptor sobe com o servidor fora
+        with self._lock_pools:
+            pool = self._pools.get((servidor, reservada))
+            if pool is None:
+                host, porta = servidor
+                minimo, maximo = (1, 1) if reservada else (BANCO_POOL_MIN, BANCO_POOL_MAX)
+                pool = psycopg2.pool.ThreadedConnectionPool(
+                    minimo, maximo, host=host, port=porta, dbname=DB_NAME, user=DB_USER, password=DB_PASS,
+                    application_name=BANCO_APLICACAO + ("-interativa" if reservada else ""),
+                    connection_factory=ConexaoPreparada)
+                self._pools[(servidor, reservada)] = pool
+            return pool
+
+    @staticmethod
+    def _para_postgres(sql):
+        """Troca os %s do psycopg2 pelos $1, $2... do PREPARE."""
+        partes = sql.split("%s")
+        return "".join(p + (f"${i + 1}" if i < len(partes) - 1 else "") for i, p in enumerate(partes))
+
+    def _obter(self, servidor, reservada=False):
+        pool = self._pool(servidor, reservada)
+        conn = pool.getconn()
+        if conn.closed:
+            pool.putconn(conn, close=True)
+            conn = pool.getconn()
+        if not self._esquema_pronto and servidor == self._primario:
+            with self._lock_esquema:
+                if not self._esquema_pronto:
+                    try:
+                        for preparar in self._preparar:
+                            preparar(conn)
+                    except psycopg2.Error:
+                        pool.putconn(conn, close=True)
+                        raise
+                    self._esquema_pronto = True
+        if self._preparadas and not conn.preparadas:
+            try:
+                cursor = conn.cursor()
+                for nome, sql in self._preparadas.items():
+                    cursor.execute(f"PREPARE {nome} AS {sql}")
+                conn.commit()
+                cursor.close()
+                conn.preparadas = set(self._preparadas)
+            except psycopg2.Error:
+                pool.putconn(conn, close=True)
+                raise
+        return self._usar(pool, conn)
+
+    @contextlib.contextmanager
+    def _usar(self, pool, conn):
+        try:
+            yield conn
+        except ERROS_CONEXAO:
+            pool.putconn(conn, close=True)  # Morta ou em estado incerto: não volta para o pool
+            raise
+        except BaseException:
+            pool.putconn(conn)
+            raise
+        else:
+            pool.putconn(conn)
+
+    def escrita(self, reservada=False):
+        """
+        Conexão do primário (context manager); com reservada, a da faixa interativa, que só
+        a thread dela usa. Levanta ERROS_CONEXAO se o primário estiver fora.
+        """
+        return self._obter(self._primario, reservada)
+
+    def leitura(self):
+        """Conexão de uma réplica, em rodízio; se nenhuma responder, do primário."""
+        for _ in range(len(self._replicas)):
+            servidor = self._replicas[self._proxima_replica % len(self._replicas)]
+            self._proxima_replica += 1
+            # Duas vezes: a primeira pode ter pego uma conexão do pool que o servidor já derrubou
+            for tentativa in range(2):
+                try:
+                    return self._obter(servidor)
+                except ERROS_CONEXAO as e:
+                    if tentativa:
+                        log.warning("Réplica indisponível, tentando a próxima: %s", str(e).strip())
+        return self.escrita()
+
+    def conectar(self, tentativas=1):
+        """Conexão própria (fora do pool) no primário, para quem precisa de sessão: tabela temporária, ferramentas."""
+        return conectar_banco(*self._primario, tentativas=tentativas)
+
+    def conectar_leitura(self):
+        """Conexão própria (fora do pool) para consultas longas: a primeira réplica que responder, ou o primário."""
+        for host, porta in self._replicas:
+            conn = conectar_banco(host, porta)
+            if conn:
+                return conn
+        return self.conectar()
+
+    def preparar_esquema(self):
+        """Roda já as funções de preparar, sem esperar a primeira leitura. Levanta ERROS_CONEXAO se o primário está fora."""
+        self.executar(lambda conn: None, tentativas=1)
+
+    def executar(self, funcao, *args, tentativas=BANCO_TENTATIVAS, reservada=False):
+        """funcao(conn, *args) numa conexão do primário, repetida com backoff se a conexão cair."""
+        for tentativa in range(tentativas):
+            try:
+                with self.escrita(reservada) as conn:
+                    return funcao(conn, *args)
+            except ERROS_CONEXAO as e:
+                self.reconexoes += 1
+                if tentativa + 1 == tentativas:
+                    raise
+                log.warning("Conexão com o banco caiu (%s); nova tentativa %d/%d", str(e).strip(),
+                            tentativa + 2, tentativas)
+                time.sleep(espera_backoff(tentativa))
+
+    def consultar(self, funcao, *args, tentativas=BANCO_TENTATIVAS):
+        """
+        funcao(conn, *args) numa conexão de leitura (réplica, ou o primário se nenhuma responder).
+        Uma conexão que caiu sai do pool e a consulta é repetida com backoff, como em executar.
+        """
+        for tentativa in range(tentativas):
+            try:
+                with self.leitura() as conn:
+                    return funcao(conn, *args)
+            except ERROS_CONEXAO as e:
+                self.reconexoes += 1
+                if tentativa + 1 == tentativas:
+                    raise
+                log.warning("Conexão de leitura caiu (%s); nova tentativa %d/%d", str(e).strip(),
+                            tentativa + 2, tentativas)
+                time.sleep(espera_backoff(tentativa))
+
+    def processar(self, funcao, *args, reservada=False, concluir=None):
+        """
+        Caminho da leitura: roda funcao(conn, *args) no primário (reservada: na conexão da
+        faixa interativa). Se as tentativas se esgotarem, a leitura fica na fila de pendentes
+        em vez de ser perdida. As faixas rodam em paralelo; só a fila de pendentes é serializada.
+        Retorna False se a leitura ficou guardada: concluir() (o ack ao broker) é chamada
+        quando ela chegar ao banco, e não antes. Com a fila cheia a faixa espera aqui por uma
+        vaga, sem confirmar nada: as mensagens seguintes ficam no broker (janela do QoS 1).
+        """
+        # Sob a trava: enquanto a fila é drenada, a leitura nova espera e não passa na frente
+        with self._ordem:
+            direto = not self._pendentes
+        if direto:
+            try:
+                self.executar(funcao, *args, reservada=reservada)
+                return True
+            except ERROS_CONEXAO:
+                log.error("✗ Banco fora do ar; leitura guardada até ele voltar.")
+        with self._ordem:
+            if len(self._pendentes) >= BANCO_PENDENTES_MAX:
+                self.retidas += 1
+                log.error("✗ Fila de pendentes cheia (%d); faixa parada até o banco abrir vaga.", BANCO_PENDENTES_MAX)
+                # Ao encerrar entra assim mesmo: parar() a relata como não gravada nem confirmada
+                while len(self._pendentes) >= BANCO_PENDENTES_MAX and not self._fim.is_set():
+                    self._vaga.wait(BANCO_VERIFICAR_S)
+            self._pendentes.append((funcao, args, concluir))
+        return False
+
+    def pendentes(self):
+        return len(self._pendentes)
+
+    def _drenar(self):
+        while not self._fim.wait(BANCO_VERIFICAR_S):
+            if not self._pendentes:
+                continue
+            with self._ordem:
+                quantidade = len(self._pendentes)
+                while self._pendentes:
+                    funcao, args, concluir = self._pendentes[0]
+                    try:
+                        self.executar(funcao, *args, tentativas=1)
+                    except ERROS_CONEXAO:
+                        break  # Ainda fora; tenta de novo na próxima volta
+                    self._pendentes.popleft()
+                    self._vaga.notify_all()
+                    if concluir:
+                        concluir()
+                if not self._pendentes:
+                    log.info("✓ Banco de volta: %d leituras pendentes processadas.", quantidade)
+
+    def parar(self):
+        """Processa o que der das pendentes e fecha os pools."""
+        self._fim.set()
+        self._thread.join()
+        if self._pendentes:
+            log.error("✗ %d leituras pendentes não chegaram ao banco (nem foram confirmadas ao broker).",
+                      len(self._pendentes))
+        for pool in self._pools.values():
+            pool.closeall()
+
+def preparar_dedupe(conn):
+    """Cria a tabela de leituras já processadas e descarta as antigas."""
+    try:
+        cursor = conn.cursor()
+        cursor.execute("""
+            CREATE TABLE IF NOT EXISTS leituras_processadas (
+                leitor_id TEXT NOT NULL,
+                boot TEXT NOT NULL,
+                seq BIGINT NOT NULL,
+                processada_em TIMESTAMP NOT NULL DEFAULT now(),
+                PRIMARY KEY (leitor_id, boot, seq)
+            )""")
+        cursor.execute("DELETE FROM leituras_processadas WHERE processada_em < now() - %s * interval '1 hour'",
+                       (DEDUPE_RETENCAO_HORAS,))
+        conn.commit()
+        cursor.close()
+    except ERROS_CONEXAO:
+        raise
     except psycopg2.Error as e:
-        print(f"Erro ao conectar ao banco de dados PostgreSQL: {e}")
+        log.error("✗ Erro ao preparar a tabela de dedupe: %s", e)
+        desfazer(conn)
+
+
+def criar_esquema_ledger(cursor, prefixo=""):
+    """
+    movimentacoes: uma linha por toggle, nunca atualizada, particionada por mês.
+    status_atual: uma linha curta por item, a projeção do último toggle.
+    """
+    mov, status = prefixo + "movimentacoes", prefixo + "status_atual"
+    cursor.execute(f"""
+        CREATE TABLE IF NOT EXISTS {mov} (
+            item_id INTEGER NOT NULL,
+            rfid TEXT NOT NULL,
+            status TEXT NOT NULL,
+            leitor_id TEXT,
+            momento TIMESTAMP NOT NULL
+        ) PARTITION BY RANGE (momento)""")
+    # As linhas chegam em ordem de tempo: BRIN resume cada faixa de blocos em poucos bytes
+    cursor.execute(f"CREATE INDEX IF NOT EXISTS {mov}_momento_brin ON {mov} USING BRIN (momento)")
+    cursor.execute(f"CREATE INDEX IF NOT EXISTS {mov}_item_momento ON {mov} (item_id, momento)")
+    # Sem índice em status/desde: assim todo toggle é um HOT update, na mesma página (fillfactor)
+    cursor.execute(f"""
+        CREATE TABLE IF NOT EXISTS {status} (
+            item_id INTEGER PRIMARY KEY,
+            status TEXT NOT NULL,
+            desde TIMESTAMP NOT NULL,
+            leitor_id TEXT
+        ) WITH (fillfactor = 50)""")
+
+
+def garantir_particoes(cursor, meses, prefixo=""):
+    """Cria as partições mensais de movimentacoes para os (ano, mês) informados."""
+    mov = prefixo + "movimentacoes"
+    for ano, mes in meses:
+        prox_ano, prox_mes = (ano + 1, 1) if mes == 12 else (ano, mes + 1)
+        cursor.execute(f"CREATE TABLE IF NOT EXISTS {mov}_{ano}_{mes:02d} PARTITION OF {mov} "
+                       f"FOR VALUES FROM ('{ano}-{mes:02d}-01') TO ('{prox_ano}-{prox_mes:02d}-01')")
+
+
+def meses_a_partir(data, quantidade):
+    ano, mes = data.year, data.month
+    meses = []
+    for _ in range(quantidade):
+        meses.append((ano, mes))
+        ano, mes = (ano + 1, 1) if mes == 12 else (ano, mes + 1)
+    return meses
+
+
+def preparar_ledger(conn):
+    """
+    Cria o ledger, as próximas partições e traz para status_atual o status legado de itens:
+    o item que ainda não tem linha, e o que foi alternado no esquema legado depois do último
+    toggle do ledger (ledger -> legado -> ledger), senão status_atual ficaria com o status velho.
+    """
+    try:
+        cursor = conn.cursor()
+        criar_esquema_ledger(cursor)
+        garantir_particoes(cursor, meses_a_partir(datetime.date.today(), LEDGER_MESES_A_FRENTE + 1))
+        # desde = now() só vem de um item sem ultima_atualizacao, que o legado nunca alternou:
+        # para ele vale o que status_atual já tem
+        cursor.execute("""
+            INSERT INTO status_atual (item_id, status, desde)
+            SELECT id, status, COALESCE(ultima_atualizacao, now()) FROM itens WHERE status IS NOT NULL
+            ON CONFLICT (item_id) DO UPDATE SET status = EXCLUDED.status, desde = EXCLUDED.desde, leitor_id = NULL
+            WHERE EXCLUDED.desde > status_atual.desde AND EXCLUDED.desde < now()""")
+        if cursor.rowcount:
+            log.info("✓ %d itens com o status trazido de itens para status_atual.", cursor.rowcount)
+        # Para quem consultava itens.status diretamente
+        cursor.execute("""
+            CREATE OR REPLACE VIEW itens_com_status AS
+            SELECT i.*, s.status AS status_vigente, s.desde AS status_desde, s.leitor_id AS status_leitor
+            FROM itens i LEFT JOIN status_atual s ON s.item_id = i.id""")
+        conn.commit()
+        cursor.close()
+    except ERROS_CONEXAO:
+        raise
+    except psycopg2.Error as e:
+        log.error("✗ Erro ao preparar o ledger: %s", e)
+        conn.rollback()
+
+
+def sincronizar_itens_legado(conn):
+    """
+    Volta do ledger para o esquema legado: no ledger a linha de itens não é reescrita e
+    itens.status para no último toggle feito antes dele. Copia para itens o status que está
+    em status_atual, senão o primeiro toggle legado partiria de um status velho.
+    """
+    try:
+        cursor = conn.cursor()
+        cursor.execute("SELECT to_regclass('status_atual') IS NOT NULL")
+        if cursor.fetchone()[0]:
+            cursor.execute("""
+                UPDATE itens i SET status = s.status, ultima_atualizacao = s.desde
+                FROM status_atual s WHERE s.item_id = i.id AND i.status IS DISTINCT FROM s.status""")
+            if cursor.rowcount:
+                log.info("✓ %d itens com o status copiado de status_atual.", cursor.rowcount)
+        conn.commit()
+        cursor.close()
+    except ERROS_CONEXAO:
+        raise
+    except psycopg2.Error as e:
+        log.error("✗ Erro ao sincronizar itens.status com status_atual: %s", e)
+        desfazer(conn)
+
+
+
+def ler_replicas(texto):
+    """Réplicas de "host:porta,host:porta"; None fica com DB_REPLICAS. Levanta ValueError se mal formado."""
+    if texto is None:
+        return DB_REPLICAS
+    return [(host, int(porta)) for host, porta in (r.rsplit(":", 1) for r in texto.split(",") if r)]
+
+
+def abrir_supervisor(esquema, replicas):
+    """SupervisorBanco do esquema ("ledger" ou "legado"), com o preparo que cada um pede."""
+    return SupervisorBanco(SQL_LEITURA_POR_ESQUEMA[esquema], replicas=replicas,
+                           preparar=(preparar_dedupe,
+                                     preparar_ledger if esquema == "ledger" else sincronizar_itens_legado))
+
+class LedgerMovimentacoes:
+    """
+    Ledger ativo. A movimentação é inserida na própria transação do toggle, junto com o
+    upsert em status_atual (um lote do leitor vira um INSERT só): se o commit passou, o
+    histórico está no banco. Esta classe só mantém as partições: uma thread cria, numa
+    conexão do SupervisorBanco, as dos próximos LEDGER_MESES_A_FRENTE meses a cada
+    LEDGER_PARTICOES_VERIFICAR_S, para que o INSERT do toggle nunca encontre um mês sem partição.
+    """
+
+    def __init__(self, banco):
+        self._banco = banco
+        self._fim = threading.Event()
+        self._thread = threading.Thread(target=self._manter, name="ledger", daemon=True)
+        self._thread.start()
+
+    @staticmethod
+    def _garantir(conn):
+        cursor = conn.cursor()
+        garantir_particoes(cursor, meses_a_partir(datetime.date.today(), LEDGER_MESES_A_FRENTE + 1))
+        conn.commit()
+        cursor.close()
+
+    def _manter(self):
+        while not self._fim.wait(LEDGER_PARTICOES_VERIFICAR_S):
+            try:
+                self._banco.executar(self._garantir, tentativas=1)
+            except psycopg2.Error as e:
+                log.error("✗ Erro ao criar as partições do ledger: %s", e)
+
+    def parar(self):
+        """Encerra a thread."""
+        self._fim.set()
+        self._thread.join()
+
+
+def fonte_status(ledger_ativo):
+    """Subconsulta com as colunas de itens e o status em vigor (status_vigente) no esquema ativo."""
+    if ledger_ativo:
+        return ("(SELECT i.*, COALESCE(s.status, i.status) AS status_vigente "
+                "FROM itens i LEFT JOIN status_atual s ON s.item_id = i.id) f")
+    return "(SELECT i.*, i.status AS status_vigente FROM itens i) f"
+
+
+class ContadoresEstoque:
+    """
+    Contagem de itens por status e por categoria, em memória: cada toggle ajusta os
+    contadores e uma thread confere tudo com o banco (numa conexão do SupervisorBanco) a cada
+    CONTADORES_RECONCILIAR_S; com o banco fora na partida, tenta a cada segundo até conseguir. Painéis leem em
+    GET /contadores (painel.py) ou no retido de MQTT_TOPIC_CONTADORES, sem chegar ao Postgres.
+
+    O commit do toggle e o ajuste dos contadores acontecem dentro de confirmar(), e a
+    reconciliação só tira o snapshot do banco quando não há nenhum toggle entre os dois:
+    todo toggle ou está no snapshot e já foi aplicado, ou ficou fora dele e será aplicado
+    depois, por cima do valor conferido. Em cluster (várias instâncias), os toggles das
+    outras só chegam pela reconciliação, e a diferença não é um erro.
+
+    Um commit que levanta erro de conexão pode ter chegado ao banco. Os toggles dele ficam
+    em dúvida; quando o SupervisorBanco repete a leitura e o dedupe a acha já gravada, o
+    toggle em dúvida é aplicado, a não ser que um snapshot tirado depois da falha já o inclua.
+    """
+
+    def __init__(self, banco, ledger_ativo, mqtt_client=None, intervalo_s=CONTADORES_RECONCILIAR_S, cluster=False):
+        self._banco = banco
+        self._intervalo_s = intervalo_s
+        self._cluster = cluster
+        self._fonte = fonte_status(ledger_ativo)
+        self._mqtt = mqtt_client
+        self._lock = threading.Lock()
+        self._janela = threading.Condition()
+        self._confirmando = 0  # Toggles entre o commit e o ajuste dos contadores
+        self._snapshot_pendente = False
+        self._deltas = None  # Toggles aplicados desde o snapshot de uma reconciliação em curso
+        self._snapshots = 0
+        self._em_duvida = {}  # leitura -> (snapshots na falha do commit, item_id, anterior, novo)
+        self._por_status = {}
+        self._por_categoria = {}
+        self._categoria_item = {}
+        self._geracao = 0  # Muda a cada toggle aplicado e a cada reconciliação: há o que publicar
+        self._geracao_publicada = -1
+        self._reconciliado_em = None
+        self._falhas = 0
+        self._tem_categoria = None  # Conferido na primeira reconciliação
+        self.reconciliar()
+
+        self._fim = threading.Event()
+        self._thread = threading.Thread(target=self._manter, name="contadores", daemon=True)
+        self._thread.start()
+
+    @staticmethod
+    def _coluna_existe(conn, coluna):
+        cursor = conn.cursor()
+        cursor.execute("SELECT 1 FROM information_schema.columns WHERE table_name = 'itens' AND column_name = %s",
+                       (coluna,))
+        existe = cursor.fetchone() is not None
+        cursor.close()
+        conn.commit()
+        return existe
+
+    @staticmethod
+    def _somar(tabela, chave, delta):
+        tabela[chave] = tabela.get(chave, 0) + delta
+
+    def confirmar(self, conn, toggles, repetidas=()):
+        """
+        conn.commit() e os toggles [(leitura, item_id, anterior, novo)] nos contadores, sem
+        snapshot no meio. repetidas: leituras que o dedupe desta transação achou já gravadas.
+        """
+        with self._janela:
+            while self._snapshot_pendente:
+                self._janela.wait()
+            self._confirmando += 1
+        try:
+            try:
+                conn.commit()
+            except ERROS_CONEXAO:
+                with self._lock:
+                    for leitura, item_id, anterior, novo in toggles:
+                        if leitura is not None:
+                            self._em_duvida[leitura] = (self._snapshots, item_id, anterior, novo)
+                raise
+            for leitura, item_id, anterior, novo in toggles:
+                self.aplicar_toggle(item_id, anterior, novo)
+            with self._lock:
+                duvidas = [self._em_duvida.pop(leitura, None) for leitura, *_ in toggles] + \
+                          [self._em_duvida.pop(leitura, None) for leitura in repetidas]
+            for duvida in duvidas[len(toggles):]:
+                # O commit que falhou tinha chegado ao banco; se houve snapshot depois, ele já o contou
+                if duvida and duvida[0] == self._snapshots:
+                    self.aplicar_toggle(*duvida[1:])
+        finally:
+            with self._janela:
+                self._confirmando -= 1
+                self._janela.notify_all()
+
+    def _tirar_snapshot(self, cursor):
+        """Fixa o snapshot da transação de cursor (REPEATABLE READ) quando nenhum toggle está em confirmar()."""
+        cursor.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ READ ONLY")
+        with self._janela:
+            self._snapshot_pendente = True
+            try:
+                while self._confirmando:
+                    self._janela.wait()
+                cursor.execute("SELECT 1")  # A primeira consulta da transação fixa o snapshot
+                with self._lock:
+                    self._deltas = []  # Daqui em diante, tudo o que for aplicado está fora do snapshot
+                    self._snapshots += 1
+            finally:
+                self._snapshot_pendente = False
+                self._janela.notify_all()
+
+    def aplicar_toggle(self, item_id, anterior, novo):
+        with self._lock:
+            self._aplicar(self._por_status, self._por_categoria, self._categoria_item, item_id, anterior, novo)
+            if self._deltas is not None:
+                self._deltas.append((item_id, anterior, novo))
+            self._geracao += 1
+
+    @classmethod
+    def _aplicar(cls, por_status, por_categoria, categoria_item, item_id, anterior, novo):
+        cls._somar(por_status, anterior, -1)
+        cls._somar(por_status, novo, 1)
+        categoria = categoria_item.get(item_id)
+        if categoria is not None:
+            por_categoria_status = por_categoria.setdefault(categoria, {})
+            cls._somar(por_categoria_status, anterior, -1)
+            cls._somar(por_categoria_status, novo, 1)
+
+    def instantaneo(self):
+        with self._lock:
+            return {
+                "porStatus": dict(self._por_status),
+                "porCategoria": {c: dict(s) for c, s in self._por_categoria.items()},
+                "total": sum(self._por_status.values()),
+                "reconciliadoEm": self._reconciliado_em,
+            }
+
+    def reconciliar(self):
+        """
+        Recalcula tudo pelo banco, num snapshot tirado fora de qualquer confirmar(); os
+        toggles aplicados durante a consulta são somados por cima. Retorna False se o banco falhou.
+        """
+        try:
+            linhas = self._banco.executar(self._consultar, tentativas=1)
+        except psycopg2.Error as e:
+            # Tentada de novo a cada segundo: só a primeira falha de uma sequência vai como erro
+            (log.debug if self._falhas else log.error)("✗ Erro ao reconciliar contadores: %s", str(e).strip())
+            self._falhas += 1
+            with self._lock:
+                self._deltas = None
+            return False
+        if self._falhas:
+            log.info("✓ Contadores reconciliados de novo depois de %d falhas.", self._falhas)
+            self._falhas = 0
+
+        por_status, por_categoria, categoria_item = {}, {}, {}
+        for item_id, cat, status in linhas:
+            self._somar(por_status, status, 1)
+            if cat is not None:
+                self._somar(por_categoria.setdefault(cat, {}), status, 1)
+                categoria_item[item_id] = cat
+
+        with self._lock:
+            for delta in self._deltas or ():
+                self._aplicar(por_status, por_categoria, categoria_item, *delta)
+            self._deltas = None
+            if self._reconciliado_em and (por_status != self._por_status or por_categoria != self._por_categoria):
+                if self._cluster:
+                    log.debug("Contadores atualizados com os toggles das outras instâncias: %s -> %s",
+                              self._por_status, por_status)
+                else:
+                    log.warning("Contadores divergiam do banco: memória %s, banco %s", self._por_status, por_status)
+            self._por_status, self._por_categoria, self._categoria_item = por_status, por_categoria, categoria_item
+            self._reconciliado_em = datetime.datetime.now().isoformat(timespec="seconds")
+            self._geracao += 1  # Força a publicação do valor conferido
+        return True
+
+    def _consultar(self, conn):
+        if self._tem_categoria is None:
+            self._tem_categoria = self._coluna_existe(conn, CONTADORES_COLUNA_CATEGORIA)
+        categoria = CONTADORES_COLUNA_CATEGORIA if self._tem_categoria else "NULL"
+        cursor = conn.cursor()
+        self._tirar_snapshot(cursor)
+        cursor.execute(f"SELECT id, {categoria}, status_vigente FROM {self._fonte} WHERE status_vigente IS NOT NULL")
+        linhas = cursor.fetchall()
+        cursor.close()
+        conn.commit()
+        return linhas
+
+    def _manter(self):
+        proxima = time.monotonic() + self._intervalo_s if self._reconciliado_em else 0.0
+        while not self._fim.wait(CONTADORES_PUBLICAR_S):
+            if time.monotonic() >= proxima:
+                # Se o banco falhou, tenta na próxima volta, um segundo depois
+                if self.reconciliar():
+                    proxima = time.monotonic() + self._intervalo_s
+            with self._lock:
+                geracao = self._geracao
+            if self._mqtt and geracao != self._geracao_publicada:
+                self._mqtt.publish(MQTT_TOPIC_CONTADORES, json.dumps(self.instantaneo()), qos=1, retain=True)
+                self._geracao_publicada = geracao
+
+    def parar(self):
+        self._fim.set()
+        self._thread.join()
+
+
+def ler_nomes(caminho):
+    """Nomes dos itens, um por linha (primeira coluna do CSV), na ordem em que as tags serão lidas."""
+    with open(caminho, newline="", encoding="utf-8") as arquivo:
+        nomes = [linha[0].strip() for linha in csv.reader(arquivo) if linha and linha[0].strip()]
+    if nomes and nomes[0].lower() == "nome":
+        nomes = nomes[1:]  # Cabeçalho
+    return nomes
+
+
+class CadastroEmLote:
+    """
+    Modo cadastro: cada UID nova recebe, na ordem de chegada, o próximo nome da lista
+    e vai para uma fila. Uma thread com conexão própria junta até CADASTRO_LOTE tags
+    (no máximo CADASTRO_INTERVALO_S depois da primeira), copia o lote com COPY para uma
+    tabela temporária e dali insere em itens só as UIDs que ainda não existem: uma tag
+    cadastrada por fora no meio da sessão não derruba o lote inteiro.
+    """
+
+    def __init__(self, conn, nomes=None):
+        self._conn = conn
+        self._nomes = nomes
+        self._proximo_nome = 0
+        cursor = conn.cursor()
+        cursor.execute("SELECT UPPER(TRIM(rfid)) FROM itens WHERE rfid IS NOT NULL")
+        self._conhecidas = {linha[0] for linha in cursor.fetchall()}
+        cursor.close()
+        self._criar_tabela_lote()
+        self._lock = threading.Lock()  # _conhecidas e _reservados: thread do MQTT e a do cadastro
+        self._reservados = {}  # UID recusada pelo banco -> o nome que ela já tinha recebido
+        self._sessao = {}  # UID cadastrada nesta sessão -> nome, para avisar de uma leitura repetida
+        self.recebidas = 0
+        self.repetidas = 0
+        self.gravadas = 0
+        self._primeira = None
+        self._ultima = None
+        self._fila = queue.SimpleQueue()
+        self._thread = threading.Thread(target=self._escrever, name="cadastro", daemon=True)
+        self._thread.start()
+
+    @property
+    def completo(self):
+        """Todos os nomes da lista já foram atribuídos."""
+        return self._nomes is not None and self._proximo_nome >= len(self._nomes)
+
+    def adicionar(self, uid):
+        """
+        Chamado pela thread do MQTT, na ordem das leituras. Retorna False se a UID já
+        existe (reentrega, tag já cadastrada) ou se não há mais nomes. Uma UID que já recebeu
+        nome nesta sessão é avisada e contada em repetidas, não descartada calada. Uma UID que o
+        banco recusou volta com o mesmo nome.
+        """
+        uid = uid.strip().upper()
+        with self._lock:
+            if uid in self._conhecidas:
+                if uid in self._sessao:
+                    self.repetidas += 1
+                    log.warning("! Tag %s já lida nesta sessão como '%s'; não recebe outro nome.",
+                                uid, self._sessao[uid])
+                return False
+            nome = self._reservados.pop(uid, None)
+            if nome is None:
+                if self.completo:
+                    return False
+                if self._nomes is None:
+                    nome = f"Item {uid}"
+                else:
+                    nome = self._nomes[self._proximo_nome]
+                    self._proximo_nome += 1
+            self._conhecidas.add(uid)
+            self._sessao[uid] = nome
+        agora = time.monotonic()
+        if self._primeira is None:
+            self._primeira = agora
+        self._ultima = agora
+        self.recebidas += 1
+        self._fila.put((uid, nome))
+        return True
+
+    def _devolver(self, tags):
+        """Desfaz adicionar() das tags que o banco recusou: uma nova leitura as cadastra com o mesmo nome."""
+        with self._lock:
+            for uid, nome in tags:
+                self._conhecidas.discard(uid)
+                self._sessao.pop(uid, None)
+                self._reservados[uid] = nome
+                log.error("✗ Tag %s ('%s') não cadastrada; reinicie a sessão no leitor e aproxime-a de novo.",
+                          uid, nome)
+
+    def _criar_tabela_lote(self):
+        # Temporária: existe só nesta sessão, então é recriada quando a conexão é refeita
+        cursor = self._conn.cursor()
+        cursor.execute("CREATE TEMP TABLE IF NOT EXISTS cadastro_lote (rfid text, nome text) ON COMMIT DELETE ROWS")
+        self._conn.commit()
+        cursor.close()
+
+    @staticmethod
+    def _inserir_uma_a_uma(conn, lote):
+        """
+        Depois de um erro que não é de conexão (um nome ou UID que o banco recusa): cada tag
+        no seu SAVEPOINT, para que só a recusada fique de fora. Retorna (inseridas, recusadas).
+        """
+        cursor = conn.cursor()
+        inseridas, recusadas = 0, []
+        for uid, nome in lote:
+            cursor.execute("SAVEPOINT tag")
+            try:
+                cursor.execute("""
+                    INSERT INTO itens (nome, status, rfid, ultima_atualizacao)
+                    SELECT %s, %s, %s, now()
+                    WHERE NOT EXISTS (SELECT 1 FROM itens i WHERE UPPER(TRIM(i.rfid)) = %s)""",
+                               (nome, CADASTRO_STATUS_INICIAL, uid, uid))
+                inseridas += cursor.rowcount
+            except ERROS_CONEXAO:
+                raise
+            except psycopg2.Error as e:
+                cursor.execute("ROLLBACK TO SAVEPOINT tag")
+                log.warning("Tag %s recusada pelo banco: %s", uid, str(e).strip())
+                recusadas.append((uid, nome))
+        conn.commit()
+        cursor.close()
+        return inseridas, recusadas
+
+    def _gravar(self, lote):
+        """Retorna False se o banco ficou fora em todas as tentativas: o lote continua na fila."""
+        dados = io.StringIO()
+        csv.writer(dados).writerows(lote)
+        inicio = time.perf_counter()
+        inseridas, recusadas = None, []
+        # Repetir é seguro: o INSERT só leva as UIDs que ainda não estão em itens
+        for tentativa in range(BANCO_TENTATIVAS):
+            conn = conexao_viva(self._conn)
+            try:
+                if conn is not self._conn:
+                    self._conn = conn
+                    self._criar_tabela_lote()
+                dados.seek(0)
+                cursor = conn.cursor()
+                try:
+                    cursor.copy_expert("COPY cadastro_lote (rfid, nome) FROM STDIN WITH (FORMAT csv)", dados)
+                    cursor.execute("""
+                        INSERT INTO itens (nome, status, rfid, ultima_atualizacao)
+                        SELECT c.nome, %s, c.rfid, now() FROM cadastro_lote c
+                        WHERE NOT EXISTS (SELECT 1 FROM itens i WHERE UPPER(TRIM(i.rfid)) = c.rfid)""",
+                                   (CADASTRO_STATUS_INICIAL,))
+                    inseridas = cursor.rowcount
+                    conn.commit()
+                except ERROS_CONEXAO:
+                    raise
+                except psycopg2.Error as e:
+                    log.warning("Lote de %d tags recusado (%s); gravando uma a uma", len(lote), str(e).strip())
+                    desfazer(conn)
+                    inseridas, recusadas = self._inserir_uma_a_uma(conn, lote)
+                cursor.close()
+                break
+            except ERROS_CONEXAO as e:
+                log.warning("Conexão do cadastro caiu (%s); nova tentativa", str(e).strip())
+                desfazer(conn)
+                time.sleep(espera_backoff(tentativa))
+            except psycopg2.Error as e:
+                log.error("✗ Erro ao cadastrar lote de %d tags: %s", len(lote), e)
+                desfazer(conn)
+                recusadas = lote
+                inseridas = 0
+                break
+        if inseridas is None:
+            log.error("✗ Banco fora do ar: lote de %d tags fica na fila para a próxima tentativa.", len(lote))
+            return False
+        self._devolver(recusadas)
+        self.gravadas += inseridas
+        log.info("✓ Lote de %d tags cadastrado em %.0f ms (%d já existiam, %d recusadas); total %d",
+                 len(lote), (time.perf_counter() - inicio) * 1e3, len(lote) - len(recusadas) - inseridas,
+                 len(recusadas), self.gravadas)
+        return True
+
+    def _escrever(self):
+        lote = []
+        prazo = 0.0
+        while True:
+            try:
+                espera = max(0.0, prazo - time.monotonic()) if lote else None
+                item = self._fila.get(timeout=espera)
+            except queue.Empty:
+                item = ()  # Prazo do lote venceu
+            if item is None:
+                break
+            if item:
+                if not lote:
+                    prazo = time.monotonic() + CADASTRO_INTERVALO_S
+                lote.append(item)
+            if len(lote) >= CADASTRO_LOTE or (lote and time.monotonic() >= prazo):
+                if self._gravar(lote):
+                    lote = []
+                else:
+                    prazo = time.monotonic() + BANCO_VERIFICAR_S  # Junta o que chegar e tenta de novo
+        if lote and not self._gravar(lote):
+            self._devolver(lote)
+
+    def tags_por_minuto(self):
+        """Ritmo da sessão, da primeira à última tag lida."""
+        if self.recebidas < 2 or self._ultima == self._primeira:
+            return 0.0
+        return (self.recebidas - 1) * 60 / (self._ultima - self._primeira)
+
+    def parar(self):
+        """Grava o lote pendente, encerra a thread, fecha a conexão e relata o ritmo."""
+        self._fila.put(None)
+        self._thread.join()
+        self._conn.close()
+        log.info("Cadastro: %d tags lidas, %d gravadas, %d leituras repetidas, %.0f tags/min", self.recebidas,
+                 self.gravadas, self.repetidas, self.tags_por_minuto())
+
+
+def sessao_leitores(client, prefixo, leitores, ligar):
+    """Liga ou desliga o modo (cadastro ou auditoria) nos leitores. Retido: num reboot o leitor volta no modo certo."""
+    for leitor in leitores:
+        client.publish(prefixo + leitor, "1" if ligar else "0", qos=1, retain=True)
+
+
+def sair_da_sessao(client, prefixo, leitores):
+    """Desliga o modo nos leitores e desconecta; o loop do MQTT entrega os "0" antes do DISCONNECT."""
+    sessao_leitores(client, prefixo, leitores, False)
+    client.disconnect()
+
+
+def guardas_de_sessao(prefixo, leitores):
+    """
+    Um cliente MQTT ocioso por leitor, com will "0" retido no tópico do modo: se o receptor
+    morrer sem desligar a sessão, o broker a desliga por ele e o leitor volta ao normal.
+    O will é um só por conexão, daí uma conexão por leitor.
+    """
+    guardas = []
+    for leitor in leitores:
+        guarda = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=f"receptor-sessao-{leitor}")
+        guarda.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+        guarda.will_set(prefixo + leitor, "0", qos=1, retain=True)
+        guarda.connect(MQTT_BROKER_URL, 1883, 60)
+        guarda.loop_start()
+        guardas.append(guarda)
+    return guardas
+
+
+def encerrar_guardas(guardas, prefixo, leitores):
+    """Saída limpa (sem will): cada guarda publica o "0" do seu leitor, caso o cliente principal não tenha conseguido."""
+    for guarda, leitor in zip(guardas, leitores):
+        envio = guarda.publish(prefixo + leitor, "0", qos=1, retain=True)
+        if envio.rc == mqtt.MQTT_ERR_SUCCESS:
+            envio.wait_for_publish(timeout=1.0)
+        guarda.disconnect()
+        guarda.loop_stop()
+
+
+def _bits(valor, tamanho):
+    """Posições dos bits ligados de um bitmap em int (little-endian), sem percorrer bit a bit."""
+    dados = valor.to_bytes(tamanho, "little")
+    for indice, byte in enumerate(dados):
+        while byte:
+            baixo = byte & -byte
+            yield indice * 8 + baixo.bit_length() - 1
+            byte ^= baixo
+
+
+class Auditoria:
+    """
+    Sessão de auditoria: os leitores só informam as tags vistas, sem alternar nada.
+    As tags vistas ficam num bitmap indexado pelo id do item (bytearray, 1 bit por id);
+    o inventário esperado (status AUDITORIA_STATUS_ESPERADO) e o existente viram outros
+    dois bitmaps a cada releitura. A reconciliação é feita com operações de int sobre os
+    bitmaps inteiros, em C, de modo que 100 mil itens custam alguns milissegundos além
+    da consulta:
+      faltando    = esperado & ~visto
+      status      = visto & existente & ~esperado  (na prateleira, mas constava emprestado)
+      inesperadas = UIDs sem item no banco (conjunto à parte: não têm id)
+    Cada leitura já é classificada na chegada; as listas completas saem a cada
+    AUDITORIA_RECONCILIAR_S, quando o inventário é relido.
+    """
+
+    def __init__(self, conn, ledger_ativo, mqtt_client=None):
+        self._conn = conn
+        self._fonte = fonte_status(ledger_ativo)
+        self._mqtt = mqtt_client
+        self._lock = threading.Lock()
+        self._visto = bytearray()
+        self._inesperadas = set()
+        self._uid_item = {}
+        self._itens = {}
+        self._esperado = 0
+        self._existente = 0
+        self.leituras = 0
+        self.ultimo_resumo = None
+        self.listas = {}
+        self.carregar(self._ler_inventario())
+        self._fim = threading.Event()
+        self._thread = None
+
+    def iniciar(self):
+        """Liga a reconciliação periódica."""
+        self._thread = threading.Thread(target=self._manter, name="auditoria", daemon=True)
+        self._thread.start()
+
+    def _ler_inventario(self):
+        self._conn = conexao_viva(self._conn)
+        cursor = self._conn.cursor()
+        cursor.execute(f"SELECT id, UPPER(TRIM(rfid)), nome, status_vigente FROM {self._fonte}")
+        linhas = cursor.fetchall()
+        cursor.close()
+        self._conn.commit()
+        return linhas
+
+    def carregar(self, linhas):
+        """Monta os bitmaps do inventário (id, rfid, nome, status); o que já foi visto é mantido."""
+        tamanho = (max((linha[0] for linha in linhas), default=0) >> 3) + 1
+        esperado = bytearray(tamanho)
+        existente = bytearray(tamanho)
+        uid_item = {}
+        itens = {}
+        for item_id, rfid, nome, status in linhas:
+            existente[item_id >> 3] |= 1 << (item_id & 7)
+            if status == AUDITORIA_STATUS_ESPERADO:
+                esperado[item_id >> 3] |= 1 << (item_id & 7)
+            if rfid:
+                uid_item[rfid] = item_id
+            itens[item_id] = (rfid, nome, status)
+        with self._lock:
+            if len(self._visto) < tamanho:
+                self._visto.extend(bytes(tamanho - len(self._visto)))
+            self._uid_item, self._itens = uid_item, itens
+            self._esperado = int.from_bytes(esperado, "little")
+            self._existente = int.from_bytes(existente, "little")
+            # Uma tag desconhecida pode ter sido cadastrada no meio da sessão
+            for uid in [u for u in self._inesperadas if u in uid_item]:
+                self._inesperadas.discard(uid)
+                self._marcar(uid_item[uid])
+
+    def _marcar(self, item_id):
+        indice, bit = item_id >> 3, 1 << (item_id & 7)
+        if indice >= len(self._visto):
+            self._visto.extend(bytes(indice + 1 - len(self._visto)))
+        novo = not self._visto[indice] & bit
+        self._visto[indice] |= bit
+        return novo
+
+    def registrar(self, uid):
+        """
+        Marca a tag como vista e a classifica na hora: 'ok', 'status' (constava emprestada),
+        'inesperada' (sem item no banco) ou 'repetida'.
+        """
+        uid = uid.strip().upper()
+        with self._lock:
+            self.leituras += 1
+            item_id = self._uid_item.get(uid)
+            if item_id is None:
+                if uid in self._inesperadas:
+                    return "repetida"
+                self._inesperadas.add(uid)
+                return "inesperada"
+            if not self._marcar(item_id):
+                return "repetida"
+            return "ok" if self._esperado >> item_id & 1 else "status"
+
+    def reconciliar(self, recarregar=True):
+        """Relê o inventário (opcional) e recalcula as três listas. Retorna o resumo."""
+        inicio = time.perf_counter()
+        if recarregar:
+            self.carregar(self._ler_inventario())
+        consulta_ms = (time.perf_counter() - inicio) * 1e3
+
+        inicio = time.perf_counter()
+        with self._lock:
+            visto = int.from_bytes(self._visto, "little")
+            tamanho = len(self._visto)
+            esperado, existente = self._esperado, self._existente
+            inesperadas = sorted(self._inesperadas)
+            itens = self._itens
+        faltando = esperado & ~visto
+        status = visto & existente & ~esperado
+        resumo = {
+            "esperados": esperado.bit_count(),
+            "conferidos": (esperado & visto).bit_count(),
+            "faltando": faltando.bit_count(),
+            "statusErrado": status.bit_count(),
+            "inesperadas": len(inesperadas),
+            "leituras": self.leituras,
+        }
+        conjuntos_ms = (time.perf_counter() - inicio) * 1e3
+        resumo["reconciliacaoMs"] = round(consulta_ms + conjuntos_ms, 1)
+
+        self.ultimo_resumo = resumo
+        self.listas = {
+            "faltando": [(i,) + itens[i] for i in _bits(faltando, tamanho)],
+            "status": [(i,) + itens[i] for i in _bits(status, tamanho)],
+            "inesperada": [(None, uid, None, None) for uid in inesperadas],
+        }
+        log.info("Auditoria: %d/%d conferidos, %d faltando, %d com status errado, %d inesperadas "
+                 "(consulta %.0f ms + conjuntos %.1f ms)", resumo["conferidos"], resumo["esperados"],
+                 resumo["faltando"], resumo["statusErrado"], resumo["inesperadas"], consulta_ms, conjuntos_ms)
+        if self._mqtt:
+            self._mqtt.publish(MQTT_TOPIC_AUDITORIA_RESUMO, json.dumps(resumo), qos=1, retain=True)
+        return resumo
+
+    def _manter(self):
+        while not self._fim.wait(AUDITORIA_RECONCILIAR_S):
+            try:
+                self.reconciliar()
+            except psycopg2.Error as e:
+                log.error("✗ Erro ao reler o inventário da auditoria: %s", e)
+                desfazer(self._conn)
+
+    def parar(self, relatorio=None):
+        """Encerra a thread, faz a reconciliação final, grava o relatório (CSV) e fecha a conexão."""
+        self._fim.set()
+        if self._thread:
+            self._thread.join()
+        self.reconciliar()
+        for tipo, linhas in self.listas.items():
+            for item_id, rfid, nome, _ in linhas[:AUDITORIA_LISTAR_MAX]:
+                log.info("  %-10s %s %s %s", tipo, item_id if item_id is not None else "-", rfid, nome or "")
+            if len(linhas) > AUDITORIA_LISTAR_MAX:
+                log.info("  %-10s ... e mais %d", tipo, len(linhas) - AUDITORIA_LISTAR_MAX)
+        if relatorio:
+            with open(relatorio, "w", newline="", encoding="utf-8") as arquivo:
+                escritor = csv.writer(arquivo)
+                escritor.writerow(["situacao", "id", "rfid", "nome", "status"])
+                for tipo, linhas in self.listas.items():
+                    escritor.writerows([tipo] + list(linha) for linha in linhas)
+            log.info("Relatório da auditoria gravado em %s", relatorio)
+        self._conn.close()
+
+
+class Escalonador:
+    """
+    Filas das faixas de tráfego. O callback do paho só classifica a mensagem pelo tópico e a
+    enfileira; quem processa são duas threads. A da faixa interativa atende só a ela, na
+    conexão reservada do banco: um toque no balcão espera no máximo o toque anterior, nunca
+    um lote de carga. A compartilhada divide-se entre carga e telemetria por rodízio ponderado
+    suave (FAIXA_PESOS; com 4/1 e as duas cheias, 4 de cada 5 escolhas vão para a carga, sem
+    rajadas de uma faixa só) e pula a faixa vazia. Cada faixa roda uma mensagem por vez, na
+    ordem de chegada, como o receptor fazia com todas antes.
+    """
+
+    def __init__(self, pesos=FAIXA_PESOS):
+        self._pesos = dict(pesos)
+        self._filas = {faixa: collections.deque() for faixa in (FAIXA_INTERATIVA, *pesos)}
+        self._credito = dict.fromkeys(pesos, 0)
+        self._cond = threading.Condition()
+        self._fim = False
+        self.esperas = {faixa: collections.deque(maxlen=FAIXA_AMOSTRAS) for faixa in self._filas}
+        self.processadas = collections.Counter()
+        self.descartadas = collections.Counter()
+        self._threads = [threading.Thread(target=self._trabalhar, args=((FAIXA_INTERATIVA,),),
+                                          name="faixa-interativa", daemon=True),
+                         threading.Thread(target=self._trabalhar, args=(tuple(pesos),),
+                                          name="faixa-compartilhada", daemon=True)]
+        for thread in self._threads:
+            thread.start()
+
+    def enfileirar(self, faixa, funcao, *args):
+        """funcao(*args, reservada=...) na thread da faixa. Retorna False se a fila estiver cheia."""
+        with self._cond:
+            fila = self._filas[faixa]
+            if len(fila) >= FAIXA_FILA_MAX:
+                self.descartadas[faixa] += 1
+                return False
+            fila.append((time.perf_counter(), funcao, args))
+            self._cond.notify_all()
+        return True
+
+    def _proxima(self, faixas):
+        with self._cond:
+            while True:
+                cheias = [faixa for faixa in faixas if self._filas[faixa]]
+                if cheias:
+                    break
+                if self._fim:
+                    return None
+                self._cond.wait()
+            escolhida = cheias[0]
+            if len(cheias) > 1:
+                # Cada faixa com fila ganha seu peso em crédito; a de maior crédito paga o total
+                for faixa in cheias:
+                    self._credito[faixa] += self._pesos[faixa]
+                escolhida = max(cheias, key=self._credito.get)
+                self._credito[escolhida] -= sum(self._pesos[faixa] for faixa in cheias)
+            return escolhida, self._filas[escolhida].popleft()
+
+    def _trabalhar(self, faixas):
+        while True:
+            proxima = self._proxima(faixas)
+            if proxima is None:
+                return
+            faixa, (enfileirada, funcao, args) = proxima
+            self.esperas[faixa].append(time.perf_counter() - enfileirada)
+            try:
+                funcao(*args, reservada=faixa == FAIXA_INTERATIVA)
+            except Exception as e:
+                log.error("✗ Erro na faixa %s: %s", faixa, e)
+            self.processadas[faixa] += 1
+
+    def relatorio(self):
+        for faixa, esperas in self.esperas.items():
+            if not self.processadas[faixa] and not self.descartadas[faixa]:
+                continue
+            ordenadas = sorted(esperas) or [0.0]
+            log.info("Faixa %s: %d mensagens, %d descartadas; espera na fila p50=%.1f ms p99=%.1f ms",
+                     faixa, self.processadas[faixa], self.descartadas[faixa],
+                     ordenadas[len(ordenadas) // 2] * 1e3, ordenadas[len(ordenadas) * 99 // 100] * 1e3)
+
+    def parar(self):
+        """Processa o que já está nas filas e encerra as threads."""
+        with self._cond:
+            self._fim = True
+            self._cond.notify_all()
+        for thread in self._threads:
+            thread.join()
+        self.relatorio()
+
+
+def registrar_leitura(cursor, leitura):
+    """
+    Marca a leitura (leitorId, boot, seq) como processada, na mesma transação do toggle.
+    Retorna False se ela já foi processada: reentrega do QoS 1, reenvio do leitor ou
+    outra instância durante um rebalanceamento. Leituras sem seq (firmware antigo) passam.
+    """
+    if leitura is None:
+        return True
+    executar(cursor, "registrar_leitura", leitura)
+    return cursor.rowcount == 1
+
+
+def alternar_item(cursor, uid, leitura, ledger, momento, movimentacoes=None):
+    """
+    Núcleo do toggle, dentro da transação de quem chama: trava o item, marca a leitura e
+    grava o novo status (com ledger, também a movimentação; se movimentacoes for uma lista,
+    a linha vai para ela e quem chama a insere antes do commit). Retorna (item_id, nome,
+    anterior, novo), com novo igual a anterior numa leitura repetida, ou None se nenhum
+    item tem essa UID.
+    """
+    # FOR UPDATE: duas instâncias nunca alternam o mesmo item ao mesmo tempo
+    executar(cursor, "item", (uid,))
+    item = cursor.fetchone()
+    if not item:
         return None
+    item_id, nome_item, status_atual = item
+    if ledger:
+        executar(cursor, "status_ledger", (item_id,))
+        vigente = cursor.fetchone()
+        if vigente:
+            status_atual = vigente[0]
+    if not registrar_leitura(cursor, leitura):
+        return item_id, nome_item, status_atual, status_atual
+
+    novo_status = "Emprestado" if status_atual == "Disponivel" else "Disponivel"
+    leitor_id = leitura[0] if leitura else None
+    if ledger:
+        executar(cursor, "status_atual", (item_id, novo_status, momento, leitor_id))
+        movimentacao = (item_id, uid, novo_status, leitor_id, momento)
+        if movimentacoes is None:
+            executar(cursor, "movimentacao", movimentacao)
+        else:
+            movimentacoes.append(movimentacao)
+    else:
+        executar(cursor, "itens_status", (novo_status, momento, uid))
+    return item_id, nome_item, status_atual, novo_status
+
+
+def confirmar_toggles(conn, contadores, toggles, repetidas):
+    """
+    Commit do toggle; com contadores, o ajuste deles vai junto, fora de qualquer reconciliação.
+    toggles: [(leitura, item_id, anterior, novo)]; repetidas: leituras que o dedupe barrou.
+    """
+    if contadores:
+        contadores.confirmar(conn, toggles, repetidas)
+    else:
+        conn.commit()
+
+
+def eco_da_leitura(leitura):
+    """leitorId e seq da leitura, ecoados na resposta: quem mede a latência pareia por eles (o firmware os ignora)."""
+    return {"leitorId": leitura[0], "seq": leitura[2]} if leitura else {}
+
 
-def atualizar_status_item(conn, uid, mqtt_client):
+def atualizar_status_item(conn, uid, mqtt_client, leitura=None, ledger=None, contadores=None,
+                          topico_resposta=MQTT_TOPIC_RESPONSE):
     """
-    Verifica o status, alterna, e envia respostas para os tópicos corretos,
-    tratando os caracteres para o LCD.
+    Verifica o status, alterna, e envia respostas para os tópicos corretos (a resposta vai
+    para topico_resposta: a leitura de carga tem o seu), tratando os caracteres para o LCD. Uma leitura repetida não alterna de novo:
+    só reenvia o status atual. Com ledger, o status vive em status_atual e cada
+    toggle vira uma linha em movimentacoes, na mesma transação; a linha de itens não é
+    reescrita (itens.status fica com o valor de antes do ledger: use itens_com_status).
+    Se a conexão cair, o erro sobe para o SupervisorBanco repetir a leitura.
     """
     if not conn:
         return
@@ -55,87 +1461,480 @@ def atualizar_status_item(conn, uid, mqtt_client):
 
     try:
         cursor = conn.cursor()
-        sql_select = "SELECT nome, status FROM itens WHERE UPPER(TRIM(rfid)) = UPPER(%s)"
-        cursor.execute(sql_select, (uid_limpo,))
-        item = cursor.fetchone()
+        item = alternar_item(cursor, uid_limpo, leitura, ledger, timestamp_atual)
 
         if item:
-            nome_item, status_atual = item[0], item[1]
-            novo_status = "Emprestado" if status_atual == "Disponivel" else "Disponivel"
-
-            sql_update = "UPDATE itens SET status = %s, ultima_atualizacao = %s WHERE UPPER(TRIM(rfid)) = UPPER(%s)"
-            cursor.execute(sql_update, (novo_status, timestamp_atual, uid_limpo))
-            conn.commit()
-            print(f"✓ ATUALIZADO NO BANCO: Item '{nome_item}' alterado para '{novo_status}'.")
+            item_id, nome_item, status_atual, novo_status = item
+            alternou = novo_status != status_atual
+            confirmar_toggles(conn, contadores, [(leitura, item_id, status_atual, novo_status)] if alternou else [],
+                              [leitura] if not alternou and leitura else [])
+            if alternou:
+                log.info("✓ ATUALIZADO NO BANCO: Item '%s' alterado para '%s'.", nome_item, novo_status)
+            else:
+                log.info("= Leitura repetida %s ignorada: item '%s' continua '%s'.", leitura, nome_item, novo_status)
 
             nome_limpo_para_lcd = limpar_para_lcd(nome_item)
             status_limpo_para_lcd = limpar_para_lcd(novo_status)
 
-            response_payload_lcd = json.dumps({"nome": nome_limpo_para_lcd, "status": status_limpo_para_lcd})
-            mqtt_client.publish(MQTT_TOPIC_RESPONSE, response_payload_lcd)
-            print(f"✓ Resposta de sucesso ('{nome_limpo_para_lcd}', '{status_limpo_para_lcd}') enviada para o ESP32.")
+            response_payload_lcd = json.dumps({"nome": nome_limpo_para_lcd, "status": status_limpo_para_lcd,
+                                               **eco_da_leitura(leitura)})
+            mqtt_client.publish(topico_resposta, response_payload_lcd)
+            log.debug("✓ Resposta de sucesso ('%s', '%s') enviada para o ESP32.", nome_limpo_para_lcd, status_limpo_para_lcd)
 
         else:
-            print(f"✗ Item não encontrado no banco para o UID: {uid_limpo}")
+            log.warning("✗ Item não encontrado no banco para o UID: %s", uid_limpo)
             
-            response_payload_lcd = json.dumps({"erro": "Nao cadastrado"})
-            mqtt_client.publish(MQTT_TOPIC_RESPONSE, response_payload_lcd)
-            print(f"✓ Resposta de 'não cadastrado' enviada para o ESP32.")
+            response_payload_lcd = json.dumps({"erro": "Nao cadastrado", **eco_da_leitura(leitura)})
+            mqtt_client.publish(topico_resposta, response_payload_lcd)
+            log.debug("✓ Resposta de 'não cadastrado' enviada para o ESP32.")
 
             response_payload_notfound = json.dumps({"uid": uid_limpo, "hora": timestamp_atual.strftime("%H:%M:%S")})
             mqtt_client.publish(MQTT_TOPIC_NOT_FOUND, response_payload_notfound)
-            print(f"✓ Alerta de UID não encontrado enviado para o tópico '{MQTT_TOPIC_NOT_FOUND}'.")
+            log.debug("✓ Alerta de UID não encontrado enviado para o tópico '%s'.", MQTT_TOPIC_NOT_FOUND)
         
         cursor.close()
+    except ERROS_CONEXAO:
+        raise
     except psycopg2.Error as e:
-        print(f"✗ Erro ao interagir com o banco de dados: {e}")
+        log.error("✗ Erro ao interagir com o banco de dados: %s", e)
         conn.rollback()
 
+def alternar_lote(conn, registros, leitor_id, boot, ledger, contadores, momento, por_item=False):
+    """
+    Os toggles do lote numa transação, em ordem de UID, e o commit. Com por_item, cada leitura
+    vai no seu SAVEPOINT: a que o banco recusa fica de fora, sem levar as outras junto.
+    Retorna ([(uid, leitura, item)], [uids recusadas]).
+    """
+    cursor = conn.cursor()
+    resultados, recusadas = [], []
+    movimentacoes = None if por_item else []
+    for registro in sorted(registros, key=lambda r: r['uid'].strip().upper()):
+        uid_limpo = registro['uid'].strip()
+        leitura = (leitor_id, boot, registro['seq']) if 'seq' in registro else None
+        if not por_item:
+            resultados.append((uid_limpo, leitura, alternar_item(cursor, uid_limpo, leitura, ledger,
+                                                                 momento, movimentacoes)))
+            continue
+        cursor.execute("SAVEPOINT leitura")
+        try:
+            resultados.append((uid_limpo, leitura, alternar_item(cursor, uid_limpo, leitura, ledger, momento)))
+        except ERROS_CONEXAO:
+            raise
+        except psycopg2.Error as e:
+            cursor.execute("ROLLBACK TO SAVEPOINT leitura")
+            log.warning("✗ Leitura de %s no lote de %s recusada pelo banco: %s", uid_limpo, leitor_id, str(e).strip())
+            recusadas.append(uid_limpo)
+    if movimentacoes:
+        psycopg2.extras.execute_values(
+            cursor, "INSERT INTO movimentacoes (item_id, rfid, status, leitor_id, momento) VALUES %s",
+            movimentacoes)
+    confirmar_toggles(conn, contadores,
+                      [(leitura, item[0], item[2], item[3]) for _, leitura, item in resultados
+                       if item and item[3] != item[2]],
+                      [leitura for _, leitura, item in resultados if item and item[3] == item[2] and leitura])
+    cursor.close()
+    return resultados, recusadas
+
+
+def atualizar_lote(conn, registros, mqtt_client, leitor_id, boot, ledger=None, contadores=None,
+                   topico_resposta=MQTT_TOPIC_RESPONSE):
+    """
+    Lote do leitor (uma bandeja, toques seguidos): todos os toggles numa transação e uma
+    resposta só, com o resumo para o LCD. Os itens são travados em ordem de UID, para que dois
+    lotes com itens em comum não se travem. Cada leitura passa pelo dedupe como as avulsas:
+    um lote reentregue só reenvia o resumo. Se a conexão cair no meio, nada foi gravado e o
+    SupervisorBanco repete o lote inteiro. Um erro que não é de conexão refaz o lote leitura
+    a leitura, e as recusadas vão no resumo como falhas; se nem assim houver commit, o leitor
+    recebe um erro em vez do silêncio.
+    """
+    if not conn:
+        return
+    timestamp_atual = datetime.datetime.now().replace(microsecond=0)
+    # Só o resumo: a lista de nomes passaria do buffer de entrada do MQTT no ESP32. A seq ecoada é a maior do lote
+    seqs = [registro['seq'] for registro in registros if 'seq' in registro]
+    eco = eco_da_leitura((leitor_id, boot, max(seqs)) if seqs else None)
+
+    try:
+        try:
+            resultados, recusadas = alternar_lote(conn, registros, leitor_id, boot, ledger, contadores,
+                                                  timestamp_atual)
+        except ERROS_CONEXAO:
+            raise
+        except psycopg2.Error as e:
+            log.error("✗ Erro ao gravar o lote de %s: %s; refazendo leitura a leitura.", leitor_id, str(e).strip())
+            conn.rollback()
+            resultados, recusadas = alternar_lote(conn, registros, leitor_id, boot, ledger, contadores,
+                                                  timestamp_atual, por_item=True)
+    except ERROS_CONEXAO:
+        raise
+    except psycopg2.Error as e:
+        log.error("✗ Lote de %s não gravado: %s", leitor_id, str(e).strip())
+        desfazer(conn)
+        mqtt_client.publish(topico_resposta, json.dumps({"erro": "Falha no banco", **eco}))
+        return
+
+    contagem = collections.Counter()
+    for uid_limpo, _, item in resultados:
+        if item is None:
+            contagem["erros"] += 1
+            log.warning("✗ Item não encontrado no banco para o UID: %s (lote)", uid_limpo)
+            mqtt_client.publish(MQTT_TOPIC_NOT_FOUND, json.dumps(
+                {"uid": uid_limpo, "hora": timestamp_atual.strftime("%H:%M:%S")}))
+            continue
+        item_id, nome_item, status_atual, novo_status = item
+        if novo_status != status_atual:
+            contagem["alternados"] += 1
+        if novo_status == "Disponivel":
+            contagem["devolvidos"] += 1
+        elif novo_status == "Emprestado":
+            contagem["emprestados"] += 1
+        log.debug("  lote: '%s' %s '%s'", nome_item, "->" if novo_status != status_atual else "continua", novo_status)
+
+    mqtt_client.publish(topico_resposta, json.dumps({
+        "lote": len(registros), "devolvidos": contagem["devolvidos"],
+        "emprestados": contagem["emprestados"], "erros": contagem["erros"], "falhas": len(recusadas), **eco}))
+    log.info("✓ LOTE de %s: %d leituras, %d alternadas (%d devolvidos, %d emprestados), %d sem cadastro%s.",
+             leitor_id, len(registros), contagem["alternados"], contagem["devolvidos"], contagem["emprestados"],
+             contagem["erros"], f", {len(recusadas)} recusadas pelo banco" if recusadas else "")
+
+
+def gravar_registro_tag(conn, uid, mqtt_client):
+    """
+    Modo de gravação: em vez de alternar o status, envia ao leitor o id e o nome
+    do item para serem gravados na tag. O leitor grava quando a tag for aproximada de novo.
+    """
+    if not conn:
+        return
+    uid_limpo = uid.strip()
+
+    try:
+        cursor = conn.cursor()
+        cursor.execute("SELECT id, nome FROM itens WHERE UPPER(TRIM(rfid)) = UPPER(%s)", (uid_limpo,))
+        item = cursor.fetchone()
+        cursor.close()
+    except psycopg2.Error as e:
+        log.error("✗ Erro ao interagir com o banco de dados: %s", e)
+        desfazer(conn)
+        return
+
+    if item:
+        item_id, nome_item = item[0], item[1]
+        nome_tag = limpar_para_lcd(nome_item)[:TAG_NOME_MAX]
+        payload = json.dumps({"uid": uid_limpo, "itemId": item_id, "nome": nome_tag})
+        mqtt_client.publish(MQTT_TOPIC_GRAVAR, payload, qos=1)
+        log.info("✓ Gravação solicitada: UID %s -> item %s '%s'. Aproxime a tag novamente.", uid_limpo, item_id, nome_tag)
+    else:
+        log.warning("✗ Item não encontrado no banco para o UID: %s; nada a gravar.", uid_limpo)
+        mqtt_client.publish(MQTT_TOPIC_RESPONSE, json.dumps({"erro": "Nao cadastrado"}))
+
+def faixa_do_topico(topico):
+    """Classe de tráfego pelo espaço de tópicos; o que não é carga nem telemetria é interativo."""
+    if topico.startswith(MQTT_PREFIXO_CARGA):
+        return FAIXA_CARGA
+    if topico.startswith(MQTT_PREFIXO_TELEMETRIA):
+        return FAIXA_TELEMETRIA
+    return FAIXA_INTERATIVA
+
+
 def on_message(client, userdata, msg):
+    if msg.topic == MQTT_TOPIC_PING:
+        # Benchmark de RTT do leitor: ecoa sem log para não distorcer a medida
+        client.publish(MQTT_TOPIC_PONG, msg.payload)
+        client.ack(msg.mid, msg.qos)
+        return
+    if msg.topic == MQTT_TOPIC_LOG:
+        nivel = msg.payload.decode("utf-8").strip().upper()
+        if nivel in ("DEBUG", "INFO", "WARNING", "ERROR"):
+            log.set_nivel(nivel)
+        client.ack(msg.mid, msg.qos)
+        return
+
+    # Só classifica: o banco fica para a thread da faixa, e a confirmação ao broker também
+    faixa = faixa_do_topico(msg.topic) if userdata.get('faixas', True) else FAIXA_INTERATIVA
+    if not userdata['escalonador'].enfileirar(faixa, tratar_mensagem, client, userdata, msg):
+        log.error("✗ Fila da faixa %s cheia (%d); mensagem de '%s' descartada.", faixa, FAIXA_FILA_MAX, msg.topic)
+        client.ack(msg.mid, msg.qos)
+
+
+def registrar_telemetria(userdata, leitor_id, dados):
+    """Estatísticas periódicas de um leitor: guarda a última e deixa no log de depuração."""
+    userdata['telemetria'][leitor_id] = dados
+    log.debug("Telemetria de %s: %s", leitor_id, dados)
+
+
+def tratar_mensagem(client, userdata, msg, reservada=False):
+    """
+    Roda na thread da faixa. A mensagem (QoS 1) só é confirmada ao broker depois de
+    processada: se o receptor cair com ela na fila, o broker a entrega de novo. Uma leitura
+    guardada nas pendentes do SupervisorBanco é confirmada quando a fila a levar ao banco.
+    """
+    guardada = False
+    try:
+        guardada = processar_mensagem(client, userdata, msg, reservada,
+                                      lambda: client.ack(msg.mid, msg.qos))
+    finally:
+        if not guardada:
+            client.ack(msg.mid, msg.qos)
+
+
+def processar_mensagem(client, userdata, msg, reservada, confirmar=None):
+    """Retorna True se a leitura ficou nas pendentes do banco: o ack fica com confirmar()."""
+    guardada = False
     json_string = msg.payload.decode("utf-8")
-    print(f"\nMensagem JSON recebida no tópico '{msg.topic}': {json_string}")
+    log.debug("Mensagem JSON recebida no tópico '%s': %s", msg.topic, json_string)
     try:
         data = json.loads(json_string)
-        uid_recebido = data['uid']
-        print(f"UID extraído do JSON: {uid_recebido}")
-        db_connection = userdata['db_conn']
+        if msg.topic.startswith(MQTT_TOPIC_TELEMETRIA_LEITOR):
+            registrar_telemetria(userdata, msg.topic[len(MQTT_TOPIC_TELEMETRIA_LEITOR):], data)
+            return
+        lote = data.get('lote')
+        # Um lote leva leitorId, boot e o tipo uma vez, e uid/seq/t por leitura
+        uids = [registro['uid'] for registro in lote] if lote is not None else [data['uid']]
+        log.debug("UIDs extraídas do JSON: %s", uids)
+        banco = userdata['banco']
         mqtt_client = userdata['mqtt_client']
-        atualizar_status_item(db_connection, uid_recebido, mqtt_client)
+        if userdata.get('modo') == 'cadastro':
+            # Só as leituras do leitor em cadastro; as demais ficam para o receptor normal
+            if data.get('cadastro') and data.get('leitorId') in userdata['leitores']:
+                cadastro = userdata['cadastro']
+                for uid_recebido in uids:
+                    if cadastro.adicionar(uid_recebido) and cadastro.completo:
+                        log.info("Todos os nomes foram atribuídos; encerrando o cadastro.")
+                        sair_da_sessao(mqtt_client, MQTT_TOPIC_CADASTRO, userdata['leitores'])
+                        break
+        elif userdata.get('modo') == 'auditoria':
+            if data.get('auditoria') and data.get('leitorId') in userdata['leitores']:
+                for uid_recebido in uids:
+                    situacao = userdata['auditoria'].registrar(uid_recebido)
+                    if situacao == "status":
+                        log.warning("! Auditoria: %s está no estoque, mas não consta como %s.",
+                                    uid_recebido, AUDITORIA_STATUS_ESPERADO)
+                    elif situacao == "inesperada":
+                        log.warning("? Auditoria: tag %s sem item no banco.", uid_recebido)
+                    else:
+                        log.debug("Auditoria: %s %s", uid_recebido, situacao)
+        elif data.get('cadastro') or data.get('auditoria'):
+            log.debug("Leitura de sessão de %s ignorada (tratada pelo receptor em --modo cadastro/auditoria)",
+                      data.get('leitorId'))
+        elif userdata.get('modo') == 'gravar':
+            for uid_recebido in uids:
+                banco.consultar(gravar_registro_tag, uid_recebido, mqtt_client)  # Só consulta: vai para uma réplica
+        else:
+            resposta = MQTT_TOPIC_CARGA_RESPONSE if msg.topic.startswith(MQTT_PREFIXO_CARGA) else MQTT_TOPIC_RESPONSE
+            if lote is not None:
+                guardada = not banco.processar(atualizar_lote, lote, mqtt_client, data['leitorId'], data['boot'],
+                                               userdata.get('ledger'), userdata.get('contadores'), resposta,
+                                               reservada=reservada, concluir=confirmar)
+            else:
+                leitura = (data['leitorId'], data['boot'], data['seq']) if 'seq' in data else None
+                guardada = not banco.processar(atualizar_status_item, uids[0], mqtt_client, leitura,
+                                               userdata.get('ledger'), userdata.get('contadores'), resposta,
+                                               reservada=reservada, concluir=confirmar)
+            with userdata['trava']:  # Faixas em threads diferentes
+                antes = userdata['processadas']
+                userdata['processadas'] = depois = antes + len(uids)
+            if depois // DEDUPE_LIMPEZA_A_CADA != antes // DEDUPE_LIMPEZA_A_CADA:
+                banco.processar(preparar_dedupe, reservada=reservada)
     except (json.JSONDecodeError, KeyError) as e:
-        print(f"Erro ao processar JSON: {e}")
+        log.error("Erro ao processar JSON: %s", e)
+    except ERROS_CONEXAO as e:
+        log.error("✗ Banco indisponível: %s", e)
+    return guardada
+
+def topicos_leitura(instancia, instancias, base=MQTT_TOPIC):
+    """
+    Tópicos de leitura desta instância sob `base` (MQTT_TOPIC, ou MQTT_TOPIC_CARGA para a
+    faixa de carga). Sozinha, assina todas as partições. Em cluster,
+    fica com as partições p em que p % instancias == instancia: uma UID cai sempre na mesma
+    partição, logo na mesma instância, e seus toggles seguem em ordem. As assinaturas são
+    compartilhadas ($share) para que, se duas instâncias reivindicarem a mesma partição
+    durante uma troca de escala, cada leitura ainda seja entregue a uma só.
+    """
+    particao, lote = base + "/p/", base + "/lote"
+    if instancias == 1:
+        return [base, particao + "+", lote]
+    prefixo = f"$share/{GRUPO_COMPARTILHADO}/"
+    # Firmware antigo e lotes: sem partição, o dedupe e o FOR UPDATE seguram
+    topicos = [prefixo + base, prefixo + lote]
+    topicos += [f"{prefixo}{particao}{p}" for p in range(PARTICOES) if p % instancias == instancia]
+    return topicos
+
 
 def on_connect(client, userdata, flags, rc, properties=None):
     if rc == 0:
-        print("Conectado ao Broker MQTT com sucesso!")
-        client.subscribe(MQTT_TOPIC)
-        print(f"Inscrito no tópico: {MQTT_TOPIC}")
+        log.info("Conectado ao Broker MQTT com sucesso!")
+        # QoS 1 nas leituras: o que a instância não confirmou é reentregue (e barrado pelo dedupe)
+        for topico in userdata['topicos_leitura']:
+            client.subscribe(topico, qos=1)
+        client.subscribe(MQTT_TOPIC_PING)
+        client.subscribe(MQTT_TOPIC_LOG)
+        client.subscribe(MQTT_TOPIC_TELEMETRIA_LEITOR + "+")
+        topicos = userdata['topicos_leitura'] + [MQTT_TOPIC_PING, MQTT_TOPIC_LOG, MQTT_TOPIC_TELEMETRIA_LEITOR + "+"]
+        log.info("Inscrito nos tópicos: %s", ", ".join(topicos))
+        prefixo = {'cadastro': MQTT_TOPIC_CADASTRO, 'auditoria': MQTT_TOPIC_AUDITORIA}.get(userdata.get('modo'))
+        if prefixo:
+            sessao_leitores(client, prefixo, userdata['leitores'], True)
+            log.info("Modo %s ligado em: %s", userdata['modo'], ", ".join(userdata['leitores']))
     else:
-        print(f"Falha ao conectar, código de retorno: {rc}\n")
+        log.error("Falha ao conectar, código de retorno: %s", rc)
+
+def on_connect_carga(client, userdata, flags, rc, properties=None):
+    """
+    Conexão própria da faixa de carga. O broker limita as mensagens sem confirmação por
+    conexão: numa só, uma carga represada na fila ocuparia a janela e seguraria os toques.
+    """
+    if rc == 0:
+        for topico in userdata['topicos_carga']:
+            client.subscribe(topico, qos=1)
+        log.info("Faixa de carga inscrita em: %s", ", ".join(userdata['topicos_carga']))
+    else:
+        log.error("Falha ao conectar a faixa de carga, código de retorno: %s", rc)
+
 
 if __name__ == "__main__":
-    db_conn = conectar_banco()
-    if not db_conn:
-        exit(1)
-    
-    user_data = {'db_conn': db_conn}
-    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, userdata=user_data)
+    parser = argparse.ArgumentParser(description="Receptor MQTT do sistema de estoque")
+    parser.add_argument("--modo", choices=["normal", "gravar", "cadastro", "auditoria"], default="normal",
+                        help="'gravar' grava id e nome do item em cada tag lida em vez de alternar o status; "
+                             "'cadastro' liga o modo cadastro em --leitor e grava em lote as tags novas; "
+                             "'auditoria' confere as tags vistas pelos --leitor contra o estoque, sem alternar nada")
+    parser.add_argument("--leitor", action="append",
+                        help="leitorId usado em --modo cadastro; em --modo auditoria pode ser repetido")
+    parser.add_argument("--relatorio", metavar="CSV",
+                        help="em --modo auditoria, grava ao sair as listas de faltando/status/inesperadas")
+    parser.add_argument("--nomes", metavar="CSV",
+                        help="nomes dos itens, na ordem em que as tags serão lidas; ao acabar, o cadastro encerra")
+    parser.add_argument("--log-nivel", choices=["DEBUG", "INFO", "WARNING", "ERROR"], default="INFO",
+                        help="nível inicial do log; pode ser trocado em execução publicando em " + MQTT_TOPIC_LOG)
+    parser.add_argument("--instancias", type=int, default=1,
+                        help="total de instâncias no cluster; cada uma fica com parte das partições")
+    parser.add_argument("--instancia", type=int, default=0,
+                        help="índice desta instância (0 .. instancias-1)")
+    parser.add_argument("--sem-faixas", action="store_true",
+                        help="uma fila e uma conexão MQTT para todo o tráfego, como antes das faixas "
+                             "(referência para --bench-faixas do ferramentas.py)")
+    parser.add_argument("--esquema", choices=["ledger", "legado"], default="legado",
+                        help="'legado' (padrão) reescreve status na linha de itens, copiado antes de status_atual; "
+                             "'ledger' grava cada toggle em movimentacoes e o status em status_atual "
+                             "(itens.status deixa de ser atualizado: consulte a view itens_com_status)")
+    parser.add_argument("--replicas", metavar="HOST:PORTA,...",
+                        help="réplicas de leitura (substitui DB_REPLICAS); vazio = consultas no primário")
+    args = parser.parse_args()
+    if not 0 <= args.instancia < args.instancias:
+        parser.error("--instancia deve estar entre 0 e --instancias - 1")
+    if args.modo in ("cadastro", "auditoria") and not args.leitor:
+        parser.error(f"--modo {args.modo} precisa de --leitor")
+    if args.modo == "cadastro" and len(args.leitor) > 1:
+        parser.error("--modo cadastro usa um só --leitor: os nomes seguem a ordem de leitura")
+    try:
+        replicas = ler_replicas(args.replicas)
+    except ValueError:
+        parser.error("--replicas deve ser host:porta[,host:porta...]")
+
+    log.set_nivel(args.log_nivel)
+    # Todas as conexões saem do supervisor; o esquema é preparado na primeira que der certo
+    banco = abrir_supervisor(args.esquema, replicas)
+
+    # Banco fora na partida não impede a subida: as leituras esperam nas pendentes do supervisor
+    try:
+        banco.preparar_esquema()
+    except ERROS_CONEXAO as e:
+        log.warning("Banco fora do ar na partida (%s); subindo assim mesmo.", str(e).strip())
+
+    # As partições do ledger são mantidas por uma thread própria, fora da thread do MQTT
+    ledger = LedgerMovimentacoes(banco) if args.esquema == "ledger" else None
+    user_data = {'banco': banco, 'modo': args.modo, 'processadas': 0, 'ledger': ledger,
+                 'topicos_leitura': topicos_leitura(args.instancia, args.instancias),
+                 'topicos_carga': topicos_leitura(args.instancia, args.instancias, MQTT_TOPIC_CARGA),
+                 'faixas': not args.sem_faixas, 'escalonador': Escalonador(), 'trava': threading.Lock(),
+                 'telemetria': {}}
+    if args.sem_faixas:
+        user_data['topicos_leitura'] += user_data['topicos_carga']
+
+    cadastro = None
+    if args.modo == "cadastro":
+        cadastro_conn = banco.conectar(tentativas=BANCO_CONECTAR_TENTATIVAS)  # Sessão própria: tabela temporária
+        if not cadastro_conn:
+            sair(1)
+        nomes = ler_nomes(args.nomes) if args.nomes else None
+        cadastro = CadastroEmLote(cadastro_conn, nomes)
+        user_data.update(cadastro=cadastro, leitores=args.leitor)
+        if nomes is None:
+            log.info("Cadastro sem lista de nomes: cada item entra como 'Item <UID>'.")
+        else:
+            log.info("Cadastro: %d nomes na lista.", len(nomes))
+    # Assinaturas compartilhadas ($share) pedem MQTT v5
+    protocolo = mqtt.MQTTv5 if args.instancias > 1 else mqtt.MQTTv311
+    # Confirmação manual: a mensagem só é confirmada depois que a thread da faixa a processa
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, userdata=user_data, protocol=protocolo, manual_ack=True)
     
     client.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
     client.on_connect = on_connect
     client.on_message = on_message
+
+    cliente_carga = None
+    if not args.sem_faixas:
+        cliente_carga = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, userdata=user_data, protocol=protocolo,
+                                    manual_ack=True)
+        cliente_carga.username_pw_set(MQTT_USERNAME, MQTT_PASSWORD)
+        cliente_carga.on_connect = on_connect_carga
+        cliente_carga.on_message = on_message
     
     client.user_data_set(user_data)
     client._userdata['mqtt_client'] = client
 
+    auditoria = None
+    if args.modo == "auditoria":
+        auditoria_conn = banco.conectar_leitura()  # Inventário relido a cada 10 s: a réplica dá conta
+        if not auditoria_conn:
+            sair(1)
+        auditoria = Auditoria(auditoria_conn, args.esquema == "ledger", client)
+        auditoria.iniciar()
+        user_data.update(auditoria=auditoria, leitores=args.leitor)
+
+    # Em cluster só a instância 0 publica; as partições das outras entram pela reconciliação
+    contadores = None
+    servidor_painel = None
+    if args.modo == "normal" and args.instancia == 0:
+        contadores = ContadoresEstoque(banco, args.esquema == "ledger", client,
+                                       intervalo_s=CONTADORES_RECONCILIAR_S if args.instancias == 1
+                                       else CONTADORES_RECONCILIAR_CLUSTER_S, cluster=args.instancias > 1)
+        servidor_painel = servir_contadores(contadores)
+        user_data['contadores'] = contadores
+
+    sessao = MQTT_TOPIC_CADASTRO if cadastro else MQTT_TOPIC_AUDITORIA if auditoria else None
+    guardas = []
     try:
-        print("Tentando conectar ao broker MQTT...")
+        log.info("Tentando conectar ao broker MQTT...")
+        if sessao:
+            guardas = guardas_de_sessao(sessao, args.leitor)  # Antes do "1": uma queda já encontra o will
+        if cliente_carga:
+            cliente_carga.connect(MQTT_BROKER_URL, 1883, 60)
+            cliente_carga.loop_start()
         client.connect(MQTT_BROKER_URL, 1883, 60)
         client.loop_forever()
     except KeyboardInterrupt:
-        print("\nPrograma interrompido.")
+        log.info("Programa interrompido.")
     except Exception as e:
-        print(f"Ocorreu um erro: {e}")
+        log.error("Ocorreu um erro: %s", e)
     finally:
-        if db_conn:
-            db_conn.close()
-            print("Conexão com o banco de dados fechada.")
\ No newline at end of file
+        if sessao and client.is_connected():
+            sair_da_sessao(client, sessao, args.leitor)
+            client.loop(timeout=1.0)  # Entrega os "0" antes de sair
+        if guardas:
+            encerrar_guardas(guardas, sessao, args.leitor)
+        if cliente_carga:
+            cliente_carga.loop_stop()
+            cliente_carga.disconnect()
+        user_data['escalonador'].parar()
+        if cadastro:
+            cadastro.parar()
+        if auditoria:
+            auditoria.parar(args.relatorio)
+        if servidor_painel:
+            parar_servidor(servidor_painel)
+        if contadores:
+            contadores.parar()
+        if ledger:
+            ledger.parar()
+        banco.parar()
+        log.parar()
@@ -0,0 +1,292 @@
+"""
+Testes do receptor.py sem broker nem Postgres: o banco é um dublê em memória que entende
+só os comandos de SQL_LEITURA e as consultas de contadores e auditoria.
+
+    python3 -m unittest discover tests
+"""
+import os
+import sys
+import unittest
+
+import psycopg2
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import receptor  # noqa: E402
+
+receptor.log.set_nivel("ERROR")
+
+
+class BancoFalso:
+    """Itens {uid: [id, nome, status, categoria]} com commit/rollback e SAVEPOINT, como uma transação."""
+
+    def __init__(self, itens):
+        self.confirmado = {uid.upper(): list(item) for uid, item in itens.items()}
+        self.leituras = set()
+        self.recusar = set()  # UIDs cujo UPDATE o "banco" recusa (psycopg2.DataError)
+        self.falhar_commit = False
+        self.ao_consultar = None  # Chamado entre o snapshot e o resultado da consulta dos contadores
+        self.commits = 0
+        self.rollbacks = 0
+        self._reabrir()
+
+    def _reabrir(self):
+        self.itens = {uid: list(item) for uid, item in self.confirmado.items()}
+        self._leituras = set(self.leituras)
+
+    def conexao(self):
+        return ConexaoFalsa(self)
+
+
+class ConexaoFalsa:
+    closed = False
+
+    def __init__(self, banco):
+        self.banco = banco
+
+    def cursor(self):
+        return CursorFalso(self)
+
+    def commit(self):
+        if self.banco.falhar_commit:
+            raise psycopg2.OperationalError("conexão perdida no commit")
+        self.banco.confirmado = {uid: list(item) for uid, item in self.banco.itens.items()}
+        self.banco.leituras = set(self.banco._leituras)
+        self.banco.commits += 1
+
+    def rollback(self):
+        self.banco._reabrir()
+        self.banco.rollbacks += 1
+
+
+class CursorFalso:
+    def __init__(self, conn):
+        self.connection = conn
+        self._banco = conn.banco
+        self._linhas = []
+        self._savepoint = None
+        self.rowcount = 0
+
+    def execute(self, sql, params=()):
+        banco = self._banco
+        self._linhas = []
+        if sql == receptor.SQL_LEITURA["item"]:
+            item = banco.itens.get(params[0].upper())
+            self._linhas = [tuple(item[:3])] if item else []
+        elif sql == receptor.SQL_LEITURA["registrar_leitura"]:
+            self.rowcount = 0 if params in banco._leituras else 1
+            banco._leituras.add(params)
+        elif sql == receptor.SQL_LEITURA["itens_status"]:
+            status, _, uid = params
+            if uid.upper() in banco.recusar:
+                raise psycopg2.DataError(f"valor recusado para {uid}")
+            banco.itens[uid.upper()][2] = status
+        elif sql == "SAVEPOINT leitura":
+            self._savepoint = ({uid: list(item) for uid, item in banco.itens.items()}, set(banco._leituras))
+        elif sql == "ROLLBACK TO SAVEPOINT leitura":
+            banco.itens, banco._leituras = self._savepoint
+        elif sql.startswith("SELECT 1 FROM information_schema.columns"):
+            self._linhas = [(1,)]
+        elif sql.startswith("SELECT id, categoria, status_vigente"):
+            if banco.ao_consultar:
+                banco.ao_consultar()
+            self._linhas = [(i, cat, status) for i, _, status, cat in banco.confirmado.values()]
+        elif sql.startswith("SELECT id, UPPER(TRIM(rfid)), nome, status_vigente"):
+            self._linhas = [(i, uid, nome, status) for uid, (i, nome, status, _) in banco.confirmado.items()]
+        elif sql.startswith(("SET TRANSACTION", "SELECT 1")):
+            pass
+        else:
+            raise AssertionError(f"SQL inesperado no dublê: {sql}")
+
+    def fetchone(self):
+        return self._linhas[0] if self._linhas else None
+
+    def fetchall(self):
+        return list(self._linhas)
+
+    def close(self):
+        pass
+
+
+class SupervisorFalso:
+    """O que ContadoresEstoque usa do SupervisorBanco: executar(funcao) numa conexão."""
+
+    def __init__(self, banco):
+        self.banco = banco
+
+    def executar(self, funcao, *args, tentativas=None):
+        return funcao(self.banco.conexao(), *args)
+
+
+class MqttFalso:
+    def __init__(self):
+        self.publicados = []
+
+    def publish(self, topico, payload, *args, **kwargs):
+        self.publicados.append((topico, payload))
+
+
+def itens_de_teste():
+    return {
+        "A1": (1, "Furadeira", "Disponivel", "Ferramentas"),
+        "B2": (2, "Serra", "Emprestado", "Ferramentas"),
+        "C3": (3, "Trena", "Disponivel", "Medição"),
+    }
+
+
+class TestContadoresEstoque(unittest.TestCase):
+    def setUp(self):
+        self.banco = BancoFalso(itens_de_teste())
+        self.contadores = receptor.ContadoresEstoque(SupervisorFalso(self.banco), ledger_ativo=False,
+                                                     intervalo_s=3600)
+
+    def tearDown(self):
+        self.contadores.parar()
+
+    def alternar(self, uid, leitura):
+        """Toggle como o receptor faz: alternar_item e confirmar_toggles na mesma transação."""
+        conn = self.banco.conexao()
+        item_id, _, anterior, novo = receptor.alternar_item(conn.cursor(), uid, leitura, None, None)
+        toggles = [(leitura, item_id, anterior, novo)] if novo != anterior else []
+        receptor.confirmar_toggles(conn, self.contadores, toggles, [] if toggles else [leitura])
+
+    def test_carga_inicial(self):
+        agora = self.contadores.instantaneo()
+        self.assertEqual(agora["porStatus"], {"Disponivel": 2, "Emprestado": 1})
+        self.assertEqual(agora["porCategoria"]["Ferramentas"], {"Disponivel": 1, "Emprestado": 1})
+        self.assertEqual(agora["total"], 3)
+
+    def test_toggle_ajusta_status_e_categoria(self):
+        self.alternar("A1", ("leitor", 1, 1))
+        agora = self.contadores.instantaneo()
+        self.assertEqual(agora["porStatus"], {"Disponivel": 1, "Emprestado": 2})
+        self.assertEqual(agora["porCategoria"]["Ferramentas"], {"Disponivel": 0, "Emprestado": 2})
+        self.assertEqual(agora["porCategoria"]["Medição"], {"Disponivel": 1})
+
+    def test_leitura_repetida_nao_conta_duas_vezes(self):
+        self.alternar("A1", ("leitor", 1, 1))
+        self.alternar("A1", ("leitor", 1, 1))
+        self.assertEqual(self.contadores.instantaneo()["porStatus"], {"Disponivel": 1, "Emprestado": 2})
+
+    def test_toggle_durante_a_reconciliacao_vai_por_cima_do_snapshot(self):
+        # O toggle chega entre o snapshot e o resultado da consulta: não está no que o banco devolve
+        fora_do_snapshot = {"C3": ("leitor", 1, 7)}
+
+        def toggle_concorrente():
+            self.banco.ao_consultar = None
+            confirmado = self.banco.confirmado
+            self.alternar("C3", fora_do_snapshot["C3"])
+            self.banco.confirmado, self.banco.itens = confirmado, confirmado
+
+        self.banco.ao_consultar = toggle_concorrente
+        self.assertTrue(self.contadores.reconciliar())
+        self.assertEqual(self.contadores.instantaneo()["porStatus"], {"Disponivel": 1, "Emprestado": 2})
+        self.assertEqual(self.contadores.instantaneo()["porCategoria"]["Medição"], {"Disponivel": 0, "Emprestado": 1})
+
+    def test_commit_em_duvida_aplicado_quando_o_dedupe_o_acha(self):
+        leitura = ("leitor", 1, 2)
+        self.banco.falhar_commit = True
+        conn = self.banco.conexao()
+        item = receptor.alternar_item(conn.cursor(), "B2", leitura, None, None)
+        with self.assertRaises(psycopg2.OperationalError):
+            receptor.confirmar_toggles(conn, self.contadores, [(leitura, item[0], item[2], item[3])], [])
+        self.assertEqual(self.contadores.instantaneo()["porStatus"], {"Disponivel": 2, "Emprestado": 1})
+
+        # O commit tinha chegado ao banco; o SupervisorBanco repete e o dedupe barra a leitura
+        self.banco.falhar_commit = False
+        self.banco.confirmado["B2"][2] = "Disponivel"
+        self.banco.leituras.add(leitura)
+        self.banco._reabrir()
+        self.alternar("B2", leitura)
+        self.assertEqual(self.contadores.instantaneo()["porStatus"], {"Disponivel": 3, "Emprestado": 0})
+
+    def test_reconciliacao_corrige_divergencia(self):
+        self.banco.confirmado["A1"][2] = "Emprestado"  # Toggle de outra instância
+        self.assertTrue(self.contadores.reconciliar())
+        self.assertEqual(self.contadores.instantaneo()["porStatus"], {"Disponivel": 1, "Emprestado": 2})
+
+
+class TestAuditoria(unittest.TestCase):
+    def setUp(self):
+        self.banco = BancoFalso(itens_de_teste())
+        self.auditoria = receptor.Auditoria(self.banco.conexao(), ledger_ativo=False)
+
+    def test_classificacao_na_chegada(self):
+        self.assertEqual(self.auditoria.registrar("a1"), "ok")
+        self.assertEqual(self.auditoria.registrar("A1"), "repetida")
+        self.assertEqual(self.auditoria.registrar("B2"), "status")
+        self.assertEqual(self.auditoria.registrar("FF"), "inesperada")
+        self.assertEqual(self.auditoria.registrar("FF"), "repetida")
+
+    def test_reconciliacao_monta_as_listas(self):
+        for uid in ("A1", "B2", "FF"):
+            self.auditoria.registrar(uid)
+        resumo = self.auditoria.reconciliar()
+        self.assertEqual((resumo["esperados"], resumo["conferidos"], resumo["faltando"],
+                          resumo["statusErrado"], resumo["inesperadas"], resumo["leituras"]), (2, 1, 1, 1, 1, 3))
+        self.assertEqual([linha[:2] for linha in self.auditoria.listas["faltando"]], [(3, "C3")])
+        self.assertEqual([linha[:2] for linha in self.auditoria.listas["status"]], [(2, "B2")])
+        self.assertEqual(self.auditoria.listas["inesperada"], [(None, "FF", None, None)])
+
+    def test_tag_cadastrada_no_meio_da_sessao_deixa_de_ser_inesperada(self):
+        self.assertEqual(self.auditoria.registrar("D4"), "inesperada")
+        self.banco.confirmado["D4"] = [4, "Nível", "Disponivel", None]
+        resumo = self.auditoria.reconciliar()
+        self.assertEqual((resumo["esperados"], resumo["conferidos"], resumo["inesperadas"]), (3, 1, 0))
+
+
+class TestTopicosLeitura(unittest.TestCase):
+    def test_instancia_unica_assina_tudo_sem_share(self):
+        base = receptor.MQTT_TOPIC
+        self.assertEqual(receptor.topicos_leitura(0, 1), [base, base + "/p/+", base + "/lote"])
+
+    def test_cluster_divide_as_particoes_sem_sobra_nem_repeticao(self):
+        for instancias in (2, 3, 4):
+            particoes = []
+            for instancia in range(instancias):
+                topicos = receptor.topicos_leitura(instancia, instancias, receptor.MQTT_TOPIC_CARGA)
+                self.assertTrue(all(t.startswith(f"$share/{receptor.GRUPO_COMPARTILHADO}/") for t in topicos))
+                self.assertIn(f"$share/{receptor.GRUPO_COMPARTILHADO}/{receptor.MQTT_TOPIC_CARGA}/lote", topicos)
+                particoes += [int(t.rsplit("/", 1)[1]) for t in topicos if "/p/" in t]
+            self.assertEqual(sorted(particoes), list(range(receptor.PARTICOES)))
+
+
+class TestAlternarLote(unittest.TestCase):
+    def setUp(self):
+        self.banco = BancoFalso(itens_de_teste())
+        self.mqtt = MqttFalso()
+        self.registros = [{"uid": "C3", "seq": 3}, {"uid": "A1", "seq": 1}, {"uid": "B2", "seq": 2}]
+
+    def test_lote_inteiro_numa_transacao(self):
+        resultados, recusadas = receptor.alternar_lote(self.banco.conexao(), self.registros, "leitor", 1,
+                                                       None, None, None)
+        self.assertEqual([uid for uid, _, _ in resultados], ["A1", "B2", "C3"])  # Em ordem de UID
+        self.assertEqual(recusadas, [])
+        self.assertEqual([self.banco.confirmado[u][2] for u in ("A1", "B2", "C3")],
+                         ["Emprestado", "Disponivel", "Emprestado"])
+
+    def test_savepoint_deixa_de_fora_so_a_recusada(self):
+        self.banco.recusar.add("B2")
+        resultados, recusadas = receptor.alternar_lote(self.banco.conexao(), self.registros, "leitor", 1,
+                                                       None, None, None, por_item=True)
+        self.assertEqual(recusadas, ["B2"])
+        self.assertEqual([uid for uid, _, _ in resultados], ["A1", "C3"])
+        self.assertEqual([self.banco.confirmado[u][2] for u in ("A1", "B2", "C3")],
+                         ["Emprestado", "Emprestado", "Emprestado"])
+        self.assertNotIn(("leitor", 1, 2), self.banco.leituras)  # O dedupe da recusada também volta
+
+    def test_atualizar_lote_refaz_leitura_a_leitura(self):
+        self.banco.recusar.add("B2")
+        receptor.atualizar_lote(self.banco.conexao(), self.registros, self.mqtt, "leitor", 1)
+        self.assertEqual(self.banco.rollbacks, 1)  # A primeira tentativa, com o lote inteiro
+        self.assertEqual(self.banco.commits, 1)
+        self.assertEqual([self.banco.confirmado[u][2] for u in ("A1", "B2", "C3")],
+                         ["Emprestado", "Emprestado", "Emprestado"])
+        topico, payload = self.mqtt.publicados[-1]
+        self.assertEqual(topico, receptor.MQTT_TOPIC_RESPONSE)
+        self.assertEqual(receptor.json.loads(payload),
+                         {"lote": 3, "devolvidos": 0, "emprestados": 2, "erros": 0, "falhas": 1,
+                          "leitorId": "leitor", "seq": 3})
+
+
+if __name__ == "__main__":
+    unittest.main()